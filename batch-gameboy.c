@@ -0,0 +1,438 @@
+/**
+ * @file batch-gameboy.c
+ * @brief Runs a manifest of (ROM, cycle budget, input script) jobs on a
+ *        work-stealing pool, and writes the results of all of them to a
+ *        single file
+ *
+ * Manifest: one job per line, blank lines and lines starting with '#'
+ * being ignored; fields are separated by spaces, double quotes allowing
+ * spaces in a field:
+ *     "rom file.gb" cycles [input_script]
+ * Input script: one event per line, in increasing cycle order:
+ *     cycle press|release RIGHT|LEFT|UP|DOWN|A|B|SELECT|START
+ *
+ * @date 2020
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <ctype.h>
+#include <time.h>
+#include <stdatomic.h>
+#include <inttypes.h>
+
+#include "gameboy.h"
+#include "joypad.h"
+#include "work_pool.h"
+#include "util.h"
+#include "error.h"
+
+#define DEFAULT_SLICE_CYCLES (GB_CYCLES_PER_S / 16) // emulated cycles run per turn
+#define ACTIVE_JOBS_PER_WORKER 4 // bounds the number of gameboys alive at once
+#define MAX_LINE 4096
+#define MAX_FIELDS 3
+
+#define FNV_OFFSET 0xCBF29CE484222325ULL
+#define FNV_PRIME  0x100000001B3ULL
+
+// ======================================================================
+typedef struct {
+    uint64_t cycle;
+    bit_t pressed;
+    gb_key_t key;
+} input_event_t;
+
+typedef enum { JOB_PENDING, JOB_RUNNING, JOB_DONE } job_state_t;
+
+/**
+ * @brief Settings and admission count shared by all the jobs of a run
+ */
+typedef struct {
+    atomic_size_t active_jobs;
+    size_t max_active_jobs;
+    uint64_t slice_cycles;
+    boot_mode_t boot;
+} batch_t;
+
+typedef struct {
+    batch_t* batch;
+    char* rom;
+    uint64_t budget;
+    input_event_t* events;
+    size_t nb_events;
+    size_t next_event;
+
+    job_state_t state;
+    gameboy_t* gb;
+    FILE* serial_stream;
+    char* serial;
+    size_t serial_size;
+    double started;  // s, monotonic
+    double run_time; // s spent in slices
+    double wall_time; // s from first to last slice
+
+    int err;
+    cpu_t cpu;       // CPU state at the end
+    uint64_t cycles; // cycles run
+    uint64_t mem_hash;
+} job_t;
+
+// ======================================================================
+static double now_s(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double) ts.tv_sec + (double) ts.tv_nsec * 1e-9;
+}
+
+// ======================================================================
+static void error(const char* pgm, const char* msg)
+{
+    fputs("ERROR: ", stderr);
+    if (msg != NULL) fputs(msg, stderr);
+    fprintf(stderr, "\nusage:    %s [-f] manifest results_file [workers [slice_cycles]]\n", pgm);
+    fprintf(stderr, "examples: %s nightly.txt results.txt\n", pgm);
+    fprintf(stderr, "          %s nightly.txt results.txt 8 262144\n", pgm);
+    fprintf(stderr, "          %s -f nightly.txt results.txt   (skips the boot ROM)\n", pgm);
+}
+
+// ======================================================================
+/**
+ * @brief splits a line into fields (in place); returns the number of fields
+ */
+static size_t split_fields(char* line, char* fields[MAX_FIELDS])
+{
+    size_t nb = 0;
+    char* p = line;
+    while (nb < MAX_FIELDS) {
+        while (isspace((unsigned char) *p)) ++p;
+        if (*p == '\0') break;
+        if (*p == '"') {
+            fields[nb++] = ++p;
+            while (*p != '\0' && *p != '"') ++p;
+        } else {
+            fields[nb++] = p;
+            while (*p != '\0' && !isspace((unsigned char) *p)) ++p;
+        }
+        if (*p != '\0') *p++ = '\0';
+    }
+    return nb;
+}
+
+// ======================================================================
+static int parse_key(const char* name, gb_key_t* key)
+{
+    static const char* const names[NB_GB_KEYS] = {
+        "RIGHT", "LEFT", "UP", "DOWN", "A", "B", "SELECT", "START"
+    };
+    for (int k = 0; k < NB_GB_KEYS; ++k) {
+        if (strcmp(name, names[k]) == 0) {
+            *key = (gb_key_t) k;
+            return ERR_NONE;
+        }
+    }
+    return ERR_BAD_PARAMETER;
+}
+
+// ======================================================================
+static int load_script(job_t* job, const char* filename)
+{
+    FILE* file = fopen(filename, "r");
+    M_EXIT_IF(file == NULL, ERR_IO, "cannot open input script \"%s\"", filename);
+
+    char line[MAX_LINE];
+    size_t capacity = 0;
+    int err = ERR_NONE;
+    while (err == ERR_NONE && fgets(line, sizeof(line), file) != NULL) {
+        char* fields[MAX_FIELDS] = { NULL };
+        if (line[0] == '#' || split_fields(line, fields) == 0) continue;
+
+        input_event_t event = { .cycle = strtoull(fields[0], NULL, 0) };
+        const int press = fields[1] != NULL && strcmp(fields[1], "press") == 0;
+        const int release = fields[1] != NULL && strcmp(fields[1], "release") == 0;
+        if ((!press && !release) || fields[2] == NULL || parse_key(fields[2], &event.key) != ERR_NONE ||
+            (job -> nb_events > 0 && event.cycle < job -> events[job -> nb_events - 1].cycle)) {
+            err = ERR_BAD_PARAMETER;
+            break;
+        }
+        event.pressed = (bit_t) press;
+
+        if (job -> nb_events == capacity) {
+            capacity = capacity == 0 ? 16 : 2 * capacity;
+            input_event_t* more = realloc(job -> events, capacity * sizeof(input_event_t));
+            if (more == NULL) {
+                err = ERR_MEM;
+                break;
+            }
+            job -> events = more;
+        }
+        job -> events[job -> nb_events++] = event;
+    }
+
+    fclose(file);
+    return err;
+}
+
+// ======================================================================
+static int load_manifest(const char* filename, job_t** jobs, size_t* nb_jobs)
+{
+    FILE* file = fopen(filename, "r");
+    M_EXIT_IF(file == NULL, ERR_IO, "cannot open manifest \"%s\"", filename);
+
+    char line[MAX_LINE];
+    size_t capacity = 0;
+    size_t line_nb = 0;
+    int err = ERR_NONE;
+    while (err == ERR_NONE && fgets(line, sizeof(line), file) != NULL) {
+        ++line_nb;
+        char* fields[MAX_FIELDS] = { NULL };
+        const size_t nb = line[0] == '#' ? 0 : split_fields(line, fields);
+        if (nb == 0) continue;
+        if (nb < 2) {
+            fprintf(stderr, "%s:%zu: expected a ROM and a cycle budget\n", filename, line_nb);
+            err = ERR_BAD_PARAMETER;
+            break;
+        }
+
+        if (*nb_jobs == capacity) {
+            capacity = capacity == 0 ? 64 : 2 * capacity;
+            job_t* more = realloc(*jobs, capacity * sizeof(job_t));
+            if (more == NULL) {
+                err = ERR_MEM;
+                break;
+            }
+            *jobs = more;
+        }
+        job_t* const job = *jobs + *nb_jobs;
+        zero_init_ptr(job);
+        ++(*nb_jobs);
+
+        job -> rom = strdup(fields[0]);
+        job -> budget = strtoull(fields[1], NULL, 0);
+        if (job -> rom == NULL) {
+            err = ERR_MEM;
+        } else if (nb > 2 && (err = load_script(job, fields[2])) != ERR_NONE) {
+            fprintf(stderr, "%s:%zu: invalid input script \"%s\"\n", filename, line_nb, fields[2]);
+        }
+    }
+
+    fclose(file);
+    return err;
+}
+
+// ======================================================================
+static uint64_t work_ram_hash(const gameboy_t* gb)
+{
+    const memory_t* const mem = gb -> components[0].mem;
+    uint64_t hash = FNV_OFFSET;
+    for (size_t i = 0; mem != NULL && i < mem -> size; ++i) {
+        hash = (hash ^ mem -> memory[i]) * FNV_PRIME;
+    }
+    return hash;
+}
+
+// ======================================================================
+static int job_start(job_t* job)
+{
+    job -> gb = calloc(1, sizeof(gameboy_t));
+    if (job -> gb == NULL) return ERR_MEM;
+
+    job -> serial_stream = open_memstream(&(job -> serial), &(job -> serial_size));
+    if (job -> serial_stream == NULL) return ERR_MEM;
+
+    M_REQUIRE_NO_ERR(gameboy_create_with_boot(job -> gb, job -> rom, job -> batch -> boot));
+    // only CPU, memory and serial output are reported: no frame to draw
+    M_REQUIRE_NO_ERR(gameboy_set_render_policy(job -> gb, RENDER_NEVER, 0));
+    return gameboy_set_serial(job -> gb, job -> serial_stream);
+}
+
+// ======================================================================
+static void job_finish(job_t* job)
+{
+    if (job -> gb != NULL) {
+        job -> cpu = job -> gb -> cpu;
+        job -> cycles = job -> gb -> cycles;
+        job -> mem_hash = work_ram_hash(job -> gb);
+        gameboy_free(job -> gb);
+        free(job -> gb);
+        job -> gb = NULL;
+    }
+    if (job -> serial_stream != NULL) {
+        fclose(job -> serial_stream); // sets serial and serial_size
+        job -> serial_stream = NULL;
+    }
+    job -> wall_time = now_s() - job -> started;
+    job -> state = JOB_DONE;
+    atomic_fetch_sub(&(job -> batch -> active_jobs), 1);
+}
+
+// ======================================================================
+/**
+ * @brief runs one slice of a job, stopping at input events to apply them
+ */
+static work_status_t job_slice(void* task)
+{
+    job_t* const job = task;
+    batch_t* const batch = job -> batch;
+
+    if (job -> state == JOB_PENDING) {
+        if (atomic_fetch_add(&(batch -> active_jobs), 1) >= batch -> max_active_jobs) {
+            atomic_fetch_sub(&(batch -> active_jobs), 1);
+            return WORK_AGAIN;
+        }
+        job -> state = JOB_RUNNING;
+        job -> started = now_s();
+        job -> err = job_start(job);
+        if (job -> err != ERR_NONE) {
+            job_finish(job);
+            return WORK_DONE;
+        }
+    }
+
+    const double start = now_s();
+    gameboy_t* const gb = job -> gb;
+    const uint64_t slice_end = gb -> cycles + batch -> slice_cycles < job -> budget ?
+                               gb -> cycles + batch -> slice_cycles : job -> budget;
+    while (job -> err == ERR_NONE && gb -> cycles < slice_end) {
+        for (; job -> next_event < job -> nb_events &&
+               job -> events[job -> next_event].cycle <= gb -> cycles; ++(job -> next_event)) {
+            const input_event_t* const e = job -> events + job -> next_event;
+            job -> err = e -> pressed ? joypad_key_pressed(&(gb -> pad), e -> key)
+                                      : joypad_key_released(&(gb -> pad), e -> key);
+        }
+        uint64_t until = slice_end;
+        if (job -> next_event < job -> nb_events && job -> events[job -> next_event].cycle < until) {
+            until = job -> events[job -> next_event].cycle;
+        }
+        if (job -> err == ERR_NONE) {
+            job -> err = gameboy_run_until(gb, until);
+        }
+    }
+    job -> run_time += now_s() - start;
+
+    if (job -> err != ERR_NONE || gb -> cycles >= job -> budget) {
+        job_finish(job);
+        return WORK_DONE;
+    }
+    return WORK_AGAIN;
+}
+
+// ======================================================================
+#define PRREG  "0x%02" PRIX8
+#define PRPAIR "0x%04" PRIX16
+static void cpu_dump(FILE* file, const cpu_t* cpu)
+{
+    fprintf(file, "REGS: " PRREG ", " PRREG ", " PRREG ", " PRREG ", " PRREG ", " PRREG ", " PRREG ", " PRREG "\n",
+            cpu->A, cpu->B, cpu->C, cpu->D, cpu->E, cpu->F, cpu->H, cpu->L);
+    fprintf(file, "REGPAIRS: " PRPAIR ", " PRPAIR ", " PRPAIR ", " PRPAIR "\n",
+            cpu->AF, cpu->BC,  cpu->DE, cpu->HL);
+    fprintf(file, "PC: " PRPAIR "\n", cpu->PC);
+    fprintf(file, "SP: " PRPAIR "\n", cpu->SP);
+    fprintf(file, "IME: %u, IE: " PRREG ", IF: " PRREG ", HALT: %u\n",
+            cpu->IME, cpu->IE, cpu->IF, cpu->HALT);
+}
+
+// ======================================================================
+static void serial_dump(FILE* file, const char* bytes, size_t size)
+{
+    fputs("serial: \"", file);
+    for (size_t i = 0; i < size; ++i) {
+        const unsigned char c = (unsigned char) bytes[i];
+        if (c == '\n') fputs("\\n", file);
+        else if (c == '"' || c == '\\') fprintf(file, "\\%c", c);
+        else if (isprint(c)) fputc(c, file);
+        else fprintf(file, "\\x%02X", c);
+    }
+    fputs("\"\n", file);
+}
+
+// ======================================================================
+static int write_results(const char* filename, const job_t* jobs, size_t nb_jobs)
+{
+    FILE* file = fopen(filename, "w");
+    M_EXIT_IF(file == NULL, ERR_IO, "cannot open file \"%s\" for writing", filename);
+
+    for (size_t i = 0; i < nb_jobs; ++i) {
+        const job_t* const job = jobs + i;
+        fprintf(file, "job %zu: %s\n", i, job -> rom);
+        if (job -> err == ERR_NONE) {
+            fprintf(file, "status: ok\n");
+        } else {
+            fprintf(file, "status: error: %s\n", ERR_MESSAGES[job -> err - ERR_NONE]);
+        }
+        fprintf(file, "cycles: %" PRIu64 "\n", job -> cycles);
+        fprintf(file, "time: %.6f s (wall %.6f s)\n", job -> run_time, job -> wall_time);
+        cpu_dump(file, &(job -> cpu));
+        fprintf(file, "memory: 0x%016" PRIX64 "\n", job -> mem_hash);
+        serial_dump(file, job -> serial, job -> serial_size);
+        fputc('\n', file);
+    }
+
+    const int err = ferror(file) ? ERR_IO : ERR_NONE;
+    fclose(file);
+    return err;
+}
+
+// ======================================================================
+int main(int argc, char* argv[])
+{
+    const char* const pgm = argv[0];
+    boot_mode_t boot = BOOT_WITH_ROM;
+    if (argc > 1 && strcmp(argv[1], "-f") == 0) {
+        boot = BOOT_FAST;
+        --argc;
+        ++argv;
+    }
+
+    if (argc < 3) {
+        error(pgm, "please provide a manifest and a results file");
+        return 1;
+    }
+
+    size_t nb_workers = argc > 3 ? (size_t) atoll(argv[3]) : 0;
+    if (nb_workers == 0) nb_workers = work_pool_default_workers();
+    batch_t batch = {
+        .max_active_jobs = ACTIVE_JOBS_PER_WORKER * nb_workers,
+        .slice_cycles = argc > 4 ? (uint64_t) atoll(argv[4]) : DEFAULT_SLICE_CYCLES,
+        .boot = boot
+    };
+    if (batch.slice_cycles == 0) {
+        error(pgm, "slice_cycles must be positive");
+        return 1;
+    }
+    atomic_init(&(batch.active_jobs), 0);
+
+    job_t* jobs = NULL;
+    size_t nb_jobs = 0;
+    int err = load_manifest(argv[1], &jobs, &nb_jobs);
+
+    void** tasks = NULL;
+    if (err == ERR_NONE) {
+        tasks = calloc(nb_jobs == 0 ? 1 : nb_jobs, sizeof(void*));
+        err = tasks == NULL ? ERR_MEM : ERR_NONE;
+    }
+    if (err == ERR_NONE) {
+        for (size_t i = 0; i < nb_jobs; ++i) {
+            jobs[i].batch = &batch;
+            tasks[i] = jobs + i;
+        }
+        const double start = now_s();
+        err = work_pool_run(nb_workers, tasks, nb_jobs, job_slice);
+        fprintf(stderr, "%zu jobs on %zu workers in %.3f s\n", nb_jobs, nb_workers, now_s() - start);
+    }
+    if (err == ERR_NONE) {
+        err = write_results(argv[2], jobs, nb_jobs);
+    }
+
+    for (size_t i = 0; i < nb_jobs; ++i) {
+        free(jobs[i].rom);
+        free(jobs[i].events);
+        free(jobs[i].serial);
+    }
+    free(jobs);
+    free(tasks);
+
+    return err;
+}
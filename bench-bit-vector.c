@@ -0,0 +1,105 @@
+/**
+ * @file bench-bit-vector.c
+ * @brief Benchmark of the bulk bit_vector operations (not, and, or, xor)
+ *        of every backend, in GB/s, from one LCD line to a whole frame
+ *
+ * @date 2020
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "bit_vector.h"
+#include "lcdc.h"
+#include "error.h"
+
+#define BYTES_PER_RUN (1u << 26) // volume processed for each (op, size, backend)
+
+// ======================================================================
+static double now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double) ts.tv_sec * 1e9 + (double) ts.tv_nsec;
+}
+
+// ======================================================================
+typedef enum { OP_NOT, OP_AND, OP_OR, OP_XOR, NB_OPS } op_t;
+
+static const char* const op_names[NB_OPS] = { "not", "and", "or", "xor" };
+
+// ======================================================================
+/**
+ * @brief runs an operation until BYTES_PER_RUN bytes (of the first operand) are processed
+ * @return throughput in GB/s
+ */
+static double run(op_t op, bit_vector_t* pbv1, const bit_vector_t* pbv2)
+{
+    const size_t bytes = (pbv1->size + 7) / 8;
+    const size_t nb_runs = BYTES_PER_RUN / bytes + 1;
+
+    const double start = now_ns();
+    for (size_t i = 0; i < nb_runs; ++i) {
+        switch (op) {
+        case OP_NOT:
+            bit_vector_not(pbv1);
+            break;
+        case OP_AND:
+            bit_vector_and(pbv1, pbv2);
+            break;
+        case OP_OR:
+            bit_vector_or(pbv1, pbv2);
+            break;
+        default:
+            bit_vector_xor(pbv1, pbv2);
+            break;
+        }
+    }
+    return (double) (nb_runs * bytes) / (now_ns() - start);
+}
+
+// ======================================================================
+int main(void)
+{
+    // one LCD line, one background line, a whole frame plane, four frames
+    const size_t sizes[] = {
+        LCD_WIDTH, 256, LCD_WIDTH * LCD_HEIGHT, 4 * LCD_WIDTH * LCD_HEIGHT
+    };
+    const size_t nb_sizes = sizeof(sizes) / sizeof(sizes[0]);
+
+    printf("%-8s %-4s", "backend", "op");
+    for (size_t s = 0; s < nb_sizes; ++s) {
+        printf(" %9zub", sizes[s]);
+    }
+    printf("   (GB/s)\n");
+
+    int status = EXIT_SUCCESS;
+    for (bit_vector_backend_t b = BIT_VECTOR_BACKEND_SCALAR; b < NB_BIT_VECTOR_BACKENDS; ++b) {
+        if (bit_vector_select_backend(b) != ERR_NONE) {
+            printf("%-8s n/a\n", bit_vector_backend_name(b));
+            continue;
+        }
+        for (op_t op = OP_NOT; op < NB_OPS; ++op) {
+            printf("%-8s %-4s", bit_vector_backend_name(b), op_names[op]);
+            for (size_t s = 0; s < nb_sizes; ++s) {
+                bit_vector_t* pbv1 = bit_vector_create(sizes[s], 1);
+                bit_vector_t* pbv2 = bit_vector_create(sizes[s], 0);
+                if (pbv1 == NULL || pbv2 == NULL) {
+                    bit_vector_free(&pbv1);
+                    bit_vector_free(&pbv2);
+                    return EXIT_FAILURE;
+                }
+                printf(" %10.2f", run(op, pbv1, pbv2));
+                bit_vector_free(&pbv1);
+                bit_vector_free(&pbv2);
+            }
+            printf("\n");
+        }
+    }
+
+    bit_vector_select_backend(BIT_VECTOR_BACKEND_AUTO);
+    printf("auto: %s\n", bit_vector_backend_name(BIT_VECTOR_BACKEND_AUTO));
+    return status;
+}
@@ -0,0 +1,121 @@
+/**
+ * @file bench-tile-decode.c
+ * @brief Benchmark of tile_decode_line() kernels against the bit-by-bit
+ *        image_line path (set_word + map_colors + extract_wrap_ext)
+ *
+ * @date 2020
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "tile_decode.h"
+#include "image.h"
+#include "lcdc.h"
+#include "error.h"
+
+#define BG_LINE_PIXELS  (TILE_LINE_SIZE * 8)
+#define NB_ITERATIONS   100000
+#define PALETTE         0x1B // reversed default palette: exercises mapping
+
+// ======================================================================
+static double now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double) ts.tv_sec * 1e9 + (double) ts.tv_nsec;
+}
+
+// ======================================================================
+/**
+ * @brief reference path: words built bit by bit, then the image_line API
+ */
+static int decode_reference(image_line_t* output, const data_t* rows, size_t scroll)
+{
+    image_line_t raw, mapped;
+    M_REQUIRE_NO_ERR(image_line_create(&raw, BG_LINE_PIXELS));
+
+    for (size_t w = 0; w < BG_LINE_PIXELS / IMAGE_LINE_WORD_BITS; ++w) {
+        uint32_t lsb = 0, msb = 0;
+        for (size_t x = 0; x < IMAGE_LINE_WORD_BITS; ++x) {
+            const size_t tile = (w * IMAGE_LINE_WORD_BITS + x) / 8;
+            const int bit = 7 - (int) (x % 8);
+            lsb |= (uint32_t) ((rows[2 * tile]     >> bit) & 1) << x;
+            msb |= (uint32_t) ((rows[2 * tile + 1] >> bit) & 1) << x;
+        }
+        image_line_set_word(&raw, w, msb, lsb);
+    }
+
+    int err = image_line_map_colors(&mapped, raw, PALETTE);
+    image_line_free(&raw);
+    M_REQUIRE_NO_ERR(err);
+
+    err = image_line_extract_wrap_ext(output, mapped, (int64_t) scroll, LCD_WIDTH);
+    image_line_free(&mapped);
+    return err;
+}
+
+// ======================================================================
+static int same_lines(const image_line_t* l1, const image_line_t* l2)
+{
+    for (size_t w = 0; w < LCD_WIDTH / IMAGE_LINE_WORD_BITS; ++w) {
+        if (l1->msb->content[w] != l2->msb->content[w] ||
+            l1->lsb->content[w] != l2->lsb->content[w] ||
+            l1->opacity->content[w] != l2->opacity->content[w]) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// ======================================================================
+int main(void)
+{
+    data_t rows[2 * TILE_LINE_SIZE];
+    srand(42);
+    for (size_t i = 0; i < sizeof(rows); ++i) {
+        rows[i] = (data_t) rand();
+    }
+
+    image_line_t reference, line;
+    if (image_line_create(&line, LCD_WIDTH) != ERR_NONE) return EXIT_FAILURE;
+
+    double start = now_ns();
+    for (size_t i = 0; i < NB_ITERATIONS; ++i) {
+        if (decode_reference(&reference, rows, i % BG_LINE_PIXELS) != ERR_NONE) return EXIT_FAILURE;
+        image_line_free(&reference);
+    }
+    const double reference_ns = (now_ns() - start) / NB_ITERATIONS;
+    printf("%-10s %10.1f ns/line\n", "bit-by-bit", reference_ns);
+
+    int status = EXIT_SUCCESS;
+    for (tile_decode_kernel_t k = TILE_DECODE_SCALAR; k < NB_TILE_DECODE_KERNELS; ++k) {
+        if (tile_decode_select(k) != ERR_NONE) {
+            printf("%-10s        n/a\n", tile_decode_kernel_name(k));
+            continue;
+        }
+
+        for (size_t scroll = 0; scroll < BG_LINE_PIXELS; ++scroll) {
+            if (decode_reference(&reference, rows, scroll) != ERR_NONE) return EXIT_FAILURE;
+            tile_decode_line(&line, rows, TILE_LINE_SIZE, scroll, PALETTE, 0);
+            if (!same_lines(&reference, &line)) {
+                fprintf(stderr, "%s: mismatch with scroll %zu\n", tile_decode_kernel_name(k), scroll);
+                status = EXIT_FAILURE;
+            }
+            image_line_free(&reference);
+        }
+
+        start = now_ns();
+        for (size_t i = 0; i < NB_ITERATIONS; ++i) {
+            tile_decode_line(&line, rows, TILE_LINE_SIZE, i % BG_LINE_PIXELS, PALETTE, 0);
+        }
+        const double ns = (now_ns() - start) / NB_ITERATIONS;
+        printf("%-10s %10.1f ns/line  (x%.1f)\n", tile_decode_kernel_name(k), ns, reference_ns / ns);
+    }
+
+    image_line_free(&line);
+    tile_decode_select(TILE_DECODE_AUTO);
+    return status;
+}
@@ -1,11 +1,17 @@
+#include <stdio.h>
 #include <stddef.h>
 #include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
 #include "bit_vector.h"
-#include "bit.c"
+#include "error.h"
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define BIT_VECTOR_X86 1
+#endif
 
 #define CHUNK_SIZE 32
-#define BYTE_SIZE 8
 
 //================================ HELPERS ================================
 
@@ -27,6 +33,18 @@ size_t forced_size(size_t size)
 
 //==================================================================================
 
+/**
+ * @brief mask of the n lowest bits of a chunk
+ * @param n, number of bits (0 to CHUNK_SIZE)
+ * @return the mask
+ */
+static inline uint32_t low_bits_mask(size_t n)
+{
+    return n >= CHUNK_SIZE ? UINT32_MAX : (((uint32_t) 1 << n) - 1);
+}
+
+//==================================================================================
+
 /**
  * @brief sets the bits allocated but not used by the vector to 0
  * @param vector, the vector whose unused bits will be set to 0
@@ -37,16 +55,50 @@ void bit_vector_set_unnecessary_bits_to_0(bit_vector_t* vector, size_t size){
         size_t index_of_uint32 = forced_size(size) - 1;
         size_t extra_bits = size % CHUNK_SIZE;
         if (extra_bits != 0){
-            uint32_t mask = 0;
-            for (size_t i = extra_bits; i < CHUNK_SIZE; ++i){
-                mask = mask + (1 << i);
-            }
-            mask = ~mask;
-            (vector -> content)[index_of_uint32] = (vector -> content)[index_of_uint32] & mask;
+            (vector -> content)[index_of_uint32] &= low_bits_mask(extra_bits);
         } 
     }
 }
 
+//==================================================================================
+
+/**
+ * @brief gets a chunk of the vector, its unused bits set to 0
+ * @param pbv, the vector
+ * @param chunk, index of the chunk (0 outside of the vector)
+ * @return the chunk
+ */
+static inline uint32_t chunk_at(const bit_vector_t* pbv, int64_t chunk)
+{
+    const int64_t nb_chunks = (int64_t) forced_size(pbv -> size);
+    if (chunk < 0 || chunk >= nb_chunks){
+        return 0;
+    }
+    uint32_t value = pbv -> content[chunk];
+    if (chunk == nb_chunks - 1){
+        value &= low_bits_mask(pbv -> size - (size_t) chunk * CHUNK_SIZE);
+    }
+    return value;
+}
+
+//==================================================================================
+
+/**
+ * @brief gets the CHUNK_SIZE bits of the vector starting at a given index,
+ *        bits outside of the vector being 0 (funnel shift of two chunks)
+ * @param pbv, the vector
+ * @param index, index of the first bit (may be negative)
+ * @return the bits, the first one as least significant bit
+ */
+static inline uint32_t word_at(const bit_vector_t* pbv, int64_t index)
+{
+    // floor division, also for negative indexes
+    const int64_t chunk = (index >= 0 ? index : index - (CHUNK_SIZE - 1)) / CHUNK_SIZE;
+    const unsigned int offset = (unsigned int) (index - chunk * CHUNK_SIZE);
+    const uint64_t pair = ((uint64_t) chunk_at(pbv, chunk + 1) << CHUNK_SIZE) | chunk_at(pbv, chunk);
+    return (uint32_t) (pair >> offset);
+}
+
 //========================================================================================
 
 
@@ -55,16 +107,201 @@ void bit_vector_set_unnecessary_bits_to_0(bit_vector_t* vector, size_t size){
 
 //============================ END HELPERS ===============================================
 
+
+
+//============================ BULK OPERATIONS ===========================================
+
+// below this many chunks, a plain loop beats an indirect call
+#define MIN_BULK_CHUNKS 8
+
+typedef uint32_t vec128_t __attribute__((vector_size(16)));
+typedef uint32_t vec256_t __attribute__((vector_size(32)));
+
+typedef void (*binary_fn)(uint32_t* dst, const uint32_t* src, size_t nb_chunks);
+typedef void (*unary_fn)(uint32_t* dst, size_t nb_chunks);
+
+/**
+ * @brief chunk kernels of a backend
+ */
+typedef struct {
+    binary_fn and_fn;
+    binary_fn or_fn;
+    binary_fn xor_fn;
+    unary_fn not_fn;
+} backend_kernels_t;
+
+/**
+ * @brief defines a kernel dst OP= src, over vectors of type V, then a scalar tail
+ *        (loads and stores through memcpy: chunks need not be aligned)
+ */
+#define define_binary_kernel(name, V, OP, ...) \
+    __VA_ARGS__ static void name(uint32_t* dst, const uint32_t* src, size_t nb_chunks) \
+    { \
+        const size_t step = sizeof(V) / sizeof(uint32_t); \
+        size_t i = 0; \
+        for (; i + step <= nb_chunks; i += step) { \
+            V a, b; \
+            memcpy(&a, dst + i, sizeof(V)); \
+            memcpy(&b, src + i, sizeof(V)); \
+            a OP b; \
+            memcpy(dst + i, &a, sizeof(V)); \
+        } \
+        for (; i < nb_chunks; ++i) { \
+            dst[i] OP src[i]; \
+        } \
+    }
+
+#define define_not_kernel(name, V, ...) \
+    __VA_ARGS__ static void name(uint32_t* dst, size_t nb_chunks) \
+    { \
+        const size_t step = sizeof(V) / sizeof(uint32_t); \
+        size_t i = 0; \
+        for (; i + step <= nb_chunks; i += step) { \
+            V a; \
+            memcpy(&a, dst + i, sizeof(V)); \
+            a = ~a; \
+            memcpy(dst + i, &a, sizeof(V)); \
+        } \
+        for (; i < nb_chunks; ++i) { \
+            dst[i] = ~dst[i]; \
+        } \
+    }
+
+#define define_backend(prefix, V, ...) \
+    define_binary_kernel(prefix##_and, V, &=, __VA_ARGS__) \
+    define_binary_kernel(prefix##_or,  V, |=, __VA_ARGS__) \
+    define_binary_kernel(prefix##_xor, V, ^=, __VA_ARGS__) \
+    define_not_kernel(prefix##_not, V, __VA_ARGS__)
+
+define_backend(scalar, uint32_t, )
+define_backend(vec128, vec128_t, )
+#ifdef BIT_VECTOR_X86
+define_backend(avx2, vec256_t, __attribute__((target("avx2"))))
+#endif
+
+static const backend_kernels_t backends[NB_BIT_VECTOR_BACKENDS] = {
+    [BIT_VECTOR_BACKEND_SCALAR] = { scalar_and, scalar_or, scalar_xor, scalar_not },
+    [BIT_VECTOR_BACKEND_VEC128] = { vec128_and, vec128_or, vec128_xor, vec128_not },
+#ifdef BIT_VECTOR_X86
+    [BIT_VECTOR_BACKEND_AVX2]   = { avx2_and, avx2_or, avx2_xor, avx2_not },
+#endif
+};
+
+static const char* const backend_names[NB_BIT_VECTOR_BACKENDS] = {
+    "auto", "scalar", "vec128", "avx2"
+};
+
+// shared by all threads: detection only ever replaces BIT_VECTOR_BACKEND_AUTO
+static _Atomic(bit_vector_backend_t) selected = BIT_VECTOR_BACKEND_AUTO;
+
+//=========================================================================
+static int backend_supported(bit_vector_backend_t backend)
+{
+    if (backend <= BIT_VECTOR_BACKEND_AUTO || backend >= NB_BIT_VECTOR_BACKENDS
+        || backends[backend].and_fn == NULL) {
+        return 0;
+    }
+#ifdef BIT_VECTOR_X86
+    if (backend == BIT_VECTOR_BACKEND_AVX2) {
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("avx2");
+    }
+#endif
+    return 1;
+}
+
+//=========================================================================
+static const backend_kernels_t* backend_in_use(void)
+{
+    bit_vector_backend_t backend = atomic_load_explicit(&selected, memory_order_relaxed);
+    if (backend == BIT_VECTOR_BACKEND_AUTO) {
+        const bit_vector_backend_t detected = backend_supported(BIT_VECTOR_BACKEND_AVX2)
+                                              ? BIT_VECTOR_BACKEND_AVX2 : BIT_VECTOR_BACKEND_VEC128;
+        // on failure, backend is the one another thread detected or forced meanwhile
+        backend = BIT_VECTOR_BACKEND_AUTO;
+        if (atomic_compare_exchange_strong(&selected, &backend, detected)) {
+            backend = detected;
+        }
+    }
+    return &backends[backend];
+}
+
+//=========================================================================
+int bit_vector_select_backend(bit_vector_backend_t backend)
+{
+    if (backend == BIT_VECTOR_BACKEND_AUTO) {
+        atomic_store(&selected, BIT_VECTOR_BACKEND_AUTO);
+        return ERR_NONE;
+    }
+    M_REQUIRE(backend_supported(backend), ERR_BAD_PARAMETER, "backend %d not supported", backend);
+    atomic_store(&selected, backend);
+    return ERR_NONE;
+}
+
+//=========================================================================
+const char* bit_vector_backend_name(bit_vector_backend_t backend)
+{
+    if (backend == BIT_VECTOR_BACKEND_AUTO) {
+        backend = (bit_vector_backend_t) (backend_in_use() - backends);
+    }
+    if (backend < BIT_VECTOR_BACKEND_AUTO || backend >= NB_BIT_VECTOR_BACKENDS) {
+        return "unknown";
+    }
+    return backend_names[backend];
+}
+
+//=========================================================================
+void bit_vector_chunks_and(uint32_t* dst, const uint32_t* src, size_t nb_chunks)
+{
+    if (nb_chunks < MIN_BULK_CHUNKS) {
+        scalar_and(dst, src, nb_chunks);
+    } else {
+        backend_in_use() -> and_fn(dst, src, nb_chunks);
+    }
+}
+
+//=========================================================================
+void bit_vector_chunks_or(uint32_t* dst, const uint32_t* src, size_t nb_chunks)
+{
+    if (nb_chunks < MIN_BULK_CHUNKS) {
+        scalar_or(dst, src, nb_chunks);
+    } else {
+        backend_in_use() -> or_fn(dst, src, nb_chunks);
+    }
+}
+
+//=========================================================================
+void bit_vector_chunks_xor(uint32_t* dst, const uint32_t* src, size_t nb_chunks)
+{
+    if (nb_chunks < MIN_BULK_CHUNKS) {
+        scalar_xor(dst, src, nb_chunks);
+    } else {
+        backend_in_use() -> xor_fn(dst, src, nb_chunks);
+    }
+}
+
+//=========================================================================
+void bit_vector_chunks_not(uint32_t* dst, size_t nb_chunks)
+{
+    if (nb_chunks < MIN_BULK_CHUNKS) {
+        scalar_not(dst, nb_chunks);
+    } else {
+        backend_in_use() -> not_fn(dst, nb_chunks);
+    }
+}
+
+//========================================================================================
+
 bit_vector_t* bit_vector_create(size_t size, bit_t value) {
     if(size == 0){
         return NULL;
     }
     size_t nb_chunks = forced_size(size);
-    const size_t N_MAX = (SIZE_MAX - sizeof(bit_vector_t)) / CHUNK_SIZE + 1; 
+    const size_t N_MAX = (SIZE_MAX - sizeof(bit_vector_t)) / sizeof(uint32_t) + 1; 
     if (nb_chunks <= N_MAX) {
         size_t nb_extra_chunks = nb_chunks - 1;
         
-        bit_vector_t* vector = malloc(sizeof(bit_vector_t) + (nb_extra_chunks) * CHUNK_SIZE);
+        bit_vector_t* vector = malloc(sizeof(bit_vector_t) + (nb_extra_chunks) * sizeof(uint32_t));
 
         if(vector != NULL) {
             vector -> size = size;
@@ -92,6 +329,19 @@ bit_vector_t* bit_vector_create(size_t size, bit_t value) {
 
 //=========================================================================================
 
+bit_vector_t* bit_vector_cpy_to(bit_vector_t* dst, const bit_vector_t* pbv)
+{
+    if (dst == NULL || pbv == NULL || dst -> size != pbv -> size){
+        return NULL;
+    }
+    if (dst != pbv){
+        memcpy(dst -> content, pbv -> content, forced_size(pbv -> size) * sizeof(uint32_t));
+    }
+    return dst;
+}
+
+//=========================================================================================
+
 bit_vector_t* bit_vector_cpy(const bit_vector_t* pbv)
 {
     if (pbv == NULL){
@@ -101,10 +351,7 @@ bit_vector_t* bit_vector_cpy(const bit_vector_t* pbv)
         + (forced_size(pbv -> size) - 1) * sizeof(uint32_t));
     if (copy != NULL){
         copy -> size = pbv -> size;
-        size_t nb_chunks =  forced_size(pbv -> size);
-        for (size_t i = 0; i < nb_chunks; ++i){
-            copy -> content[i] = pbv -> content[i];
-        }
+        bit_vector_cpy_to(copy, pbv);
     }
     return copy;
 }
@@ -116,22 +363,7 @@ bit_t bit_vector_get(const bit_vector_t* pbv, size_t index)
     if (pbv == NULL || index >= (CHUNK_SIZE * forced_size(pbv -> size))){
         return 0;
     }
-    size_t chunk = index / CHUNK_SIZE;
-    size_t byte_chunk = (index - CHUNK_SIZE * chunk) / (BYTE_SIZE); 
-    size_t idx = index % (BYTE_SIZE);
-    uint16_t half_chunk = 0;
-    if (byte_chunk <= 1){
-        half_chunk = pbv -> content[chunk] & 0xFFFF;
-    } else {
-        half_chunk = pbv -> content[chunk] >> (CHUNK_SIZE / 2);
-    }
-    uint8_t byte = 0;
-    if (byte_chunk % 2 == 0){
-        byte = lsb8(half_chunk);
-    } else {
-        byte = msb8(half_chunk);
-    }
-    return bit_get(byte, idx);
+    return bit_vector_test(pbv, index);
 }
 
 //=========================================================================
@@ -141,10 +373,7 @@ bit_vector_t* bit_vector_not(bit_vector_t* pbv)
     if (pbv == NULL){
         return NULL;
     }
-    size_t nb_chunks =  forced_size(pbv -> size);
-    for (size_t i = 0; i < nb_chunks; ++i){
-        pbv -> content[i] = ~(pbv -> content[i]);
-    }
+    bit_vector_chunks_not(pbv -> content, forced_size(pbv -> size));
     bit_vector_set_unnecessary_bits_to_0(pbv, pbv -> size);
     return pbv;
 }
@@ -156,10 +385,7 @@ bit_vector_t* bit_vector_and(bit_vector_t* pbv1, const bit_vector_t* pbv2)
     if(pbv1 == NULL || pbv2 == NULL || pbv1 -> size != pbv2 -> size){
         return NULL;
     }
-    size_t nb_chunks =  forced_size(pbv1 -> size);
-    for (size_t i = 0; i < nb_chunks; ++i){
-        pbv1 -> content[i] = (pbv1 -> content[i]) & (pbv2 -> content[i]);
-    }
+    bit_vector_chunks_and(pbv1 -> content, pbv2 -> content, forced_size(pbv1 -> size));
     return pbv1;
 }
 
@@ -169,10 +395,7 @@ bit_vector_t* bit_vector_or(bit_vector_t* pbv1, const bit_vector_t* pbv2)
     if(pbv1 == NULL || pbv2 == NULL || pbv1 -> size != pbv2 -> size){
         return NULL;
     }
-    size_t nb_chunks =  forced_size(pbv1 -> size);
-    for (size_t i = 0; i < nb_chunks; ++i){
-        pbv1 -> content[i] = (pbv1 -> content[i]) | (pbv2 -> content[i]);
-    }
+    bit_vector_chunks_or(pbv1 -> content, pbv2 -> content, forced_size(pbv1 -> size));
     return pbv1;
 }
 
@@ -182,35 +405,72 @@ bit_vector_t* bit_vector_xor(bit_vector_t* pbv1, const bit_vector_t* pbv2)
     if(pbv1 == NULL || pbv2 == NULL || pbv1 -> size != pbv2 -> size){
         return NULL;
     }
-    size_t nb_chunks =  forced_size(pbv1 -> size);
-    for (size_t i = 0; i < nb_chunks; ++i){
-        pbv1 -> content[i] = (pbv1 -> content[i]) ^ (pbv2 -> content[i]);
-    }
+    bit_vector_chunks_xor(pbv1 -> content, pbv2 -> content, forced_size(pbv1 -> size));
     return pbv1;
 }
 
 //=========================================================================
-bit_vector_t* bit_vector_extract_zero_ext(const bit_vector_t* pbv, int64_t index, size_t size)
+bit_vector_t* bit_vector_extract_zero_ext_to(bit_vector_t* dst, const bit_vector_t* pbv, int64_t index)
 {
+    if(dst == NULL || dst == pbv){
+        return NULL;
+    }
+    size_t nb_chunks = forced_size(dst -> size);
     if(pbv == NULL){
-        return bit_vector_create(size, 0);
+        memset(dst -> content, 0, nb_chunks * sizeof(uint32_t));
+        return dst;
     }
+    for(size_t j = 0; j < nb_chunks; ++j){
+        dst -> content[j] = word_at(pbv, index + (int64_t) (j * CHUNK_SIZE));
+    }
+    bit_vector_set_unnecessary_bits_to_0(dst, dst -> size);
+    return dst;
+}
+
+//=========================================================================
+bit_vector_t* bit_vector_extract_zero_ext(const bit_vector_t* pbv, int64_t index, size_t size)
+{
     bit_vector_t* extracted = bit_vector_create(size, 0);
-    if (extracted != NULL){
-        size_t nb_chunks = forced_size(size);
-        for(size_t j = 0; j < nb_chunks; ++j){
-            for(size_t i = 0; i < CHUNK_SIZE; ++i){
-                size_t index_in_original_vector = j * CHUNK_SIZE + index + i;
-                if( index_in_original_vector >= 0 && (index_in_original_vector < pbv -> size)){
-                    extracted -> content[j] = (extracted -> content[j]) + (bit_vector_get(pbv, index_in_original_vector) << i);
-                }
-            }
-        }
+    if (extracted != NULL && pbv != NULL){
+        bit_vector_extract_zero_ext_to(extracted, pbv, index);
     }
     return extracted;
 }
 
 
+//=========================================================================
+bit_vector_t* bit_vector_extract_wrap_ext_to(bit_vector_t* dst, const bit_vector_t* pbv, int64_t index)
+{
+    if(dst == NULL || pbv == NULL || dst == pbv){
+        return NULL;
+    }
+    const int64_t length = (int64_t) pbv -> size;
+    size_t nb_chunks = forced_size(dst -> size);
+    for(size_t j = 0; j < nb_chunks; ++j){
+        // first source bit of the word, in [0, length)
+        int64_t position = (index + (int64_t) (j * CHUNK_SIZE)) % length;
+        if (position < 0){
+            position += length;
+        }
+        // segments until the end of the source, then from its start
+        // (at most two of them when the source holds at least one word)
+        uint32_t word = 0;
+        size_t filled = 0;
+        while (filled < CHUNK_SIZE){
+            size_t taken = (size_t) (length - position);
+            if (taken > CHUNK_SIZE - filled){
+                taken = CHUNK_SIZE - filled;
+            }
+            word |= (word_at(pbv, position) & low_bits_mask(taken)) << filled;
+            filled += taken;
+            position = 0;
+        }
+        dst -> content[j] = word;
+    }
+    bit_vector_set_unnecessary_bits_to_0(dst, dst -> size);
+    return dst;
+}
+
 //=========================================================================
 bit_vector_t* bit_vector_extract_wrap_ext(const bit_vector_t* pbv, int64_t index, size_t size)
 {
@@ -219,27 +479,40 @@ bit_vector_t* bit_vector_extract_wrap_ext(const bit_vector_t* pbv, int64_t index
     }
     bit_vector_t* extracted = bit_vector_create(size, 0);
     if (extracted != NULL){
-        size_t nb_chunks = forced_size(size);
-        for(size_t j = 0; j < nb_chunks; ++j){
-            for(size_t i = 0; i < CHUNK_SIZE; ++i){
-                size_t index_in_original_vector = j * CHUNK_SIZE + index + i;
-                size_t looped_index = index_in_original_vector % pbv -> size;
-                if(looped_index < 0){
-                    looped_index = looped_index + pbv -> size;
-                }
-                extracted -> content[j] = (extracted -> content[j]) + (bit_vector_get(pbv, looped_index) << i); 
-            }
-        }
+        bit_vector_extract_wrap_ext_to(extracted, pbv, index);
     }
     return extracted;
 }
 
 
+//=========================================================================
+bit_vector_t* bit_vector_shift_to(bit_vector_t* dst, const bit_vector_t* pbv, int64_t shift)
+{
+    if(dst == NULL || pbv == NULL || dst -> size != pbv -> size){
+        return NULL;
+    }
+    // a chunk only depends on source chunks at the same index or further in
+    // the direction the bits come from: visiting them in that order also
+    // works in place
+    const int64_t nb_chunks = (int64_t) forced_size(dst -> size);
+    if(shift <= 0){
+        for(int64_t j = 0; j < nb_chunks; ++j){
+            dst -> content[j] = word_at(pbv, j * CHUNK_SIZE - shift);
+        }
+    } else {
+        for(int64_t j = nb_chunks - 1; j >= 0; --j){
+            dst -> content[j] = word_at(pbv, j * CHUNK_SIZE - shift);
+        }
+    }
+    bit_vector_set_unnecessary_bits_to_0(dst, dst -> size);
+    return dst;
+}
+
 //=========================================================================
 bit_vector_t* bit_vector_shift(const bit_vector_t* pbv, int64_t shift)
 {
     if(pbv != NULL){
-        return bit_vector_extract_zero_ext(pbv, -shift, pbv -> size);
+        return bit_vector_shift_to(bit_vector_create(pbv -> size, 0), pbv, shift);
     }
     else{
         return NULL;
@@ -247,35 +520,40 @@ bit_vector_t* bit_vector_shift(const bit_vector_t* pbv, int64_t shift)
 }
 
 //=========================================================================
-bit_vector_t* bit_vector_join(const bit_vector_t* pbv1, const bit_vector_t* pbv2, int64_t shift)
+bit_vector_t* bit_vector_join_to(bit_vector_t* dst, const bit_vector_t* pbv1, const bit_vector_t* pbv2, int64_t shift)
 {
-    if(shift < 0 || pbv1 == NULL || pbv2 == NULL || shift > (pbv1 -> size) || (pbv1 -> size != pbv2 -> size)) {
+    if(dst == NULL || pbv1 == NULL || pbv2 == NULL || shift < 0 || shift > (int64_t) (pbv1 -> size)
+       || pbv1 -> size != pbv2 -> size || dst -> size != pbv1 -> size) {
         return NULL;
     }
-    bit_vector_t* vector = bit_vector_create(pbv1 -> size, 0);
-    size_t shift_chunk_index = shift / CHUNK_SIZE;
-    size_t shift_bit_index = shift % CHUNK_SIZE;
-    
-    size_t nb_chunks = forced_size(pbv1 -> size);
-    for(int j  = 0; j < nb_chunks; ++j){
+    size_t shift_chunk_index = (size_t) shift / CHUNK_SIZE;
+    const uint32_t first_bits = low_bits_mask((size_t) shift % CHUNK_SIZE);
+
+    size_t nb_chunks = forced_size(dst -> size);
+    for(size_t j = 0; j < nb_chunks; ++j){
         if(j < shift_chunk_index){
-            vector -> content[j] = pbv1 -> content[j];
+            dst -> content[j] = pbv1 -> content[j];
         }
         else if(j > shift_chunk_index){
-            vector -> content[j] = pbv2 -> content[j];
+            dst -> content[j] = pbv2 -> content[j];
         }
         else{
-            for(size_t i = 0; i < CHUNK_SIZE; ++i){
-                size_t index_in_vector = j * CHUNK_SIZE + i;
-                if(i < shift_bit_index){
-                    vector -> content[j] = vector -> content[j] + (bit_vector_get(pbv1, index_in_vector) << i);
-                }
-                else{
-                    vector -> content[j] = vector -> content[j] + (bit_vector_get(pbv2, index_in_vector) << i);
-                }   
-            }
+            dst -> content[j] = (pbv1 -> content[j] & first_bits) | (pbv2 -> content[j] & ~first_bits);
         }
     }
+    return dst;
+}
+
+//=========================================================================
+bit_vector_t* bit_vector_join(const bit_vector_t* pbv1, const bit_vector_t* pbv2, int64_t shift)
+{
+    if(pbv1 == NULL){
+        return NULL;
+    }
+    bit_vector_t* vector = bit_vector_create(pbv1 -> size, 0);
+    if(bit_vector_join_to(vector, pbv1, pbv2, shift) == NULL){
+        bit_vector_free(&vector);
+    }
     return vector;
 } 
 
@@ -320,5 +598,108 @@ void bit_vector_free(bit_vector_t** pbv)
     *pbv = NULL;
 }
 
+//================================ FIXED SIZES ============================
+
+// the fixed sizes are whole numbers of chunks: no unused bits to clear
+#define CHUNKS_160 BIT_VECTOR_CHUNKS(BIT_VECTOR_160_BITS)
+#define CHUNKS_256 BIT_VECTOR_CHUNKS(BIT_VECTOR_256_BITS)
 
+#define unroll_160(OP) OP(0); OP(1); OP(2); OP(3); OP(4)
+#define unroll_256(OP) unroll_160(OP); OP(5); OP(6); OP(7)
 
+//=========================================================================
+/**
+ * @brief gets CHUNK_SIZE bits of a fixed-size vector starting at a given
+ *        index, bits outside of the vector being 0
+ * @param content, the chunks of the vector
+ * @param nb_chunks, number of chunks of the vector
+ * @param index, index of the first bit (may be negative)
+ * @return the bits, the first one as least significant bit
+ */
+static inline uint32_t fixed_word_at(const uint32_t* content, int64_t nb_chunks, int64_t index)
+{
+    const int64_t chunk = (index >= 0 ? index : index - (CHUNK_SIZE - 1)) / CHUNK_SIZE;
+    const unsigned int offset = (unsigned int) (index - chunk * CHUNK_SIZE);
+    const uint64_t lo = (chunk >= 0 && chunk < nb_chunks) ? content[chunk] : 0;
+    const uint64_t hi = (chunk + 1 >= 0 && chunk + 1 < nb_chunks) ? content[chunk + 1] : 0;
+    return (uint32_t) (((hi << CHUNK_SIZE) | lo) >> offset);
+}
+
+//=========================================================================
+// one chunk of each operation, on dst (and src)
+#define init_chunk(i)  dst[i] = init_value
+#define not_chunk(i)   dst[i] = ~dst[i]
+#define and_chunk(i)   dst[i] &= src[i]
+#define or_chunk(i)    dst[i] |= src[i]
+#define xor_chunk(i)   dst[i] ^= src[i]
+#define shift_chunk(i) shifted[i] = fixed_word_at(src, nb_chunks, (int64_t) (i) * CHUNK_SIZE - shift)
+#define copy_chunk(i)  dst[i] = shifted[i]
+
+#define define_fixed_ops(N) \
+    bit_vector_t* bit_vector_##N##_init(bit_vector_##N##_t* pbv, bit_t value) \
+    { \
+        uint32_t* const dst = pbv -> fixed.content; \
+        const uint32_t init_value = value ? UINT32_MAX : 0; \
+        pbv -> fixed.size = BIT_VECTOR_##N##_BITS; \
+        unroll_##N(init_chunk); \
+        return &(pbv -> vector); \
+    } \
+    \
+    void bit_vector_##N##_not(bit_vector_##N##_t* pbv) \
+    { \
+        uint32_t* const dst = pbv -> fixed.content; \
+        unroll_##N(not_chunk); \
+    } \
+    \
+    void bit_vector_##N##_and(bit_vector_##N##_t* pbv1, const bit_vector_##N##_t* pbv2) \
+    { \
+        uint32_t* const dst = pbv1 -> fixed.content; \
+        const uint32_t* const src = pbv2 -> fixed.content; \
+        unroll_##N(and_chunk); \
+    } \
+    \
+    void bit_vector_##N##_or(bit_vector_##N##_t* pbv1, const bit_vector_##N##_t* pbv2) \
+    { \
+        uint32_t* const dst = pbv1 -> fixed.content; \
+        const uint32_t* const src = pbv2 -> fixed.content; \
+        unroll_##N(or_chunk); \
+    } \
+    \
+    void bit_vector_##N##_xor(bit_vector_##N##_t* pbv1, const bit_vector_##N##_t* pbv2) \
+    { \
+        uint32_t* const dst = pbv1 -> fixed.content; \
+        const uint32_t* const src = pbv2 -> fixed.content; \
+        unroll_##N(xor_chunk); \
+    } \
+    \
+    void bit_vector_##N##_shift(bit_vector_##N##_t* dst_pbv, const bit_vector_##N##_t* pbv, int64_t shift) \
+    { \
+        const int64_t nb_chunks = CHUNKS_##N; \
+        const uint32_t* const src = pbv -> fixed.content; \
+        uint32_t* const dst = dst_pbv -> fixed.content; \
+        uint32_t shifted[CHUNKS_##N]; \
+        unroll_##N(shift_chunk); \
+        unroll_##N(copy_chunk); \
+        dst_pbv -> fixed.size = BIT_VECTOR_##N##_BITS; \
+    }
+
+define_fixed_ops(160)
+define_fixed_ops(256)
+
+//=========================================================================
+// 256 being a power of two, wrapping is a mask
+#define extract_chunk(i) \
+    do { \
+        const size_t position = (index + (i) * CHUNK_SIZE) % BIT_VECTOR_256_BITS; \
+        const size_t chunk = position / CHUNK_SIZE; \
+        const uint64_t pair = ((uint64_t) src[(chunk + 1) % CHUNKS_256] << CHUNK_SIZE) | src[chunk]; \
+        dst[i] = (uint32_t) (pair >> (position % CHUNK_SIZE)); \
+    } while (0)
+
+void bit_vector_256_extract_160(bit_vector_160_t* dst_pbv, const bit_vector_256_t* pbv, size_t index)
+{
+    const uint32_t* const src = pbv -> fixed.content;
+    uint32_t* const dst = dst_pbv -> fixed.content;
+    unroll_160(extract_chunk);
+    dst_pbv -> fixed.size = BIT_VECTOR_160_BITS;
+}
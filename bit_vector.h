@@ -28,6 +28,36 @@ typedef struct
     uint32_t content[1];
 } bit_vector_t;
 
+//=========================================================================
+#define BIT_VECTOR_CHUNK_BITS 32
+#define BIT_VECTOR_CHUNKS(bits) (((bits) + BIT_VECTOR_CHUNK_BITS - 1) / BIT_VECTOR_CHUNK_BITS)
+
+#define BIT_VECTOR_160_BITS 160 // a line of the LCD
+#define BIT_VECTOR_256_BITS 256 // a line of the background or of the window
+
+/**
+ * @brief Fixed-capacity bit vectors for the two line sizes of the emulator,
+ * stored inline (no allocation). They have the layout of bit_vector_t:
+ * vector is a view usable with every bit_vector_* function.
+ */
+typedef union
+{
+    bit_vector_t vector;
+    struct {
+        size_t size;
+        uint32_t content[BIT_VECTOR_CHUNKS(BIT_VECTOR_160_BITS)];
+    } fixed;
+} bit_vector_160_t;
+
+typedef union
+{
+    bit_vector_t vector;
+    struct {
+        size_t size;
+        uint32_t content[BIT_VECTOR_CHUNKS(BIT_VECTOR_256_BITS)];
+    } fixed;
+} bit_vector_256_t;
+
 //=========================================================================
 /**
  * @brief Create a bit vector of a given size and fill it with bit value
@@ -45,15 +75,79 @@ bit_vector_t* bit_vector_create(size_t size, bit_t value);
  */
 bit_vector_t* bit_vector_cpy(const bit_vector_t* pbv);
 
+//=========================================================================
+/**
+ * @brief Copy a bit vector into another one of the same size (no allocation)
+ * @param dst pointer to the destination bit vector
+ * @param pbv pointer to the bit vector to copy
+ * @return pointer to the destination bit vector (NULL if sizes differ)
+ */
+bit_vector_t* bit_vector_cpy_to(bit_vector_t* dst, const bit_vector_t* pbv);
+
 //=========================================================================
 /**
  * @brief Get the value of a given bit in a bit vector
  * @param pbv pointer to the bit vector
  * @param index index of bit
- * @return value of bit at index
+ * @return value of bit at index (0 if pbv is NULL or index out of the vector)
  */
 bit_t bit_vector_get(const bit_vector_t* pbv, size_t index);
 
+//=========================================================================
+/**
+ * Unchecked single-bit access, a shift and a mask each, for inner loops:
+ * pbv must not be NULL and index must be lower than pbv->size.
+ */
+#define BIT_VECTOR_CHUNK_OF(index) ((index) / BIT_VECTOR_CHUNK_BITS)
+#define BIT_VECTOR_BIT_MASK(index) ((uint32_t) 1 << ((index) % BIT_VECTOR_CHUNK_BITS))
+
+/**
+ * @brief Value of the bit at index
+ */
+static inline bit_t bit_vector_test(const bit_vector_t* pbv, size_t index)
+{
+    return (bit_t) ((pbv->content[BIT_VECTOR_CHUNK_OF(index)] >> (index % BIT_VECTOR_CHUNK_BITS)) & 1);
+}
+
+/**
+ * @brief Sets the bit at index to 1
+ */
+static inline void bit_vector_set(bit_vector_t* pbv, size_t index)
+{
+    pbv->content[BIT_VECTOR_CHUNK_OF(index)] |= BIT_VECTOR_BIT_MASK(index);
+}
+
+/**
+ * @brief Sets the bit at index to 0
+ */
+static inline void bit_vector_clear(bit_vector_t* pbv, size_t index)
+{
+    pbv->content[BIT_VECTOR_CHUNK_OF(index)] &= ~BIT_VECTOR_BIT_MASK(index);
+}
+
+/**
+ * @brief Flips the bit at index
+ */
+static inline void bit_vector_toggle(bit_vector_t* pbv, size_t index)
+{
+    pbv->content[BIT_VECTOR_CHUNK_OF(index)] ^= BIT_VECTOR_BIT_MASK(index);
+}
+
+/**
+ * @brief Bits index to index + width - 1, bit index being bit 0 of the result
+ * @param width number of bits (1 to 32), index + width must not exceed pbv->size
+ */
+static inline uint32_t bit_vector_get_bits(const bit_vector_t* pbv, size_t index, size_t width)
+{
+    const size_t chunk = BIT_VECTOR_CHUNK_OF(index);
+    const size_t offset = index % BIT_VECTOR_CHUNK_BITS;
+    uint64_t bits = pbv->content[chunk] >> offset;
+    if (offset + width > BIT_VECTOR_CHUNK_BITS) {
+        bits |= (uint64_t) pbv->content[chunk + 1] << (BIT_VECTOR_CHUNK_BITS - offset);
+    }
+    return (uint32_t) (bits & (((uint64_t) 1 << width) - 1));
+}
+
 //=========================================================================
 /**
  * @brief Compute logical NOT of a bit vector
@@ -99,6 +193,16 @@ bit_vector_t* bit_vector_xor(bit_vector_t* pbv1, const bit_vector_t* pbv2);
  */
 bit_vector_t* bit_vector_extract_zero_ext(const bit_vector_t* pbv, int64_t index, size_t size);
 
+//=========================================================================
+/**
+ * @brief Extract (zero extended) from a bit vector into an existing one (no allocation)
+ * @param dst pointer to the destination bit vector, its size is the extracted size
+ * @param pbv pointer to bit vector to extract from (all zeros if NULL), cannot be dst
+ * @param index index from where to start extraction
+ * @return pointer to the destination bit vector
+ */
+bit_vector_t* bit_vector_extract_zero_ext_to(bit_vector_t* dst, const bit_vector_t* pbv, int64_t index);
+
 //=========================================================================
 /**
  * @brief Create a new bit vector extracted from another bit vector (wrap extended)
@@ -109,6 +213,16 @@ bit_vector_t* bit_vector_extract_zero_ext(const bit_vector_t* pbv, int64_t index
  */
 bit_vector_t* bit_vector_extract_wrap_ext(const bit_vector_t* pbv, int64_t index, size_t size);
 
+//=========================================================================
+/**
+ * @brief Extract (wrap extended) from a bit vector into an existing one (no allocation)
+ * @param dst pointer to the destination bit vector, its size is the extracted size
+ * @param pbv pointer to bit vector to extract from, cannot be dst
+ * @param index index from where to start extraction
+ * @return pointer to the destination bit vector
+ */
+bit_vector_t* bit_vector_extract_wrap_ext_to(bit_vector_t* dst, const bit_vector_t* pbv, int64_t index);
+
 //=========================================================================
 /**
  * @brief Create a new bit vector shifted from another bit vector
@@ -118,6 +232,16 @@ bit_vector_t* bit_vector_extract_wrap_ext(const bit_vector_t* pbv, int64_t index
  */
 bit_vector_t* bit_vector_shift(const bit_vector_t* pbv, int64_t shift);
 
+//=========================================================================
+/**
+ * @brief Shift a bit vector into another one of the same size (no allocation)
+ * @param dst pointer to the destination bit vector (can be pbv, to shift in place)
+ * @param pbv pointer to bit vector to shift
+ * @param shift bit shift count
+ * @return pointer to the destination bit vector (NULL if sizes differ)
+ */
+bit_vector_t* bit_vector_shift_to(bit_vector_t* dst, const bit_vector_t* pbv, int64_t shift);
+
 //=========================================================================
 /**
  * @brief Join two bit vectors into a new bit vector
@@ -128,6 +252,17 @@ bit_vector_t* bit_vector_shift(const bit_vector_t* pbv, int64_t shift);
  */
 bit_vector_t* bit_vector_join(const bit_vector_t* pbv1, const bit_vector_t* pbv2, int64_t shift);
 
+//=========================================================================
+/**
+ * @brief Join two bit vectors into another one of the same size (no allocation)
+ * @param dst pointer to the destination bit vector (can be pbv1 or pbv2)
+ * @param pbv1 pointer to first bit vector
+ * @param pbv2 pointer to second bit vector
+ * @param shift bit shift count
+ * @return pointer to the destination bit vector (NULL if sizes differ)
+ */
+bit_vector_t* bit_vector_join_to(bit_vector_t* dst, const bit_vector_t* pbv1, const bit_vector_t* pbv2, int64_t shift);
+
 //=========================================================================
 /**
  * @brief Print bit vector values
@@ -145,6 +280,100 @@ int bit_vector_print(const bit_vector_t* pbv);
  */
 int bit_vector_println(const char* prefix, const bit_vector_t* pbv);
 
+//=========================================================================
+/**
+ * @brief Initialize a fixed-size bit vector with bit value
+ * (the operations on fixed-size vectors are unrolled and check nothing:
+ * pointers must be valid and vectors initialized)
+ * @param pbv pointer to the bit vector
+ * @param value bit value
+ * @return pointer to the bit vector, as a bit_vector_t
+ */
+bit_vector_t* bit_vector_160_init(bit_vector_160_t* pbv, bit_t value);
+bit_vector_t* bit_vector_256_init(bit_vector_256_t* pbv, bit_t value);
+
+//=========================================================================
+/**
+ * @brief Compute logical NOT of a fixed-size bit vector (in place)
+ * @param pbv pointer to the bit vector
+ */
+void bit_vector_160_not(bit_vector_160_t* pbv);
+void bit_vector_256_not(bit_vector_256_t* pbv);
+
+//=========================================================================
+/**
+ * @brief Compute logical AND, OR, XOR of two fixed-size bit vectors (into the first one)
+ * @param pbv1 pointer to first bit vector
+ * @param pbv2 pointer to second bit vector
+ */
+void bit_vector_160_and(bit_vector_160_t* pbv1, const bit_vector_160_t* pbv2);
+void bit_vector_256_and(bit_vector_256_t* pbv1, const bit_vector_256_t* pbv2);
+void bit_vector_160_or(bit_vector_160_t* pbv1, const bit_vector_160_t* pbv2);
+void bit_vector_256_or(bit_vector_256_t* pbv1, const bit_vector_256_t* pbv2);
+void bit_vector_160_xor(bit_vector_160_t* pbv1, const bit_vector_160_t* pbv2);
+void bit_vector_256_xor(bit_vector_256_t* pbv1, const bit_vector_256_t* pbv2);
+
+//=========================================================================
+/**
+ * @brief Shift a fixed-size bit vector (as bit_vector_shift)
+ * @param dst pointer to the destination bit vector (can be pbv)
+ * @param pbv pointer to bit vector to shift
+ * @param shift bit shift count
+ */
+void bit_vector_160_shift(bit_vector_160_t* dst, const bit_vector_160_t* pbv, int64_t shift);
+void bit_vector_256_shift(bit_vector_256_t* dst, const bit_vector_256_t* pbv, int64_t shift);
+
+//=========================================================================
+/**
+ * @brief Extract (wrap extended) an LCD line from a background line
+ * @param dst pointer to the destination bit vector
+ * @param pbv pointer to the background line
+ * @param index index from where to start extraction
+ */
+void bit_vector_256_extract_160(bit_vector_160_t* dst, const bit_vector_256_t* pbv, size_t index);
+
+//=========================================================================
+/**
+ * @brief Backends of the bulk operations (not, and, or, xor)
+ */
+typedef enum {
+    BIT_VECTOR_BACKEND_AUTO,   // best backend supported by the running CPU
+    BIT_VECTOR_BACKEND_SCALAR, // one chunk at a time
+    BIT_VECTOR_BACKEND_VEC128, // GCC vector extensions, 128 bits (any target)
+    BIT_VECTOR_BACKEND_AVX2,   // GCC vector extensions, 256 bits (x86 with AVX2)
+    NB_BIT_VECTOR_BACKENDS
+} bit_vector_backend_t;
+
+//=========================================================================
+/**
+ * @brief Forces the backend of the bulk operations
+ * @param backend backend to use (BIT_VECTOR_BACKEND_AUTO restores runtime detection)
+ * @return error code (ERR_BAD_PARAMETER if the CPU does not support it)
+ */
+int bit_vector_select_backend(bit_vector_backend_t backend);
+
+//=========================================================================
+/**
+ * @brief Name of a backend
+ * @param backend backend (BIT_VECTOR_BACKEND_AUTO for the one in use)
+ * @return name of the backend
+ */
+const char* bit_vector_backend_name(bit_vector_backend_t backend);
+
+//=========================================================================
+/**
+ * @brief Bulk operations on raw chunks, e.g. the opacity chunks of a whole
+ * frame at once (bit_vector_not/and/or/xor use them). Chunks need not be
+ * aligned; unused bits of a last partial chunk are not cleared.
+ * @param dst chunks to update
+ * @param src second operand chunks
+ * @param nb_chunks number of chunks
+ */
+void bit_vector_chunks_and(uint32_t* dst, const uint32_t* src, size_t nb_chunks);
+void bit_vector_chunks_or(uint32_t* dst, const uint32_t* src, size_t nb_chunks);
+void bit_vector_chunks_xor(uint32_t* dst, const uint32_t* src, size_t nb_chunks);
+void bit_vector_chunks_not(uint32_t* dst, size_t nb_chunks);
+
 //=========================================================================
 /**
  * @brief Frees a bit vector
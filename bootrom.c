@@ -1,19 +1,47 @@
 #include <stdio.h>
 #include <stdint.h>
+#include <string.h>
 #include "bootrom.h"
 #include "component.h"
+#include "cpu-registers.h"
+#include "timer.h"
+#include "lcdc.h"
+#include "joypad.h"
 #include "error.h"
 
+// one read-only copy for the whole process
+static const data_t bootrom_content[MEM_SIZE(BOOT_ROM)] = GAMEBOY_BOOT_ROM_CONTENT;
+
+// internal counter of the timer when the boot ROM hands over (DIV = 0xAB)
+#define POST_BOOT_TIMER_COUNTER 0xABCC
+
+// IO registers as the boot ROM of a DMG leaves them
+static const struct {
+    addr_t addr;
+    data_t value;
+} post_boot_io[] = {
+    { REG_P1, 0xCF }, { BLARGG_REG, 0x00 }, { 0xFF02, 0x7E },
+    { REG_TIMA, 0x00 }, { REG_TMA, 0x00 }, { REG_TAC, 0xF8 }, { REG_IF, 0xE1 },
+    // sound
+    { 0xFF10, 0x80 }, { 0xFF11, 0xBF }, { 0xFF12, 0xF3 }, { 0xFF13, 0xFF }, { 0xFF14, 0xBF },
+    { 0xFF16, 0x3F }, { 0xFF17, 0x00 }, { 0xFF18, 0xFF }, { 0xFF19, 0xBF },
+    { 0xFF1A, 0x7F }, { 0xFF1B, 0xFF }, { 0xFF1C, 0x9F }, { 0xFF1D, 0xFF }, { 0xFF1E, 0xBF },
+    { 0xFF20, 0xFF }, { 0xFF21, 0x00 }, { 0xFF22, 0x00 }, { 0xFF23, 0xBF },
+    { 0xFF24, 0x77 }, { 0xFF25, 0xF3 }, { 0xFF26, 0xF1 },
+    // LCD
+    { REG_LCDC, 0x91 }, { REG_STAT, 0x85 }, { REG_SCY, 0x00 }, { REG_SCX, 0x00 },
+    { REG_LY, 0x00 }, { REG_LYC, 0x00 }, { REG_DMA, 0xFF }, { REG_BGP, 0xFC },
+    { REG_OBP0, 0xFF }, { REG_OBP1, 0xFF }, { REG_WY, 0x00 }, { REG_WX, 0x00 },
+    { REG_BOOT_ROM_DISABLE, 0xFF }, { REG_IE, 0x00 }
+};
+
 // ======================================================================
 int bootrom_init(component_t* c)
 {
     M_REQUIRE_NON_NULL(c);
     M_REQUIRE_NO_ERR(component_create(c, MEM_SIZE(BOOT_ROM)));
-    data_t content[MEM_SIZE(BOOT_ROM)] = GAMEBOY_BOOT_ROM_CONTENT;
-    for (size_t i = 0; i < MEM_SIZE(BOOT_ROM); ++i){
-        *(c -> mem -> memory + i) = content[i];
-    }
-    
+    memcpy(c -> mem -> memory, bootrom_content, sizeof(bootrom_content));
+
     return ERR_NONE;
 }
 
@@ -30,4 +58,32 @@ int bootrom_bus_listener(gameboy_t* gameboy, addr_t addr)
     }
 
     return ERR_NONE;
-}
\ No newline at end of file
+}
+
+// ======================================================================
+int bootrom_skip(gameboy_t* gameboy)
+{
+    M_REQUIRE_NON_NULL(gameboy);
+    M_REQUIRE(gameboy -> boot == 0, ERR_BAD_PARAMETER, "boot ROM of %p still mapped", (void*) gameboy);
+
+    cpu_t* const cpu = &(gameboy -> cpu);
+    cpu_AF_set(cpu, 0x01B0);
+    cpu_BC_set(cpu, 0x0013);
+    cpu_DE_set(cpu, 0x00D8);
+    cpu_HL_set(cpu, 0x014D);
+    cpu -> SP = 0xFFFE;
+    cpu -> PC = 0x0100;
+    cpu -> IME = 0;
+    cpu -> HALT = 0;
+
+    // written as the boot ROM would have: no listener but the joypad's is concerned
+    for (size_t i = 0; i < sizeof(post_boot_io) / sizeof(post_boot_io[0]); ++i) {
+        M_REQUIRE_NO_ERR(bus_write(gameboy -> bus, post_boot_io[i].addr, post_boot_io[i].value));
+    }
+    M_REQUIRE_NO_ERR(joypad_bus_listener(&(gameboy -> pad), REG_P1));
+
+    gameboy -> timer.counter = POST_BOOT_TIMER_COUNTER;
+    M_REQUIRE_NO_ERR(bus_write(gameboy -> bus, REG_DIV, msb8(POST_BOOT_TIMER_COUNTER)));
+
+    return ERR_NONE;
+}
@@ -65,6 +65,17 @@ extern "C" {
 int bootrom_init(component_t* c);
 
 
+/**
+ * @brief Puts a gameboy, whose boot ROM is not mapped, in the state
+ *        the boot ROM of a DMG leaves it in: CPU registers (PC = 0x0100),
+ *        IO registers and timer counter
+ *
+ * @param gameboy gameboy
+ * @return error code
+ */
+int bootrom_skip(gameboy_t* gameboy);
+
+
 /**
  * @brief Macro to plug bootrom onto the bus
  */
@@ -0,0 +1,176 @@
+/**
+ * @file compose.c
+ * @brief Fused compositing of the background, window and sprites of a line
+ *
+ * @date 2020
+ */
+
+#include <stdint.h>
+
+#include "compose.h"
+#include "error.h"
+
+#define WORD_BITS IMAGE_LINE_WORD_BITS
+
+#define nb_words_of(size) (((size) + WORD_BITS - 1) / WORD_BITS)
+
+// ======================================================================
+#define M_REQUIRE_LAYER(piml) \
+    do { \
+        M_REQUIRE_NON_NULL((piml)->msb); \
+        M_REQUIRE_NON_NULL((piml)->lsb); \
+        M_REQUIRE_NON_NULL((piml)->opacity); \
+        M_REQUIRE((piml)->lsb->size == (piml)->msb->size, ERR_BAD_PARAMETER, "%s", "Sizes do not match"); \
+        M_REQUIRE((piml)->opacity->size == (piml)->msb->size, ERR_BAD_PARAMETER, "%s", "Sizes do not match"); \
+    } while(0)
+
+#define M_REQUIRE_NOT_OUTPUT(output, piml) \
+    M_REQUIRE((piml)->msb != (output)->msb && (piml)->lsb != (output)->lsb, \
+              ERR_BAD_PARAMETER, "%s", "Output cannot be a layer")
+
+// ======================================================================
+/**
+ * @brief word of 32 pixels from index, modulo the size (nb_words words)
+ */
+static inline uint32_t wrap_word(const uint32_t* content, size_t nb_words, size_t index)
+{
+    const size_t w = (index / WORD_BITS) % nb_words;
+    const size_t s = index % WORD_BITS;
+    if (s == 0) return content[w];
+    return (content[w] >> s) | (content[(w + 1) % nb_words] << (WORD_BITS - s));
+}
+
+// ======================================================================
+static inline uint32_t chunk(const uint32_t* content, size_t nb_words, int64_t w)
+{
+    return w >= 0 && (uint64_t) w < nb_words ? content[w] : 0;
+}
+
+// ======================================================================
+/**
+ * @brief word of 32 pixels from index, pixels outside being 0
+ */
+static inline uint32_t zero_word(const uint32_t* content, size_t nb_words, int64_t index)
+{
+    const int64_t w = index >= 0 ? index / WORD_BITS : -((-index + WORD_BITS - 1) / WORD_BITS);
+    const int64_t s = index - w * WORD_BITS;
+    const uint32_t low = chunk(content, nb_words, w);
+    if (s == 0) return low;
+    return (low >> s) | (chunk(content, nb_words, w + 1) << (WORD_BITS - s));
+}
+
+// ======================================================================
+/**
+ * @brief mask of the pixels of the word starting at x0 which are at or after start
+ */
+static inline uint32_t from_mask(int64_t start, int64_t x0)
+{
+    const int64_t rel = start - x0;
+    if (rel <= 0) return UINT32_MAX;
+    if (rel >= WORD_BITS) return 0;
+    return ~((UINT32_C(1) << rel) - 1);
+}
+
+// ======================================================================
+/**
+ * @brief sprite row placed in the word starting at x0
+ */
+static inline uint32_t place(uint8_t row, int64_t x, int64_t x0)
+{
+    const int64_t rel = x - x0;
+    if (rel <= -COMPOSE_SPRITE_WIDTH || rel >= WORD_BITS) return 0;
+    return rel >= 0 ? (uint32_t) row << rel : (uint32_t) row >> -rel;
+}
+
+// ======================================================================
+int compose_line(image_line_t* output, const compose_line_t* line)
+{
+    M_REQUIRE_NON_NULL(output);
+    M_REQUIRE_NON_NULL(line);
+    M_REQUIRE_LAYER(output);
+    M_REQUIRE(line->nb_sprites <= COMPOSE_MAX_SPRITES, ERR_BAD_PARAMETER,
+              "Too many sprites (%zu > %d)", line->nb_sprites, COMPOSE_MAX_SPRITES);
+    M_REQUIRE(line->nb_sprites == 0 || line->sprites != NULL, ERR_BAD_PARAMETER, "%s", "No sprites");
+
+    const image_line_t* const bg = line->background;
+    const image_line_t* const win = line->window;
+    if (bg != NULL) {
+        M_REQUIRE_LAYER(bg);
+        M_REQUIRE_NOT_OUTPUT(output, bg);
+        M_REQUIRE(bg->msb->size > 0 && bg->msb->size % WORD_BITS == 0, ERR_BAD_PARAMETER,
+                  "Background size (%zu) is not a multiple of %d", bg->msb->size, WORD_BITS);
+    }
+    if (win != NULL) {
+        M_REQUIRE_LAYER(win);
+        M_REQUIRE_NOT_OUTPUT(output, win);
+    }
+    const size_t bg_words = bg == NULL ? 0 : nb_words_of(bg->msb->size);
+    const size_t win_words = win == NULL ? 0 : nb_words_of(win->msb->size);
+
+    // sprite rows, mapped once: pixels are then only placed in the words
+    uint8_t opaque[COMPOSE_MAX_SPRITES];
+    uint8_t mapped_lsb[COMPOSE_MAX_SPRITES];
+    uint8_t mapped_msb[COMPOSE_MAX_SPRITES];
+    for (size_t i = 0; i < line->nb_sprites; ++i) {
+        const compose_sprite_t* const sprite = line->sprites + i;
+        uint32_t l = sprite->lsb;
+        uint32_t m = sprite->msb;
+        image_map_colors_word(&l, &m, sprite->palette);
+        opaque[i] = sprite->lsb | sprite->msb;
+        mapped_lsb[i] = (uint8_t) l;
+        mapped_msb[i] = (uint8_t) m;
+    }
+
+    const size_t size = output->msb->size;
+    const size_t nb_words = nb_words_of(size);
+    for (size_t j = 0; j < nb_words; ++j) {
+        const int64_t x0 = (int64_t) (j * WORD_BITS);
+
+        // background, then window over it
+        uint32_t l = 0, m = 0, covered = 0;
+        if (bg != NULL) {
+            l = wrap_word(bg->lsb->content, bg_words, line->scroll_x + j * WORD_BITS);
+            m = wrap_word(bg->msb->content, bg_words, line->scroll_x + j * WORD_BITS);
+            covered = UINT32_MAX;
+        }
+        if (win != NULL) {
+            const uint32_t in_window = from_mask(line->window_x, x0);
+            const int64_t from = x0 - line->window_x;
+            l = (l & ~in_window) | (zero_word(win->lsb->content, win_words, from) & in_window);
+            m = (m & ~in_window) | (zero_word(win->msb->content, win_words, from) & in_window);
+            covered |= in_window;
+        }
+        const uint32_t bg_opaque = l | m;
+        image_map_colors_word(&l, &m, line->bg_palette);
+        l &= covered;
+        m &= covered;
+
+        // sprites: the first opaque one wins a pixel, and shows unless behind the background
+        uint32_t taken = 0, shown = 0, sprite_l = 0, sprite_m = 0;
+        for (size_t i = 0; i < line->nb_sprites; ++i) {
+            const int64_t x = line->sprites[i].x;
+            const uint32_t mine = place(opaque[i], x, x0) & ~taken;
+            if (mine == 0) continue;
+            taken |= mine;
+
+            const uint32_t visible = line->sprites[i].behind_bg ? mine & ~bg_opaque : mine;
+            sprite_l |= place(mapped_lsb[i], x, x0) & visible;
+            sprite_m |= place(mapped_msb[i], x, x0) & visible;
+            shown |= visible;
+        }
+
+        output->lsb->content[j] = (l & ~shown) | sprite_l;
+        output->msb->content[j] = (m & ~shown) | sprite_m;
+        output->opacity->content[j] = bg_opaque | shown;
+    }
+
+    // no pixel past the size
+    if (size % WORD_BITS != 0) {
+        const uint32_t mask = (UINT32_C(1) << (size % WORD_BITS)) - 1;
+        output->lsb->content[nb_words - 1] &= mask;
+        output->msb->content[nb_words - 1] &= mask;
+        output->opacity->content[nb_words - 1] &= mask;
+    }
+
+    return ERR_NONE;
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+/**
+ * @file compose.h
+ * @brief Fused compositing of the background, window and sprites of a line
+ *
+ * Instead of chaining extract_wrap_ext, map_colors, below and join on whole
+ * image lines, the layers of a screen line are read, mapped through their
+ * palettes and stacked one output word at a time, without intermediate lines.
+ *
+ * @date 2020
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "bit.h"
+#include "image.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Maximum number of sprites composed on a single line
+#define COMPOSE_MAX_SPRITES 10
+
+// Width of a sprite row
+#define COMPOSE_SPRITE_WIDTH 8
+
+/**
+ * @brief One row of a sprite
+ */
+typedef struct {
+    uint8_t lsb;        // colors, unmapped: pixel k is bit k (flip already applied)
+    uint8_t msb;
+    int64_t x;          // screen x of pixel 0 (OAM x - 8), can be negative
+    palette_t palette;  // OBP0 or OBP1
+    bit_t behind_bg;    // only drawn where the background color is 0
+} compose_sprite_t;
+
+/**
+ * @brief Layers of a line
+ */
+typedef struct {
+    const image_line_t* background; // colors, unmapped (NULL: background off);
+                                    // size a multiple of IMAGE_LINE_WORD_BITS
+    size_t scroll_x;                // background pixel shown at screen x = 0
+    const image_line_t* window;     // colors, unmapped (NULL: no window on this line)
+    int64_t window_x;               // screen x of window pixel 0 (WX - 7)
+    palette_t bg_palette;           // BGP, for both the background and the window
+    const compose_sprite_t* sprites; // highest priority first
+    size_t nb_sprites;
+} compose_line_t;
+
+
+/**
+ * @brief Composes a screen line in a single pass over its words.
+ *        Screen pixel x is:
+ *         - the first opaque (color not 0) sprite pixel at x, mapped through
+ *           its palette, unless that sprite is behind a background or window
+ *           color which is not 0;
+ *         - otherwise window pixel (x - window_x) if x >= window_x, or
+ *           background pixel (scroll_x + x) modulo the background size,
+ *           mapped through bg_palette;
+ *         - otherwise (no background nor window) color 0.
+ *        Opacity is set where the shown color, before mapping, is not 0.
+ *
+ * @param output image line to write to (already created, e.g. LCD_WIDTH
+ *        pixels), which cannot be one of the layers
+ * @param line layers of the line
+ * @return error code
+ */
+int compose_line(image_line_t* output, const compose_line_t* line);
+
+#ifdef __cplusplus
+}
+#endif
@@ -243,8 +243,10 @@ static int cpu_dispatch(const instruction_t* lu, cpu_t* cpu)
     case LD_HLSP_S8:
     case DAA:
     case SCCF:
+        // operands are read relative to the opcode
         cpu -> PC = cpu -> PC - lu -> bytes;
         M_EXIT_IF_ERR(cpu_dispatch_alu(lu, cpu));
+        cpu -> PC = cpu -> PC + lu -> bytes;
         break;
 
     // STORAGE
@@ -272,6 +274,7 @@ static int cpu_dispatch(const instruction_t* lu, cpu_t* cpu)
     case PUSH_R16:
         cpu -> PC = cpu -> PC - lu -> bytes;
         M_EXIT_IF_ERR(cpu_dispatch_storage(lu, cpu));
+        cpu -> PC = cpu -> PC + lu -> bytes;
         break;
 
 
@@ -0,0 +1,410 @@
+/**
+ * @file frame_dump.c
+ * @brief Asynchronous capture of LCD frames to PPM, Y4M or PNG files
+ *
+ * @date 2020
+ */
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <inttypes.h>
+#include <errno.h>
+
+#include "frame_dump.h"
+#include "error.h"
+
+#define GREY(color) ((uint8_t) (255 - 85 * (color)))
+
+#define FRAME_PIXELS (LCD_WIDTH * LCD_HEIGHT)
+
+// frames encoded before a write, for streamed formats
+#define BATCH_FRAMES 8
+
+// PPM
+#define PPM_HEADER     "P6\n" "160 144\n" "255\n"
+#define PPM_FRAME_SIZE (sizeof(PPM_HEADER) - 1 + 3 * FRAME_PIXELS)
+
+// Y4M: one frame every FRAME_TOTAL_CYCLES cycles of 2^20 Hz
+#define Y4M_HEADER       "YUV4MPEG2 W160 H144 F1048576:17556 Ip A1:1 C420jpeg XCOLORRANGE=FULL\n"
+#define Y4M_FRAME_HEADER "FRAME\n"
+#define Y4M_CHROMA       ((LCD_WIDTH / 2) * (LCD_HEIGHT / 2))
+#define Y4M_FRAME_SIZE   (sizeof(Y4M_FRAME_HEADER) - 1 + FRAME_PIXELS + 2 * Y4M_CHROMA)
+
+// PNG: 8-bit greyscale, image data in a single stored deflate block
+#define PNG_RAW_SIZE   (LCD_HEIGHT * (1 + LCD_WIDTH)) // filter byte per row
+#define PNG_ZLIB_SIZE  (2 + 5 + PNG_RAW_SIZE + 4)
+#define PNG_CHUNK(n)   (4 + 4 + (n) + 4)
+#define PNG_FRAME_SIZE (8 + PNG_CHUNK(13) + PNG_CHUNK(PNG_ZLIB_SIZE) + PNG_CHUNK(0))
+#define PNG_EXTENSION  ".png"
+
+#if PNG_RAW_SIZE > 0xFFFF
+#error "PNG image data does not fit in a single stored block"
+#endif
+
+// ======================================================================
+static uint32_t crc_table[256];
+static pthread_once_t crc_once = PTHREAD_ONCE_INIT;
+
+static void crc_init(void)
+{
+    for (uint32_t n = 0; n < 256; ++n) {
+        uint32_t c = n;
+        for (int k = 0; k < 8; ++k) {
+            c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+        }
+        crc_table[n] = c;
+    }
+}
+
+// ======================================================================
+static uint32_t png_crc(const uint8_t* data, size_t size)
+{
+    uint32_t c = 0xFFFFFFFFu;
+    for (size_t i = 0; i < size; ++i) {
+        c = crc_table[(c ^ data[i]) & 0xFF] ^ (c >> 8);
+    }
+    return c ^ 0xFFFFFFFFu;
+}
+
+// ======================================================================
+static uint32_t adler32(const uint8_t* data, size_t size)
+{
+    uint32_t a = 1, b = 0;
+    for (size_t i = 0; i < size; ++i) {
+        a = (a + data[i]) % 65521;
+        b = (b + a) % 65521;
+    }
+    return (b << 16) | a;
+}
+
+// ======================================================================
+static uint8_t* put32(uint8_t* p, uint32_t value)
+{
+    p[0] = (uint8_t) (value >> 24);
+    p[1] = (uint8_t) (value >> 16);
+    p[2] = (uint8_t) (value >> 8);
+    p[3] = (uint8_t) value;
+    return p + 4;
+}
+
+// ======================================================================
+/**
+ * @brief writes a PNG chunk whose data is already at p + 8
+ */
+static uint8_t* png_chunk(uint8_t* p, const char* type, size_t size)
+{
+    put32(p, (uint32_t) size);
+    memcpy(p + 4, type, 4);
+    return put32(p + 8 + size, png_crc(p + 4, 4 + size));
+}
+
+// ======================================================================
+static size_t encode_ppm(uint8_t* out, const uint8_t* pixels)
+{
+    memcpy(out, PPM_HEADER, sizeof(PPM_HEADER) - 1);
+    uint8_t* p = out + sizeof(PPM_HEADER) - 1;
+    for (size_t y = 0; y < LCD_HEIGHT; ++y) {
+        for (size_t x = 0; x < LCD_WIDTH; ++x) {
+            p[0] = p[1] = p[2] = GREY(pixels[y * LCD_WIDTH + x]);
+            p += 3;
+        }
+    }
+    return PPM_FRAME_SIZE;
+}
+
+// ======================================================================
+static size_t encode_y4m(uint8_t* out, const uint8_t* pixels)
+{
+    memcpy(out, Y4M_FRAME_HEADER, sizeof(Y4M_FRAME_HEADER) - 1);
+    uint8_t* p = out + sizeof(Y4M_FRAME_HEADER) - 1;
+    for (size_t y = 0; y < LCD_HEIGHT; ++y) {
+        for (size_t x = 0; x < LCD_WIDTH; ++x) {
+            *p++ = GREY(pixels[y * LCD_WIDTH + x]);
+        }
+    }
+    memset(p, 128, 2 * Y4M_CHROMA); // no chroma
+    return Y4M_FRAME_SIZE;
+}
+
+// ======================================================================
+static size_t encode_png(uint8_t* out, const uint8_t* pixels)
+{
+    static const uint8_t signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+    memcpy(out, signature, sizeof(signature));
+    uint8_t* p = out + sizeof(signature);
+
+    uint8_t* d = put32(p + 8, LCD_WIDTH);
+    d = put32(d, LCD_HEIGHT);
+    d[0] = 8; // bit depth
+    d[1] = 0; // greyscale
+    d[2] = d[3] = d[4] = 0; // deflate, no filter, no interlace
+    p = png_chunk(p, "IHDR", 13);
+
+    d = p + 8;
+    d[0] = 0x78; // deflate, 32K window
+    d[1] = 0x01; // no compression level, (0x7801 % 31 == 0)
+    d[2] = 0x01; // final stored block
+    d[3] = (uint8_t) (PNG_RAW_SIZE & 0xFF);
+    d[4] = (uint8_t) (PNG_RAW_SIZE >> 8);
+    d[5] = (uint8_t) ~d[3];
+    d[6] = (uint8_t) ~d[4];
+    uint8_t* const raw = d + 7;
+    uint8_t* r = raw;
+    for (size_t y = 0; y < LCD_HEIGHT; ++y) {
+        *r++ = 0; // no filter
+        for (size_t x = 0; x < LCD_WIDTH; ++x) {
+            *r++ = GREY(pixels[y * LCD_WIDTH + x]);
+        }
+    }
+    put32(r, adler32(raw, PNG_RAW_SIZE));
+    p = png_chunk(p, "IDAT", PNG_ZLIB_SIZE);
+    p = png_chunk(p, "IEND", 0);
+
+    return (size_t) (p - out);
+}
+
+// ======================================================================
+static void set_error(frame_dump_t* dump, int err)
+{
+    int none = ERR_NONE;
+    atomic_compare_exchange_strong(&(dump -> error), &none, err);
+}
+
+// ======================================================================
+static void flush_out(frame_dump_t* dump, size_t* used)
+{
+    if (*used > 0 && fwrite(dump -> out, 1, *used, dump -> stream) != *used) {
+        set_error(dump, ERR_IO);
+    }
+    *used = 0;
+}
+
+// ======================================================================
+static void write_png(frame_dump_t* dump, const uint8_t* pixels, uint64_t number)
+{
+    const size_t size = encode_png(dump -> out, pixels);
+    char name[FILENAME_MAX];
+    snprintf(name, sizeof(name), "%s-%06" PRIu64 PNG_EXTENSION, dump -> path, number);
+
+    FILE* file = fopen(name, "wb");
+    if (file == NULL) {
+        set_error(dump, ERR_IO);
+        return;
+    }
+    if (fwrite(dump -> out, 1, size, file) != size) {
+        set_error(dump, ERR_IO);
+    }
+    fclose(file);
+}
+
+// ======================================================================
+static void* writer_thread(void* arg)
+{
+    frame_dump_t* const dump = arg;
+    size_t used = 0;
+
+    for (;;) {
+        while (sem_wait(&(dump -> pending)) != 0 && errno == EINTR);
+
+        const size_t tail = atomic_load_explicit(&(dump -> tail), memory_order_relaxed);
+        const size_t head = atomic_load_explicit(&(dump -> head), memory_order_acquire);
+        if (tail == head) {
+            // the only token without a frame is the stop one
+            break;
+        }
+
+        const uint8_t* const frame = &(dump -> ring[tail % dump -> capacity][0][0]);
+        const uint64_t number = atomic_load(&(dump -> written));
+        switch (dump -> format) {
+        case FRAME_DUMP_PPM:
+            used += encode_ppm(dump -> out + used, frame);
+            break;
+        case FRAME_DUMP_Y4M:
+            used += encode_y4m(dump -> out + used, frame);
+            break;
+        default:
+            write_png(dump, frame, number);
+            break;
+        }
+        atomic_store_explicit(&(dump -> tail), tail + 1, memory_order_release);
+        atomic_store(&(dump -> written), number + 1);
+
+        // one write for every frame available, or for a full buffer (PPM frames are the largest)
+        if (dump -> format != FRAME_DUMP_PNG &&
+            (tail + 1 == head || used + PPM_FRAME_SIZE > dump -> out_size)) {
+            flush_out(dump, &used);
+        }
+    }
+
+    if (dump -> format != FRAME_DUMP_PNG) {
+        flush_out(dump, &used);
+    }
+    return NULL;
+}
+
+// ======================================================================
+frame_dump_format_t frame_dump_format_from_name(const char* filename)
+{
+    const char* const dot = filename == NULL ? NULL : strrchr(filename, '.');
+    if (dot != NULL && strcmp(dot, ".y4m") == 0) return FRAME_DUMP_Y4M;
+    if (dot != NULL && strcmp(dot, PNG_EXTENSION) == 0) return FRAME_DUMP_PNG;
+    return FRAME_DUMP_PPM;
+}
+
+// ======================================================================
+int frame_dump_open(frame_dump_t* dump, const char* path, frame_dump_format_t format, size_t ring_size)
+{
+    M_REQUIRE_NON_NULL(dump);
+    M_REQUIRE_NON_NULL(path);
+    M_REQUIRE(format >= FRAME_DUMP_PPM && format < NB_FRAME_DUMP_FORMATS, ERR_BAD_PARAMETER,
+              "Invalid dump format (%d)", format);
+    M_REQUIRE(ring_size > 0, ERR_BAD_PARAMETER, "%s", "ring size cannot be zero");
+
+    memset(dump, 0, sizeof(frame_dump_t));
+    pthread_once(&crc_once, crc_init);
+
+    dump -> format = format;
+    dump -> capacity = ring_size;
+    dump -> out_size = format == FRAME_DUMP_PNG ? PNG_FRAME_SIZE : BATCH_FRAMES * PPM_FRAME_SIZE;
+    dump -> path = strdup(path);
+    dump -> ring = calloc(ring_size, sizeof(frame_pixels_t));
+    dump -> out = malloc(dump -> out_size);
+    if (dump -> path == NULL || dump -> ring == NULL || dump -> out == NULL) {
+        free(dump -> path);
+        free(dump -> ring);
+        free(dump -> out);
+        return ERR_MEM;
+    }
+
+    int err = ERR_NONE;
+    if (format == FRAME_DUMP_PNG) {
+        // frames are named after the path, without its extension
+        char* const dot = strrchr(dump -> path, '.');
+        if (dot != NULL && strcmp(dot, PNG_EXTENSION) == 0) *dot = '\0';
+    } else {
+        dump -> stream = fopen(path, "wb");
+        if (dump -> stream == NULL) {
+            err = ERR_IO;
+        } else if (format == FRAME_DUMP_Y4M &&
+                   fputs(Y4M_HEADER, dump -> stream) == EOF) {
+            fclose(dump -> stream);
+            err = ERR_IO;
+        }
+    }
+
+    atomic_init(&(dump -> head), 0);
+    atomic_init(&(dump -> tail), 0);
+    atomic_init(&(dump -> written), 0);
+    atomic_init(&(dump -> error), ERR_NONE);
+
+    if (err == ERR_NONE && sem_init(&(dump -> pending), 0, 0) != 0) {
+        if (dump -> stream != NULL) fclose(dump -> stream);
+        err = ERR_MEM;
+    }
+    if (err == ERR_NONE && pthread_create(&(dump -> writer), NULL, writer_thread, dump) != 0) {
+        sem_destroy(&(dump -> pending));
+        if (dump -> stream != NULL) fclose(dump -> stream);
+        err = ERR_MEM;
+    }
+    if (err != ERR_NONE) {
+        free(dump -> path);
+        free(dump -> ring);
+        free(dump -> out);
+        memset(dump, 0, sizeof(frame_dump_t));
+    }
+    return err;
+}
+
+// ======================================================================
+/**
+ * @brief gets the ring slot to capture the next frame into, NULL if full
+ */
+static frame_pixels_t* reserve(frame_dump_t* dump)
+{
+    const size_t head = atomic_load_explicit(&(dump -> head), memory_order_relaxed);
+    const size_t tail = atomic_load_explicit(&(dump -> tail), memory_order_acquire);
+    ++(dump -> captured);
+    if (head - tail >= dump -> capacity) {
+        ++(dump -> dropped);
+        return NULL;
+    }
+    return &(dump -> ring[head % dump -> capacity]);
+}
+
+// ======================================================================
+static void commit(frame_dump_t* dump)
+{
+    atomic_fetch_add_explicit(&(dump -> head), 1, memory_order_release);
+    sem_post(&(dump -> pending));
+}
+
+// ======================================================================
+int frame_dump_push_pixels(frame_dump_t* dump, const uint8_t* pixels)
+{
+    M_REQUIRE_NON_NULL(dump);
+    M_REQUIRE_NON_NULL(dump -> ring);
+    M_REQUIRE_NON_NULL(pixels);
+
+    frame_pixels_t* const slot = reserve(dump);
+    if (slot != NULL) {
+        memcpy(slot, pixels, sizeof(frame_pixels_t));
+        commit(dump);
+    }
+    return ERR_NONE;
+}
+
+// ======================================================================
+int frame_dump_push_image(frame_dump_t* dump, const image_t* image)
+{
+    M_REQUIRE_NON_NULL(dump);
+    M_REQUIRE_NON_NULL(dump -> ring);
+    M_REQUIRE_NON_NULL(image);
+    M_REQUIRE_NON_NULL(image -> content);
+    M_REQUIRE(image -> height >= LCD_HEIGHT, ERR_BAD_PARAMETER,
+              "image too small (%zu lines)", image -> height);
+    for (size_t y = 0; y < LCD_HEIGHT; ++y) {
+        M_REQUIRE(image -> content[y].msb != NULL && image -> content[y].lsb != NULL &&
+                  image -> content[y].msb -> size >= LCD_WIDTH, ERR_BAD_PARAMETER,
+                  "invalid image line %zu", y);
+    }
+
+    frame_pixels_t* const slot = reserve(dump);
+    if (slot != NULL) {
+        for (size_t y = 0; y < LCD_HEIGHT; ++y) {
+            const uint32_t* const msb = image -> content[y].msb -> content;
+            const uint32_t* const lsb = image -> content[y].lsb -> content;
+            for (size_t x = 0; x < LCD_WIDTH; ++x) {
+                const size_t w = x / IMAGE_LINE_WORD_BITS, b = x % IMAGE_LINE_WORD_BITS;
+                (*slot)[y][x] = (uint8_t) ((((msb[w] >> b) & 1) << 1) | ((lsb[w] >> b) & 1));
+            }
+        }
+        commit(dump);
+    }
+    return ERR_NONE;
+}
+
+// ======================================================================
+int frame_dump_close(frame_dump_t* dump)
+{
+    M_REQUIRE_NON_NULL(dump);
+    M_REQUIRE_NON_NULL(dump -> ring);
+
+    // stop token, after every frame token
+    sem_post(&(dump -> pending));
+    pthread_join(dump -> writer, NULL);
+    sem_destroy(&(dump -> pending));
+
+    if (dump -> stream != NULL && fclose(dump -> stream) != 0) {
+        set_error(dump, ERR_IO);
+    }
+    dump -> stream = NULL;
+    free(dump -> path);
+    free(dump -> ring);
+    free(dump -> out);
+    dump -> path = NULL;
+    dump -> ring = NULL;
+    dump -> out = NULL;
+
+    return atomic_load(&(dump -> error));
+}
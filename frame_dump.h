@@ -0,0 +1,123 @@
+#pragma once
+
+/**
+ * @file frame_dump.h
+ * @brief Asynchronous capture of LCD frames to PPM, Y4M or PNG files
+ *
+ * Frames are copied into a bounded ring of preallocated buffers. A writer
+ * thread encodes them and writes them out in large sequential writes.
+ * Pushing a frame never blocks nor touches the disk: when the ring is
+ * full, the frame is dropped and counted.
+ *
+ * @date 2020
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <semaphore.h>
+
+#include "image.h"
+#include "lcdc.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Output formats
+ */
+typedef enum {
+    FRAME_DUMP_PPM, // stream of binary (P6) PPM images, in a single file
+    FRAME_DUMP_Y4M, // YUV4MPEG2 video stream (4:2:0, full range grey)
+    FRAME_DUMP_PNG, // one greyscale PNG file per frame
+    NB_FRAME_DUMP_FORMATS
+} frame_dump_format_t;
+
+#define FRAME_DUMP_DEFAULT_RING_SIZE 16
+
+/**
+ * @brief A captured frame: color (0 to 3) of every pixel
+ */
+typedef uint8_t frame_pixels_t[LCD_HEIGHT][LCD_WIDTH];
+
+/**
+ * @brief Frame dump type
+ */
+typedef struct {
+    frame_dump_format_t format;
+    char* path;               // output file (PPM, Y4M) or file name prefix (PNG)
+    FILE* stream;             // output file (PPM, Y4M)
+    frame_pixels_t* ring;     // ring of captured frames
+    size_t capacity;          // number of frames in the ring
+    atomic_size_t head;       // next slot to fill (capturing thread only)
+    atomic_size_t tail;       // next slot to write (writer thread only)
+    uint8_t* out;             // encoding buffer of the writer thread
+    size_t out_size;
+    sem_t pending;            // one token per captured frame, plus one to stop
+    pthread_t writer;
+    uint64_t captured;        // frames captured (capturing thread only)
+    uint64_t dropped;         // frames dropped because the ring was full
+    atomic_uint_fast64_t written; // frames written out
+    atomic_int error;         // first error of the writer thread
+} frame_dump_t;
+
+
+/**
+ * @brief Guesses the output format from a file name extension
+ *        (".y4m", ".png", anything else is PPM)
+ *
+ * @param filename file name
+ * @return output format
+ */
+frame_dump_format_t frame_dump_format_from_name(const char* filename);
+
+
+/**
+ * @brief Opens a frame dump and starts its writer thread
+ *
+ * @param dump frame dump to open
+ * @param path output file; for PNG, frames are written to path with its
+ *        ".png" extension replaced by "-NNNNNN.png"
+ * @param format output format
+ * @param ring_size number of frames the ring can hold
+ * @return error code
+ */
+int frame_dump_open(frame_dump_t* dump, const char* path, frame_dump_format_t format, size_t ring_size);
+
+
+/**
+ * @brief Captures a frame given as pixel colors. Never blocks.
+ *
+ * @param dump frame dump
+ * @param pixels colors of the frame, row by row (LCD_WIDTH x LCD_HEIGHT)
+ * @return error code (ERR_NONE also when the frame was dropped)
+ */
+int frame_dump_push_pixels(frame_dump_t* dump, const uint8_t* pixels);
+
+
+/**
+ * @brief Captures a frame given as an LCD image (LCD_WIDTH x LCD_HEIGHT).
+ *        Never blocks.
+ *
+ * @param dump frame dump
+ * @param image image of the frame
+ * @return error code (ERR_NONE also when the frame was dropped)
+ */
+int frame_dump_push_image(frame_dump_t* dump, const image_t* image);
+
+
+/**
+ * @brief Writes out every captured frame, stops the writer thread and
+ *        closes the output
+ *
+ * @param dump frame dump to close
+ * @return first error encountered by the writer thread, if any
+ */
+int frame_dump_close(frame_dump_t* dump);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,210 @@
+/**
+ * @file frame_pacer.c
+ * @brief Pacing of emulated frames to real time, on the monotonic clock
+ *
+ * @date 2020
+ */
+
+#include <time.h>
+#include <errno.h>
+#include <string.h>
+#include <inttypes.h>
+
+#include "frame_pacer.h"
+#include "error.h"
+
+#define NS_PER_S 1000000000ULL
+
+// ======================================================================
+uint64_t frame_pacer_now_ns(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t) now.tv_sec * NS_PER_S + (uint64_t) now.tv_nsec;
+}
+
+// ----------------------------------------------------------------------
+/**
+ * @brief default clock: current time of CLOCK_MONOTONIC
+ */
+static uint64_t monotonic_now(void* clock_data)
+{
+    (void) clock_data;
+    return frame_pacer_now_ns();
+}
+
+// ----------------------------------------------------------------------
+/**
+ * @brief default clock: sleeps until the given time of CLOCK_MONOTONIC
+ */
+static int monotonic_sleep_until(void* clock_data, uint64_t until_ns)
+{
+    (void) clock_data;
+    const struct timespec until = {
+        .tv_sec = (time_t) (until_ns / NS_PER_S),
+        .tv_nsec = (long) (until_ns % NS_PER_S)
+    };
+    int err = 0;
+    do {
+        err = clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &until, NULL);
+    } while (err == EINTR);
+    M_REQUIRE(err == 0, ERR_IO, "cannot sleep until %" PRIu64 " ns (%d)", until_ns, err);
+    return ERR_NONE;
+}
+
+// ----------------------------------------------------------------------
+/**
+ * @brief monotonic time the given frame is due at
+ */
+static uint64_t deadline_ns(const frame_pacer_t* pacer, uint64_t frame)
+{
+    // seconds and remainder apart: no overflow, and no rounding error accumulated
+    const uint64_t cycles = frame * pacer -> frame_cycles;
+    const uint64_t rate = pacer -> cycles_per_s * pacer -> multiplier;
+    return pacer -> origin_ns + cycles / rate * NS_PER_S + cycles % rate * NS_PER_S / rate;
+}
+
+// ----------------------------------------------------------------------
+/**
+ * @brief makes the frame due one frame from now the first one
+ */
+static void restart(frame_pacer_t* pacer, uint64_t now)
+{
+    pacer -> origin_ns = now;
+    pacer -> frames = 1;
+    pacer -> late = 0;
+}
+
+// ----------------------------------------------------------------------
+/**
+ * @brief counts a frame in the current measure of speed, and ends it when due
+ */
+static void update_readout(frame_pacer_t* pacer, uint64_t now)
+{
+    ++(pacer -> readout_frames);
+    const uint64_t elapsed = now - pacer -> readout_ns;
+    if (elapsed >= FRAME_PACER_READOUT_NS) {
+        pacer -> achieved_cps = (uint64_t) ((double) (pacer -> readout_frames * pacer -> frame_cycles)
+                                            * (double) NS_PER_S / (double) elapsed);
+        ++(pacer -> readouts);
+        pacer -> readout_ns = now;
+        pacer -> readout_frames = 0;
+    }
+}
+
+// ======================================================================
+int frame_pacer_init(frame_pacer_t* pacer, uint64_t frame_cycles, uint64_t cycles_per_s,
+                     uint32_t max_catch_up)
+{
+    M_REQUIRE_NON_NULL(pacer);
+    M_REQUIRE(frame_cycles > 0 && cycles_per_s > 0 && cycles_per_s <= UINT32_MAX, ERR_BAD_PARAMETER,
+              "invalid frame of %" PRIu64 " cycles at %" PRIu64 " cycles/s", frame_cycles, cycles_per_s);
+
+    memset(pacer, 0, sizeof(*pacer));
+    pacer -> frame_cycles = frame_cycles;
+    pacer -> cycles_per_s = cycles_per_s;
+    pacer -> max_catch_up = max_catch_up;
+    pacer -> mode = SPEED_REAL_TIME;
+    pacer -> multiplier = 1;
+    pacer -> now = monotonic_now;
+    pacer -> sleep_until = monotonic_sleep_until;
+    return frame_pacer_reset(pacer);
+}
+
+// ======================================================================
+int frame_pacer_set_clock(frame_pacer_t* pacer, frame_pacer_now_fn now,
+                          frame_pacer_sleep_fn sleep_until, void* clock_data)
+{
+    M_REQUIRE_NON_NULL(pacer);
+    M_REQUIRE(pacer -> frame_cycles > 0, ERR_BAD_PARAMETER, "pacer %p not initialised", (void*) pacer);
+
+    pacer -> now = now != NULL ? now : monotonic_now;
+    pacer -> sleep_until = sleep_until != NULL ? sleep_until : monotonic_sleep_until;
+    pacer -> clock_data = clock_data;
+    return frame_pacer_reset(pacer);
+}
+
+// ======================================================================
+int frame_pacer_set_speed(frame_pacer_t* pacer, speed_mode_t mode, uint32_t multiplier)
+{
+    M_REQUIRE_NON_NULL(pacer);
+    M_REQUIRE(pacer -> frame_cycles > 0, ERR_BAD_PARAMETER, "pacer %p not initialised", (void*) pacer);
+    M_REQUIRE(mode < NB_SPEED_MODES, ERR_BAD_PARAMETER, "invalid speed mode %d", mode);
+    if (mode == SPEED_MULTIPLIER) {
+        // the rate in cycles must keep fitting 32 bits (see deadline_ns())
+        M_REQUIRE(multiplier > 0 && multiplier <= FRAME_PACER_MAX_MULTIPLIER
+                  && pacer -> cycles_per_s * multiplier <= UINT32_MAX, ERR_BAD_PARAMETER,
+                  "invalid speed multiplier %u", multiplier);
+    }
+
+    pacer -> mode = mode;
+    pacer -> multiplier = mode == SPEED_MULTIPLIER ? multiplier : 1;
+    restart(pacer, pacer -> now(pacer -> clock_data));
+    return ERR_NONE;
+}
+
+// ======================================================================
+int frame_pacer_reset(frame_pacer_t* pacer)
+{
+    M_REQUIRE_NON_NULL(pacer);
+    M_REQUIRE(pacer -> frame_cycles > 0, ERR_BAD_PARAMETER, "pacer %p not initialised", (void*) pacer);
+    const uint64_t now = pacer -> now(pacer -> clock_data);
+    restart(pacer, now);
+    pacer -> present_ns = now;
+    pacer -> readout_ns = now;
+    pacer -> readout_frames = 0;
+    return ERR_NONE;
+}
+
+// ======================================================================
+int frame_pacer_wait(frame_pacer_t* pacer)
+{
+    M_REQUIRE_NON_NULL(pacer);
+    M_REQUIRE(pacer -> frame_cycles > 0, ERR_BAD_PARAMETER, "pacer %p not initialised", (void*) pacer);
+
+    const uint64_t now = pacer -> now(pacer -> clock_data);
+    ++(pacer -> paced);
+    update_readout(pacer, now);
+    if (pacer -> mode == SPEED_UNTHROTTLED) {
+        ++(pacer -> frames);
+        return ERR_NONE;
+    }
+
+    const uint64_t deadline = deadline_ns(pacer, pacer -> frames);
+
+    if (now < deadline) {
+        M_REQUIRE_NO_ERR(pacer -> sleep_until(pacer -> clock_data, deadline));
+        pacer -> late = 0;
+        ++(pacer -> frames);
+        return ERR_NONE;
+    }
+
+    // late: the next frames are run at once to catch up, a few at most
+    if (pacer -> late < pacer -> max_catch_up) {
+        ++(pacer -> late);
+        ++(pacer -> frames);
+        return ERR_NONE;
+    }
+    const uint64_t period = deadline_ns(pacer, pacer -> frames + 1) - deadline;
+    pacer -> dropped += period > 0 ? (now - deadline) / period : 0;
+    restart(pacer, now);
+    return ERR_NONE;
+}
+
+// ======================================================================
+bit_t frame_pacer_present_due(frame_pacer_t* pacer)
+{
+    if (pacer == NULL || pacer -> frame_cycles == 0) {
+        return 0;
+    }
+    if (pacer -> mode == SPEED_REAL_TIME) {
+        return 1;
+    }
+    const uint64_t now = pacer -> now(pacer -> clock_data);
+    if (now < pacer -> present_ns) {
+        return 0;
+    }
+    // the display keeps the real-time frame rate
+    pacer -> present_ns = now + pacer -> frame_cycles * NS_PER_S / pacer -> cycles_per_s;
+    return 1;
+}
@@ -0,0 +1,165 @@
+#pragma once
+
+/**
+ * @file frame_pacer.h
+ * @brief Pacing of emulated frames to real time, on the monotonic clock
+ *
+ * The deadline of the k-th frame since the origin is computed from k
+ * (origin + k frames, exactly, in cycles): sleeping until it, as an
+ * absolute time of CLOCK_MONOTONIC, neither drifts nor is subject to
+ * wall-clock changes. After a stall, frames are run without sleeping
+ * to catch up, but at most `max_catch_up` of them: further behind, the
+ * origin is moved to now and the frames late are dropped.
+ *
+ * Pacing can also be sped up: frames are then due `multiplier` times
+ * as often, or not waited for at all (unthrottled). Either way, fewer
+ * frames need to be shown than are run (see frame_pacer_present_due()).
+ * The cycles per second actually achieved are measured in all modes.
+ *
+ * Time is read and waited for through a clock which defaults to
+ * CLOCK_MONOTONIC, and which can be replaced (see frame_pacer_set_clock()),
+ * for tests to check the deadlines computed without depending on the load
+ * of the machine.
+ *
+ * @date 2020
+ */
+
+#include <stdint.h>
+
+#include "bit.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Highest speed multiplier
+#define FRAME_PACER_MAX_MULTIPLIER 16
+
+// Period of the measure of achieved speed (0.5 s)
+#define FRAME_PACER_READOUT_NS 500000000ULL
+
+/**
+ * @brief Speed modes
+ */
+typedef enum {
+    SPEED_REAL_TIME,   // one frame per frame period
+    SPEED_MULTIPLIER,  // `multiplier` frames per frame period
+    SPEED_UNTHROTTLED, // frames are not waited for
+    NB_SPEED_MODES
+} speed_mode_t;
+
+/**
+ * @brief Clock of a frame pacer: current time, in nanoseconds
+ */
+typedef uint64_t (*frame_pacer_now_fn)(void* clock_data);
+
+/**
+ * @brief Clock of a frame pacer: sleeps until the given time, in
+ *        nanoseconds; returns an error code
+ */
+typedef int (*frame_pacer_sleep_fn)(void* clock_data, uint64_t until_ns);
+
+/**
+ * @brief Frame pacer type
+ */
+typedef struct {
+    uint64_t frame_cycles;   // cycles of a frame
+    uint64_t cycles_per_s;
+    uint32_t max_catch_up;   // frames run late at most
+    speed_mode_t mode;
+    uint32_t multiplier;     // 1 but for SPEED_MULTIPLIER
+
+    uint64_t origin_ns;      // monotonic time of frame 0
+    uint64_t frames;         // since the origin
+    uint32_t late;           // frames run late in a row
+
+    uint64_t paced;          // frames waited for
+    uint64_t dropped;        // frames skipped after stalls
+
+    uint64_t present_ns;     // monotonic time a frame is next shown at, when sped up
+    uint64_t readout_ns;     // start of the current measure
+    uint64_t readout_frames; // frames waited for since then
+    uint64_t achieved_cps;   // cycles per second of the last measure
+    uint64_t readouts;       // measures taken
+
+    frame_pacer_now_fn now;  // clock, and what it is given
+    frame_pacer_sleep_fn sleep_until;
+    void* clock_data;
+} frame_pacer_t;
+
+
+/**
+ * @brief Initialises a frame pacer, whose first frame is due one frame from now
+ *
+ * @param pacer pacer to initialise
+ * @param frame_cycles cycles of a frame
+ * @param cycles_per_s cycles of a second
+ * @param max_catch_up number of frames run late at most, after a stall
+ * @return error code
+ */
+int frame_pacer_init(frame_pacer_t* pacer, uint64_t frame_cycles, uint64_t cycles_per_s,
+                     uint32_t max_catch_up);
+
+
+/**
+ * @brief Replaces the clock of a frame pacer, and restarts pacing from
+ *        its current time
+ *
+ * @param pacer pacer
+ * @param now function giving the current time, NULL for CLOCK_MONOTONIC
+ * @param sleep_until function sleeping until a time, NULL for CLOCK_MONOTONIC
+ * @param clock_data given to both functions
+ * @return error code
+ */
+int frame_pacer_set_clock(frame_pacer_t* pacer, frame_pacer_now_fn now,
+                          frame_pacer_sleep_fn sleep_until, void* clock_data);
+
+
+/**
+ * @brief Changes the speed of a frame pacer, from now
+ *
+ * @param pacer pacer
+ * @param mode speed mode
+ * @param multiplier frames per frame period, used (and required to be
+ *        1 to FRAME_PACER_MAX_MULTIPLIER) for SPEED_MULTIPLIER only
+ * @return error code
+ */
+int frame_pacer_set_speed(frame_pacer_t* pacer, speed_mode_t mode, uint32_t multiplier);
+
+
+/**
+ * @brief Restarts pacing from now (after a pause, for instance)
+ *
+ * @param pacer pacer
+ * @return error code
+ */
+int frame_pacer_reset(frame_pacer_t* pacer);
+
+
+/**
+ * @brief Sleeps until the deadline of the current frame, which is then over
+ *
+ * @param pacer pacer
+ * @return error code
+ */
+int frame_pacer_wait(frame_pacer_t* pacer);
+
+
+/**
+ * @brief Tells whether the frame about to be run is to be shown: always
+ *        in real time, at most once per frame period when sped up
+ *
+ * @param pacer pacer
+ * @return 1 if the frame is to be shown, 0 otherwise
+ */
+bit_t frame_pacer_present_due(frame_pacer_t* pacer);
+
+
+/**
+ * @brief Current time of the monotonic clock, in nanoseconds
+ */
+uint64_t frame_pacer_now_ns(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -1,4 +1,7 @@
 #include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include "gameboy.h"
 #include "component.h"
 #include "bus.h"
@@ -6,6 +9,11 @@
 #include "bootrom.h"
 #include "timer.h"
 #include "cartridge.h"
+#include "tile_cache.h"
+#include "render_policy.h"
+#include "scanline.h"
+#include "sprite_index.h"
+#include "joypad.h"
 
 // ### CORR: modularity on component creation
 #define COMP_INIT(i, X) \
@@ -13,10 +21,40 @@
 #define COMP_PLUG(i, X) \
     M_REQUIRE_NO_ERR(bus_plug(gameboy -> bus, &(gameboy -> components[i]), X ## _START, X ## _END));
 
+// FNV-1a, 64 bits
+#define FNV_OFFSET 0xCBF29CE484222325ULL
+#define FNV_PRIME  0x100000001B3ULL
+
+// ======================================================================
+/**
+ * @brief keeps the cartridge as loaded, and its hash, for the save states
+ */
+static int keep_rom(gameboy_t* gameboy)
+{
+    const memory_t* const mem = gameboy -> cartridge.c.mem;
+    gameboy -> rom = malloc(mem -> size);
+    M_REQUIRE_NON_NULL_CUSTOM_ERR(gameboy -> rom, ERR_MEM);
+    memcpy(gameboy -> rom, mem -> memory, mem -> size);
+
+    uint64_t hash = FNV_OFFSET;
+    for (size_t i = 0; i < mem -> size; ++i) {
+        hash = (hash ^ mem -> memory[i]) * FNV_PRIME;
+    }
+    gameboy -> rom_hash = hash;
+    return ERR_NONE;
+}
+
 // ======================================================================
 int gameboy_create(gameboy_t* gameboy, const char* filename)
+{
+    return gameboy_create_with_boot(gameboy, filename, BOOT_WITH_ROM);
+}
+
+// ======================================================================
+int gameboy_create_with_boot(gameboy_t* gameboy, const char* filename, boot_mode_t boot)
 {
     M_REQUIRE_NON_NULL(gameboy);
+    M_REQUIRE(boot == BOOT_WITH_ROM || boot == BOOT_FAST, ERR_BAD_PARAMETER, "invalid boot mode %d", boot);
 
     //BUS
     for (int i = 0; i < BUS_SIZE; ++i){
@@ -25,31 +63,30 @@ int gameboy_create(gameboy_t* gameboy, const char* filename)
 
     //CPU
     M_REQUIRE_NO_ERR(cpu_init(&(gameboy -> cpu)));
-    M_REQUIRE_NO_ERR(cpu_plug(&(gameboy -> cpu), &(gameboy -> bus)));
 
     //CYCLES
     gameboy -> cycles = 1;
 
     //TIMER
-    gameboy -> timer.cpu = &(gameboy -> cpu);
-    gameboy -> timer.counter = 0;
+    M_REQUIRE_NO_ERR(timer_init(&(gameboy -> timer), &(gameboy -> cpu)));
+
+    //SERIAL
+    gameboy -> serial = NULL;
 
     //CARTRIDGE
     M_REQUIRE_NO_ERR(cartridge_init(&(gameboy -> cartridge), filename));
     M_REQUIRE_NO_ERR(bus_plug(gameboy -> bus, &(gameboy -> cartridge.c), BANK_ROM0_START,
             BANK_ROM1_END));
+    M_REQUIRE_NO_ERR(keep_rom(gameboy));
 
     // WORK RAM
     COMP_INIT(0, WORK_RAM);
     COMP_PLUG(0, WORK_RAM);
 
-    // ECHO_RAM
-    component_t* echo_ram = (component_t*)malloc(sizeof(component_t));
-    M_REQUIRE_NO_ERR(component_shared(echo_ram, &(gameboy -> components[0])));
-    M_REQUIRE_NO_ERR(bus_plug(gameboy -> bus, echo_ram, ECHO_RAM_START,
+    // ECHO_RAM: shares the memory of the work RAM, which owns it
+    M_REQUIRE_NO_ERR(component_shared(&(gameboy -> echo_ram), &(gameboy -> components[0])));
+    M_REQUIRE_NO_ERR(bus_plug(gameboy -> bus, &(gameboy -> echo_ram), ECHO_RAM_START,
             ECHO_RAM_END));
-    mem_free(echo_ram -> mem); // ### CORR: free memory of echo ram
-    gameboy -> echo_ram = *echo_ram;
 
      //REGISTERS
     COMP_INIT(1, REGISTERS);
@@ -62,6 +99,7 @@ int gameboy_create(gameboy_t* gameboy, const char* filename)
     //VIDEO_RAM
     COMP_INIT(3, VIDEO_RAM);
     COMP_PLUG(3, VIDEO_RAM);
+    M_REQUIRE_NO_ERR(tile_cache_init(&(gameboy -> tiles), &(gameboy -> components[3])));
 
     //GRAPH_RAM
     COMP_INIT(4, GRAPH_RAM);
@@ -72,20 +110,33 @@ int gameboy_create(gameboy_t* gameboy, const char* filename)
     COMP_PLUG(5, USELESS);
     gameboy -> nb_components = GB_NB_COMPONENTS;
 
-    // BOOT ROM
+    // CPU: high RAM, IF and IE go over the registers, which must be plugged first
+    M_REQUIRE_NO_ERR(cpu_plug(&(gameboy -> cpu), &(gameboy -> bus)));
+
+    // BOOT ROM: over the cartridge until it unmaps itself, not mapped at all on fast boot
     M_REQUIRE_NO_ERR(bootrom_init(&(gameboy -> bootrom)));
-    // ### CORR: error propagation
-    M_REQUIRE_NO_ERR(bootrom_plug(&(gameboy -> bootrom), gameboy -> bus));
-    gameboy -> boot = 1;
+    if (boot == BOOT_WITH_ROM){
+        // ### CORR: error propagation
+        M_REQUIRE_NO_ERR(bootrom_plug(&(gameboy -> bootrom), gameboy -> bus));
+    }
+    gameboy -> boot = boot == BOOT_WITH_ROM;
+
+    // RENDERING
+    M_REQUIRE_NO_ERR(render_policy_init(&(gameboy -> render), RENDER_ALWAYS, 1));
+    M_REQUIRE_NO_ERR(scanline_tracker_init(&(gameboy -> lines)));
+    M_REQUIRE_NO_ERR(sprite_index_init(&(gameboy -> sprites), gameboy -> bus));
+
+    // JOYPAD
+    M_REQUIRE_NO_ERR(joypad_init_and_plug(&(gameboy -> pad), &(gameboy -> cpu)));
 
-    /* ### REMOVED BECAUSE COULD'T CORRECTLY USE LIBRARY
     // SCREEN
     M_REQUIRE_NO_ERR(lcdc_init(gameboy));
     M_REQUIRE_NO_ERR(lcdc_plug(&(gameboy -> screen), gameboy -> bus));
 
-    // JOYPAD
-    M_REQUIRE_NO_ERR(joypad_init_and_plug(&(gameboy -> pad), &(gameboy -> cpu)));
-    */
+    // FAST BOOT: the state the boot ROM would have left, registers plugged
+    if (boot == BOOT_FAST){
+        M_REQUIRE_NO_ERR(bootrom_skip(gameboy));
+    }
     return ERR_NONE;
 }
 
@@ -93,58 +144,96 @@ int gameboy_create(gameboy_t* gameboy, const char* filename)
 void gameboy_free(gameboy_t* gameboy)
 {
     if (gameboy != NULL){
-        for (int i = 0; i < gameboy -> nb_components; ++i){
-            if (&(gameboy -> components[i]) != NULL){
-                bus_unplug(gameboy -> bus, &(gameboy -> components[i]));
-                component_free(&(gameboy -> components[i]));
-            }
-        }
-        //free echo_ram
-        if (&(gameboy -> echo_ram) != NULL){
-            bus_unplug(gameboy -> bus, &(gameboy -> echo_ram));
-            component_free(&(gameboy -> echo_ram));
-        }
-        //free cpu
-        if (&(gameboy -> cpu) != NULL){
-            cpu_free(&(gameboy -> cpu));
-        }
-        // what to do with bus??
+        //free cpu (unplugs high RAM, IF and IE)
+        cpu_free(&(gameboy -> cpu));
 
         //free bootrom
-        if(&(gameboy -> bootrom) != NULL){
-            bus_unplug(gameboy -> bus, &(gameboy -> bootrom));
-            component_free(&(gameboy -> bootrom));
-        }
+        bus_unplug(gameboy -> bus, &(gameboy -> bootrom));
+        component_free(&(gameboy -> bootrom));
+
         //free cartridge
-        if (&(gameboy -> cartridge) != NULL){
-            bus_unplug(gameboy -> bus, &(gameboy -> cartridge.c));
-            cartridge_free(&gameboy -> cartridge);
+        bus_unplug(gameboy -> bus, &(gameboy -> cartridge.c));
+        cartridge_free(&gameboy -> cartridge);
+        free(gameboy -> rom);
+        gameboy -> rom = NULL;
+
+        //echo ram: its memory is the one of the work RAM, freed below
+        bus_unplug(gameboy -> bus, &(gameboy -> echo_ram));
+        gameboy -> echo_ram.mem = NULL;
+
+        for (size_t i = 0; i < gameboy -> nb_components; ++i){
+            bus_unplug(gameboy -> bus, &(gameboy -> components[i]));
+            component_free(&(gameboy -> components[i]));
         }
-        /* ### REMOVED BECAUSE COULD'T CORRECTLY USE LIBRARY
+        gameboy -> nb_components = 0;
+
         //free screen
         lcdc_free(&(gameboy -> screen));
-        */
-        gameboy = NULL;
     }
 }
 
+// ======================================================================
+/**
+ * @brief forwards the bytes written to the serial data register (SB)
+ */
+static int serial_bus_listener(gameboy_t* gameboy, addr_t addr)
+{
+    if (addr == BLARGG_REG && gameboy -> serial != NULL){
+        data_t byte = 0;
+        M_REQUIRE_NO_ERR(bus_read(gameboy -> bus, BLARGG_REG, &byte));
+        fputc(byte, gameboy -> serial);
+    }
+    return ERR_NONE;
+}
+
 // ======================================================================
 int gameboy_run_until(gameboy_t* gameboy, uint64_t cycle)
 {
     M_REQUIRE_NON_NULL(gameboy); // ### CORR: null check
-    M_REQUIRE_NO_ERR(timer_cycle(&(gameboy -> timer)));
-    M_REQUIRE_NO_ERR(cpu_cycle(&(gameboy -> cpu)));
+    if (cycle <= gameboy -> cycles){
+        return ERR_BAD_PARAMETER; // ### CORR: added error if cycle <= cycles
+    }
 
-    M_REQUIRE_NON_NULL(gameboy);
-    if(cycle > gameboy -> cycles){
-        for(; gameboy -> cycles < cycle; ++(gameboy -> cycles)){
-            // ### CORR: listeners in loop
-            M_REQUIRE_NO_ERR(bootrom_bus_listener(gameboy, gameboy -> cpu.PC));
-            M_REQUIRE_NO_ERR(timer_bus_listener(&(gameboy -> timer), gameboy -> cpu.write_listener));
-            M_REQUIRE_NO_ERR(cpu_cycle(&(gameboy -> cpu)));
+    for(; gameboy -> cycles < cycle; ++(gameboy -> cycles)){
+        // frame boundary: the render policy decides whether the LCD controller draws this frame
+        if (gameboy -> cycles % FRAME_TOTAL_CYCLES == 0) {
+            render_policy_frame_start(&(gameboy -> render));
         }
-    } else {
-        return ERR_BAD_PARAMETER; // ### CORR: added error if cycle <= cycles
+        M_REQUIRE_NO_ERR(timer_cycle(&(gameboy -> timer)));
+        M_REQUIRE_NO_ERR(lcdc_cycle(&(gameboy -> screen), gameboy -> cycles));
+        M_REQUIRE_NO_ERR(cpu_cycle(&(gameboy -> cpu)));
+
+        // ### CORR: listeners in loop
+        const addr_t written = gameboy -> cpu.write_listener;
+        M_REQUIRE_NO_ERR(bootrom_bus_listener(gameboy, written));
+        M_REQUIRE_NO_ERR(timer_bus_listener(&(gameboy -> timer), written));
+        M_REQUIRE_NO_ERR(joypad_bus_listener(&(gameboy -> pad), written));
+        M_REQUIRE_NO_ERR(serial_bus_listener(gameboy, written));
+        M_REQUIRE_NO_ERR(lcdc_bus_listener(&(gameboy -> screen), written));
+        M_REQUIRE_NO_ERR(tile_cache_bus_listener(&(gameboy -> tiles), written));
+        M_REQUIRE_NO_ERR(sprite_index_bus_listener(&(gameboy -> sprites), gameboy -> bus, written));
     }
     return ERR_NONE;
-}
\ No newline at end of file
+}
+
+// ======================================================================
+int gameboy_set_serial(gameboy_t* gameboy, FILE* output)
+{
+    M_REQUIRE_NON_NULL(gameboy);
+    gameboy -> serial = output;
+    return ERR_NONE;
+}
+
+// ======================================================================
+int gameboy_set_render_policy(gameboy_t* gameboy, render_mode_t mode, uint32_t every)
+{
+    M_REQUIRE_NON_NULL(gameboy);
+    return render_policy_init(&(gameboy -> render), mode, every);
+}
+
+// ======================================================================
+int gameboy_request_frame(gameboy_t* gameboy)
+{
+    M_REQUIRE_NON_NULL(gameboy);
+    return render_policy_request(&(gameboy -> render));
+}
@@ -10,6 +10,7 @@
 
 #include <stdint.h>
 #include <stdlib.h>
+#include <stdio.h>
 
 #include "bus.h"
 #include "component.h"
@@ -18,6 +19,10 @@
 #include "cartridge.h"
 #include "lcdc.h"
 #include "joypad.h"
+#include "tile_cache.h"
+#include "render_policy.h"
+#include "scanline.h"
+#include "sprite_index.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -41,7 +46,14 @@ struct gameboy_ {
     bit_t boot;
     lcdc_t screen;
     joypad_t pad;
-    component_t echo_ram; //pas nécessaire?
+    tile_cache_t tiles;
+    render_policy_t render;
+    scanline_tracker_t lines;
+    sprite_index_t sprites;
+    component_t echo_ram; // shares the memory of the work RAM
+    FILE* serial;         // where bytes written to the serial port go (NULL: nowhere)
+    data_t* rom;          // the cartridge as loaded, which save states only store the changes of
+    uint64_t rom_hash;    // hash of rom, telling save states of other cartridges apart
 };
 
 typedef gameboy_t gameboy_;
@@ -51,12 +63,30 @@ typedef gameboy_t gameboy_;
 #define GB_TICS_PER_CYCLE 4
 
 /**
- * @brief Creates a gameboy
+ * @brief How a gameboy starts
+ */
+typedef enum {
+    BOOT_WITH_ROM, // runs the boot ROM, which then maps the cartridge over it
+    BOOT_FAST      // starts the cartridge at once, in the state the boot ROM leaves
+} boot_mode_t;
+
+/**
+ * @brief Creates a gameboy, which runs its boot ROM first
  *
  * @param gameboy pointer to gameboy to create
  */
 int gameboy_create(gameboy_t* gameboy, const char* filename);
 
+/**
+ * @brief Creates a gameboy, which starts as asked for
+ *
+ * @param gameboy pointer to gameboy to create
+ * @param filename cartridge ROM file
+ * @param boot BOOT_FAST to skip the boot ROM (about 2.5 s of emulated time)
+ * @return error code
+ */
+int gameboy_create_with_boot(gameboy_t* gameboy, const char* filename, boot_mode_t boot);
+
 /**
  * @brief Destroys a gameboy
  *
@@ -69,6 +99,34 @@ void gameboy_free(gameboy_t* gameboy);
  */
 int gameboy_run_until(gameboy_t* gameboy, uint64_t cycle);
 
+/**
+ * @brief Sets where the bytes written to the serial port (SB, BLARGG_REG) go
+ *
+ * @param gameboy gameboy
+ * @param output stream to write them to (NULL, the default, to drop them)
+ * @return error code
+ */
+int gameboy_set_serial(gameboy_t* gameboy, FILE* output);
+
+/**
+ * @brief Sets the rendering policy of a gameboy (RENDER_ALWAYS after creation):
+ *        which frames the LCD controller draws (see render_policy.h)
+ *
+ * @param gameboy gameboy
+ * @param mode rendering mode
+ * @param every period for RENDER_EVERY_NTH (ignored otherwise)
+ * @return error code
+ */
+int gameboy_set_render_policy(gameboy_t* gameboy, render_mode_t mode, uint32_t every);
+
+/**
+ * @brief Asks for the next frame of a gameboy to be rendered
+ *
+ * @param gameboy gameboy
+ * @return error code
+ */
+int gameboy_request_frame(gameboy_t* gameboy);
+
 /**
  * @brief Adresses of the GameBoy
  *
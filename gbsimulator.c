@@ -1,16 +1,72 @@
 #include "sidlib.h"
 #include "lcdc.h"
 #include "gameboy.h"
+#include "triple_buffer.h"
+#include "frame_dump.h"
+#include "rewind.h"
+#include "movie.h"
+#include "run_ahead.h"
+#include "frame_pacer.h"
 #include "error.h"
 
 #include <stdint.h>
+#include <inttypes.h>
 #include <stdio.h>
-#include <sys/time.h>
-
-// Variables globales
-gameboy_t gameboy;
-struct timeval start;
-struct timeval paused;
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <stdatomic.h>
+
+/**
+ * @brief A published frame: color of every pixel of the screen
+ */
+typedef struct {
+    uint8_t pixels[LCD_HEIGHT][LCD_WIDTH];
+} frame_t;
+
+// Sleep of the emulation thread while paused (1 ms)
+#define EMULATION_IDLE_NS 1000000L
+
+// Frames run at once at most to catch up after a stall, the others are dropped
+#define MAX_CATCH_UP_FRAMES 5
+
+// Rewind history: a snapshot per frame, 5 minutes at most in 64 MiB
+#define REWIND_BYTES ((size_t) 64 << 20)
+#define REWIND_SNAPSHOTS ((size_t) 60 * 60 * 5)
+#define REWIND_KEYFRAME_EVERY 60
+
+// A recorded movie embeds a save state every 10 s, to seek in it
+#define MOVIE_KEYFRAME_CYCLES (10 * GB_CYCLES_PER_S)
+
+/**
+ * @brief The whole state of the simulator
+ */
+typedef struct {
+    // emulation thread only
+    gameboy_t gameboy;
+    frame_pacer_t pacer;   // one frame run per frame period
+    frame_dump_t dump;     // optional capture of every frame
+    bit_t dumping;
+    rewind_t history;      // a snapshot per frame run
+    movie_t movie;         // optional record of every key change
+    bit_t recording;
+    run_ahead_t ahead;     // frames shown ahead of the real run (0: none)
+
+    // GTK main loop only
+    unsigned int multiplier; // speed to go back to when throttled again
+
+    // shared between the emulation thread and the GTK main loop
+    triple_buffer_t frames;
+    atomic_uint keys;      // bit k set while gb_key_t k is pressed
+    atomic_bool pause_request;
+    atomic_bool rewinding; // while the rewind key is held
+    atomic_uint speed;     // times real time (0: unthrottled)
+    atomic_bool quit;
+} simulator_t;
+
+// GTK callbacks are given no data of ours: the simulator of this program
+static simulator_t simulator;
 
 // Key press bits
 #define MY_KEY_UP_BIT     0x01
@@ -30,47 +86,192 @@ static void set_grey(guchar* pixels, int row, int col, int width, guchar grey)
 }
 
 // ======================================================================
-static uint64_t get_time_in_GB_cycles_since(struct timeval* from)
+/**
+ * @brief forwards key changes made by the GTK main loop to the joypad
+ */
+static void apply_keys(simulator_t* sim, unsigned int* state)
 {
-    struct timeval now;
-    int err = gettimeofday(&now, NULL);
-    if (err != 0){
-        fprintf(stderr, "error reading time from system!");
-        return 0;
-    }
-    int cmp = timercmp(&now, from);
-    if (cmp != 0){
-        struct timeval delta;
-        timersub(&now, from, &delta);
-        return delta.tv_sec * GB_CYCLES_PER_S +
-                (delta.tv_usec * GB_CYCLES_PER_S) / 1000000;
-    } else {
-        return 0;
+    const unsigned int now = atomic_load(&(sim -> keys));
+    const unsigned int changed = now ^ *state;
+    for (gb_key_t key = RIGHT_KEY; key < NB_GB_KEYS; ++key){
+        if (changed & (1u << key)){
+            if (sim -> recording){
+                if (movie_record_key(&(sim -> movie), &(sim -> gameboy), key, (now >> key) & 1) != ERR_NONE){
+                    fprintf(stderr, "error recording movie!\n");
+                }
+            } else if (now & (1u << key)){
+                joypad_key_pressed(&(sim -> gameboy.pad), key);
+            } else {
+                joypad_key_released(&(sim -> gameboy.pad), key);
+            }
+        }
     }
+    *state = now;
 }
 
 // ======================================================================
-static void generate_image(guchar* pixels, int height, int width)
+/**
+ * @brief sets the pacing to the speed asked for, if it changed
+ */
+static void apply_speed(simulator_t* sim, unsigned int* speed)
 {
-    int err = 0;
-    err = gameboy_run_until(&gameboy,
-            get_time_in_GB_cycles_since(&start));
-    if (err == 0){
-        fprintf(stderr, "error running gameboy!\n");
+    const unsigned int wanted = atomic_load(&(sim -> speed));
+    if (wanted == *speed){
         return;
     }
-    for (size_t y = 0; y < height; ++y){
-        for (size_t x = 0; x < width; ++x){
-            uint8_t pixel = 0;
-            err = image_get_pixel(pixel, &(gameboy.screen.display),
-                    x, y); // changer facteur?
-            if (err == 0){
-            fprintf(stderr, "error generating image!\n");
-            return;
+    const speed_mode_t mode = wanted == 0 ? SPEED_UNTHROTTLED
+                              : wanted == 1 ? SPEED_REAL_TIME : SPEED_MULTIPLIER;
+    if (frame_pacer_set_speed(&(sim -> pacer), mode, wanted) != ERR_NONE){
+        fprintf(stderr, "invalid speed %u!\n", wanted);
+    }
+    if (wanted == 1){
+        fprintf(stderr, "\n");
+    }
+    *speed = wanted;
+}
+
+// ======================================================================
+/**
+ * @brief converts the screen of the gameboy into the emulation-side frame and publishes it
+ *        (current keeps the previous frame: only lines which changed since are converted)
+ */
+static int publish_frame(simulator_t* sim, frame_t* current)
+{
+    scanline_mask_t dirty;
+    M_REQUIRE_NO_ERR(scanline_tracker_take_dirty(&(sim -> gameboy.lines), dirty));
+    for (size_t y = 0; y < LCD_HEIGHT; ++y){
+        if (!scanline_mask_get(dirty, y)){
+            continue;
+        }
+        for (size_t x = 0; x < LCD_WIDTH; ++x){
+            const int err = image_get_pixel(&(current -> pixels[y][x]), &(sim -> gameboy.screen.display), x, y);
+            if (err != ERR_NONE){
+                // not fully converted: convert it again next time
+                scanline_tracker_invalidate_all(&(sim -> gameboy.lines));
+                return err;
+            }
+        }
+    }
+    memcpy(triple_buffer_back(&(sim -> frames)), current, sizeof(frame_t));
+    triple_buffer_publish(&(sim -> frames));
+    if (sim -> dumping){
+        M_REQUIRE_NO_ERR(frame_dump_push_pixels(&(sim -> dump), &(current -> pixels[0][0])));
+    }
+    return ERR_NONE;
+}
+
+// ======================================================================
+/**
+ * @brief runs the Game Boy at the speed asked for, one whole frame at a time,
+ *        and publishes the completed frames which are due to be shown
+ */
+static void* emulation_thread(void* arg)
+{
+    simulator_t* const sim = arg;
+    frame_t current;
+    memset(&current, 0, sizeof(current));
+    unsigned int key_state = 0;
+    unsigned int speed = 1;
+    uint64_t readouts = 0;
+    bit_t was_paused = 0;
+    const struct timespec idle = { 0, EMULATION_IDLE_NS };
+
+    while (!atomic_load(&(sim -> quit))){
+        if (atomic_load(&(sim -> pause_request))){
+            was_paused = 1;
+            nanosleep(&idle, NULL);
+            continue;
+        }
+        if (was_paused){
+            // the time paused is not to be caught up
+            frame_pacer_reset(&(sim -> pacer));
+            was_paused = 0;
+        }
+
+        // a movie records a run without going back in time
+        if (!sim -> recording && atomic_load(&(sim -> rewinding))){
+            // back one frame per frame period, as long as there is history
+            if (rewind_count(&(sim -> history)) > 0 &&
+                rewind_step_back(&(sim -> history), &(sim -> gameboy)) == ERR_NONE &&
+                publish_frame(sim, &current) != ERR_NONE){
+                fprintf(stderr, "error publishing frame!\n");
+            }
+        } else {
+            apply_keys(sim, &key_state);
+            apply_speed(sim, &speed);
+            // sped up, frames the display would not show are neither drawn nor published
+            const bit_t present = sim -> dumping || frame_pacer_present_due(&(sim -> pacer));
+            if (present && sim -> ahead.frames == 0){
+                gameboy_request_frame(&(sim -> gameboy));
+            }
+            const uint64_t frame_end = (sim -> gameboy.cycles / FRAME_TOTAL_CYCLES + 1) * FRAME_TOTAL_CYCLES;
+            const int err = sim -> recording
+                            ? movie_record_run_until(&(sim -> movie), &(sim -> gameboy), frame_end)
+                            : gameboy_run_until(&(sim -> gameboy), frame_end);
+            if (err != ERR_NONE){
+                fprintf(stderr, "error running gameboy!\n");
+                return NULL;
+            }
+            if (present && sim -> ahead.frames > 0){
+                // the frame shown already reacts to the keys, the real run goes on from here
+                if (run_ahead_begin(&(sim -> ahead), &(sim -> gameboy)) == ERR_NONE &&
+                    publish_frame(sim, &current) != ERR_NONE){
+                    fprintf(stderr, "error publishing frame!\n");
+                }
+                if (run_ahead_end(&(sim -> ahead), &(sim -> gameboy)) != ERR_NONE){
+                    fprintf(stderr, "error running gameboy ahead!\n");
+                    return NULL;
+                }
+            } else if (present && publish_frame(sim, &current) != ERR_NONE){
+                fprintf(stderr, "error publishing frame!\n");
             }
-            set_grey(pixels, x, y, width, 255 - 85 * pixel);
+            if (rewind_push(&(sim -> history), &(sim -> gameboy)) != ERR_NONE){
+                fprintf(stderr, "error saving rewind snapshot!\n");
+            }
+        }
+
+        if (frame_pacer_wait(&(sim -> pacer)) != ERR_NONE){
+            fprintf(stderr, "error waiting for the next frame!\n");
+            return NULL;
         }
+        if (speed != 1 && sim -> pacer.readouts != readouts){
+            fprintf(stderr, "\rspeed: %" PRIu64 " cycles/s (%.1fx)   ", sim -> pacer.achieved_cps,
+                    (double) sim -> pacer.achieved_cps / GB_CYCLES_PER_S);
+        }
+        readouts = sim -> pacer.readouts;
     }
+    return NULL;
+}
+
+// ======================================================================
+static void generate_image(guchar* pixels, int height, int width)
+{
+    static frame_t shown;     // last frame blitted
+    static bit_t blitted = 0; // whether shown is on screen at all
+
+    // nothing new from the emulation thread: keep the image as is
+    if (!triple_buffer_acquire(&(simulator.frames))){
+        return;
+    }
+    const frame_t* const frame = triple_buffer_front(&(simulator.frames));
+
+    // only rows of lines which changed since the previous image are converted
+    bit_t changed[LCD_HEIGHT];
+    for (size_t ly = 0; ly < LCD_HEIGHT; ++ly){
+        changed[ly] = !blitted || memcmp(frame -> pixels[ly], shown.pixels[ly], LCD_WIDTH) != 0;
+    }
+    for (int y = 0; y < height; ++y){
+        const size_t ly = (size_t) y * LCD_HEIGHT / (size_t) height;
+        if (!changed[ly]){
+            continue;
+        }
+        for (int x = 0; x < width; ++x){
+            const uint8_t pixel = frame -> pixels[ly][(size_t) x * LCD_WIDTH / (size_t) width];
+            set_grey(pixels, y, x, width, (guchar) (255 - 85 * pixel));
+        }
+    }
+    memcpy(&shown, frame, sizeof(frame_t));
+    blitted = 1;
 }
 
 // ======================================================================
@@ -78,9 +279,9 @@ static void generate_image(guchar* pixels, int height, int width)
     do { \
         if (! (psd->key_status & MY_KEY_ ## X ##_BIT)) { \
             psd->key_status |= MY_KEY_ ## X ##_BIT; \
-            joypad_key_pressed(&gameboy.pad, X ## _KEY); \
+            atomic_fetch_or(&(simulator.keys), 1u << X ## _KEY); \
         } \
-    } while(0) // error codes?
+    } while(0)
 
 static gboolean keypress_handler(guint keyval, gpointer data)
 {
@@ -123,15 +324,32 @@ static gboolean keypress_handler(guint keyval, gpointer data)
         return TRUE;
 
     case GDK_KEY_space:
-        if (psd -> timeout_id > 0){
-            gettimeofday(&paused, NULL);
-        } else {
-            struct timeval now;
-            gettimeofday(&now, NULL);
-            timersub(&now, &paused, &paused);
-            timeradd(&start, &paused, &start);
-            timerclear(&paused);
+        // the emulation thread shifts its time origin when resumed
+        atomic_store(&(simulator.pause_request), psd -> timeout_id > 0);
+        break;
+
+    case GDK_KEY_BackSpace:
+        atomic_store(&(simulator.rewinding), 1);
+        return TRUE;
+
+    case 'T':
+    case 't':
+        // toggles unthrottled speed
+        atomic_store(&(simulator.speed), atomic_load(&(simulator.speed)) == 0 ? simulator.multiplier : 0u);
+        return TRUE;
+
+    case '+':
+        simulator.multiplier = simulator.multiplier * 2 < FRAME_PACER_MAX_MULTIPLIER
+                               ? simulator.multiplier * 2 : FRAME_PACER_MAX_MULTIPLIER;
+        atomic_store(&(simulator.speed), simulator.multiplier);
+        return TRUE;
+
+    case '-':
+        if (simulator.multiplier > 1){
+            simulator.multiplier /= 2;
         }
+        atomic_store(&(simulator.speed), simulator.multiplier);
+        return TRUE;
 
     }
 
@@ -144,7 +362,7 @@ static gboolean keypress_handler(guint keyval, gpointer data)
     do { \
         if (psd->key_status & MY_KEY_ ## X ##_BIT) { \
           psd->key_status &= (unsigned char) ~MY_KEY_ ## X ##_BIT; \
-            joypad_key_released(&gameboy.pad, X ## _KEY); \
+            atomic_fetch_and(&(simulator.keys), ~(1u << X ## _KEY)); \
         } \
     } while(0)
 
@@ -188,6 +406,10 @@ static gboolean keyrelease_handler(guint keyval, gpointer data)
         do_key(START);
         return TRUE;
 
+    case GDK_KEY_BackSpace:
+        atomic_store(&(simulator.rewinding), 0);
+        return TRUE;
+
     }
 
     return FALSE;
@@ -197,31 +419,143 @@ static gboolean keyrelease_handler(guint keyval, gpointer data)
 // ======================================================================
 int main(int argc, char *argv[])
 {
-    int err = gettimeofday(&start, NULL);
-    if (err != 0){
-        fprintf(stderr, "error reading time from system!");
-        return 1;// error code?
-    }
-    timerclear(&paused);
-
     char cr_name[25];
     printf("Cartridge name (max length 25):\n");
-    err = 0;
-    while (err == 0){
-        err = fgets(cr_name, 25, stdin);
-        if (err == 0){
-            printf("Invalid name, insert again:\n");
+    if (fgets(cr_name, sizeof(cr_name), stdin) == NULL){
+        fprintf(stderr, "no cartridge name given!\n");
+        return 1;
+    }
+    cr_name[strcspn(cr_name, "\n")] = '\0';
+
+    // the boot mode is needed at creation, before the other options
+    boot_mode_t boot = BOOT_WITH_ROM;
+    for (int i = 1; i < argc; ++i){
+        if (strcmp(argv[i], "-f") == 0){
+            boot = BOOT_FAST;
         }
     }
-    err = 0;
-    memset(&gameboy, 0, sizeof(gameboy_t));
-    err = gameboy_create(&gameboy, cr_name);
+
+    simulator_t* const sim = &simulator;
+    int err = ERR_NONE;
+    memset(&(sim -> gameboy), 0, sizeof(gameboy_t));
+    err = gameboy_create_with_boot(&(sim -> gameboy), cr_name, boot);
+    if (err != ERR_NONE) {
+        gameboy_free(&(sim -> gameboy));
+        return err;
+    }
+
+    err = triple_buffer_create(&(sim -> frames), sizeof(frame_t));
     if (err != ERR_NONE) {
-        gameboy_free(&gameboy);
+        gameboy_free(&(sim -> gameboy));
         return err;
     }
+    atomic_init(&(sim -> keys), 0u);
+    atomic_init(&(sim -> pause_request), 0);
+    atomic_init(&(sim -> rewinding), 0);
+    atomic_init(&(sim -> speed), 1u);
+    sim -> multiplier = 1;
+    atomic_init(&(sim -> quit), 0);
+
+    err = rewind_init(&(sim -> history), &(sim -> gameboy), REWIND_BYTES,
+                      REWIND_SNAPSHOTS, REWIND_KEYFRAME_EVERY);
+    if (err != ERR_NONE) {
+        triple_buffer_free(&(sim -> frames));
+        gameboy_free(&(sim -> gameboy));
+        return err;
+    }
+
+    // real time starts now, not while the name was typed
+    err = frame_pacer_init(&(sim -> pacer), FRAME_TOTAL_CYCLES, GB_CYCLES_PER_S, MAX_CATCH_UP_FRAMES);
+    if (err != ERR_NONE) {
+        rewind_free(&(sim -> history));
+        triple_buffer_free(&(sim -> frames));
+        gameboy_free(&(sim -> gameboy));
+        return err;
+    }
+
+    // only the frames shown are drawn
+    err = gameboy_set_render_policy(&(sim -> gameboy), RENDER_ON_REQUEST, 0);
+
+    // options: gbsimulator [-f] [-a frames_ahead] [-s speed] [frames.y4m|frames.ppm|frames.png] [movie.gbm]
+    for (int i = 1; err == ERR_NONE && i < argc; ++i){
+        const char* const dot = strrchr(argv[i], '.');
+        if (strcmp(argv[i], "-f") == 0){
+            // already done
+        } else if (strcmp(argv[i], "-a") == 0 && i + 1 < argc){
+            err = run_ahead_init(&(sim -> ahead), &(sim -> gameboy), (uint32_t) atoi(argv[++i]));
+        } else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc){
+            // times real time, 0 for unthrottled
+            const int speed = atoi(argv[++i]);
+            if (speed < 0 || speed > FRAME_PACER_MAX_MULTIPLIER){
+                fprintf(stderr, "invalid speed %d (0 to %d)!\n", speed, FRAME_PACER_MAX_MULTIPLIER);
+                err = ERR_BAD_PARAMETER;
+            } else {
+                atomic_store(&(sim -> speed), (unsigned int) speed);
+                sim -> multiplier = speed > 0 ? (unsigned int) speed : 1;
+            }
+        } else if (dot != NULL && strcmp(dot, ".gbm") == 0){
+            if (!sim -> recording){
+                err = movie_record_open(&(sim -> movie), argv[i], &(sim -> gameboy), MOVIE_KEYFRAME_CYCLES);
+                sim -> recording = err == ERR_NONE;
+            }
+        } else if (!sim -> dumping){
+            err = frame_dump_open(&(sim -> dump), argv[i], frame_dump_format_from_name(argv[i]),
+                                  FRAME_DUMP_DEFAULT_RING_SIZE);
+            sim -> dumping = err == ERR_NONE;
+        }
+    }
+    if (err != ERR_NONE) {
+        if (sim -> dumping){
+            frame_dump_close(&(sim -> dump));
+        }
+        if (sim -> recording){
+            movie_close(&(sim -> movie), &(sim -> gameboy));
+        }
+        run_ahead_free(&(sim -> ahead));
+        rewind_free(&(sim -> history));
+        triple_buffer_free(&(sim -> frames));
+        gameboy_free(&(sim -> gameboy));
+        return err;
+    }
+
+    pthread_t emulation;
+    if (pthread_create(&emulation, NULL, emulation_thread, sim) != 0) {
+        if (sim -> dumping){
+            frame_dump_close(&(sim -> dump));
+        }
+        if (sim -> recording){
+            movie_close(&(sim -> movie), &(sim -> gameboy));
+        }
+        run_ahead_free(&(sim -> ahead));
+        rewind_free(&(sim -> history));
+        triple_buffer_free(&(sim -> frames));
+        gameboy_free(&(sim -> gameboy));
+        return ERR_MEM;
+    }
+
     sd_launch(&argc, &argv, sd_init("Simulateur GameBoy", LCD_WIDTH * 2,
             LCD_HEIGHT * 2, 40, generate_image, keypress_handler, keyrelease_handler));
-    gameboy_free(&gameboy);
+
+    atomic_store(&(sim -> quit), 1);
+    pthread_join(emulation, NULL);
+    if (sim -> pacer.dropped > 0){
+        fprintf(stderr, "pacing: %" PRIu64 " frames, %" PRIu64 " dropped after stalls\n",
+                sim -> pacer.paced, sim -> pacer.dropped);
+    }
+    if (sim -> dumping){
+        frame_dump_close(&(sim -> dump));
+        fprintf(stderr, "frames: %" PRIu64 " written, %" PRIu64 " dropped\n",
+                (uint64_t) sim -> dump.written, sim -> dump.dropped);
+    }
+    if (sim -> recording){
+        if (movie_close(&(sim -> movie), &(sim -> gameboy)) != ERR_NONE){
+            fprintf(stderr, "error writing movie!\n");
+        }
+        fprintf(stderr, "movie: %" PRIu64 " key changes recorded\n", sim -> movie.events);
+    }
+    run_ahead_free(&(sim -> ahead));
+    rewind_free(&(sim -> history));
+    triple_buffer_free(&(sim -> frames));
+    gameboy_free(&(sim -> gameboy));
     return 0;
 }
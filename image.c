@@ -9,6 +9,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
+#include <stddef.h>
 
 #include "error.h"
 #include "image.h"
@@ -20,6 +21,16 @@
 
 #define do_image_line(piml) do_imlc(piml, lsb); do_imlc(piml, msb); do_imlc(piml, opacity)
 
+// image storage: the line array, then the msb, lsb and opacity vectors of
+// every line, each at a fixed stride, in a single slab
+#define SLAB_ALIGNMENT   64
+#define VECTOR_ALIGNMENT 32
+
+#define round_up(n, a) ((((n) + (a) - 1) / (a)) * (a))
+
+#define IMAGE_HASH_OFFSET UINT64_C(0xcbf29ce484222325) // FNV-1a
+#define IMAGE_HASH_PRIME  UINT64_C(0x100000001b3)
+
 // ======================================================================
 #define M_REQUIRE_NON_NULL_IMAGE_LINE(iml)\
     do { \
@@ -84,113 +95,191 @@ int image_line_set_word(image_line_t* piml, size_t index, uint32_t msb, uint32_t
 }
 
 // ======================================================================
-int image_line_shift(image_line_t* output, image_line_t iml, int64_t shift)
+/**
+ * @brief Creates output with the size of iml, then fills it with a "_to"
+ *        function (the allocating API is a wrapper of the in-place one)
+ */
+#define M_CREATE_THEN(output, iml, call) \
+    do { \
+        M_REQUIRE_NON_NULL(output); \
+        M_REQUIRE_NON_NULL_IMAGE_LINE(iml); \
+        M_REQUIRE_NO_ERR(image_line_create(output, (iml).msb->size)); \
+        const int err_ = (call); \
+        if (err_ != ERR_NONE) { \
+            image_line_free(output); \
+        } \
+        return err_; \
+    } while(0)
+
+// ======================================================================
+int image_line_shift_to(image_line_t* output, image_line_t iml, int64_t shift)
 {
     M_REQUIRE_NON_NULL(output);
-    M_REQUIRE_NON_NULL_IMAGE_LINE(iml);
+    M_REQUIRE_MATCHING_IMAGE_LINE_SIZE(*output, iml);
 
 #define do_imlc(I, X) \
-    I->X = bit_vector_shift(iml.X, shift)
+    bit_vector_shift_to(I->X, iml.X, shift)
 
     do_image_line(output);
 #undef do_imlc
 
-    return valid(output);
+    return ERR_NONE;
 }
 
 // ======================================================================
-int image_line_extract_wrap_ext(image_line_t* output, image_line_t iml, int64_t index, size_t size)
+int image_line_shift(image_line_t* output, image_line_t iml, int64_t shift)
+{
+    M_CREATE_THEN(output, iml, image_line_shift_to(output, iml, shift));
+}
+
+// ======================================================================
+int image_line_extract_wrap_ext_to(image_line_t* output, image_line_t iml, int64_t index)
 {
     M_REQUIRE_NON_NULL(output);
+    M_REQUIRE_NON_NULL_IMAGE_LINE(*output);
     M_REQUIRE_NON_NULL_IMAGE_LINE(iml);
-    M_REQUIRE(size > 0, ERR_BAD_PARAMETER, "%s", "Size argument cannot be zero");
+    M_REQUIRE(output->msb != iml.msb && output->lsb != iml.lsb && output->opacity != iml.opacity,
+              ERR_BAD_PARAMETER, "%s", "Cannot extract a line into itself");
 
 #define do_imlc(I, X) \
-    I->X = bit_vector_extract_wrap_ext(iml.X, index, size)
+    bit_vector_extract_wrap_ext_to(I->X, iml.X, index)
 
     do_image_line(output);
 #undef do_imlc
 
-    return valid(output);
+    return ERR_NONE;
 }
 
 // ======================================================================
-int image_line_map_colors(image_line_t* output, image_line_t iml, palette_t map)
+int image_line_extract_wrap_ext(image_line_t* output, image_line_t iml, int64_t index, size_t size)
 {
     M_REQUIRE_NON_NULL(output);
     M_REQUIRE_NON_NULL_IMAGE_LINE(iml);
+    M_REQUIRE(size > 0, ERR_BAD_PARAMETER, "%s", "Size argument cannot be zero");
 
-    if (map == DEFAULT_PALETTE) {
-#define do_imlc(I, X) \
-        I->X = bit_vector_cpy(iml.X)
-
-        do_image_line(output);
-#undef do_imlc
-        return ERR_NONE;
+    M_REQUIRE_NO_ERR(image_line_create(output, size));
+    const int err = image_line_extract_wrap_ext_to(output, iml, index);
+    if (err != ERR_NONE) {
+        image_line_free(output);
     }
+    return err;
+}
 
-    output->lsb = bit_vector_create(iml.lsb->size, 0);
-    output->msb = bit_vector_create(iml.msb->size, 0);
-    output->opacity = bit_vector_cpy(iml.opacity);
-
-    for (size_t i = 0; i < PALETTE_COLOR_COUNT; ++i) {
-        bit_vector_t* mask = NULL;
-
-        const bit_t color_bit_0 = (bit_t) (map & (1 << (i * 2    )));
-        const bit_t color_bit_1 = (bit_t) (map & (1 << (i * 2 + 1)));
-
-        if (color_bit_0 || color_bit_1) {
-            switch (i) {
-            case 0: {
-                bit_vector_t* tmp = bit_vector_not(bit_vector_cpy(iml.lsb));
-
-                if (tmp == NULL) {
-                    image_line_free(output);
-                    return ERR_MEM;
-                }
-
-                mask = bit_vector_and(bit_vector_not(bit_vector_cpy(iml.msb)), tmp);
-                bit_vector_free(&tmp);
-            } break;
-
-            case 1: {
-                mask = bit_vector_and(bit_vector_not(bit_vector_cpy(iml.msb)), iml.lsb);
-            } break;
+// ======================================================================
+/**
+ * @brief palette mapping as boolean formulas: each output plane is a
+ *        function of the (l, m) pixel bits, written in algebraic normal form
+ *            out = c0 ^ (c1 & l) ^ (c2 & m) ^ (c3 & l & m)
+ *        with c0 = T0, c1 = T0^T1, c2 = T0^T2, c3 = T0^T1^T2^T3, where Tc is
+ *        the bit of color c in that plane. The four coefficients of the lsb
+ *        plane are bits 0-3 of the table entry, those of the msb plane bits 4-7.
+ */
+#define ANF(t0, t1, t2, t3) \
+    ((t0) | (((t0) ^ (t1)) << 1) | (((t0) ^ (t2)) << 2) | (((t0) ^ (t1) ^ (t2) ^ (t3)) << 3))
+#define PLANE_ANF(p, b) \
+    ANF(((p) >> (b)) & 1, ((p) >> ((b) + 2)) & 1, ((p) >> ((b) + 4)) & 1, ((p) >> ((b) + 6)) & 1)
+#define PALETTE_ANF(p) (PLANE_ANF(p, 0) | (PLANE_ANF(p, 1) << 4))
+#define A4(n)  PALETTE_ANF(n), PALETTE_ANF(n + 1), PALETTE_ANF(n + 2), PALETTE_ANF(n + 3)
+#define A16(n) A4(n), A4(n + 4), A4(n + 8), A4(n + 12)
+#define A64(n) A16(n), A16(n + 16), A16(n + 32), A16(n + 48)
+static const uint8_t palette_formulas[256] = { A64(0), A64(64), A64(128), A64(192) };
+#undef A64
+#undef A16
+#undef A4
+#undef PALETTE_ANF
+#undef PLANE_ANF
+#undef ANF
+
+// coefficient k of a formula, as an all-ones or all-zeros word
+#define coefficient(formula, k) (UINT32_C(0) - (((formula) >> (k)) & 1))
 
-            case 2: {
-                mask = bit_vector_and(bit_vector_not(bit_vector_cpy(iml.lsb)), iml.msb);
-            } break;
+// ======================================================================
+/**
+ * @brief maps nb_words words of 32 pixels; the outputs can be the inputs
+ */
+static void map_colors_words(uint32_t* lsb_out, uint32_t* msb_out,
+                             const uint32_t* lsb, const uint32_t* msb,
+                             size_t nb_words, palette_t map)
+{
+    const uint8_t formula = palette_formulas[map];
+    const uint32_t l0 = coefficient(formula, 0), l1 = coefficient(formula, 1),
+                   l2 = coefficient(formula, 2), l3 = coefficient(formula, 3);
+    const uint32_t m0 = coefficient(formula, 4), m1 = coefficient(formula, 5),
+                   m2 = coefficient(formula, 6), m3 = coefficient(formula, 7);
+
+    for (size_t j = 0; j < nb_words; ++j) {
+        const uint32_t l = lsb[j];
+        const uint32_t m = msb[j];
+        const uint32_t lm = l & m;
+        lsb_out[j] = l0 ^ (l1 & l) ^ (l2 & m) ^ (l3 & lm);
+        msb_out[j] = m0 ^ (m1 & l) ^ (m2 & m) ^ (m3 & lm);
+    }
+}
 
-            case 3: {
-                mask = bit_vector_and(bit_vector_cpy(iml.lsb), iml.msb);
-            } break;
-            }
+// ======================================================================
+void image_map_colors_word(uint32_t* lsb, uint32_t* msb, palette_t map)
+{
+    map_colors_words(lsb, msb, lsb, msb, 1, map);
+}
 
-            if (mask == NULL) {
-                image_line_free(output);
-                return ERR_MEM;
-            }
+// ======================================================================
+/**
+ * @brief clears the bits past the size, which color 0 may have set
+ */
+static void map_colors_tail(image_line_t* piml)
+{
+    const size_t size = piml->msb->size;
+    if (size % IMAGE_LINE_WORD_BITS != 0) {
+        const uint32_t mask = (UINT32_C(1) << (size % IMAGE_LINE_WORD_BITS)) - 1;
+        const size_t last = size_to_content_size(size) - 1;
+        piml->lsb->content[last] &= mask;
+        piml->msb->content[last] &= mask;
+    }
+}
 
-            if (color_bit_0) {
-                output->lsb = bit_vector_or(output->lsb, mask);
+// ======================================================================
+int image_line_map_colors_to(image_line_t* output, image_line_t iml, palette_t map)
+{
+    M_REQUIRE_NON_NULL(output);
+    M_REQUIRE_MATCHING_IMAGE_LINE_SIZE(*output, iml);
 
-                if (output->lsb == NULL) {
-                    image_line_free(output);
-                    return ERR_MEM;
-                }
-            }
+    const size_t nb_words = size_to_content_size(iml.msb->size);
+    map_colors_words(output->lsb->content, output->msb->content,
+                     iml.lsb->content, iml.msb->content, nb_words, map);
+    if (output->opacity != iml.opacity) {
+        memcpy(output->opacity->content, iml.opacity->content, nb_words * sizeof(uint32_t));
+    }
+    map_colors_tail(output);
 
-            if (color_bit_1) {
-                output->msb = bit_vector_or(output->msb, mask);
+    return ERR_NONE;
+}
 
-                if (output->msb == NULL) {
-                    image_line_free(output);
-                    return ERR_MEM;
-                }
-            }
+// ======================================================================
+int image_line_map_colors(image_line_t* output, image_line_t iml, palette_t map)
+{
+    M_CREATE_THEN(output, iml, image_line_map_colors_to(output, iml, map));
+}
 
-            bit_vector_free(&mask);
-        }
+// ======================================================================
+int image_line_below_with_opacity_to(image_line_t* output, image_line_t iml1, image_line_t iml2,
+                                     const bit_vector_t* p_opacity)
+{
+    M_REQUIRE_NON_NULL(output);
+    M_REQUIRE_NON_NULL(p_opacity);
+    M_REQUIRE_MATCHING_IMAGE_LINE_SIZE(iml1, iml2);
+    M_REQUIRE_MATCHING_IMAGE_LINE_SIZE(*output, iml1);
+    M_REQUIRE(p_opacity->size == iml1.opacity->size, ERR_BAD_PARAMETER, "%s", "Sizes do not match");
+
+    const size_t nb_words = size_to_content_size(iml1.msb->size);
+    for (size_t j = 0; j < nb_words; ++j) {
+        // read everything first: output may be iml1 or iml2
+        const uint32_t above = p_opacity->content[j];
+        const uint32_t msb = (iml1.msb->content[j] & ~above) | (iml2.msb->content[j] & above);
+        const uint32_t lsb = (iml1.lsb->content[j] & ~above) | (iml2.lsb->content[j] & above);
+        const uint32_t opacity = iml1.opacity->content[j] | above;
+        output->msb->content[j] = msb;
+        output->lsb->content[j] = lsb;
+        output->opacity->content[j] = opacity;
     }
 
     return ERR_NONE;
@@ -199,38 +288,16 @@ int image_line_map_colors(image_line_t* output, image_line_t iml, palette_t map)
 // ======================================================================
 int image_line_below_with_opacity(image_line_t* output, image_line_t iml1, image_line_t iml2, bit_vector_t* p_opacity)
 {
-    M_REQUIRE_NON_NULL(output);
-    M_REQUIRE_NON_NULL_IMAGE_LINE(iml1);
     M_REQUIRE_NON_NULL_IMAGE_LINE(iml2);
-    M_REQUIRE_MATCHING_IMAGE_LINE_SIZE(iml1, iml2);
-
-    bit_vector_t* notopacity = bit_vector_not(bit_vector_cpy(p_opacity));
-
-    bit_vector_t* m_above_and_opacity    = bit_vector_and(bit_vector_cpy(iml2.msb), p_opacity );
-    bit_vector_t* l_above_and_opacity    = bit_vector_and(bit_vector_cpy(iml2.lsb), p_opacity );
-    bit_vector_t* m_below_and_notopacity = bit_vector_and(bit_vector_cpy(iml1.msb), notopacity);
-    bit_vector_t* l_below_and_notopacity = bit_vector_and(bit_vector_cpy(iml1.lsb), notopacity);
-
-    if (notopacity == NULL ||
-        m_above_and_opacity == NULL || m_below_and_notopacity == NULL ||
-        l_above_and_opacity == NULL || l_below_and_notopacity == NULL) {
-        bit_vector_free(&notopacity);
-        bit_vector_free(&m_above_and_opacity);
-        bit_vector_free(&m_below_and_notopacity);
-        bit_vector_free(&l_above_and_opacity);
-        bit_vector_free(&l_below_and_notopacity);
-        return ERR_MEM;
-    }
-
-    output->msb     = bit_vector_or(m_below_and_notopacity, m_above_and_opacity);
-    output->lsb     = bit_vector_or(l_below_and_notopacity, l_above_and_opacity);
-    output->opacity = bit_vector_or(bit_vector_cpy(iml1.opacity), p_opacity          );
+    M_CREATE_THEN(output, iml1, image_line_below_with_opacity_to(output, iml1, iml2, p_opacity));
+}
 
-    bit_vector_free(&notopacity);
-    bit_vector_free(&m_above_and_opacity);
-    bit_vector_free(&l_above_and_opacity);
+// ======================================================================
+int image_line_below_to(image_line_t* output, image_line_t iml1, image_line_t iml2)
+{
+    M_REQUIRE_NON_NULL_IMAGE_LINE(iml2);
 
-    return ERR_NONE;
+    return image_line_below_with_opacity_to(output, iml1, iml2, iml2.opacity);
 }
 
 // ======================================================================
@@ -245,7 +312,7 @@ int image_line_below(image_line_t* output, image_line_t iml1, image_line_t iml2)
 }
 
 // ======================================================================
-int image_line_join(image_line_t* output, image_line_t iml1, image_line_t iml2, int64_t start)
+int image_line_join_to(image_line_t* output, image_line_t iml1, image_line_t iml2, int64_t start)
 {
     M_REQUIRE_NON_NULL(output);
     M_REQUIRE_NON_NULL_IMAGE_LINE(iml1);
@@ -255,27 +322,24 @@ int image_line_join(image_line_t* output, image_line_t iml1, image_line_t iml2,
               "Incorrect sizes in image_line #1 (%zu, %zu, %zu)",
               iml1.lsb->size, iml1.msb->size, iml1.opacity->size);
     M_REQUIRE_MATCHING_IMAGE_LINE_SIZE(iml1, iml2);
+    M_REQUIRE_MATCHING_IMAGE_LINE_SIZE(*output, iml1);
     M_REQUIRE(start >= 0, ERR_BAD_PARAMETER, "Incorrect start (%ld < 0)", start);
     M_REQUIRE(start < (int64_t)iml1.msb->size, ERR_BAD_PARAMETER,
               "Incorrect start (%ld >= %zu)", start, iml1.msb->size);
 
-    const int64_t size = (int64_t)iml1.lsb->size;
-
-    if (start % size == 0) {
 #define do_imlc(I, X) \
-        I->X = bit_vector_cpy(iml2.X)
+    bit_vector_join_to(I->X, iml1.X, iml2.X, start)
 
-        do_image_line(output);
+    do_image_line(output);
 #undef do_imlc
-    } else {
-#define do_imlc(I, X) \
-        I->X = bit_vector_join(iml1.X, iml2.X, start)
 
-        do_image_line(output);
-#undef do_imlc
-    }
+    return ERR_NONE;
+}
 
-    return valid(output);
+// ======================================================================
+int image_line_join(image_line_t* output, image_line_t iml1, image_line_t iml2, int64_t start)
+{
+    M_CREATE_THEN(output, iml1, image_line_join_to(output, iml1, iml2, start));
 }
 
 // ======================================================================
@@ -288,27 +352,97 @@ void image_line_free(image_line_t* piml)
     bit_vector_free(&piml->opacity);
 }
 
+// ======================================================================
+static size_t vector_stride(size_t width)
+{
+    return round_up(offsetof(bit_vector_t, content) + size_to_content_size(width) * sizeof(uint32_t),
+                    VECTOR_ALIGNMENT);
+}
+
+// ======================================================================
+static size_t lines_bytes(size_t height)
+{
+    return round_up(height * sizeof(image_line_t), SLAB_ALIGNMENT);
+}
+
+// ======================================================================
+/**
+ * @brief start and size of the vectors of an image (everything but the line array)
+ */
+static unsigned char* image_vectors(const image_t* pim, size_t* size)
+{
+    *size = pim->height * 3 * vector_stride(pim->content[0].msb->size);
+    return (unsigned char*) pim->content + lines_bytes(pim->height);
+}
+
 // ======================================================================
 int image_create(image_t* pim, size_t width, size_t height)
 {
     M_REQUIRE_NON_NULL(pim);
     M_REQUIRE(width > 0, ERR_BAD_PARAMETER, "%s", "Parameter width is zero.");
     M_REQUIRE(height > 0, ERR_BAD_PARAMETER, "%s", "Parameter height is zero.");
+    M_REQUIRE(width <= SIZE_MAX / 2, ERR_BAD_PARAMETER, "Parameter width is too large (%zu).", width);
 
-    pim->content = calloc(height, sizeof(image_line_t));
-    if (pim->content == NULL) return ERR_MEM;
+    const size_t stride = vector_stride(width);
+    M_REQUIRE(height <= SIZE_MAX / 2 / (sizeof(image_line_t) + 3 * stride + SLAB_ALIGNMENT),
+              ERR_BAD_PARAMETER, "Parameter height is too large (%zu).", height);
 
+    const size_t size = round_up(lines_bytes(height) + height * 3 * stride, SLAB_ALIGNMENT);
+    unsigned char* const slab = aligned_alloc(SLAB_ALIGNMENT, size);
+    if (slab == NULL) return ERR_MEM;
+    memset(slab, 0, size); // also the padding: images can be hashed as a whole
+
+    pim->content = (image_line_t*) slab;
     pim->height = height;
 
-    int error = ERR_NONE;
-    for (size_t i = 0; i < height && error == ERR_NONE; ++i) {
-        error = image_line_create(pim->content + i, width);
+    unsigned char* vector = slab + lines_bytes(height);
+    for (size_t i = 0; i < height; ++i) {
+#define do_imlc(I, X) \
+        I->content[i].X = (bit_vector_t*) vector; \
+        I->content[i].X->size = width; \
+        vector += stride
+
+        do_imlc(pim, msb);
+        do_imlc(pim, lsb);
+        do_imlc(pim, opacity);
+#undef do_imlc
     }
 
-    if (error != ERR_NONE) {
-        image_free(pim);
-        return error;
+    return ERR_NONE;
+}
+
+// ======================================================================
+int image_copy(image_t* dst, const image_t* src)
+{
+    M_REQUIRE_NON_NULL(dst);
+    M_REQUIRE_NON_NULL(src);
+    M_REQUIRE_NON_NULL(dst->content);
+    M_REQUIRE_NON_NULL(src->content);
+    M_REQUIRE(dst->height == src->height && dst->content[0].msb->size == src->content[0].msb->size,
+              ERR_BAD_PARAMETER, "Sizes do not match (%zux%zu, %zux%zu)",
+              dst->content[0].msb->size, dst->height, src->content[0].msb->size, src->height);
+
+    size_t size = 0;
+    const unsigned char* const from = image_vectors(src, &size);
+    memcpy(image_vectors(dst, &size), from, size);
+
+    return ERR_NONE;
+}
+
+// ======================================================================
+int image_hash(uint64_t* output, const image_t* pim)
+{
+    M_REQUIRE_NON_NULL(output);
+    M_REQUIRE_NON_NULL(pim);
+    M_REQUIRE_NON_NULL(pim->content);
+
+    size_t size = 0;
+    const unsigned char* const bytes = image_vectors(pim, &size);
+    uint64_t hash = IMAGE_HASH_OFFSET;
+    for (size_t i = 0; i < size; ++i) {
+        hash = (hash ^ bytes[i]) * IMAGE_HASH_PRIME;
     }
+    *output = hash;
 
     return ERR_NONE;
 }
@@ -330,6 +464,23 @@ int image_set_line(image_t* pim, size_t y, image_line_t line)
     return ERR_NONE;
 }
 
+// ======================================================================
+int image_map_colors(image_t* pim, palette_t map)
+{
+    M_REQUIRE_NON_NULL(pim);
+    M_REQUIRE_NON_NULL(pim->content);
+
+    const size_t nb_words = size_to_content_size(pim->content[0].msb->size);
+    for (size_t y = 0; y < pim->height; ++y) {
+        image_line_t* const line = pim->content + y;
+        map_colors_words(line->lsb->content, line->msb->content,
+                         line->lsb->content, line->msb->content, nb_words, map);
+        map_colors_tail(line);
+    }
+
+    return ERR_NONE;
+}
+
 // ======================================================================
 int image_get_pixel(uint8_t* output, image_t* pim, size_t x, size_t y)
 {
@@ -339,8 +490,8 @@ int image_get_pixel(uint8_t* output, image_t* pim, size_t x, size_t y)
     M_REQUIRE(x < pim->content[y].msb->size, ERR_BAD_PARAMETER, "Invalid X parameter (%zu >= %zu)", x, pim->content[y].msb->size);
     M_REQUIRE(x < pim->content[y].lsb->size, ERR_BAD_PARAMETER, "Invalid X parameter (%zu >= %zu)", x, pim->content[y].lsb->size);
 
-    *output = (uint8_t)((bit_vector_get(pim->content[y].msb, x) ? 0x2 : 0x0) |
-                        (bit_vector_get(pim->content[y].lsb, x) ? 0x1 : 0x0));
+    *output = (uint8_t)((bit_vector_test(pim->content[y].msb, x) << 1) |
+                        bit_vector_test(pim->content[y].lsb, x));
 
     return ERR_NONE;
 }
@@ -354,12 +505,10 @@ int image_own_line_content(image_t* pim, size_t y, image_line_t line)
     M_REQUIRE_NON_NULL_IMAGE_LINE(line);
     M_REQUIRE_MATCHING_IMAGE_LINE_SIZE(pim->content[y], line);
 
-#define do_imlc(I, X) \
-    bit_vector_free(&(I->content[y].X)); \
-    I->content[y].X = line.X
-
-    do_image_line(pim);
-#undef do_imlc
+    // the line vectors live in the image storage: take the values, then
+    // free the given vectors, which now belong to the image
+    M_REQUIRE_NO_ERR(image_set_line(pim, y, line));
+    image_line_free(&line);
     return ERR_NONE;
 }
 
@@ -368,11 +517,64 @@ void image_free(image_t* pim)
 {
     if (pim == NULL) return;
 
-    for (size_t i = 0; i < pim->height; ++i) {
-        image_line_free(pim->content + i);
-    }
-
+    // a single slab holds the lines and their vectors
     pim->height = 0;
     free(pim->content);
     pim->content = NULL;
 }
+
+// ======================================================================
+int image_scratch_create(image_scratch_t* scratch, size_t width)
+{
+    M_REQUIRE_NON_NULL(scratch);
+    M_REQUIRE(width > 0, ERR_BAD_PARAMETER, "%s", "Parameter width is zero.");
+
+    memset(scratch, 0, sizeof(image_scratch_t));
+    scratch->width = width;
+    for (size_t i = 0; i < IMAGE_SCRATCH_LINES; ++i) {
+        const int error = image_line_create(scratch->lines + i, width);
+        if (error != ERR_NONE) {
+            image_scratch_free(scratch);
+            return error;
+        }
+    }
+
+    return ERR_NONE;
+}
+
+// ======================================================================
+int image_scratch_take(image_scratch_t* scratch, image_line_t* line, size_t size)
+{
+    M_REQUIRE_NON_NULL(scratch);
+    M_REQUIRE_NON_NULL(line);
+    M_REQUIRE(size > 0 && size <= scratch->width, ERR_BAD_PARAMETER,
+              "Invalid size (%zu not in 1..%zu)", size, scratch->width);
+    M_REQUIRE(scratch->used < IMAGE_SCRATCH_LINES, ERR_MEM,
+              "All %d scratch lines are in use", IMAGE_SCRATCH_LINES);
+
+    // a line of the scratch is used as a line of any smaller size
+    *line = scratch->lines[scratch->used++];
+    line->msb->size = line->lsb->size = line->opacity->size = size;
+
+    return ERR_NONE;
+}
+
+// ======================================================================
+void image_scratch_release(image_scratch_t* scratch)
+{
+    if (scratch == NULL) return;
+
+    scratch->used = 0;
+}
+
+// ======================================================================
+void image_scratch_free(image_scratch_t* scratch)
+{
+    if (scratch == NULL) return;
+
+    for (size_t i = 0; i < IMAGE_SCRATCH_LINES; ++i) {
+        image_line_free(scratch->lines + i);
+    }
+    scratch->width = 0;
+    scratch->used = 0;
+}
@@ -39,7 +39,9 @@ typedef struct image_line_ image_line_t;
 
 //=========================================================================
 /**
- * @brief Type to represent images
+ * @brief Type to represent images. All the lines and their bit vectors
+ * live in a single aligned slab (starting at content): the msb, lsb and
+ * opacity vectors of every line follow each other at a fixed stride.
  */
 struct image_ {
     size_t height;
@@ -47,6 +49,20 @@ struct image_ {
 };
 typedef struct image_ image_t;
 
+//=========================================================================
+#define IMAGE_SCRATCH_LINES 4
+
+/**
+ * @brief Preallocated lines for the temporaries of a line composition,
+ *        so that composing a frame makes no allocation
+ */
+struct image_scratch_ {
+    size_t width; // capacity of every line (in pixels)
+    size_t used;  // number of lines taken
+    image_line_t lines[IMAGE_SCRATCH_LINES];
+};
+typedef struct image_scratch_ image_scratch_t;
+
 //=========================================================================
 /**
  * @brief Create an image
@@ -77,6 +93,16 @@ int image_line_set_word(image_line_t* piml, size_t index, uint32_t msb, uint32_t
  */
 int image_line_shift(image_line_t* output, image_line_t iml, int64_t shift);
 
+//=========================================================================
+/**
+ * @brief Shift image line into an existing one of the same size (no allocation)
+ * @param output pointer to write output to (can be &iml, to shift in place)
+ * @param iml image line to shift
+ * @param shift shift amount
+ * @return Error code
+ */
+int image_line_shift_to(image_line_t* output, image_line_t iml, int64_t shift);
+
 //=========================================================================
 /**
  * @brief Extract image line (wrapping)
@@ -88,6 +114,17 @@ int image_line_shift(image_line_t* output, image_line_t iml, int64_t shift);
  */
 int image_line_extract_wrap_ext(image_line_t* output, image_line_t iml, int64_t index, size_t size);
 
+//=========================================================================
+/**
+ * @brief Extract image line (wrapping) into an existing one (no allocation)
+ * @param output pointer to write output to, its size is the extracted size
+ *        (cannot be &iml)
+ * @param iml image line to extract
+ * @param index index from which to extract
+ * @return Error code
+ */
+int image_line_extract_wrap_ext_to(image_line_t* output, image_line_t iml, int64_t index);
+
 //=========================================================================
 /**
  * @brief Apply Palette to image line
@@ -98,6 +135,25 @@ int image_line_extract_wrap_ext(image_line_t* output, image_line_t iml, int64_t
  */
 int image_line_map_colors(image_line_t* output, image_line_t iml, palette_t map);
 
+//=========================================================================
+/**
+ * @brief Apply Palette to image line into an existing one of the same size (no allocation)
+ * @param output pointer to write output to (can be &iml)
+ * @param iml image line to use palette on
+ * @param map palette to use
+ * @return Error code
+ */
+int image_line_map_colors_to(image_line_t* output, image_line_t iml, palette_t map);
+
+//=========================================================================
+/**
+ * @brief Apply Palette to a word of IMAGE_LINE_WORD_BITS pixels, in place
+ * @param lsb pointer to the lsb plane of the pixels
+ * @param msb pointer to the msb plane of the pixels
+ * @param map palette to use
+ */
+void image_map_colors_word(uint32_t* lsb, uint32_t* msb, palette_t map);
+
 //=========================================================================
 /**
  * @brief Combine two image lines using opacity
@@ -109,6 +165,18 @@ int image_line_map_colors(image_line_t* output, image_line_t iml, palette_t map)
  */
 int image_line_below_with_opacity(image_line_t* output, image_line_t iml1, image_line_t iml2, bit_vector_t* p_opacity);
 
+//=========================================================================
+/**
+ * @brief Combine two image lines using opacity into an existing one of the same size (no allocation)
+ * @param output pointer to write output to (can be &iml1 or &iml2)
+ * @param iml1 image line to combine
+ * @param iml2 image line to combine
+ * @param p_opacity bit vector pointer to use for opacity
+ * @return Error code
+ */
+int image_line_below_with_opacity_to(image_line_t* output, image_line_t iml1, image_line_t iml2,
+                                     const bit_vector_t* p_opacity);
+
 //=========================================================================
 /**
  * @brief Combine two image lines (using iml2 opacity)
@@ -119,6 +187,16 @@ int image_line_below_with_opacity(image_line_t* output, image_line_t iml1, image
  */
 int image_line_below(image_line_t* output, image_line_t iml1, image_line_t iml2);
 
+//=========================================================================
+/**
+ * @brief Combine two image lines (using iml2 opacity) into an existing one of the same size (no allocation)
+ * @param output pointer to write output to (can be &iml1 or &iml2)
+ * @param iml1 image line to combine
+ * @param iml2 image line to combine
+ * @return Error code
+ */
+int image_line_below_to(image_line_t* output, image_line_t iml1, image_line_t iml2);
+
 //=========================================================================
 /**
  * @brief Join two image lines
@@ -130,6 +208,17 @@ int image_line_below(image_line_t* output, image_line_t iml1, image_line_t iml2)
  */
 int image_line_join(image_line_t* output, image_line_t iml1, image_line_t iml2, int64_t start);
 
+//=========================================================================
+/**
+ * @brief Join two image lines into an existing one of the same size (no allocation)
+ * @param output pointer to write output to (can be &iml1 or &iml2)
+ * @param iml1 image line to join (values from 0 to start)
+ * @param iml2 image line to join (values from start to end)
+ * @param start index from which to use iml2 values
+ * @return Error code
+ */
+int image_line_join_to(image_line_t* output, image_line_t iml1, image_line_t iml2, int64_t start);
+
 //=========================================================================
 /**
  * @brief Free image line
@@ -170,7 +259,8 @@ int image_get_pixel(uint8_t* output, image_t* pim, size_t x, size_t y);
 
 //=========================================================================
 /**
- * @brief Set line content of image (using provided bit vectors pointers)
+ * @brief Set line content of image, taking ownership of the provided bit vectors
+ * (their values are copied into the image storage, then they are freed)
  * @param pim pointer to image
  * @param y line index to set
  * @param line line to use bit vectors from
@@ -178,6 +268,35 @@ int image_get_pixel(uint8_t* output, image_t* pim, size_t x, size_t y);
  */
 int image_own_line_content(image_t* pim, size_t y, image_line_t line);
 
+//=========================================================================
+/**
+ * @brief Copy the content of an image into another one of the same size
+ * (a single memcpy of the whole storage)
+ * @param dst pointer to destination image
+ * @param src pointer to source image
+ * @return Error code
+ */
+int image_copy(image_t* dst, const image_t* src);
+
+//=========================================================================
+/**
+ * @brief Hash (64-bit FNV-1a) of the whole storage of an image: images of
+ * the same size with the same content have the same hash
+ * @param output pointer to write hash to
+ * @param pim pointer to image
+ * @return Error code
+ */
+int image_hash(uint64_t* output, const image_t* pim);
+
+//=========================================================================
+/**
+ * @brief Apply Palette to a whole image, in place
+ * @param pim pointer to image
+ * @param map palette to use
+ * @return Error code
+ */
+int image_map_colors(image_t* pim, palette_t map);
+
 //=========================================================================
 /**
  * @brief Free image
@@ -185,6 +304,40 @@ int image_own_line_content(image_t* pim, size_t y, image_line_t line);
  */
 void image_free(image_t* pim);
 
+//=========================================================================
+/**
+ * @brief Creates a scratch of IMAGE_SCRATCH_LINES lines
+ * @param scratch pointer to scratch
+ * @param width width of the widest line to be taken
+ * @return Error code
+ */
+int image_scratch_create(image_scratch_t* scratch, size_t width);
+
+//=========================================================================
+/**
+ * @brief Takes a line of the scratch, until the scratch is released
+ *        (its content is undefined)
+ * @param scratch pointer to scratch
+ * @param line pointer to write the line to
+ * @param size length of line in pixels (at most the scratch width)
+ * @return Error code (ERR_MEM when every line is taken)
+ */
+int image_scratch_take(image_scratch_t* scratch, image_line_t* line, size_t size);
+
+//=========================================================================
+/**
+ * @brief Gives all the lines taken from a scratch back to it
+ * @param scratch pointer to scratch
+ */
+void image_scratch_release(image_scratch_t* scratch);
+
+//=========================================================================
+/**
+ * @brief Free scratch
+ * @param scratch pointer to scratch
+ */
+void image_scratch_free(image_scratch_t* scratch);
+
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,100 @@
+/**
+ * @file joypad.c
+ * @brief Game Boy joypad simulation
+ *
+ * @date 2020
+ */
+
+#include <stdint.h>
+
+#include "joypad.h"
+#include "bus.h"
+#include "error.h"
+
+// P1 bits: 5 selects the buttons row, 4 the directions row (both active
+// low); 3 to 0 are the key lines of the selected rows (0 if pressed)
+#define P1_SELECT_MASK 0x30
+#define P1_SELECT_ROW0 0x10
+#define P1_KEYS_MASK   0x0F
+#define P1_UNUSED_BITS 0xC0
+
+// ======================================================================
+/**
+ * @brief updates P1 from the selected rows, requesting the joypad
+ *        interrupt when a key line goes low
+ */
+static void joypad_update(joypad_t* pad)
+{
+    uint8_t pressed = 0;
+    for (size_t row = 0; row < NB_GB_KEY_ROWS; ++row) {
+        if (!(pad -> intern & (P1_SELECT_ROW0 << row))) {
+            pressed |= pad -> keys_state[row];
+        }
+    }
+
+    const uint8_t state = (uint8_t) (~pressed & P1_KEYS_MASK);
+    if (pad -> old_state & ~state & P1_KEYS_MASK) {
+        cpu_request_interrupt(pad -> cpu, JOYPAD);
+    }
+    pad -> old_state = state;
+    *(pad -> p_P1) = (data_t) (P1_UNUSED_BITS | (pad -> intern & P1_SELECT_MASK) | state);
+}
+
+// ======================================================================
+int joypad_init_and_plug(joypad_t* pad, cpu_t* cpu)
+{
+    M_REQUIRE_NON_NULL(pad);
+    M_REQUIRE_NON_NULL(cpu);
+    M_REQUIRE_NON_NULL(cpu -> bus);
+    M_REQUIRE_NON_NULL((*(cpu -> bus))[REG_P1]);
+
+    pad -> cpu = cpu;
+    pad -> p_P1 = (*(cpu -> bus))[REG_P1];
+    pad -> intern = P1_SELECT_MASK;
+    pad -> old_state = P1_KEYS_MASK;
+    for (size_t row = 0; row < NB_GB_KEY_ROWS; ++row) {
+        pad -> keys_state[row] = 0;
+    }
+    joypad_update(pad);
+
+    return ERR_NONE;
+}
+
+// ======================================================================
+int joypad_bus_listener(joypad_t* pad, addr_t addr)
+{
+    M_REQUIRE_NON_NULL(pad);
+    if (addr == REG_P1) {
+        // only the row selection can be written, the key lines are read-only
+        pad -> intern = (data_t) (*(pad -> p_P1) & P1_SELECT_MASK);
+        joypad_update(pad);
+    }
+    return ERR_NONE;
+}
+
+// ======================================================================
+#define M_REQUIRE_KEY(key) \
+    M_REQUIRE((key) >= 0 && (key) < NB_GB_KEYS, ERR_BAD_PARAMETER, "Invalid key (%d)", (int) (key))
+
+#define key_row(key) ((size_t) (key) / NB_GB_KEY_COLS)
+#define key_bit(key) ((uint8_t) (1 << ((size_t) (key) % NB_GB_KEY_COLS)))
+
+// ======================================================================
+int joypad_key_pressed(joypad_t* pad, gb_key_t key)
+{
+    M_REQUIRE_NON_NULL(pad);
+    M_REQUIRE_KEY(key);
+    pad -> keys_state[key_row(key)] |= key_bit(key);
+    joypad_update(pad);
+    return ERR_NONE;
+}
+
+// ======================================================================
+int joypad_key_released(joypad_t* pad, gb_key_t key)
+{
+    M_REQUIRE_NON_NULL(pad);
+    M_REQUIRE_KEY(key);
+    pad -> keys_state[key_row(key)] &= (uint8_t) ~key_bit(key);
+    joypad_update(pad);
+    return ERR_NONE;
+}
@@ -0,0 +1,447 @@
+/**
+ * @file lcdc.c
+ * @brief Game Boy LCD (liquid cristal display) controller simulation
+ *
+ * Lines are drawn from the tile cache of the Game Boy and composed by
+ * compose_line() straight into the display.
+ *
+ * @date 2020
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#include "lcdc.h"
+#include "gameboy.h"
+#include "compose.h"
+#include "scanline.h"
+#include "sprite_index.h"
+#include "error.h"
+
+#define READ_REG(X,Y) \
+    M_REQUIRE_NO_ERR(bus_read(*(lcd -> cpu -> bus), REG_ ## X, Y));
+#define WRITE_REG(X,Y) \
+    M_REQUIRE_NO_ERR(bus_write(*(lcd -> cpu -> bus), REG_ ## X, Y));
+
+// STAT interrupt enable bit of modes 0, 1 and 2
+#define STAT_REG_INT_MODE_BIT(mode) (3 + (mode))
+
+#define MODE_HBLANK 0
+#define MODE_VBLANK 1
+#define MODE_OAM    2
+#define MODE_DRAW   3
+
+// background and window lines: a whole tile map row
+#define MAP_LINE_PIXELS (TILE_LINE_SIZE * TILE_PIXELS)
+
+#define OAM_SIZE MEM_SIZE(GRAPH_RAM)
+
+#define OAM_BEHIND_BG_MASK 0x80
+#define OAM_FLIP_Y_MASK    0x40
+#define OAM_FLIP_X_MASK    0x20
+#define OAM_PALETTE_MASK   0x10
+
+// ======================================================================
+/**
+ * @brief line and mode the LCD is in (line 0, mode 0 when off)
+ */
+static void lcdc_position(const lcdc_t* lcd, data_t* ly, data_t* mode)
+{
+    *ly = 0;
+    *mode = MODE_HBLANK;
+    if (lcd -> on && lcd -> next_cycle > lcd -> on_cycle) {
+        // the current cycle lies between the last event and the next one
+        const uint64_t pos = (lcd -> next_cycle - 1 - lcd -> on_cycle) % FRAME_TOTAL_CYCLES;
+        const uint64_t x = pos % LINE_TOTAL_CYCLES;
+        *ly = (data_t) (pos / LINE_TOTAL_CYCLES);
+        *mode = *ly >= LCD_HEIGHT ? MODE_VBLANK
+                : x < LINE_MODE_3_START_CYCLE ? MODE_OAM
+                : x < LINE_MODE_0_START_CYCLE ? MODE_DRAW : MODE_HBLANK;
+    }
+}
+
+// ======================================================================
+/**
+ * @brief writes the mode and the LY=LYC flag into STAT
+ */
+static int lcdc_update_stat(lcdc_t* lcd, data_t mode)
+{
+    data_t stat = 0, ly = 0, lyc = 0;
+    READ_REG(STAT, &stat);
+    READ_REG(LY, &ly);
+    READ_REG(LYC, &lyc);
+
+    stat &= (data_t) ~(STAT_REG_MODE_MASK | (1 << STAT_REG_LYC_EQ_LY_BIT));
+    stat |= (data_t) (mode | ((ly == lyc) << STAT_REG_LYC_EQ_LY_BIT));
+    WRITE_REG(STAT, stat);
+    return ERR_NONE;
+}
+
+// ======================================================================
+/**
+ * @brief sets LY, requesting the LY=LYC interrupt if enabled
+ */
+static int lcdc_set_ly(lcdc_t* lcd, data_t ly, data_t mode)
+{
+    data_t lyc = 0, stat = 0;
+    WRITE_REG(LY, ly);
+    M_REQUIRE_NO_ERR(lcdc_update_stat(lcd, mode));
+    READ_REG(LYC, &lyc);
+    READ_REG(STAT, &stat);
+    if (ly == lyc && bit_get(stat, STAT_REG_INT_LYC_BIT)) {
+        cpu_request_interrupt(lcd -> cpu, LCD_STAT);
+    }
+    return ERR_NONE;
+}
+
+// ======================================================================
+/**
+ * @brief enters a mode, requesting its STAT interrupt if enabled
+ */
+static int lcdc_enter_mode(lcdc_t* lcd, data_t mode)
+{
+    data_t stat = 0;
+    M_REQUIRE_NO_ERR(lcdc_update_stat(lcd, mode));
+    READ_REG(STAT, &stat);
+    if (mode != MODE_DRAW && bit_get(stat, STAT_REG_INT_MODE_BIT(mode))) {
+        cpu_request_interrupt(lcd -> cpu, LCD_STAT);
+    }
+    return ERR_NONE;
+}
+
+// ======================================================================
+/**
+ * @brief fills a MAP_LINE_PIXELS wide line with pixel line y of a tile map
+ */
+static int lcdc_map_line(lcdc_t* lcd, image_line_t* output, addr_t map, size_t y, bit_t tile_source)
+{
+    const addr_t row_start = (addr_t) (map + (y / TILE_PIXELS) * TILE_LINE_SIZE);
+    const data_t* const map_row = (*(lcd -> cpu -> bus))[row_start];
+    M_REQUIRE_NON_NULL(map_row);
+
+    uint8_t colors[MAP_LINE_PIXELS];
+    M_REQUIRE_NO_ERR(tile_cache_map_row(&(lcd -> gameboy -> tiles), map_row, TILE_LINE_SIZE,
+                                        tile_source, y % TILE_PIXELS, colors));
+
+    for (size_t w = 0; w < MAP_LINE_PIXELS / IMAGE_LINE_WORD_BITS; ++w) {
+        uint32_t msb = 0;
+        uint32_t lsb = 0;
+        for (size_t k = 0; k < IMAGE_LINE_WORD_BITS; ++k) {
+            const uint8_t color = colors[w * IMAGE_LINE_WORD_BITS + k];
+            lsb |= (uint32_t) (color & 1) << k;
+            msb |= (uint32_t) (color >> 1) << k;
+        }
+        M_REQUIRE_NO_ERR(image_line_set_word(output, w, msb, lsb));
+    }
+    return ERR_NONE;
+}
+
+// ======================================================================
+/**
+ * @brief gets the rows of the sprites shown on a line, highest priority first
+ */
+static int lcdc_line_sprites(lcdc_t* lcd, size_t ly, data_t lcdc,
+                             compose_sprite_t sprites[COMPOSE_MAX_SPRITES], size_t* nb_sprites)
+{
+    const size_t height = (lcdc & LCDC_REG_OBJ_SIZE_MASK) ? 2 * TILE_PIXELS : TILE_PIXELS;
+    data_t obp0 = 0, obp1 = 0;
+    READ_REG(OBP0, &obp0);
+    READ_REG(OBP1, &obp1);
+
+    // the first sprites of the OAM overlapping the line, from the sprite index
+    data_t selected[SPRITE_INDEX_MAX_PER_LINE];
+    size_t count = 0;
+    M_REQUIRE_NO_ERR(sprite_index_get_line(&(lcd -> gameboy -> sprites), *(lcd -> cpu -> bus),
+                                           ly, selected, &count));
+    data_t entries[SPRITE_INDEX_MAX_PER_LINE][OAM_ENTRY_SIZE];
+    for (size_t i = 0; i < count; ++i) {
+        const addr_t entry = (addr_t) (OAM_START + selected[i] * OAM_ENTRY_SIZE);
+        for (addr_t b = 0; b < OAM_ENTRY_SIZE; ++b) {
+            M_REQUIRE_NO_ERR(bus_read(*(lcd -> cpu -> bus), (addr_t) (entry + b), &(entries[i][b])));
+        }
+    }
+
+    // smaller x first, then OAM order (insertion sort is stable)
+    for (size_t i = 0; i < count; ++i) {
+        const data_t* const entry = entries[i];
+        const data_t attributes = entry[3];
+        const size_t y = ly + OAM_Y_OFFSET - entry[0];
+        const size_t row = (attributes & OAM_FLIP_Y_MASK) ? height - 1 - y : y;
+        const data_t tile_nb = height > TILE_PIXELS ? (data_t) ((entry[2] & 0xFE) + row / TILE_PIXELS) : entry[2];
+
+        const uint8_t* const pixels = tile_cache_get_row(&(lcd -> gameboy -> tiles), tile_cache_index(tile_nb, 1),
+                                                         row % TILE_PIXELS,
+                                                         (attributes & OAM_FLIP_X_MASK) != 0, 0);
+        M_REQUIRE_NON_NULL(pixels);
+
+        compose_sprite_t sprite = {
+            .lsb = 0, .msb = 0,
+            .x = (int64_t) entry[1] - OAM_X_OFFSET,
+            .palette = (attributes & OAM_PALETTE_MASK) ? obp1 : obp0,
+            .behind_bg = (attributes & OAM_BEHIND_BG_MASK) != 0
+        };
+        for (size_t k = 0; k < TILE_PIXELS; ++k) {
+            sprite.lsb |= (uint8_t) ((pixels[k] & 1) << k);
+            sprite.msb |= (uint8_t) ((pixels[k] >> 1) << k);
+        }
+
+        size_t j = i;
+        for (; j > 0 && sprites[j - 1].x > sprite.x; --j) {
+            sprites[j] = sprites[j - 1];
+        }
+        sprites[j] = sprite;
+    }
+
+    *nb_sprites = count;
+    return ERR_NONE;
+}
+
+// ======================================================================
+/**
+ * @brief composes a visible line into the display
+ */
+static int lcdc_compose_line(lcdc_t* lcd, size_t ly, bit_t window_shown, data_t window_y)
+{
+    data_t lcdc = 0, scy = 0, scx = 0, wx = 0, bgp = 0;
+    READ_REG(LCDC, &lcdc);
+    READ_REG(SCY, &scy);
+    READ_REG(SCX, &scx);
+    READ_REG(WX, &wx);
+    READ_REG(BGP, &bgp);
+
+    // gives back the lines of the previous line, even if it failed
+    image_scratch_release(&(lcd -> scratch));
+
+    compose_sprite_t sprites[COMPOSE_MAX_SPRITES];
+    compose_line_t line = {
+        .background = NULL, .scroll_x = scx,
+        .window = NULL, .window_x = (int64_t) wx - WINDOW_OFFSET_X,
+        .bg_palette = bgp, .sprites = sprites, .nb_sprites = 0
+    };
+    const bit_t tile_source = (lcdc & LCDC_REG_TILE_SOURCE_MASK) != 0;
+
+    image_line_t background;
+    image_line_t window;
+    if (lcdc & LCDC_REG_BG_MASK) {
+        M_REQUIRE_NO_ERR(image_scratch_take(&(lcd -> scratch), &background, MAP_LINE_PIXELS));
+        M_REQUIRE_NO_ERR(lcdc_map_line(lcd, &background,
+                                       (lcdc & LCDC_REG_BG_AREA_MASK) ? TILE_ADDR_BASE_HIGH : TILE_ADDR_BASE_LOW,
+                                       (scy + ly) % MAP_LINE_PIXELS, tile_source));
+        line.background = &background;
+
+        if (window_shown) {
+            M_REQUIRE_NO_ERR(image_scratch_take(&(lcd -> scratch), &window, MAP_LINE_PIXELS));
+            M_REQUIRE_NO_ERR(lcdc_map_line(lcd, &window,
+                                           (lcdc & LCDC_REG_WIN_AREA_MASK) ? TILE_ADDR_BASE_HIGH : TILE_ADDR_BASE_LOW,
+                                           window_y, tile_source));
+            line.window = &window;
+        }
+    }
+
+    if (lcdc & LCDC_REG_OBJ_MASK) {
+        M_REQUIRE_NO_ERR(lcdc_line_sprites(lcd, ly, lcdc, sprites, &(line.nb_sprites)));
+    }
+
+    return compose_line(&(lcd -> display.content[ly]), &line);
+}
+
+// ======================================================================
+/**
+ * @brief draws a visible line into the display, if the render policy
+ *        renders the current frame and the line changed since then
+ */
+static int lcdc_draw_line(lcdc_t* lcd, size_t ly)
+{
+    data_t lcdc = 0, wy = 0, wx = 0;
+    READ_REG(LCDC, &lcdc);
+    READ_REG(WY, &wy);
+    READ_REG(WX, &wx);
+
+    // the window line counter runs whether the line is drawn or not
+    const bit_t window_shown = (lcdc & LCDC_REG_BG_MASK) && (lcdc & LCDC_REG_WIN_MASK)
+                               && ly >= wy && wx < LCD_WIDTH + WINDOW_OFFSET_X;
+    const data_t window_y = lcd -> window_y;
+    if (window_shown) {
+        ++(lcd -> window_y);
+    }
+
+    // a skipped frame keeps its timing, LY, STAT and interrupts, but no pixel is generated
+    if (!render_policy_is_rendering(&(lcd -> gameboy -> render))) {
+        return ERR_NONE;
+    }
+
+    // a line with the same inputs as the last time it was drawn keeps its pixels
+    uint64_t fingerprint = 0;
+    M_REQUIRE_NO_ERR(scanline_fingerprint(*(lcd -> cpu -> bus), ly, window_y, &fingerprint));
+    if (!scanline_tracker_update(&(lcd -> gameboy -> lines), ly, fingerprint)) {
+        return ERR_NONE;
+    }
+
+    const int err = lcdc_compose_line(lcd, ly, window_shown, window_y);
+    if (err != ERR_NONE) {
+        // the line does not match its fingerprint: draw it again next time
+        scanline_tracker_invalidate_all(&(lcd -> gameboy -> lines));
+    }
+    return err;
+}
+
+// ======================================================================
+/**
+ * @brief switches the LCD on, at line 0
+ */
+static void lcdc_switch_on(lcdc_t* lcd, uint64_t cycle)
+{
+    lcd -> on = 1;
+    lcd -> on_cycle = cycle;
+    lcd -> next_cycle = cycle;
+    lcd -> window_y = 0;
+}
+
+// ======================================================================
+/**
+ * @brief switches the LCD off: LY is 0 and the display blank
+ */
+static int lcdc_switch_off(lcdc_t* lcd)
+{
+    lcd -> on = 0;
+    WRITE_REG(LY, 0);
+    M_REQUIRE_NO_ERR(lcdc_update_stat(lcd, MODE_HBLANK));
+
+    for (size_t y = 0; y < LCD_HEIGHT; ++y) {
+        for (size_t w = 0; w < BIT_VECTOR_CHUNKS(LCD_WIDTH); ++w) {
+            M_REQUIRE_NO_ERR(image_line_set_word(&(lcd -> display.content[y]), w, 0, 0));
+        }
+    }
+    scanline_tracker_invalidate_all(&(lcd -> gameboy -> lines));
+    return ERR_NONE;
+}
+
+// ======================================================================
+int lcdc_init(gameboy_t* gb)
+{
+    M_REQUIRE_NON_NULL(gb);
+    lcdc_t* const lcd = &(gb -> screen);
+
+    memset(lcd, 0, sizeof(lcdc_t));
+    lcd -> cpu = &(gb -> cpu);
+    lcd -> gameboy = gb;
+
+    M_REQUIRE_NO_ERR(image_create(&(lcd -> display), LCD_WIDTH, LCD_HEIGHT));
+    const int err = image_scratch_create(&(lcd -> scratch), MAP_LINE_PIXELS);
+    if (err != ERR_NONE) {
+        image_free(&(lcd -> display));
+    }
+    return err;
+}
+
+// ======================================================================
+void lcdc_free(lcdc_t* lcd)
+{
+    if (lcd != NULL) {
+        image_free(&(lcd -> display));
+        image_scratch_free(&(lcd -> scratch));
+        lcd -> cpu = NULL;
+        lcd -> gameboy = NULL;
+    }
+}
+
+// ======================================================================
+int lcdc_plug(lcdc_t* lcd, bus_t bus)
+{
+    M_REQUIRE_NON_NULL(lcd);
+    M_REQUIRE_NON_NULL(bus);
+    // the LCD registers are part of the registers component: only checks they are there
+    for (addr_t addr = REG_LCDC; addr <= REG_WX; ++addr) {
+        M_REQUIRE(bus[addr] != NULL, ERR_BAD_PARAMETER, "LCD register 0x%04X not plugged", addr);
+    }
+    return ERR_NONE;
+}
+
+// ======================================================================
+int lcdc_cycle(lcdc_t* lcd, uint64_t cycle)
+{
+    M_REQUIRE_NON_NULL(lcd);
+
+    data_t lcdc = 0;
+    READ_REG(LCDC, &lcdc);
+    const bit_t on = (lcdc & LCDC_REG_LCD_STATUS_MASK) != 0;
+    if (on && !lcd -> on) {
+        lcdc_switch_on(lcd, cycle);
+    } else if (!on && lcd -> on) {
+        M_REQUIRE_NO_ERR(lcdc_switch_off(lcd));
+    }
+
+    if (!lcd -> on || cycle < lcd -> next_cycle) {
+        return ERR_NONE;
+    }
+
+    const uint64_t pos = (lcd -> next_cycle - lcd -> on_cycle) % FRAME_TOTAL_CYCLES;
+    const data_t ly = (data_t) (pos / LINE_TOTAL_CYCLES);
+    const uint64_t x = pos % LINE_TOTAL_CYCLES;
+
+    if (ly >= LCD_HEIGHT) {
+        M_REQUIRE_NO_ERR(lcdc_set_ly(lcd, ly, MODE_VBLANK));
+        if (ly == LCD_HEIGHT) {
+            M_REQUIRE_NO_ERR(lcdc_enter_mode(lcd, MODE_VBLANK));
+            cpu_request_interrupt(lcd -> cpu, VBLANK);
+        }
+        lcd -> next_cycle += LINE_TOTAL_CYCLES;
+    } else if (x == LINE_MODE_2_START_CYCLE) {
+        if (ly == 0) {
+            lcd -> window_y = 0;
+        }
+        M_REQUIRE_NO_ERR(lcdc_set_ly(lcd, ly, MODE_OAM));
+        M_REQUIRE_NO_ERR(lcdc_enter_mode(lcd, MODE_OAM));
+        lcd -> next_cycle += LINE_MODE_2_CYCLES;
+    } else if (x == LINE_MODE_3_START_CYCLE) {
+        M_REQUIRE_NO_ERR(lcdc_enter_mode(lcd, MODE_DRAW));
+        lcd -> next_cycle += LINE_MODE_3_CYCLES;
+    } else {
+        M_REQUIRE_NO_ERR(lcdc_draw_line(lcd, ly));
+        M_REQUIRE_NO_ERR(lcdc_enter_mode(lcd, MODE_HBLANK));
+        lcd -> next_cycle += LINE_MODE_0_CYCLES;
+    }
+
+    return ERR_NONE;
+}
+
+// ======================================================================
+int lcdc_bus_listener(lcdc_t* lcd, addr_t addr)
+{
+    M_REQUIRE_NON_NULL(lcd);
+
+    data_t ly = 0, mode = 0;
+    switch (addr) {
+    case REG_LY:
+        // read-only: the LCD gives its value back
+        lcdc_position(lcd, &ly, &mode);
+        WRITE_REG(LY, ly);
+        M_REQUIRE_NO_ERR(lcdc_update_stat(lcd, mode));
+        break;
+
+    case REG_STAT:
+    case REG_LYC:
+        lcdc_position(lcd, &ly, &mode);
+        M_REQUIRE_NO_ERR(lcdc_update_stat(lcd, mode));
+        break;
+
+    case REG_DMA: {
+        // the whole OAM at once
+        data_t source = 0;
+        READ_REG(DMA, &source);
+        lcd -> DMA_from = (addr_t) (source << 8);
+        lcd -> DMA_to = GRAPH_RAM_START;
+        for (addr_t i = 0; i < OAM_SIZE; ++i) {
+            data_t byte = 0;
+            M_REQUIRE_NO_ERR(bus_read(*(lcd -> cpu -> bus), (addr_t) (lcd -> DMA_from + i), &byte));
+            M_REQUIRE_NO_ERR(bus_write(*(lcd -> cpu -> bus), (addr_t) (lcd -> DMA_to + i), byte));
+        }
+    }
+    break;
+
+    default:
+        break;
+    }
+
+    return ERR_NONE;
+}
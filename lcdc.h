@@ -107,6 +107,8 @@ typedef struct {
     addr_t   DMA_to;
     image_t  display;
     data_t   window_y;
+    gameboy_t* gameboy;      // tile cache and sprites the lines are drawn from
+    image_scratch_t scratch; // background and window lines being drawn
 } lcdc_t;
 
 
@@ -136,7 +138,9 @@ int lcdc_plug(lcdc_t* lcd, bus_t bus);
 
 
 /**
- * @brief Run one LCD controler cycle
+ * @brief Run one LCD controler cycle: switches the LCD on or off as LCDC
+ *        asks, updates LY and the STAT mode, requests the VBLANK and STAT
+ *        interrupts, and draws each visible line at the end of its mode 3
  *
  * @param lcd LCD controler to cycle
  * @param cycle the current cycle number
@@ -146,7 +150,8 @@ int lcdc_cycle(lcdc_t* lcd, uint64_t cycle);
 
 
 /**
- * @brief LCD controler bus listening handler
+ * @brief LCD controler bus listening handler: keeps the read-only bits of
+ *        STAT and LY, updates the LY=LYC flag and runs OAM DMA transfers
  *
  * @param lcd LCD controler
  * @param address trigger address
@@ -0,0 +1,522 @@
+/**
+ * @file movie.c
+ * @brief Recording and replay of the joypad input of a gameboy (movie files)
+ *
+ * Files are written and read through stdio buffers, one event at a time:
+ * a replay only reads ahead the next event, and skips the keyframes,
+ * which only seeking reads, through the index.
+ *
+ * @date 2020
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+
+#include "movie.h"
+#include "savestate.h"
+#include "error.h"
+
+#define MOVIE_MAGIC "GBMV"
+#define INDEX_MAGIC "GBMX"
+#define MAGIC_SIZE 4
+#define HEADER_SIZE (MAGIC_SIZE + 2 + 2 + 4 + 8)
+#define INDEX_ENTRY_SIZE (3 * 8)
+#define INDEX_TRAILER_SIZE (4 + MAGIC_SIZE)
+
+#define CODE_BITS 5
+#define CODE_MASK ((1u << CODE_BITS) - 1)
+#define PRESSED_BIT 0x08
+#define KEY_MASK 0x07
+
+#define INITIAL_MAX_KEYFRAMES 16
+
+// ======================================================================
+static void put_le(uint8_t* p, uint64_t v, size_t n)
+{
+    for (size_t i = 0; i < n; ++i) {
+        p[i] = (uint8_t) (v >> (8 * i));
+    }
+}
+
+// ----------------------------------------------------------------------
+static uint64_t get_le(const uint8_t* p, size_t n)
+{
+    uint64_t v = 0;
+    for (size_t i = n; i-- > 0; ) {
+        v = (v << 8) | p[i];
+    }
+    return v;
+}
+
+// ----------------------------------------------------------------------
+/**
+ * @brief FNV-1a hash of the cartridge ROM: a movie only replays on its cartridge
+ */
+static uint32_t rom_hash(const gameboy_t* gameboy)
+{
+    const memory_t* const mem = gameboy -> cartridge.c.mem;
+    uint32_t hash = 2166136261u;
+    if (mem != NULL && mem -> memory != NULL) {
+        for (size_t i = 0; i < mem -> size; ++i) {
+            hash = (hash ^ mem -> memory[i]) * 16777619u;
+        }
+    }
+    return hash;
+}
+
+// ----------------------------------------------------------------------
+static void release(movie_t* movie)
+{
+    if (movie -> file != NULL) fclose(movie -> file);
+    free(movie -> keyframes);
+    free(movie -> state);
+    movie -> file = NULL;
+    movie -> keyframes = NULL;
+    movie -> state = NULL;
+    movie -> nb_keyframes = movie -> max_keyframes = 0;
+}
+
+// ======================================================================
+static int write_event(movie_t* movie, uint64_t cycle, uint8_t code)
+{
+    M_REQUIRE(cycle >= movie -> last_cycle, ERR_BAD_PARAMETER,
+              "event at cycle %" PRIu64 " before the previous one (%" PRIu64 ")",
+              cycle, movie -> last_cycle);
+    uint64_t v = ((cycle - movie -> last_cycle) << CODE_BITS) | code;
+    uint8_t bytes[10];
+    size_t n = 0;
+    while (v >= 0x80) {
+        bytes[n++] = (uint8_t) (v | 0x80);
+        v >>= 7;
+    }
+    bytes[n++] = (uint8_t) v;
+    M_REQUIRE(fwrite(bytes, 1, n, movie -> file) == n, ERR_IO, "cannot write movie event %" PRIu64,
+              movie -> events);
+    movie -> last_cycle = cycle;
+    return ERR_NONE;
+}
+
+// ----------------------------------------------------------------------
+/**
+ * @brief writes a keyframe of the gameboy at its current cycle, and indexes it
+ */
+static int write_keyframe(movie_t* movie, const gameboy_t* gameboy)
+{
+    if (movie -> nb_keyframes == movie -> max_keyframes) {
+        const size_t max = movie -> max_keyframes == 0 ? INITIAL_MAX_KEYFRAMES : 2 * movie -> max_keyframes;
+        movie_keyframe_t* const keyframes = realloc(movie -> keyframes, max * sizeof(movie_keyframe_t));
+        M_REQUIRE_NON_NULL_CUSTOM_ERR(keyframes, ERR_MEM);
+        movie -> keyframes = keyframes;
+        movie -> max_keyframes = max;
+    }
+
+    size_t size = 0;
+    int err = gameboy_save_state(gameboy, movie -> state, movie -> state_size, &size);
+    M_REQUIRE_NO_ERR(err);
+    err = write_event(movie, gameboy -> cycles, MOVIE_STATE_CODE);
+    M_REQUIRE_NO_ERR(err);
+
+    const long offset = ftell(movie -> file);
+    uint8_t bytes[4];
+    put_le(bytes, size, sizeof(bytes));
+    M_REQUIRE(offset >= 0 && fwrite(bytes, sizeof(bytes), 1, movie -> file) == 1 &&
+              fwrite(movie -> state, size, 1, movie -> file) == 1,
+              ERR_IO, "cannot write movie keyframe at cycle %" PRIu64, gameboy -> cycles);
+
+    movie_keyframe_t* const k = movie -> keyframes + movie -> nb_keyframes;
+    k -> cycle = gameboy -> cycles;
+    k -> offset = (uint64_t) offset;
+    k -> events = movie -> events;
+    ++(movie -> nb_keyframes);
+    return ERR_NONE;
+}
+
+// ----------------------------------------------------------------------
+static int write_index(movie_t* movie)
+{
+    uint8_t bytes[INDEX_ENTRY_SIZE];
+    for (size_t i = 0; i < movie -> nb_keyframes; ++i) {
+        const movie_keyframe_t* const k = movie -> keyframes + i;
+        put_le(bytes, k -> cycle, 8);
+        put_le(bytes + 8, k -> offset, 8);
+        put_le(bytes + 16, k -> events, 8);
+        M_REQUIRE(fwrite(bytes, sizeof(bytes), 1, movie -> file) == 1, ERR_IO,
+                  "cannot write movie keyframe index (%zu)", i);
+    }
+    put_le(bytes, movie -> nb_keyframes, 4);
+    memcpy(bytes + 4, INDEX_MAGIC, MAGIC_SIZE);
+    M_REQUIRE(fwrite(bytes, INDEX_TRAILER_SIZE, 1, movie -> file) == 1, ERR_IO,
+              "cannot write movie keyframe index (%zu keyframes)", movie -> nb_keyframes);
+    return ERR_NONE;
+}
+
+// ======================================================================
+/**
+ * @brief reads the next event ahead, skipping keyframes
+ */
+static int read_event(movie_t* movie)
+{
+    do {
+        uint64_t v = 0;
+        for (unsigned int shift = 0; ; shift += 7) {
+            const int byte = getc(movie -> file);
+            M_REQUIRE(byte != EOF && shift < 64, ERR_BAD_PARAMETER,
+                      "truncated movie after %" PRIu64 " key changes", movie -> events);
+            v |= (uint64_t) (byte & 0x7F) << shift;
+            if (!(byte & 0x80)) break;
+        }
+        movie -> next_code = (uint8_t) (v & CODE_MASK);
+        movie -> next_cycle = movie -> last_cycle + (v >> CODE_BITS);
+        M_REQUIRE(movie -> next_code <= MOVIE_STATE_CODE, ERR_BAD_PARAMETER,
+                  "invalid movie event code %u", movie -> next_code);
+        movie -> last_cycle = movie -> next_cycle;
+
+        if (movie -> next_code == MOVIE_STATE_CODE) {
+            uint8_t bytes[4];
+            M_REQUIRE(fread(bytes, sizeof(bytes), 1, movie -> file) == 1 &&
+                      fseek(movie -> file, (long) get_le(bytes, sizeof(bytes)), SEEK_CUR) == 0,
+                      ERR_BAD_PARAMETER, "truncated movie keyframe at cycle %" PRIu64, movie -> next_cycle);
+        }
+    } while (movie -> next_code == MOVIE_STATE_CODE);
+
+    movie -> ended = movie -> next_code == MOVIE_END_CODE;
+    return ERR_NONE;
+}
+
+// ----------------------------------------------------------------------
+/**
+ * @brief reads the keyframe index at the end of the file
+ */
+static int read_index(movie_t* movie)
+{
+    FILE* const file = movie -> file;
+    const long here = ftell(file);
+    uint8_t bytes[INDEX_ENTRY_SIZE];
+    M_REQUIRE(here >= 0 && fseek(file, 0, SEEK_END) == 0, ERR_IO, "cannot seek in movie (%ld)", here);
+    const long size = ftell(file);
+    M_REQUIRE(size >= HEADER_SIZE + INDEX_TRAILER_SIZE &&
+              fseek(file, -(long) INDEX_TRAILER_SIZE, SEEK_END) == 0 &&
+              fread(bytes, INDEX_TRAILER_SIZE, 1, file) == 1 &&
+              memcmp(bytes + 4, INDEX_MAGIC, MAGIC_SIZE) == 0,
+              ERR_BAD_PARAMETER, "no keyframe index in movie of %ld bytes", size);
+
+    const size_t nb = (size_t) get_le(bytes, 4);
+    M_REQUIRE(nb > 0 && nb <= (size_t) (size - HEADER_SIZE - INDEX_TRAILER_SIZE) / INDEX_ENTRY_SIZE,
+              ERR_BAD_PARAMETER, "invalid keyframe index of %zu keyframes", nb);
+    movie -> keyframes = calloc(nb, sizeof(movie_keyframe_t));
+    M_REQUIRE_NON_NULL_CUSTOM_ERR(movie -> keyframes, ERR_MEM);
+    movie -> max_keyframes = nb;
+
+    M_REQUIRE(fseek(file, -(long) (INDEX_TRAILER_SIZE + nb * INDEX_ENTRY_SIZE), SEEK_END) == 0,
+              ERR_IO, "cannot seek in movie (%ld)", size);
+    for (size_t i = 0; i < nb; ++i) {
+        movie_keyframe_t* const k = movie -> keyframes + i;
+        M_REQUIRE(fread(bytes, sizeof(bytes), 1, file) == 1, ERR_IO, "cannot read keyframe %zu", i);
+        k -> cycle = get_le(bytes, 8);
+        k -> offset = get_le(bytes + 8, 8);
+        k -> events = get_le(bytes + 16, 8);
+        M_REQUIRE(k -> offset < (uint64_t) size && (i == 0 || k -> cycle >= k[-1].cycle),
+                  ERR_BAD_PARAMETER, "invalid keyframe %zu", i);
+    }
+    movie -> nb_keyframes = nb;
+
+    M_REQUIRE(fseek(file, here, SEEK_SET) == 0, ERR_IO, "cannot seek in movie (%ld)", here);
+    return ERR_NONE;
+}
+
+// ======================================================================
+int movie_record_open(movie_t* movie, const char* filename, const gameboy_t* gameboy,
+                      uint64_t keyframe_every)
+{
+    M_REQUIRE_NON_NULL(movie);
+    M_REQUIRE_NON_NULL(filename);
+    M_REQUIRE_NON_NULL(gameboy);
+
+    memset(movie, 0, sizeof(*movie));
+    if (keyframe_every > 0) {
+        movie -> state_size = gameboy_state_size(gameboy);
+        M_REQUIRE(movie -> state_size > 0, ERR_BAD_PARAMETER, "gameboy %p cannot be saved",
+                  (const void*) gameboy);
+        movie -> state = malloc(movie -> state_size);
+        M_REQUIRE_NON_NULL_CUSTOM_ERR(movie -> state, ERR_MEM);
+    }
+    movie -> file = fopen(filename, "wb");
+    if (movie -> file == NULL) {
+        release(movie);
+        M_EXIT_ERR(ERR_IO, "cannot open movie file \"%s\" for writing", filename);
+    }
+    movie -> recording = 1;
+    movie -> last_cycle = gameboy -> cycles;
+    movie -> keyframe_every = keyframe_every;
+
+    uint8_t header[HEADER_SIZE];
+    memcpy(header, MOVIE_MAGIC, MAGIC_SIZE);
+    put_le(header + MAGIC_SIZE, GB_MOVIE_VERSION, 2);
+    put_le(header + MAGIC_SIZE + 2, (keyframe_every > 0 ? MOVIE_FLAG_KEYFRAMES : 0)
+           | (gameboy -> boot ? 0 : MOVIE_FLAG_BOOTED), 2);
+    put_le(header + MAGIC_SIZE + 4, rom_hash(gameboy), 4);
+    put_le(header + MAGIC_SIZE + 8, gameboy -> cycles, 8);
+    if (fwrite(header, sizeof(header), 1, movie -> file) != 1) {
+        release(movie);
+        M_EXIT_ERR(ERR_IO, "cannot write movie file \"%s\"", filename);
+    }
+
+    // seeking anywhere needs a keyframe at the start
+    if (keyframe_every > 0) {
+        const int err = write_keyframe(movie, gameboy);
+        if (err != ERR_NONE) {
+            release(movie);
+            return err;
+        }
+        movie -> next_keyframe = gameboy -> cycles + keyframe_every;
+    }
+    return ERR_NONE;
+}
+
+// ======================================================================
+int movie_record_key(movie_t* movie, gameboy_t* gameboy, gb_key_t key, bit_t pressed)
+{
+    M_REQUIRE_NON_NULL(movie);
+    M_REQUIRE_NON_NULL(movie -> file);
+    M_REQUIRE_NON_NULL(gameboy);
+    M_REQUIRE(movie -> recording, ERR_BAD_PARAMETER, "movie of %" PRIu64 " key changes is replayed",
+              movie -> events);
+    M_REQUIRE(key >= 0 && key < NB_GB_KEYS, ERR_BAD_PARAMETER, "invalid key %d", (int) key);
+
+    M_REQUIRE_NO_ERR(write_event(movie, gameboy -> cycles, (uint8_t) ((pressed ? PRESSED_BIT : 0) | key)));
+    ++(movie -> events);
+    return pressed ? joypad_key_pressed(&(gameboy -> pad), key)
+                   : joypad_key_released(&(gameboy -> pad), key);
+}
+
+// ======================================================================
+int movie_record_run_until(movie_t* movie, gameboy_t* gameboy, uint64_t cycle)
+{
+    M_REQUIRE_NON_NULL(movie);
+    M_REQUIRE_NON_NULL(movie -> file);
+    M_REQUIRE_NON_NULL(gameboy);
+    M_REQUIRE(movie -> recording, ERR_BAD_PARAMETER, "movie of %" PRIu64 " key changes is replayed",
+              movie -> events);
+    M_REQUIRE(cycle > gameboy -> cycles, ERR_BAD_PARAMETER, "cycle %" PRIu64 " already run (%" PRIu64 ")",
+              cycle, gameboy -> cycles);
+
+    int err = ERR_NONE;
+    while (err == ERR_NONE && movie -> keyframe_every > 0 && movie -> next_keyframe <= cycle) {
+        if (movie -> next_keyframe > gameboy -> cycles) {
+            err = gameboy_run_until(gameboy, movie -> next_keyframe);
+        }
+        if (err == ERR_NONE) {
+            err = write_keyframe(movie, gameboy);
+        }
+        movie -> next_keyframe = gameboy -> cycles + movie -> keyframe_every;
+    }
+    return err == ERR_NONE && gameboy -> cycles < cycle ? gameboy_run_until(gameboy, cycle) : err;
+}
+
+// ======================================================================
+int movie_replay_open(movie_t* movie, const char* filename, const gameboy_t* gameboy)
+{
+    M_REQUIRE_NON_NULL(movie);
+    M_REQUIRE_NON_NULL(filename);
+    M_REQUIRE_NON_NULL(gameboy);
+
+    memset(movie, 0, sizeof(*movie));
+    FILE* const file = fopen(filename, "rb");
+    M_EXIT_IF(file == NULL, ERR_IO, "cannot open movie file \"%s\"", filename);
+
+    uint8_t header[HEADER_SIZE];
+    int err = ERR_NONE;
+    if (fread(header, sizeof(header), 1, file) != 1 || memcmp(header, MOVIE_MAGIC, MAGIC_SIZE) != 0) {
+        debug_print("\"%s\" is not a movie file", filename);
+        err = ERR_BAD_PARAMETER;
+    } else if (get_le(header + MAGIC_SIZE, 2) == 0 || get_le(header + MAGIC_SIZE, 2) > GB_MOVIE_VERSION) {
+        debug_print("movie version %" PRIu64 " not supported", get_le(header + MAGIC_SIZE, 2));
+        err = ERR_BAD_PARAMETER;
+    } else if (get_le(header + MAGIC_SIZE + 4, 4) != rom_hash(gameboy)) {
+        debug_print("movie \"%s\" recorded on another cartridge", filename);
+        err = ERR_BAD_PARAMETER;
+    } else if (get_le(header + MAGIC_SIZE + 8, 8) != gameboy -> cycles) {
+        debug_print("movie starts at cycle %" PRIu64 ", gameboy at %" PRIu64,
+                    get_le(header + MAGIC_SIZE + 8, 8), gameboy -> cycles);
+        err = ERR_BAD_PARAMETER;
+    } else if (((get_le(header + MAGIC_SIZE + 2, 2) & MOVIE_FLAG_BOOTED) != 0) == gameboy -> boot) {
+        // the same cycle, but one of them skipped the boot ROM
+        debug_print("movie \"%s\" recorded with the boot ROM %s", filename,
+                    gameboy -> boot ? "skipped" : "running");
+        err = ERR_BAD_PARAMETER;
+    }
+    if (err != ERR_NONE) {
+        fclose(file);
+        return err;
+    }
+
+    movie -> file = file;
+    movie -> last_cycle = gameboy -> cycles;
+    if (get_le(header + MAGIC_SIZE + 2, 2) & MOVIE_FLAG_KEYFRAMES) {
+        movie -> state_size = gameboy_state_size(gameboy);
+        movie -> state = malloc(movie -> state_size);
+        err = movie -> state == NULL ? ERR_MEM : read_index(movie);
+        if (err == ERR_BAD_PARAMETER) {
+            // a movie whose recording was cut still replays from the start
+            debug_print("movie \"%s\" replayed without its keyframes", filename);
+            free(movie -> keyframes);
+            movie -> keyframes = NULL;
+            movie -> nb_keyframes = movie -> max_keyframes = 0;
+            err = fseek(file, HEADER_SIZE, SEEK_SET) == 0 ? ERR_NONE : ERR_IO;
+        }
+    }
+    if (err == ERR_NONE) {
+        err = read_event(movie);
+    }
+    if (err != ERR_NONE) {
+        release(movie);
+    }
+    return err;
+}
+
+// ----------------------------------------------------------------------
+/**
+ * @brief runs the gameboy to the next event of the movie and applies it
+ */
+static int apply_next_event(movie_t* movie, gameboy_t* gameboy)
+{
+    M_REQUIRE(movie -> next_cycle >= gameboy -> cycles, ERR_BAD_PARAMETER,
+              "movie event at cycle %" PRIu64 ", gameboy already at %" PRIu64,
+              movie -> next_cycle, gameboy -> cycles);
+    if (movie -> next_cycle > gameboy -> cycles) {
+        const int err = gameboy_run_until(gameboy, movie -> next_cycle);
+        M_REQUIRE_NO_ERR(err);
+    }
+    const gb_key_t key = (gb_key_t) (movie -> next_code & KEY_MASK);
+    const int err = movie -> next_code & PRESSED_BIT ? joypad_key_pressed(&(gameboy -> pad), key)
+                                                     : joypad_key_released(&(gameboy -> pad), key);
+    M_REQUIRE_NO_ERR(err);
+    ++(movie -> events);
+    return read_event(movie);
+}
+
+// ----------------------------------------------------------------------
+/**
+ * @brief applies the key changes up to the given cycle (included), then runs
+ *        the gameboy until it; after its end, the movie leaves the keys as they are
+ */
+static int replay_until(movie_t* movie, gameboy_t* gameboy, uint64_t cycle)
+{
+    while (!movie -> ended && movie -> next_cycle <= cycle) {
+        const int err = apply_next_event(movie, gameboy);
+        M_REQUIRE_NO_ERR(err);
+    }
+    return gameboy -> cycles < cycle ? gameboy_run_until(gameboy, cycle) : ERR_NONE;
+}
+
+// ----------------------------------------------------------------------
+/**
+ * @brief loads keyframe k and reads on from it
+ */
+static int load_keyframe(movie_t* movie, gameboy_t* gameboy, size_t k)
+{
+    const movie_keyframe_t* const keyframe = movie -> keyframes + k;
+    uint8_t bytes[4];
+    M_REQUIRE(fseek(movie -> file, (long) keyframe -> offset, SEEK_SET) == 0 &&
+              fread(bytes, sizeof(bytes), 1, movie -> file) == 1,
+              ERR_IO, "cannot read keyframe at cycle %" PRIu64, keyframe -> cycle);
+    const size_t size = (size_t) get_le(bytes, sizeof(bytes));
+    M_REQUIRE(size <= movie -> state_size && fread(movie -> state, size, 1, movie -> file) == 1,
+              ERR_BAD_PARAMETER, "invalid keyframe of %zu bytes at cycle %" PRIu64, size, keyframe -> cycle);
+    int err = gameboy_load_state(gameboy, movie -> state, size);
+    M_REQUIRE_NO_ERR(err);
+    M_REQUIRE(gameboy -> cycles == keyframe -> cycle, ERR_BAD_PARAMETER,
+              "keyframe of cycle %" PRIu64 " indexed at %" PRIu64, gameboy -> cycles, keyframe -> cycle);
+
+    movie -> last_cycle = keyframe -> cycle;
+    movie -> events = keyframe -> events;
+    return read_event(movie);
+}
+
+// ======================================================================
+int movie_run_until(movie_t* movie, gameboy_t* gameboy, uint64_t cycle)
+{
+    M_REQUIRE_NON_NULL(movie);
+    M_REQUIRE_NON_NULL(movie -> file);
+    M_REQUIRE_NON_NULL(gameboy);
+    M_REQUIRE(!movie -> recording, ERR_BAD_PARAMETER, "movie of %" PRIu64 " key changes is recorded",
+              movie -> events);
+    M_REQUIRE(cycle > gameboy -> cycles, ERR_BAD_PARAMETER, "cycle %" PRIu64 " already run (%" PRIu64 ")",
+              cycle, gameboy -> cycles);
+
+    return replay_until(movie, gameboy, cycle);
+}
+
+// ======================================================================
+int movie_seek(movie_t* movie, gameboy_t* gameboy, uint64_t cycle)
+{
+    M_REQUIRE_NON_NULL(movie);
+    M_REQUIRE_NON_NULL(movie -> file);
+    M_REQUIRE_NON_NULL(gameboy);
+    M_REQUIRE(!movie -> recording, ERR_BAD_PARAMETER, "movie of %" PRIu64 " key changes is recorded",
+              movie -> events);
+
+    // number of keyframes up to the cycle
+    size_t low = 0;
+    size_t high = movie -> nb_keyframes;
+    while (low < high) {
+        const size_t middle = low + (high - low) / 2;
+        if (movie -> keyframes[middle].cycle <= cycle) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    if (low > 0 && (gameboy -> cycles > cycle || movie -> keyframes[low - 1].cycle > gameboy -> cycles)) {
+        const int err = load_keyframe(movie, gameboy, low - 1);
+        M_REQUIRE_NO_ERR(err);
+    }
+    M_REQUIRE(gameboy -> cycles <= cycle, ERR_BAD_PARAMETER,
+              "no keyframe to seek back to cycle %" PRIu64 " from %" PRIu64, cycle, gameboy -> cycles);
+
+    // as after movie_run_until(), the key changes at the cycle itself are applied
+    return replay_until(movie, gameboy, cycle);
+}
+
+// ======================================================================
+int movie_run_to_end(movie_t* movie, gameboy_t* gameboy)
+{
+    M_REQUIRE_NON_NULL(movie);
+    M_REQUIRE_NON_NULL(movie -> file);
+    M_REQUIRE_NON_NULL(gameboy);
+    M_REQUIRE(!movie -> recording, ERR_BAD_PARAMETER, "movie of %" PRIu64 " key changes is recorded",
+              movie -> events);
+
+    while (!movie -> ended) {
+        const int err = apply_next_event(movie, gameboy);
+        M_REQUIRE_NO_ERR(err);
+    }
+    M_REQUIRE(movie -> next_cycle >= gameboy -> cycles, ERR_BAD_PARAMETER,
+              "movie ends at cycle %" PRIu64 ", gameboy already at %" PRIu64,
+              movie -> next_cycle, gameboy -> cycles);
+    return gameboy -> cycles < movie -> next_cycle ? gameboy_run_until(gameboy, movie -> next_cycle)
+                                                   : ERR_NONE;
+}
+
+// ======================================================================
+int movie_close(movie_t* movie, const gameboy_t* gameboy)
+{
+    M_REQUIRE_NON_NULL(movie);
+    if (movie -> file == NULL) return ERR_NONE;
+
+    int err = ERR_NONE;
+    if (movie -> recording) {
+        err = gameboy == NULL ? ERR_BAD_PARAMETER : write_event(movie, gameboy -> cycles, MOVIE_END_CODE);
+        if (err == ERR_NONE && movie -> keyframe_every > 0) {
+            err = write_index(movie);
+        }
+    }
+    if (fclose(movie -> file) != 0 && err == ERR_NONE) {
+        err = ERR_IO;
+    }
+    movie -> file = NULL;
+    release(movie);
+    return err;
+}
@@ -0,0 +1,187 @@
+#pragma once
+
+/**
+ * @file movie.h
+ * @brief Recording and replay of the joypad input of a gameboy (movie files)
+ *
+ * A movie is every key change of a run, stamped with the gameboy cycle
+ * it happened at. Replaying it from the same cartridge, started at the
+ * same cycle, applies every change at that very cycle: the run is
+ * reproduced bit-exactly, at whatever speed.
+ *
+ * A movie may also embed a save state (see savestate.h) every so many
+ * cycles, the keyframes, with an index of them at the end of the file:
+ * seeking to a cycle then loads the keyframe before it and only runs
+ * the gameboy from there, at most the keyframe interval.
+ *
+ * File format, little endian, written and read as a stream:
+ *  - header: "GBMV", u16 version, u16 flags (MOVIE_FLAG_*), u32
+ *    hash of the cartridge ROM (FNV-1a), u64 start cycle;
+ *  - events: one LEB128 varint each, (delta << 5) | code, delta being the
+ *    number of cycles since the previous event (or the start); code is
+ *    (pressed << 3) | key for a key change, MOVIE_STATE_CODE for a
+ *    keyframe, followed by the u32 size of the save state and the save
+ *    state, MOVIE_END_CODE for the end of the movie, which is its last
+ *    event;
+ *  - with keyframes, their index: per keyframe, u64 cycle, u64 file
+ *    offset of its size, u64 number of key changes before it; then u32
+ *    number of keyframes and "GBMX".
+ *
+ * A key change takes 3 bytes up to 62 ms after the previous one, 4 bytes
+ * up to 8 s after it.
+ *
+ * @date 2020
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include "bit.h"
+#include "gameboy.h"
+#include "joypad.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define GB_MOVIE_VERSION 2
+
+#define MOVIE_FLAG_KEYFRAMES 0x0001
+#define MOVIE_FLAG_BOOTED    0x0002 // boot ROM no longer mapped at the start
+
+#define MOVIE_END_CODE   0x10
+#define MOVIE_STATE_CODE 0x11
+
+/**
+ * @brief Location of a keyframe in a movie file
+ */
+typedef struct {
+    uint64_t cycle;
+    uint64_t offset;  // of the size of the save state
+    uint64_t events;  // key changes before it
+} movie_keyframe_t;
+
+/**
+ * @brief Movie type, being either recorded or replayed
+ */
+typedef struct {
+    FILE* file;
+    bit_t recording;
+    uint64_t last_cycle;  // of the last event written or read
+    uint64_t events;      // key changes written or applied
+
+    // replay: the next event, read ahead
+    uint64_t next_cycle;
+    uint8_t next_code;
+    bit_t ended;          // the end event was read
+
+    // keyframes written or found in the index
+    movie_keyframe_t* keyframes;
+    size_t nb_keyframes;
+    size_t max_keyframes;
+    uint64_t keyframe_every;  // cycles, 0 if none are recorded
+    uint64_t next_keyframe;   // cycle of the next one recorded
+    uint8_t* state;           // a save state
+    size_t state_size;
+} movie_t;
+
+
+/**
+ * @brief Starts recording the input of a gameboy, from its current cycle
+ *
+ * @param movie movie to initialise
+ * @param filename file to write
+ * @param gameboy gameboy whose input is recorded
+ * @param keyframe_every a keyframe is recorded every that many cycles
+ *        by movie_record_run_until(), from the start (0 for none)
+ * @return error code
+ */
+int movie_record_open(movie_t* movie, const char* filename, const gameboy_t* gameboy,
+                      uint64_t keyframe_every);
+
+
+/**
+ * @brief Records a key change and applies it to the joypad of the gameboy,
+ *        at the current cycle of the gameboy
+ *
+ * @param movie movie being recorded
+ * @param gameboy gameboy whose input is recorded
+ * @param key key changed
+ * @param pressed whether the key is now pressed or released
+ * @return error code
+ */
+int movie_record_key(movie_t* movie, gameboy_t* gameboy, gb_key_t key, bit_t pressed);
+
+
+/**
+ * @brief Runs the recorded gameboy until the given cycle, recording the
+ *        keyframes due on the way
+ *
+ * @param movie movie being recorded
+ * @param gameboy gameboy whose input is recorded
+ * @param cycle cycle to run until (> the current one)
+ * @return error code
+ */
+int movie_record_run_until(movie_t* movie, gameboy_t* gameboy, uint64_t cycle);
+
+
+/**
+ * @brief Starts replaying a movie on a gameboy
+ *
+ * @param movie movie to initialise
+ * @param filename file to read
+ * @param gameboy gameboy to replay the movie on: same cartridge, and at the
+ *        start cycle of the movie (typically just created)
+ * @return error code
+ */
+int movie_replay_open(movie_t* movie, const char* filename, const gameboy_t* gameboy);
+
+
+/**
+ * @brief Runs the gameboy until the given cycle, applying the key changes
+ *        of the movie at their cycle
+ *
+ * @param movie movie being replayed
+ * @param gameboy gameboy to run
+ * @param cycle cycle to run until (> the current one)
+ * @return error code
+ */
+int movie_run_until(movie_t* movie, gameboy_t* gameboy, uint64_t cycle);
+
+
+/**
+ * @brief Puts the gameboy in the state of the replayed run at the given
+ *        cycle, before or after the current one: from the nearest keyframe
+ *        before it, unless running on from the current cycle is shorter
+ *        (seeking back needs keyframes)
+ *
+ * @param movie movie being replayed
+ * @param gameboy gameboy to seek
+ * @param cycle cycle to seek to (not before the start of the movie)
+ * @return error code
+ */
+int movie_seek(movie_t* movie, gameboy_t* gameboy, uint64_t cycle);
+
+
+/**
+ * @brief Runs the gameboy until the end of the movie
+ *
+ * @param movie movie being replayed
+ * @param gameboy gameboy to run
+ * @return error code
+ */
+int movie_run_to_end(movie_t* movie, gameboy_t* gameboy);
+
+
+/**
+ * @brief Closes a movie; a recorded movie ends at the current cycle of the gameboy
+ *
+ * @param movie movie to close
+ * @param gameboy gameboy recorded (ignored on replay)
+ * @return error code
+ */
+int movie_close(movie_t* movie, const gameboy_t* gameboy);
+
+#ifdef __cplusplus
+}
+#endif
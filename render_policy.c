@@ -0,0 +1,78 @@
+/**
+ * @file render_policy.c
+ * @brief Per-instance frame rendering policy (frame-skip and render-off modes)
+ *
+ * @date 2020
+ */
+
+#include <stdint.h>
+
+#include "render_policy.h"
+#include "error.h"
+
+// ======================================================================
+int render_policy_init(render_policy_t* policy, render_mode_t mode, uint32_t every)
+{
+    M_REQUIRE_NON_NULL(policy);
+    M_REQUIRE(mode >= RENDER_ALWAYS && mode < NB_RENDER_MODES, ERR_BAD_PARAMETER,
+              "Invalid render mode (%d)", mode);
+    M_REQUIRE(mode != RENDER_EVERY_NTH || every > 0, ERR_BAD_PARAMETER,
+              "%s", "Render period cannot be zero");
+
+    policy -> mode = mode;
+    policy -> every = mode == RENDER_EVERY_NTH ? every : 1;
+    policy -> requested = 0;
+    policy -> rendering = mode == RENDER_ALWAYS;
+    policy -> frames = 0;
+    policy -> rendered = 0;
+
+    return ERR_NONE;
+}
+
+// ======================================================================
+int render_policy_request(render_policy_t* policy)
+{
+    M_REQUIRE_NON_NULL(policy);
+    policy -> requested = policy -> mode != RENDER_NEVER;
+    return ERR_NONE;
+}
+
+// ======================================================================
+bit_t render_policy_frame_start(render_policy_t* policy)
+{
+    if (policy == NULL) {
+        return 1;
+    }
+
+    switch (policy -> mode) {
+    case RENDER_ALWAYS:
+        policy -> rendering = 1;
+        break;
+
+    case RENDER_EVERY_NTH:
+        policy -> rendering = policy -> requested || (policy -> frames % policy -> every == 0);
+        break;
+
+    case RENDER_ON_REQUEST:
+        policy -> rendering = policy -> requested;
+        break;
+
+    default:
+        policy -> rendering = 0;
+        break;
+    }
+
+    if (policy -> rendering) {
+        policy -> requested = 0;
+        ++(policy -> rendered);
+    }
+    ++(policy -> frames);
+
+    return policy -> rendering;
+}
+
+// ======================================================================
+bit_t render_policy_is_rendering(const render_policy_t* policy)
+{
+    return policy == NULL || policy -> rendering;
+}
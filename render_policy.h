@@ -0,0 +1,90 @@
+#pragma once
+
+/**
+ * @file render_policy.h
+ * @brief Per-instance frame rendering policy (frame-skip and render-off modes)
+ *
+ * The policy only decides whether the pixels of a frame are generated.
+ * On a skipped frame, the LCD controller still runs its modes, LY, STAT,
+ * interrupts and window line counter at the exact same cycles, but
+ * neither decodes tiles nor composes lines (see render_policy_is_rendering()),
+ * so the display keeps the last frame rendered. gameboy_run_until() starts
+ * a policy frame every FRAME_TOTAL_CYCLES cycles, and any such span draws
+ * each visible line once.
+ *
+ * @date 2020
+ */
+
+#include <stdint.h>
+
+#include "bit.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Rendering modes
+ */
+typedef enum {
+    RENDER_ALWAYS,     // every frame is rendered
+    RENDER_EVERY_NTH,  // one frame out of `every` is rendered
+    RENDER_ON_REQUEST, // only frames following a render_policy_request()
+    RENDER_NEVER,      // no frame is rendered (headless runs)
+    NB_RENDER_MODES
+} render_mode_t;
+
+/**
+ * @brief Rendering policy type
+ */
+typedef struct {
+    render_mode_t mode;
+    uint32_t every;     // period for RENDER_EVERY_NTH
+    bit_t requested;    // pending request for RENDER_ON_REQUEST
+    bit_t rendering;    // whether the current frame is being rendered
+    uint64_t frames;    // frames started
+    uint64_t rendered;  // frames rendered
+} render_policy_t;
+
+
+/**
+ * @brief Initiates a rendering policy
+ *
+ * @param policy policy to initiate
+ * @param mode rendering mode
+ * @param every period, used (and required to be non zero) for RENDER_EVERY_NTH only
+ * @return error code
+ */
+int render_policy_init(render_policy_t* policy, render_mode_t mode, uint32_t every);
+
+
+/**
+ * @brief Asks for the next frame to be rendered (whatever the mode but RENDER_NEVER)
+ *
+ * @param policy policy
+ * @return error code
+ */
+int render_policy_request(render_policy_t* policy);
+
+
+/**
+ * @brief Decides whether the frame which starts now is rendered.
+ *        To be called once at the start of every frame (LY = 0).
+ *
+ * @param policy policy
+ * @return whether the new frame is rendered
+ */
+bit_t render_policy_frame_start(render_policy_t* policy);
+
+
+/**
+ * @brief Tells whether the current frame is rendered
+ *
+ * @param policy policy
+ * @return 1 if pixels of the current frame have to be generated, 0 otherwise
+ */
+bit_t render_policy_is_rendering(const render_policy_t* policy);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,296 @@
+/**
+ * @file rewind.c
+ * @brief Rewind history of a gameboy: delta-compressed save states in a fixed-size ring
+ *
+ * Snapshots are encoded as (equal run, literal run, literal bytes)
+ * triples, lengths being LEB128 varints, the literal bytes being the XOR
+ * of the snapshot and its reference (the previous snapshot, or zeros for
+ * a keyframe). Equal runs are skipped a 64-bit word at a time.
+ *
+ * @date 2020
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "rewind.h"
+#include "savestate.h"
+#include "error.h"
+
+// a literal run goes on over shorter runs of equal bytes, cheaper kept in it
+#define MIN_EQUAL_RUN 3
+
+// ======================================================================
+static size_t put_varint(uint8_t* out, size_t v)
+{
+    size_t n = 0;
+    while (v >= 0x80) {
+        out[n++] = (uint8_t) (v | 0x80);
+        v >>= 7;
+    }
+    out[n++] = (uint8_t) v;
+    return n;
+}
+
+// ----------------------------------------------------------------------
+static size_t get_varint(const uint8_t* in, size_t* v)
+{
+    size_t n = 0;
+    *v = 0;
+    for (unsigned int shift = 0; ; shift += 7) {
+        const uint8_t byte = in[n++];
+        *v |= (size_t) (byte & 0x7F) << shift;
+        if (!(byte & 0x80)) return n;
+    }
+}
+
+// ----------------------------------------------------------------------
+static inline uint64_t load64(const uint8_t* p)
+{
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+// ----------------------------------------------------------------------
+/**
+ * @brief number of equal bytes of a and b from i on, up to limit
+ */
+static size_t equal_run(const uint8_t* a, const uint8_t* b, size_t i, size_t limit)
+{
+    size_t j = i;
+    while (j + sizeof(uint64_t) <= limit && load64(a + j) == load64(b + j)) {
+        j += sizeof(uint64_t);
+    }
+    while (j < limit && a[j] == b[j]) ++j;
+    return j - i;
+}
+
+// ======================================================================
+/**
+ * @brief encodes a XOR b; returns the number of bytes written to out
+ */
+static size_t xor_rle_encode(uint8_t* out, const uint8_t* a, const uint8_t* b, size_t size)
+{
+    uint8_t* p = out;
+    size_t i = 0;
+    while (i < size) {
+        const size_t equal = equal_run(a, b, i, size);
+        i += equal;
+
+        size_t end = i;
+        while (end < size) {
+            if (a[end] != b[end]) {
+                ++end;
+                continue;
+            }
+            const size_t limit = end + MIN_EQUAL_RUN < size ? end + MIN_EQUAL_RUN : size;
+            const size_t run = equal_run(a, b, end, limit);
+            if (run == MIN_EQUAL_RUN || end + run == size) break;
+            end += run;
+        }
+
+        p += put_varint(p, equal);
+        p += put_varint(p, end - i);
+        for (; i < end; ++i) {
+            *p++ = a[i] ^ b[i];
+        }
+    }
+    return (size_t) (p - out);
+}
+
+// ----------------------------------------------------------------------
+/**
+ * @brief XORs an encoded snapshot into state
+ */
+static int xor_rle_apply(uint8_t* state, size_t size, const uint8_t* in, size_t length)
+{
+    const uint8_t* p = in;
+    const uint8_t* const end = in + length;
+    size_t i = 0;
+    while (p < end) {
+        size_t equal = 0;
+        size_t literal = 0;
+        p += get_varint(p, &equal);
+        p += get_varint(p, &literal);
+        i += equal;
+        M_REQUIRE(i + literal <= size && literal <= (size_t) (end - p), ERR_BAD_PARAMETER,
+                  "corrupted snapshot (literal of %zu bytes at %zu)", literal, i);
+        for (size_t k = 0; k < literal; ++k) {
+            state[i + k] ^= p[k];
+        }
+        p += literal;
+        i += literal;
+    }
+    return ERR_NONE;
+}
+
+// ======================================================================
+static rewind_entry_t* entry(const rewind_t* rw, size_t k)
+{
+    return rw -> entries + (rw -> first + k) % rw -> max_entries;
+}
+
+// ----------------------------------------------------------------------
+/**
+ * @brief drops the oldest keyframe and the deltas depending on it
+ */
+static void drop_oldest(rewind_t* rw)
+{
+    do {
+        rw -> used -= entry(rw, 0) -> length;
+        rw -> first = (rw -> first + 1) % rw -> max_entries;
+        --(rw -> count);
+    } while (rw -> count > 0 && !entry(rw, 0) -> keyframe);
+}
+
+// ----------------------------------------------------------------------
+/**
+ * @brief finds room for length bytes after the newest snapshot, dropping the oldest ones
+ * @return offset of the room in the ring
+ */
+static size_t reserve(rewind_t* rw, size_t length)
+{
+    while (rw -> count > 0) {
+        const size_t oldest = entry(rw, 0) -> offset;
+        if (oldest > rw -> head) {
+            // kept snapshots wrap around the end of the ring: room up to the oldest one
+            if (rw -> head + length <= oldest) return rw -> head;
+        } else if (oldest < rw -> head) {
+            if (rw -> head + length <= rw -> capacity) return rw -> head;
+            if (length <= oldest) return 0;
+        }
+        drop_oldest(rw);
+    }
+    rw -> head = 0;
+    return 0;
+}
+
+// ======================================================================
+int rewind_init(rewind_t* rw, const gameboy_t* gameboy, size_t capacity,
+                size_t max_snapshots, uint32_t keyframe_every)
+{
+    M_REQUIRE_NON_NULL(rw);
+    M_REQUIRE_NON_NULL(gameboy);
+    M_REQUIRE(capacity > 0 && max_snapshots > 0 && keyframe_every > 0, ERR_BAD_PARAMETER,
+              "invalid rewind history (%zu bytes, %zu snapshots, keyframe every %u)",
+              capacity, max_snapshots, keyframe_every);
+
+    memset(rw, 0, sizeof(*rw));
+    rw -> state_size = gameboy_state_size(gameboy);
+    M_REQUIRE(rw -> state_size > 0, ERR_BAD_PARAMETER, "gameboy %p cannot be saved", (const void*) gameboy);
+
+    rw -> capacity = capacity;
+    rw -> max_entries = max_snapshots;
+    rw -> keyframe_every = keyframe_every;
+    rw -> ring = malloc(capacity);
+    rw -> entries = calloc(max_snapshots, sizeof(rewind_entry_t));
+    rw -> state = malloc(rw -> state_size);
+    rw -> next = malloc(rw -> state_size);
+    rw -> zeros = calloc(1, rw -> state_size);
+    rw -> scratch = malloc(REWIND_ENCODED_MAX(rw -> state_size));
+    if (rw -> ring == NULL || rw -> entries == NULL || rw -> state == NULL ||
+        rw -> next == NULL || rw -> zeros == NULL || rw -> scratch == NULL) {
+        rewind_free(rw);
+        return ERR_MEM;
+    }
+    return ERR_NONE;
+}
+
+// ======================================================================
+void rewind_free(rewind_t* rw)
+{
+    if (rw != NULL) {
+        free(rw -> ring);
+        free(rw -> entries);
+        free(rw -> state);
+        free(rw -> next);
+        free(rw -> zeros);
+        free(rw -> scratch);
+        memset(rw, 0, sizeof(*rw));
+    }
+}
+
+// ======================================================================
+int rewind_push(rewind_t* rw, const gameboy_t* gameboy)
+{
+    M_REQUIRE_NON_NULL(rw);
+    M_REQUIRE_NON_NULL(rw -> ring);
+    M_REQUIRE_NON_NULL(gameboy);
+    M_REQUIRE_NO_ERR(gameboy_save_state(gameboy, rw -> next, rw -> state_size, NULL));
+
+    if (rw -> count == rw -> max_entries) {
+        drop_oldest(rw);
+    }
+
+    bit_t keyframe = rw -> count == 0 || rw -> since_keyframe + 1 >= rw -> keyframe_every;
+    size_t length = xor_rle_encode(rw -> scratch, rw -> next, keyframe ? rw -> zeros : rw -> state,
+                                   rw -> state_size);
+    M_REQUIRE(length <= rw -> capacity, ERR_MEM, "snapshot of %zu bytes, ring of %zu", length, rw -> capacity);
+    size_t offset = reserve(rw, length);
+    if (!keyframe && rw -> count == 0) {
+        // the snapshot this delta is against was just dropped
+        keyframe = 1;
+        length = xor_rle_encode(rw -> scratch, rw -> next, rw -> zeros, rw -> state_size);
+        M_REQUIRE(length <= rw -> capacity, ERR_MEM, "snapshot of %zu bytes, ring of %zu", length, rw -> capacity);
+        offset = reserve(rw, length);
+    }
+
+    memcpy(rw -> ring + offset, rw -> scratch, length);
+    rewind_entry_t* const e = entry(rw, rw -> count);
+    e -> offset = offset;
+    e -> length = length;
+    e -> cycles = gameboy -> cycles;
+    e -> keyframe = keyframe;
+    ++(rw -> count);
+    rw -> head = offset + length;
+    rw -> used += length;
+    rw -> since_keyframe = keyframe ? 0 : rw -> since_keyframe + 1;
+
+    uint8_t* const previous = rw -> state;
+    rw -> state = rw -> next;
+    rw -> next = previous;
+    return ERR_NONE;
+}
+
+// ======================================================================
+int rewind_step_back(rewind_t* rw, gameboy_t* gameboy)
+{
+    M_REQUIRE_NON_NULL(rw);
+    M_REQUIRE_NON_NULL(gameboy);
+    M_REQUIRE(rw -> count > 0, ERR_BAD_PARAMETER, "empty rewind history (%zu bytes)", rw -> capacity);
+    M_REQUIRE_NO_ERR(gameboy_load_state(gameboy, rw -> state, rw -> state_size));
+
+    // the room of the newest snapshot is reused by the next push
+    const rewind_entry_t* const newest = entry(rw, rw -> count - 1);
+    --(rw -> count);
+    rw -> used -= newest -> length;
+    rw -> head = newest -> offset;
+    if (rw -> count == 0) {
+        rw -> since_keyframe = 0;
+        return ERR_NONE;
+    }
+
+    if (!newest -> keyframe) {
+        --(rw -> since_keyframe);
+        return xor_rle_apply(rw -> state, rw -> state_size, rw -> ring + newest -> offset, newest -> length);
+    }
+
+    // replays the group before, from its keyframe (the oldest snapshot is one)
+    size_t k = rw -> count - 1;
+    while (!entry(rw, k) -> keyframe) --k;
+    memset(rw -> state, 0, rw -> state_size);
+    rw -> since_keyframe = (uint32_t) (rw -> count - 1 - k);
+    int err = ERR_NONE;
+    for (; err == ERR_NONE && k < rw -> count; ++k) {
+        const rewind_entry_t* const e = entry(rw, k);
+        err = xor_rle_apply(rw -> state, rw -> state_size, rw -> ring + e -> offset, e -> length);
+    }
+    return err;
+}
+
+// ======================================================================
+size_t rewind_count(const rewind_t* rw)
+{
+    return rw == NULL ? 0 : rw -> count;
+}
@@ -0,0 +1,122 @@
+#pragma once
+
+/**
+ * @file rewind.h
+ * @brief Rewind history of a gameboy: delta-compressed save states in a fixed-size ring
+ *
+ * Every snapshot is a save state (see savestate.h), stored either as a
+ * keyframe (run-length encoded on its own) or as the run-length encoded
+ * XOR against the snapshot before it; a keyframe is stored every
+ * `keyframe_every` snapshots. Since XOR is its own inverse, stepping back
+ * from the newest snapshot only decodes one delta; crossing a keyframe
+ * replays the deltas following the keyframe before it.
+ *
+ * All memory is allocated by rewind_init(). When the ring is full, the
+ * oldest snapshots are dropped, a whole keyframe group at a time, so that
+ * the history always starts with a keyframe.
+ *
+ * @date 2020
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "bit.h"
+#include "gameboy.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Location of a snapshot in the ring
+ */
+typedef struct {
+    size_t offset;   // in the byte ring
+    size_t length;   // encoded bytes
+    uint64_t cycles; // gameboy cycles of the snapshot
+    bit_t keyframe;
+} rewind_entry_t;
+
+/**
+ * @brief Rewind history type
+ */
+typedef struct {
+    uint8_t* ring;            // encoded snapshots
+    size_t capacity;          // bytes of the ring
+    size_t head;              // where the next snapshot is written
+    size_t used;              // encoded bytes of the snapshots kept
+
+    rewind_entry_t* entries;  // ring of snapshots, oldest first
+    size_t max_entries;
+    size_t first;
+    size_t count;
+
+    size_t state_size;
+    uint8_t* state;           // newest snapshot, decoded
+    uint8_t* next;            // snapshot being pushed
+    uint8_t* zeros;           // keyframes are encoded against it
+    uint8_t* scratch;         // encoding
+
+    uint32_t keyframe_every;
+    uint32_t since_keyframe;  // deltas pushed since the newest keyframe
+} rewind_t;
+
+/**
+ * @brief Worst-case encoded size of a state of the given size
+ */
+#define REWIND_ENCODED_MAX(state_size) ((state_size) + (state_size) / 2 + 16)
+
+
+/**
+ * @brief Allocates the rewind history of a gameboy
+ *
+ * @param rw history to initialise
+ * @param gameboy gameboy whose snapshots will be pushed
+ * @param capacity bytes of encoded snapshots kept at most
+ * @param max_snapshots number of snapshots kept at most
+ * @param keyframe_every a keyframe is stored every that many snapshots (> 0)
+ * @return error code
+ */
+int rewind_init(rewind_t* rw, const gameboy_t* gameboy, size_t capacity,
+                size_t max_snapshots, uint32_t keyframe_every);
+
+
+/**
+ * @brief Frees a rewind history
+ *
+ * @param rw history to free
+ */
+void rewind_free(rewind_t* rw);
+
+
+/**
+ * @brief Adds the current state of a gameboy as the newest snapshot
+ *        (typically called once per frame)
+ *
+ * @param rw history
+ * @param gameboy gameboy to snapshot
+ * @return error code
+ */
+int rewind_push(rewind_t* rw, const gameboy_t* gameboy);
+
+
+/**
+ * @brief Restores a gameboy to the newest snapshot, which is then removed:
+ *        successive calls go back further in time
+ *
+ * @param rw history (not empty)
+ * @param gameboy gameboy to restore
+ * @return error code
+ */
+int rewind_step_back(rewind_t* rw, gameboy_t* gameboy);
+
+
+/**
+ * @brief Number of snapshots in a history
+ */
+size_t rewind_count(const rewind_t* rw);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,83 @@
+/**
+ * @file run_ahead.c
+ * @brief Run-ahead of a gameboy: shows frames emulated ahead of the real state
+ *
+ * @date 2020
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "run_ahead.h"
+#include "savestate.h"
+#include "lcdc.h"
+#include "error.h"
+
+// ======================================================================
+int run_ahead_init(run_ahead_t* ra, const gameboy_t* gameboy, uint32_t frames)
+{
+    M_REQUIRE_NON_NULL(ra);
+    M_REQUIRE_NON_NULL(gameboy);
+    M_REQUIRE(frames > 0 && frames <= RUN_AHEAD_MAX_FRAMES, ERR_BAD_PARAMETER,
+              "cannot run %u frames ahead (1 to %d)", frames, RUN_AHEAD_MAX_FRAMES);
+
+    memset(ra, 0, sizeof(*ra));
+    ra -> state_size = gameboy_state_size(gameboy);
+    M_REQUIRE(ra -> state_size > 0, ERR_BAD_PARAMETER, "gameboy %p cannot be saved", (const void*) gameboy);
+    ra -> state = malloc(ra -> state_size);
+    M_REQUIRE_NON_NULL_CUSTOM_ERR(ra -> state, ERR_MEM);
+    ra -> frames = frames;
+    return ERR_NONE;
+}
+
+// ======================================================================
+void run_ahead_free(run_ahead_t* ra)
+{
+    if (ra != NULL) {
+        free(ra -> state);
+        memset(ra, 0, sizeof(*ra));
+    }
+}
+
+// ======================================================================
+int run_ahead_begin(run_ahead_t* ra, gameboy_t* gameboy)
+{
+    M_REQUIRE_NON_NULL(ra);
+    M_REQUIRE_NON_NULL(ra -> state);
+    M_REQUIRE_NON_NULL(gameboy);
+    M_REQUIRE(!ra -> ahead, ERR_BAD_PARAMETER, "already %u frames ahead", ra -> frames);
+
+    int err = gameboy_save_state(gameboy, ra -> state, ra -> state_size, NULL);
+    M_REQUIRE_NO_ERR(err);
+    ra -> ahead = 1;
+
+    // what the real run will output, not this one
+    FILE* const serial = gameboy -> serial;
+    gameboy -> serial = NULL;
+
+    const uint64_t last_frame = (gameboy -> cycles / FRAME_TOTAL_CYCLES + ra -> frames - 1) * FRAME_TOTAL_CYCLES;
+    if (last_frame > gameboy -> cycles) {
+        err = gameboy_run_until(gameboy, last_frame);
+    }
+    if (err == ERR_NONE) {
+        err = gameboy_request_frame(gameboy);
+    }
+    if (err == ERR_NONE) {
+        err = gameboy_run_until(gameboy, last_frame + FRAME_TOTAL_CYCLES);
+    }
+
+    gameboy -> serial = serial;
+    return err;
+}
+
+// ======================================================================
+int run_ahead_end(run_ahead_t* ra, gameboy_t* gameboy)
+{
+    M_REQUIRE_NON_NULL(ra);
+    M_REQUIRE_NON_NULL(gameboy);
+    M_REQUIRE(ra -> ahead, ERR_BAD_PARAMETER, "not %u frames ahead", ra -> frames);
+
+    ra -> ahead = 0;
+    return gameboy_load_state(gameboy, ra -> state, ra -> state_size);
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+/**
+ * @file run_ahead.h
+ * @brief Run-ahead of a gameboy: shows frames emulated ahead of the real state
+ *
+ * Games only react to a key some frames after it is pressed. Running
+ * ahead snapshots the gameboy (see savestate.h), emulates a few more
+ * frames with the current input, lets the caller show the last one, then
+ * restores the snapshot: what is shown reacts that many frames earlier,
+ * while the real run goes on unchanged. The snapshot holds the LCD
+ * controller and the frame on display too, so the frame run ahead must be
+ * shown before run_ahead_end(), which puts the real one back.
+ *
+ * With the RENDER_ON_REQUEST policy, only the frame shown is rendered,
+ * neither the real frames nor the other frames run ahead.
+ *
+ * @date 2020
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "bit.h"
+#include "gameboy.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define RUN_AHEAD_MAX_FRAMES 8
+
+/**
+ * @brief Run-ahead type
+ */
+typedef struct {
+    uint32_t frames;    // frames run ahead
+    uint8_t* state;     // snapshot of the real state
+    size_t state_size;
+    bit_t ahead;        // between run_ahead_begin() and run_ahead_end()
+} run_ahead_t;
+
+
+/**
+ * @brief Allocates the snapshot of a run-ahead
+ *
+ * @param ra run-ahead to initialise
+ * @param gameboy gameboy to run ahead
+ * @param frames number of frames to run ahead (1 to RUN_AHEAD_MAX_FRAMES)
+ * @return error code
+ */
+int run_ahead_init(run_ahead_t* ra, const gameboy_t* gameboy, uint32_t frames);
+
+
+/**
+ * @brief Frees a run-ahead
+ *
+ * @param ra run-ahead to free
+ */
+void run_ahead_free(run_ahead_t* ra);
+
+
+/**
+ * @brief Snapshots the gameboy and runs it ahead to the end of the frame
+ *        `frames` frames later, rendering that last frame only; the
+ *        serial port outputs nothing meanwhile
+ *
+ * @param ra run-ahead
+ * @param gameboy gameboy to run ahead
+ * @return error code
+ */
+int run_ahead_begin(run_ahead_t* ra, gameboy_t* gameboy);
+
+
+/**
+ * @brief Restores the gameboy as it was before run_ahead_begin()
+ *
+ * @param ra run-ahead
+ * @param gameboy gameboy run ahead
+ * @return error code
+ */
+int run_ahead_end(run_ahead_t* ra, gameboy_t* gameboy);
+
+#ifdef __cplusplus
+}
+#endif
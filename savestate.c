@@ -0,0 +1,653 @@
+/**
+ * @file savestate.c
+ * @brief Binary save states of a gameboy
+ *
+ * Saving and loading are one pass over the state, memories being copied
+ * page by page: only the pages which differ from the cartridge as loaded
+ * (zeros for the other memories) are stored. Loading first locates and
+ * checks every section, so that an invalid state leaves the gameboy
+ * untouched, then only redoes the work the state makes necessary: the bus
+ * is remapped if the mapping differs, and only the tiles whose bytes
+ * differ are marked dirty in the tile cache.
+ *
+ * @date 2020
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+
+#include "savestate.h"
+#include "bus.h"
+#include "tile_cache.h"
+#include "sprite_index.h"
+#include "scanline.h"
+#include "error.h"
+
+#define STATE_MAGIC "GBST"
+#define TAG_SIZE 4
+#define HEADER_SIZE (TAG_SIZE + 2 + 2 + 4)
+#define SECTION_HEADER_SIZE (TAG_SIZE + 4)
+
+// components of a state, in plugging order (the boot ROM goes over the cartridge);
+// 1 to GB_NB_COMPONENTS are the gameboy components
+#define STATE_CARTRIDGE 0
+#define STATE_ECHO_RAM  (GB_NB_COMPONENTS + 1)
+#define STATE_HIGH_RAM  (GB_NB_COMPONENTS + 2)
+#define STATE_BOOT_ROM  (GB_NB_COMPONENTS + 3)
+#define NB_STATE_COMPONENTS (GB_NB_COMPONENTS + 4)
+
+// only the echo RAM has no memory of its own
+#define owns_memory(id) ((id) != STATE_ECHO_RAM)
+
+// memories are saved by pages, each flagged in a bitmap
+#define PAGE_SIZE 256
+#define nb_pages(size) (((size) + PAGE_SIZE - 1) / PAGE_SIZE)
+#define bitmap_size(size) ((nb_pages(size) + 7) / 8)
+
+#define CPU_SECTION_SIZE  (6 * 2 + 5 + 3 + 2)
+#define TIME_V2_SECTION_SIZE (8 + 2)
+#define TIME_SECTION_SIZE (TIME_V2_SECTION_SIZE + 1 + 4 + 1 + 1 + 8 + 8)
+#define JOYP_SECTION_SIZE (2 + NB_GB_KEY_ROWS)
+#define BUS_SECTION_SIZE  (1 + NB_STATE_COMPONENTS * 4)
+#define LCDC_SECTION_SIZE (1 + 8 + 8 + 2 + 2 + 1)
+#define SCRN_SECTION_SIZE (LCD_HEIGHT * BIT_VECTOR_CHUNKS(LCD_WIDTH) * 2 * 4)
+
+enum { SECTION_CPU, SECTION_TIME, SECTION_JOYP, SECTION_BUS, SECTION_MEM, SECTION_LCDC, SECTION_SCRN,
+       NB_SECTIONS
+     };
+
+static const char section_tags[NB_SECTIONS][TAG_SIZE + 1] = {
+    "CPU ", "TIME", "JOYP", "BUS ", "MEM ", "LCDC", "SCRN"
+};
+
+// first version with each section, which older states may lack
+static const uint16_t section_versions[NB_SECTIONS] = { 1, 1, 1, 1, 1, 2, 4 };
+
+// ======================================================================
+static const component_t* state_component(const gameboy_t* gameboy, size_t id)
+{
+    switch (id) {
+    case STATE_CARTRIDGE:
+        return &(gameboy -> cartridge.c);
+    case STATE_ECHO_RAM:
+        return &(gameboy -> echo_ram);
+    case STATE_HIGH_RAM:
+        return &(gameboy -> cpu.high_ram);
+    case STATE_BOOT_ROM:
+        return &(gameboy -> bootrom);
+    default:
+        return gameboy -> components + (id - 1);
+    }
+}
+
+// ----------------------------------------------------------------------
+/**
+ * @brief what the memory of a component is saved against (NULL for zeros)
+ */
+static const data_t* state_reference(const gameboy_t* gameboy, size_t id)
+{
+    return id == STATE_CARTRIDGE ? gameboy -> rom : NULL;
+}
+
+// ----------------------------------------------------------------------
+/**
+ * @brief largest size of the memory section: every page stored
+ */
+static size_t mem_section_size(const gameboy_t* gameboy)
+{
+    if (gameboy -> rom == NULL) return 0;
+    size_t size = 8;
+    for (size_t id = 0; id < NB_STATE_COMPONENTS; ++id) {
+        if (owns_memory(id)) {
+            const component_t* const c = state_component(gameboy, id);
+            if (c -> mem == NULL || c -> mem -> memory == NULL) return 0;
+            size += 4 + bitmap_size(c -> mem -> size) + c -> mem -> size;
+        }
+    }
+    return size;
+}
+
+// ----------------------------------------------------------------------
+/**
+ * @brief tells whether a page differs from its reference
+ */
+static bit_t page_changed(const data_t* page, const data_t* reference, size_t length)
+{
+    if (reference != NULL) {
+        return memcmp(page, reference, length) != 0;
+    }
+    for (size_t i = 0; i < length; ++i) {
+        if (page[i] != 0) return 1;
+    }
+    return 0;
+}
+
+// ======================================================================
+// little-endian writing and reading, moving the pointer along
+static void put8(uint8_t** p, uint8_t v)
+{
+    *(*p)++ = v;
+}
+
+static void put16(uint8_t** p, uint16_t v)
+{
+    put8(p, (uint8_t) v);
+    put8(p, (uint8_t) (v >> 8));
+}
+
+static void put32(uint8_t** p, uint32_t v)
+{
+    put16(p, (uint16_t) v);
+    put16(p, (uint16_t) (v >> 16));
+}
+
+static void put64(uint8_t** p, uint64_t v)
+{
+    put32(p, (uint32_t) v);
+    put32(p, (uint32_t) (v >> 32));
+}
+
+static uint8_t get8(const uint8_t** p)
+{
+    return *(*p)++;
+}
+
+static uint16_t get16(const uint8_t** p)
+{
+    const uint16_t lo = get8(p);
+    return (uint16_t) (lo | (uint16_t) get8(p) << 8);
+}
+
+static uint32_t get32(const uint8_t** p)
+{
+    const uint32_t lo = get16(p);
+    return lo | (uint32_t) get16(p) << 16;
+}
+
+static uint64_t get64(const uint8_t** p)
+{
+    const uint64_t lo = get32(p);
+    return lo | (uint64_t) get32(p) << 32;
+}
+
+// ----------------------------------------------------------------------
+/**
+ * @brief writes a section header; returns where its size goes, see end_section()
+ */
+static uint8_t* begin_section(uint8_t** p, size_t section)
+{
+    memcpy(*p, section_tags[section], TAG_SIZE);
+    *p += TAG_SIZE;
+    uint8_t* const size_slot = *p;
+    *p += 4;
+    return size_slot;
+}
+
+static void end_section(const uint8_t* p, uint8_t* size_slot)
+{
+    uint8_t* slot = size_slot;
+    put32(&slot, (uint32_t) (p - (size_slot + 4)));
+}
+
+// ======================================================================
+static void save_mem(const gameboy_t* gameboy, uint8_t** p)
+{
+    put64(p, gameboy -> rom_hash);
+    for (size_t id = 0; id < NB_STATE_COMPONENTS; ++id) {
+        if (!owns_memory(id)) continue;
+
+        const memory_t* const mem = state_component(gameboy, id) -> mem;
+        const data_t* const reference = state_reference(gameboy, id);
+        put32(p, (uint32_t) mem -> size);
+        uint8_t* const bitmap = *p;
+        memset(bitmap, 0, bitmap_size(mem -> size));
+        *p += bitmap_size(mem -> size);
+        for (size_t page = 0; page < nb_pages(mem -> size); ++page) {
+            const size_t offset = page * PAGE_SIZE;
+            const size_t length = mem -> size - offset < PAGE_SIZE ? mem -> size - offset : PAGE_SIZE;
+            if (page_changed(mem -> memory + offset, reference == NULL ? NULL : reference + offset, length)) {
+                bitmap[page / 8] = (uint8_t) (bitmap[page / 8] | 1 << (page % 8));
+                memcpy(*p, mem -> memory + offset, length);
+                *p += length;
+            }
+        }
+    }
+}
+
+// ======================================================================
+size_t gameboy_state_size(const gameboy_t* gameboy)
+{
+    if (gameboy == NULL) return 0;
+    const size_t mem_size = mem_section_size(gameboy);
+    if (mem_size == 0) return 0;
+    return HEADER_SIZE + NB_SECTIONS * SECTION_HEADER_SIZE
+           + CPU_SECTION_SIZE + TIME_SECTION_SIZE + JOYP_SECTION_SIZE + BUS_SECTION_SIZE
+           + mem_size + LCDC_SECTION_SIZE + SCRN_SECTION_SIZE;
+}
+
+// ======================================================================
+int gameboy_save_state(const gameboy_t* gameboy, void* buffer, size_t size, size_t* written)
+{
+    M_REQUIRE_NON_NULL(gameboy);
+    M_REQUIRE_NON_NULL(buffer);
+    M_REQUIRE_NON_NULL(gameboy -> screen.display.content);
+    const size_t needed = gameboy_state_size(gameboy);
+    M_REQUIRE(needed > 0 && size >= needed, ERR_BAD_PARAMETER, "state needs %zu bytes, only %zu given", needed, size);
+
+    uint8_t* p = buffer;
+    memcpy(p, STATE_MAGIC, TAG_SIZE);
+    p += TAG_SIZE;
+    put16(&p, GB_STATE_VERSION);
+    put16(&p, NB_SECTIONS);
+    uint8_t* const total_slot = p; // known at the end
+    p += 4;
+
+    const cpu_t* const cpu = &(gameboy -> cpu);
+    uint8_t* slot = begin_section(&p, SECTION_CPU);
+    put16(&p, cpu -> AF);
+    put16(&p, cpu -> BC);
+    put16(&p, cpu -> DE);
+    put16(&p, cpu -> HL);
+    put16(&p, cpu -> PC);
+    put16(&p, cpu -> SP);
+    put8(&p, cpu -> IF);
+    put8(&p, cpu -> IE);
+    put8(&p, cpu -> IME);
+    put8(&p, cpu -> HALT);
+    put8(&p, cpu -> idle_time);
+    put16(&p, cpu -> alu.value);
+    put8(&p, cpu -> alu.flags);
+    put16(&p, cpu -> write_listener);
+    end_section(p, slot);
+
+    slot = begin_section(&p, SECTION_TIME);
+    put64(&p, gameboy -> cycles);
+    put16(&p, gameboy -> timer.counter);
+    const render_policy_t* const render = &(gameboy -> render);
+    put8(&p, (uint8_t) render -> mode);
+    put32(&p, render -> every);
+    put8(&p, render -> requested);
+    put8(&p, render -> rendering);
+    put64(&p, render -> frames);
+    put64(&p, render -> rendered);
+    end_section(p, slot);
+
+    slot = begin_section(&p, SECTION_JOYP);
+    put8(&p, gameboy -> pad.intern);
+    put8(&p, gameboy -> pad.old_state);
+    for (size_t row = 0; row < NB_GB_KEY_ROWS; ++row) {
+        put8(&p, gameboy -> pad.keys_state[row]);
+    }
+    end_section(p, slot);
+
+    slot = begin_section(&p, SECTION_BUS);
+    put8(&p, gameboy -> boot);
+    for (size_t id = 0; id < NB_STATE_COMPONENTS; ++id) {
+        const component_t* const c = state_component(gameboy, id);
+        put16(&p, c -> start);
+        put16(&p, c -> end);
+    }
+    end_section(p, slot);
+
+    slot = begin_section(&p, SECTION_MEM);
+    save_mem(gameboy, &p);
+    end_section(p, slot);
+
+    const lcdc_t* const lcd = &(gameboy -> screen);
+    slot = begin_section(&p, SECTION_LCDC);
+    put8(&p, lcd -> on);
+    put64(&p, lcd -> next_cycle);
+    put64(&p, lcd -> on_cycle);
+    put16(&p, lcd -> DMA_from);
+    put16(&p, lcd -> DMA_to);
+    put8(&p, lcd -> window_y);
+    end_section(p, slot);
+
+    slot = begin_section(&p, SECTION_SCRN);
+    for (size_t y = 0; y < LCD_HEIGHT; ++y) {
+        const image_line_t* const line = lcd -> display.content + y;
+        for (size_t w = 0; w < BIT_VECTOR_CHUNKS(LCD_WIDTH); ++w) {
+            put32(&p, line -> msb -> content[w]);
+            put32(&p, line -> lsb -> content[w]);
+        }
+    }
+    end_section(p, slot);
+
+    // the rest up to the largest size is zeroed, so that states of a gameboy
+    // kept in buffers of that size only differ where the gameboys do
+    const size_t total = (size_t) (p - (uint8_t*) buffer);
+    uint8_t* total_p = total_slot;
+    put32(&total_p, (uint32_t) total);
+    memset(p, 0, needed - total);
+    if (written != NULL) *written = total;
+    return ERR_NONE;
+}
+
+// ======================================================================
+/**
+ * @brief checks the bus and memory sections against the gameboy; before
+ *        version 3, memories are saved whole (every page, no bitmap nor hash)
+ */
+static int check_sections(const gameboy_t* gameboy, uint16_t version,
+                          const uint8_t* bus, const uint8_t* mem, size_t mem_length)
+{
+    ++bus; // boot flag
+    for (size_t id = 0; id < NB_STATE_COMPONENTS; ++id) {
+        const addr_t start = get16(&bus);
+        const addr_t end = get16(&bus);
+        const memory_t* const c_mem = state_component(gameboy, id) -> mem;
+        M_REQUIRE(start == end || (start < end && (size_t) (end - start) < c_mem -> size),
+                  ERR_BAD_PARAMETER, "component %zu cannot be plugged at 0x%04X-0x%04X", id, start, end);
+    }
+
+    const uint8_t* const mem_end = mem + mem_length;
+    if (version >= 3) {
+        M_REQUIRE(mem_length >= 8, ERR_BAD_PARAMETER, "truncated memory section (%zu bytes)", mem_length);
+        const uint64_t hash = get64(&mem);
+        M_REQUIRE(hash == gameboy -> rom_hash, ERR_BAD_PARAMETER,
+                  "state of another cartridge (hash %016" PRIx64 ")", hash);
+    }
+    for (size_t id = 0; id < NB_STATE_COMPONENTS; ++id) {
+        if (!owns_memory(id)) continue;
+
+        const size_t size = state_component(gameboy, id) -> mem -> size;
+        M_REQUIRE(mem_end - mem >= 4, ERR_BAD_PARAMETER, "truncated memory of component %zu", id);
+        const uint32_t saved = get32(&mem);
+        M_REQUIRE(saved == size, ERR_BAD_PARAMETER,
+                  "component %zu has %zu bytes, %" PRIu32 " saved", id, size, saved);
+        size_t stored = size;
+        if (version >= 3) {
+            M_REQUIRE((size_t) (mem_end - mem) >= bitmap_size(size), ERR_BAD_PARAMETER,
+                      "truncated memory of component %zu", id);
+            const uint8_t* const bitmap = mem;
+            mem += bitmap_size(size);
+            stored = 0;
+            for (size_t page = 0; page < nb_pages(size); ++page) {
+                if (bit_get(bitmap[page / 8], (int) (page % 8))) {
+                    stored += size - page * PAGE_SIZE < PAGE_SIZE ? size - page * PAGE_SIZE : PAGE_SIZE;
+                }
+            }
+        }
+        M_REQUIRE((size_t) (mem_end - mem) >= stored, ERR_BAD_PARAMETER,
+                  "truncated memory of component %zu", id);
+        mem += stored;
+    }
+    M_REQUIRE(mem == mem_end, ERR_BAD_PARAMETER, "%zu extra bytes of memory", (size_t) (mem_end - mem));
+    return ERR_NONE;
+}
+
+// ----------------------------------------------------------------------
+/**
+ * @brief restores the mapping of the bus, if it changed
+ */
+static int load_bus(gameboy_t* gameboy, const uint8_t* p)
+{
+    gameboy -> boot = get8(&p);
+
+    addr_t ranges[NB_STATE_COMPONENTS][2];
+    bit_t same = 1;
+    for (size_t id = 0; id < NB_STATE_COMPONENTS; ++id) {
+        const component_t* const c = state_component(gameboy, id);
+        ranges[id][0] = get16(&p);
+        ranges[id][1] = get16(&p);
+        same = same && ranges[id][0] == c -> start && ranges[id][1] == c -> end;
+    }
+    if (same) return ERR_NONE;
+
+    for (size_t id = 0; id < NB_STATE_COMPONENTS; ++id) {
+        M_REQUIRE_NO_ERR(bus_unplug(gameboy -> bus, (component_t*) state_component(gameboy, id)));
+    }
+    for (size_t id = 0; id < NB_STATE_COMPONENTS; ++id) {
+        if (ranges[id][0] != ranges[id][1]) {
+            M_REQUIRE_NO_ERR(bus_forced_plug(gameboy -> bus, (component_t*) state_component(gameboy, id),
+                                             ranges[id][0], ranges[id][1], 0));
+        }
+    }
+    // over the registers, as cpu_plug() does
+    gameboy -> bus[REG_IF] = &(gameboy -> cpu.IF);
+    gameboy -> bus[REG_IE] = &(gameboy -> cpu.IE);
+    return ERR_NONE;
+}
+
+// ----------------------------------------------------------------------
+/**
+ * @brief restores a page of memory (from its reference if source is NULL)
+ */
+static void load_page(gameboy_t* gameboy, memory_t* mem, size_t offset,
+                      const data_t* source, const data_t* reference, size_t length)
+{
+    const data_t* const from = source != NULL ? source : reference != NULL ? reference + offset : NULL;
+    if (mem == gameboy -> tiles.vram -> mem) {
+        // only the tiles which differ have to be decoded again
+        for (size_t tile = offset / TILE_SIZE; tile < (offset + length) / TILE_SIZE
+             && tile < TILE_CACHE_NB_TILES; ++tile) {
+            const data_t* const now = mem -> memory + tile * TILE_SIZE;
+            const bit_t differs = from != NULL ? memcmp(now, from + (tile * TILE_SIZE - offset), TILE_SIZE) != 0
+                                  : page_changed(now, NULL, TILE_SIZE);
+            if (differs) {
+                tile_cache_bus_listener(&(gameboy -> tiles), (addr_t) (TILE_SRC_ADDR_LOW + tile * TILE_SIZE));
+            }
+        }
+    }
+    if (from != NULL) {
+        memcpy(mem -> memory + offset, from, length);
+    } else {
+        memset(mem -> memory + offset, 0, length);
+    }
+}
+
+// ----------------------------------------------------------------------
+static void load_mem(gameboy_t* gameboy, uint16_t version, const uint8_t* p)
+{
+    if (version >= 3) p += 8; // hash, checked
+    for (size_t id = 0; id < NB_STATE_COMPONENTS; ++id) {
+        if (!owns_memory(id)) continue;
+
+        memory_t* const mem = state_component(gameboy, id) -> mem;
+        const data_t* const reference = state_reference(gameboy, id);
+        p += 4; // size, checked
+        const uint8_t* bitmap = NULL;
+        if (version >= 3) {
+            bitmap = p;
+            p += bitmap_size(mem -> size);
+        }
+        for (size_t page = 0; page < nb_pages(mem -> size); ++page) {
+            const size_t offset = page * PAGE_SIZE;
+            const size_t length = mem -> size - offset < PAGE_SIZE ? mem -> size - offset : PAGE_SIZE;
+            if (bitmap == NULL || bit_get(bitmap[page / 8], (int) (page % 8))) {
+                load_page(gameboy, mem, offset, p, reference, length);
+                p += length;
+            } else {
+                load_page(gameboy, mem, offset, NULL, reference, length);
+            }
+        }
+    }
+}
+
+// ======================================================================
+int gameboy_load_state(gameboy_t* gameboy, const void* buffer, size_t size)
+{
+    M_REQUIRE_NON_NULL(gameboy);
+    M_REQUIRE_NON_NULL(buffer);
+    M_REQUIRE(size >= HEADER_SIZE && memcmp(buffer, STATE_MAGIC, TAG_SIZE) == 0,
+              ERR_BAD_PARAMETER, "not a gameboy state (%zu bytes)", size);
+
+    const uint8_t* p = (const uint8_t*) buffer + TAG_SIZE;
+    const uint16_t version = get16(&p);
+    const uint16_t nb_sections = get16(&p);
+    const uint32_t total = get32(&p);
+    M_REQUIRE(version >= 1 && version <= GB_STATE_VERSION, ERR_BAD_PARAMETER,
+              "unsupported state version %u", version);
+    M_REQUIRE(total >= HEADER_SIZE && total <= size, ERR_BAD_PARAMETER,
+              "truncated state (%zu bytes out of %" PRIu32 ")", size, total);
+    const size_t mem_size = mem_section_size(gameboy);
+    M_REQUIRE(mem_size > 0, ERR_BAD_PARAMETER, "gameboy %p has components without memory", (const void*) gameboy);
+    M_REQUIRE_NON_NULL(gameboy -> screen.display.content);
+
+    // locates and checks every section before anything is changed
+    // (the memory section is checked on its own, its pages being optional)
+    const size_t expected[NB_SECTIONS] = {
+        CPU_SECTION_SIZE, version >= 3 ? TIME_SECTION_SIZE : TIME_V2_SECTION_SIZE,
+        JOYP_SECTION_SIZE, BUS_SECTION_SIZE, mem_size, LCDC_SECTION_SIZE, SCRN_SECTION_SIZE
+    };
+    const uint8_t* sections[NB_SECTIONS] = { NULL };
+    size_t lengths[NB_SECTIONS] = { 0 };
+    const uint8_t* const end = (const uint8_t*) buffer + total;
+    for (uint16_t s = 0; s < nb_sections; ++s) {
+        M_REQUIRE(end - p >= SECTION_HEADER_SIZE, ERR_BAD_PARAMETER, "truncated section %u", s);
+        const uint8_t* const tag = p;
+        p += TAG_SIZE;
+        const uint32_t length = get32(&p);
+        M_REQUIRE(length <= (size_t) (end - p), ERR_BAD_PARAMETER, "truncated section %u", s);
+        for (size_t k = 0; k < NB_SECTIONS; ++k) {
+            if (memcmp(tag, section_tags[k], TAG_SIZE) == 0) {
+                M_REQUIRE(sections[k] == NULL && (length == expected[k] || (k == SECTION_MEM && length <= expected[k])),
+                          ERR_BAD_PARAMETER, "bad section \"%s\" (%" PRIu32 " bytes)", section_tags[k], length);
+                sections[k] = p;
+                lengths[k] = length;
+            }
+        }
+        p += length; // unknown sections are skipped
+    }
+    for (size_t k = 0; k < NB_SECTIONS; ++k) {
+        M_REQUIRE(sections[k] != NULL || version < section_versions[k], ERR_BAD_PARAMETER,
+                  "missing section \"%s\"", section_tags[k]);
+    }
+    M_REQUIRE_NO_ERR(check_sections(gameboy, version, sections[SECTION_BUS],
+                                    sections[SECTION_MEM], lengths[SECTION_MEM]));
+    if (version >= 3) {
+        p = sections[SECTION_TIME] + TIME_V2_SECTION_SIZE;
+        const uint8_t mode = get8(&p);
+        const uint32_t every = get32(&p);
+        M_REQUIRE(mode < NB_RENDER_MODES && (mode != RENDER_EVERY_NTH || every > 0), ERR_BAD_PARAMETER,
+                  "invalid render policy %u (every %" PRIu32 ")", mode, every);
+    }
+
+    cpu_t* const cpu = &(gameboy -> cpu);
+    p = sections[SECTION_CPU];
+    cpu -> AF = get16(&p);
+    cpu -> BC = get16(&p);
+    cpu -> DE = get16(&p);
+    cpu -> HL = get16(&p);
+    cpu -> PC = get16(&p);
+    cpu -> SP = get16(&p);
+    cpu -> IF = get8(&p);
+    cpu -> IE = get8(&p);
+    cpu -> IME = get8(&p);
+    cpu -> HALT = get8(&p);
+    cpu -> idle_time = get8(&p);
+    cpu -> alu.value = get16(&p);
+    cpu -> alu.flags = get8(&p);
+    cpu -> write_listener = get16(&p);
+
+    p = sections[SECTION_TIME];
+    gameboy -> cycles = get64(&p);
+    gameboy -> timer.counter = get16(&p);
+    if (version >= 3) {
+        render_policy_t* const render = &(gameboy -> render);
+        render -> mode = (render_mode_t) get8(&p);
+        render -> every = get32(&p);
+        render -> requested = get8(&p);
+        render -> rendering = get8(&p);
+        render -> frames = get64(&p);
+        render -> rendered = get64(&p);
+    }
+
+    p = sections[SECTION_JOYP];
+    gameboy -> pad.intern = get8(&p);
+    gameboy -> pad.old_state = get8(&p);
+    for (size_t row = 0; row < NB_GB_KEY_ROWS; ++row) {
+        gameboy -> pad.keys_state[row] = get8(&p);
+    }
+
+    // states without LCD controller: it is off, and switched on by LCDC if needed
+    lcdc_t* const lcd = &(gameboy -> screen);
+    lcd -> on = 0;
+    lcd -> next_cycle = lcd -> on_cycle = 0;
+    lcd -> DMA_from = lcd -> DMA_to = 0;
+    lcd -> window_y = 0;
+    if ((p = sections[SECTION_LCDC]) != NULL) {
+        lcd -> on = get8(&p);
+        lcd -> next_cycle = get64(&p);
+        lcd -> on_cycle = get64(&p);
+        lcd -> DMA_from = get16(&p);
+        lcd -> DMA_to = get16(&p);
+        lcd -> window_y = get8(&p);
+    }
+
+    // the displayed frame goes back with the state (blank for older states,
+    // until the next frame is drawn)
+    p = sections[SECTION_SCRN];
+    for (size_t y = 0; y < LCD_HEIGHT; ++y) {
+        const image_line_t* const line = lcd -> display.content + y;
+        for (size_t w = 0; w < BIT_VECTOR_CHUNKS(LCD_WIDTH); ++w) {
+            line -> msb -> content[w] = p != NULL ? get32(&p) : 0;
+            line -> lsb -> content[w] = p != NULL ? get32(&p) : 0;
+        }
+    }
+
+    M_REQUIRE_NO_ERR(load_bus(gameboy, sections[SECTION_BUS]));
+    load_mem(gameboy, version, sections[SECTION_MEM]);
+
+    // derived from the memory just restored
+    M_REQUIRE_NO_ERR(sprite_index_rebuild(&(gameboy -> sprites), gameboy -> bus));
+    scanline_tracker_invalidate_all(&(gameboy -> lines));
+    return ERR_NONE;
+}
+
+// ======================================================================
+int gameboy_save_state_file(const gameboy_t* gameboy, const char* filename)
+{
+    M_REQUIRE_NON_NULL(gameboy);
+    M_REQUIRE_NON_NULL(filename);
+
+    const size_t size = gameboy_state_size(gameboy);
+    M_REQUIRE(size > 0, ERR_BAD_PARAMETER, "gameboy %p has components without memory", (const void*) gameboy);
+    uint8_t* const buffer = malloc(size);
+    M_REQUIRE_NON_NULL_CUSTOM_ERR(buffer, ERR_MEM);
+
+    size_t written = 0;
+    int err = gameboy_save_state(gameboy, buffer, size, &written);
+    if (err == ERR_NONE) {
+        FILE* file = fopen(filename, "wb");
+        if (file == NULL) {
+            err = ERR_IO;
+        } else {
+            if (fwrite(buffer, written, 1, file) != 1) err = ERR_IO;
+            if (fclose(file) != 0) err = ERR_IO;
+        }
+    }
+    free(buffer);
+    return err;
+}
+
+// ======================================================================
+int gameboy_load_state_file(gameboy_t* gameboy, const char* filename)
+{
+    M_REQUIRE_NON_NULL(gameboy);
+    M_REQUIRE_NON_NULL(filename);
+
+    FILE* file = fopen(filename, "rb");
+    M_EXIT_IF(file == NULL, ERR_IO, "cannot open state file \"%s\"", filename);
+
+    int err = ERR_NONE;
+    uint8_t* buffer = NULL;
+    long size = -1;
+    if (fseek(file, 0, SEEK_END) == 0) size = ftell(file);
+    if (size <= 0 || fseek(file, 0, SEEK_SET) != 0) {
+        err = ERR_IO;
+    } else if ((buffer = malloc((size_t) size)) == NULL) {
+        err = ERR_MEM;
+    } else if (fread(buffer, (size_t) size, 1, file) != 1) {
+        err = ERR_IO;
+    }
+    fclose(file);
+
+    if (err == ERR_NONE) {
+        err = gameboy_load_state(gameboy, buffer, (size_t) size);
+    }
+    free(buffer);
+    return err;
+}
@@ -0,0 +1,100 @@
+#pragma once
+
+/**
+ * @file savestate.h
+ * @brief Binary save states of a gameboy
+ *
+ * A state is a header followed by tagged sections:
+ *
+ *     header:  "GBST", version (u16), number of sections (u16), total size (u32)
+ *     section: tag (4 chars), payload size (u32), payload
+ *
+ * with the sections "CPU ", "TIME" (cycles, timer and, since version 3,
+ * render policy), "JOYP", "BUS " (boot flag and where every component is
+ * plugged), "MEM ", since version 2, "LCDC" (power, timing, DMA and
+ * window line of the LCD controller) and, since version 4, "SCRN" (the
+ * frame on display, as msb and lsb words of every line).
+ *
+ * Since version 3, "MEM" starts with the hash of the cartridge as loaded,
+ * which must match, then gives per component owning memory its size, a
+ * bitmap of its 256-byte pages and the pages set in it: those which differ
+ * from the cartridge as loaded, or from zeros for the other memories.
+ * Before, every memory was saved whole. States are thus of variable size,
+ * at most gameboy_state_size().
+ *
+ * Integers are little endian. Sections of unknown tag are skipped when
+ * loading, so that newer states stay readable as long as the version is
+ * not higher than ours; a version 1 state loads with the LCD off, and
+ * states older than version 4 with a blank display.
+ *
+ * The serial output is not part of the state.
+ *
+ * @date 2020
+ */
+
+#include <stddef.h>
+
+#include "gameboy.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define GB_STATE_VERSION 4
+
+/**
+ * @brief Largest size of the save state of a gameboy
+ *
+ * @param gameboy gameboy
+ * @return number of bytes gameboy_save_state() needs (0 on error)
+ */
+size_t gameboy_state_size(const gameboy_t* gameboy);
+
+
+/**
+ * @brief Saves the state of a gameboy to memory
+ *
+ * @param gameboy gameboy to save
+ * @param buffer where to write the state
+ * @param size size of buffer, at least gameboy_state_size()
+ * @param written size of the state (may be NULL); the buffer is zeroed
+ *        after it, up to gameboy_state_size()
+ * @return error code
+ */
+int gameboy_save_state(const gameboy_t* gameboy, void* buffer, size_t size, size_t* written);
+
+
+/**
+ * @brief Restores a gameboy (created on the same cartridge) from a saved state.
+ *        The gameboy is left untouched if the state is invalid.
+ *
+ * @param gameboy gameboy to restore
+ * @param buffer state, as written by gameboy_save_state()
+ * @param size size of the state
+ * @return error code
+ */
+int gameboy_load_state(gameboy_t* gameboy, const void* buffer, size_t size);
+
+
+/**
+ * @brief Saves the state of a gameboy to a file
+ *
+ * @param gameboy gameboy to save
+ * @param filename file to write
+ * @return error code
+ */
+int gameboy_save_state_file(const gameboy_t* gameboy, const char* filename);
+
+
+/**
+ * @brief Restores a gameboy from a state file
+ *
+ * @param gameboy gameboy to restore
+ * @param filename file to read
+ * @return error code
+ */
+int gameboy_load_state_file(gameboy_t* gameboy, const char* filename);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,189 @@
+/**
+ * @file scanline.c
+ * @brief Scanline fingerprints and dirty-line tracking for the LCD controller
+ *
+ * @date 2020
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#include "scanline.h"
+#include "sprite_index.h"
+#include "error.h"
+
+// FNV-1a, 64 bits
+#define FNV_OFFSET 0xCBF29CE484222325ULL
+#define FNV_PRIME  0x100000001B3ULL
+
+#define OAM_FLIP_Y_MASK  0x40
+
+#define TILE_HEIGHT 8
+
+#define LINE_MASK(y)  ((uint32_t) 1 << ((y) % 32))
+
+// ======================================================================
+static inline data_t peek(const bus_t bus, addr_t address)
+{
+    return bus[address] == NULL ? 0xFF : *bus[address];
+}
+
+// ======================================================================
+static inline void feed(uint64_t* hash, data_t byte)
+{
+    *hash = (*hash ^ byte) * FNV_PRIME;
+}
+
+// ======================================================================
+/**
+ * @brief feeds the two bytes of a background/window tile row
+ */
+static void feed_tile_row(uint64_t* hash, const bus_t bus, data_t lcdc, data_t tile_nb, size_t row)
+{
+    const addr_t base = (lcdc & LCDC_REG_TILE_SOURCE_MASK)
+                        ? (addr_t) (TILE_SRC_ADDR_LOW + tile_nb * TILE_SIZE)
+                        : (addr_t) (TILE_SRC_ADDR_HIGH + (tile_nb ^ 0x80) * TILE_SIZE);
+    const addr_t address = (addr_t) (base + 2 * row);
+    feed(hash, tile_nb);
+    feed(hash, peek(bus, address));
+    feed(hash, peek(bus, (addr_t) (address + 1)));
+}
+
+// ======================================================================
+/**
+ * @brief feeds nb_tiles consecutive (wrapping) entries of a tile map row
+ */
+static void feed_map_row(uint64_t* hash, const bus_t bus, data_t lcdc, addr_t map,
+                         size_t y, size_t first_tile, size_t nb_tiles)
+{
+    const addr_t row_start = (addr_t) (map + (y / TILE_HEIGHT) * TILE_LINE_SIZE);
+    for (size_t i = 0; i < nb_tiles; ++i) {
+        const data_t tile_nb = peek(bus, (addr_t) (row_start + (first_tile + i) % TILE_LINE_SIZE));
+        feed_tile_row(hash, bus, lcdc, tile_nb, y % TILE_HEIGHT);
+    }
+}
+
+// ======================================================================
+int scanline_tracker_init(scanline_tracker_t* tracker)
+{
+    M_REQUIRE_NON_NULL(tracker);
+    memset(tracker, 0, sizeof(scanline_tracker_t));
+    scanline_tracker_invalidate_all(tracker);
+    return ERR_NONE;
+}
+
+// ======================================================================
+void scanline_tracker_invalidate_all(scanline_tracker_t* tracker)
+{
+    if (tracker != NULL) {
+        memset(tracker -> valid, 0, sizeof(tracker -> valid));
+        for (size_t y = 0; y < LCD_HEIGHT; ++y) {
+            tracker -> dirty[y / 32] |= LINE_MASK(y);
+        }
+    }
+}
+
+// ======================================================================
+int scanline_fingerprint(const bus_t bus, size_t ly, data_t window_y, uint64_t* fingerprint)
+{
+    M_REQUIRE_NON_NULL(bus);
+    M_REQUIRE_NON_NULL(fingerprint);
+    M_REQUIRE(ly < LCD_HEIGHT, ERR_BAD_PARAMETER, "line %zu out of screen", ly);
+
+    uint64_t hash = FNV_OFFSET;
+    const data_t lcdc = peek(bus, REG_LCDC);
+    const data_t scy  = peek(bus, REG_SCY);
+    const data_t scx  = peek(bus, REG_SCX);
+    const data_t wy   = peek(bus, REG_WY);
+    const data_t wx   = peek(bus, REG_WX);
+
+    feed(&hash, lcdc);
+    feed(&hash, scy);
+    feed(&hash, scx);
+    feed(&hash, wy);
+    feed(&hash, wx);
+    feed(&hash, peek(bus, REG_BGP));
+    feed(&hash, peek(bus, REG_OBP0));
+    feed(&hash, peek(bus, REG_OBP1));
+
+    // background: the visible line may straddle one more tile than it covers
+    if (lcdc & LCDC_REG_BG_MASK) {
+        const addr_t map = (lcdc & LCDC_REG_BG_AREA_MASK) ? TILE_ADDR_BASE_HIGH : TILE_ADDR_BASE_LOW;
+        feed_map_row(&hash, bus, lcdc, map, (scy + ly) % (TILE_LINE_SIZE * TILE_HEIGHT),
+                     scx / TILE_HEIGHT, VISIBLE_LINE_SIZE + 1);
+    }
+
+    // window
+    if ((lcdc & LCDC_REG_WIN_MASK) && ly >= wy && wx < LCD_WIDTH + WINDOW_OFFSET_X) {
+        const addr_t map = (lcdc & LCDC_REG_WIN_AREA_MASK) ? TILE_ADDR_BASE_HIGH : TILE_ADDR_BASE_LOW;
+        const size_t start = wx > WINDOW_OFFSET_X ? (size_t) (wx - WINDOW_OFFSET_X) : 0;
+        feed(&hash, window_y);
+        feed_map_row(&hash, bus, lcdc, map, window_y, 0, (LCD_WIDTH - start) / TILE_HEIGHT + 1);
+    }
+
+    // sprites: the first SCANLINE_MAX_SPRITES entries overlapping the line
+    if (lcdc & LCDC_REG_OBJ_MASK) {
+        const size_t height = (lcdc & LCDC_REG_OBJ_SIZE_MASK) ? 2 * TILE_HEIGHT : TILE_HEIGHT;
+        size_t found = 0;
+        for (size_t i = 0; i < OAM_NB_SPRITES && found < SCANLINE_MAX_SPRITES; ++i) {
+            const addr_t entry = (addr_t) (OAM_START + i * OAM_ENTRY_SIZE);
+            const size_t y = ly + OAM_Y_OFFSET - peek(bus, entry);
+            if (y >= height) continue; // also catches sprites below the line (wrapped)
+
+            ++found;
+            const data_t attributes = peek(bus, (addr_t) (entry + 3));
+            data_t tile_nb = peek(bus, (addr_t) (entry + 2));
+            if (height > TILE_HEIGHT) tile_nb &= 0xFE;
+            const size_t row = (attributes & OAM_FLIP_Y_MASK) ? height - 1 - y : y;
+            const addr_t address = (addr_t) (TILE_SRC_ADDR_LOW + tile_nb * TILE_SIZE + 2 * row);
+
+            feed(&hash, (data_t) i);
+            for (addr_t b = 0; b < OAM_ENTRY_SIZE; ++b) {
+                feed(&hash, peek(bus, (addr_t) (entry + b)));
+            }
+            feed(&hash, peek(bus, address));
+            feed(&hash, peek(bus, (addr_t) (address + 1)));
+        }
+    }
+
+    *fingerprint = hash;
+    return ERR_NONE;
+}
+
+// ======================================================================
+bit_t scanline_tracker_update(scanline_tracker_t* tracker, size_t ly, uint64_t fingerprint)
+{
+    if (tracker == NULL || ly >= LCD_HEIGHT) {
+        return 1;
+    }
+
+    const uint32_t bit = LINE_MASK(ly);
+    if ((tracker -> valid[ly / 32] & bit) && tracker -> fingerprints[ly] == fingerprint) {
+        return 0;
+    }
+
+    tracker -> fingerprints[ly] = fingerprint;
+    tracker -> valid[ly / 32] |= bit;
+    tracker -> dirty[ly / 32] |= bit;
+    return 1;
+}
+
+// ======================================================================
+bit_t scanline_tracker_is_dirty(const scanline_tracker_t* tracker, size_t ly)
+{
+    if (tracker == NULL || ly >= LCD_HEIGHT) {
+        return 1;
+    }
+    return (tracker -> dirty[ly / 32] & LINE_MASK(ly)) != 0;
+}
+
+// ======================================================================
+int scanline_tracker_take_dirty(scanline_tracker_t* tracker, scanline_mask_t mask)
+{
+    M_REQUIRE_NON_NULL(tracker);
+    M_REQUIRE_NON_NULL(mask);
+
+    memcpy(mask, tracker -> dirty, sizeof(scanline_mask_t));
+    memset(tracker -> dirty, 0, sizeof(tracker -> dirty));
+    return ERR_NONE;
+}
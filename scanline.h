@@ -0,0 +1,112 @@
+#pragma once
+
+/**
+ * @file scanline.h
+ * @brief Scanline fingerprints and dirty-line tracking for the LCD controller
+ *
+ * A fingerprint covers everything a line depends on (map row, referenced
+ * tile rows, scroll/window registers, palettes and sprites on the line).
+ * The LCD controller updates the tracker before composing each line and
+ * keeps the image line drawn last when the fingerprint did not change;
+ * changed lines are accumulated in a dirty-line mask, which front ends
+ * take to convert only those lines of the display.
+ *
+ * @date 2020
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "bus.h"
+#include "bit.h"
+#include "lcdc.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SCANLINE_MASK_WORDS ((LCD_HEIGHT + 31) / 32)
+
+// Maximum number of sprites drawn on a single line
+#define SCANLINE_MAX_SPRITES 10
+
+/**
+ * @brief Dirty-line mask: bit (y % 32) of word (y / 32) for line y
+ */
+typedef uint32_t scanline_mask_t[SCANLINE_MASK_WORDS];
+
+#define scanline_mask_get(mask, y) (((mask)[(y) / 32] >> ((y) % 32)) & 1)
+
+/**
+ * @brief Scanline tracker type
+ */
+typedef struct {
+    uint64_t fingerprints[LCD_HEIGHT];
+    scanline_mask_t valid; // lines whose fingerprint is known
+    scanline_mask_t dirty; // lines changed since the last scanline_tracker_take_dirty()
+} scanline_tracker_t;
+
+
+/**
+ * @brief Initiates a scanline tracker (every line is unknown, hence dirty)
+ *
+ * @param tracker tracker to initiate
+ * @return error code
+ */
+int scanline_tracker_init(scanline_tracker_t* tracker);
+
+
+/**
+ * @brief Forgets every fingerprint, so that every line is composed again
+ *        (e.g. when the LCD is switched on or the display is reallocated)
+ *
+ * @param tracker tracker
+ */
+void scanline_tracker_invalidate_all(scanline_tracker_t* tracker);
+
+
+/**
+ * @brief Computes the fingerprint of the inputs of a line
+ *
+ * @param bus bus to read VRAM, OAM and LCD registers from
+ * @param ly line number (0 to LCD_HEIGHT - 1)
+ * @param window_y internal window line counter for that line
+ * @param fingerprint where to write the fingerprint
+ * @return error code
+ */
+int scanline_fingerprint(const bus_t bus, size_t ly, data_t window_y, uint64_t* fingerprint);
+
+
+/**
+ * @brief Records the fingerprint of a line about to be composed
+ *
+ * @param tracker tracker
+ * @param ly line number (0 to LCD_HEIGHT - 1)
+ * @param fingerprint fingerprint of the line inputs
+ * @return 1 if the line changed and has to be composed, 0 if the previous one can be kept
+ */
+bit_t scanline_tracker_update(scanline_tracker_t* tracker, size_t ly, uint64_t fingerprint);
+
+
+/**
+ * @brief Tells whether a line changed since the last scanline_tracker_take_dirty()
+ *
+ * @param tracker tracker
+ * @param ly line number
+ * @return 1 if dirty (or invalid arguments), 0 otherwise
+ */
+bit_t scanline_tracker_is_dirty(const scanline_tracker_t* tracker, size_t ly);
+
+
+/**
+ * @brief Gets and clears the dirty-line mask
+ *
+ * @param tracker tracker
+ * @param mask where to copy the mask of lines changed since the previous call
+ * @return error code
+ */
+int scanline_tracker_take_dirty(scanline_tracker_t* tracker, scanline_mask_t mask);
+
+#ifdef __cplusplus
+}
+#endif
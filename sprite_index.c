@@ -0,0 +1,124 @@
+/**
+ * @file sprite_index.c
+ * @brief Line to sprite index, maintained incrementally from OAM writes
+ *
+ * @date 2020
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#include "sprite_index.h"
+#include "error.h"
+
+#define OAM_END (OAM_START + OAM_NB_SPRITES * OAM_ENTRY_SIZE - 1)
+
+#define SPRITE_HEIGHT(index) ((index) -> tall ? 16 : 8)
+
+// ======================================================================
+static inline data_t peek(const bus_t bus, addr_t address)
+{
+    return bus[address] == NULL ? 0xFF : *bus[address];
+}
+
+// ======================================================================
+/**
+ * @brief sets or clears the bit of sprite nb on every screen line a
+ *        sprite at OAM coordinate y would cover
+ */
+static void mark_lines(sprite_index_t* index, size_t nb, data_t y, bit_t set)
+{
+    const uint64_t bit = (uint64_t) 1 << nb;
+    const int height = SPRITE_HEIGHT(index);
+    const int top = (int) y - OAM_Y_OFFSET;
+
+    const int first = top < 0 ? 0 : top;
+    const int last = top + height > LCD_HEIGHT ? LCD_HEIGHT : top + height;
+    for (int ly = first; ly < last; ++ly) {
+        if (set) {
+            index -> lines[ly] |= bit;
+        } else {
+            index -> lines[ly] &= ~bit;
+        }
+    }
+}
+
+// ======================================================================
+int sprite_index_init(sprite_index_t* index, const bus_t bus)
+{
+    M_REQUIRE_NON_NULL(index);
+    M_REQUIRE_NON_NULL(bus);
+    memset(index, 0, sizeof(sprite_index_t));
+    return sprite_index_rebuild(index, bus);
+}
+
+// ======================================================================
+int sprite_index_rebuild(sprite_index_t* index, const bus_t bus)
+{
+    M_REQUIRE_NON_NULL(index);
+    M_REQUIRE_NON_NULL(bus);
+
+    memset(index -> lines, 0, sizeof(index -> lines));
+    index -> tall = (peek(bus, REG_LCDC) & LCDC_REG_OBJ_SIZE_MASK) != 0;
+    for (size_t i = 0; i < OAM_NB_SPRITES; ++i) {
+        index -> y[i] = peek(bus, (addr_t) (OAM_START + i * OAM_ENTRY_SIZE));
+        mark_lines(index, i, index -> y[i], 1);
+    }
+    index -> stale = 0;
+
+    return ERR_NONE;
+}
+
+// ======================================================================
+int sprite_index_bus_listener(sprite_index_t* index, const bus_t bus, addr_t address)
+{
+    M_REQUIRE_NON_NULL(index);
+    M_REQUIRE_NON_NULL(bus);
+
+    if (address == REG_DMA) {
+        index -> stale = 1;
+    } else if (address == REG_LCDC) {
+        const bit_t tall = (peek(bus, REG_LCDC) & LCDC_REG_OBJ_SIZE_MASK) != 0;
+        index -> stale |= tall != index -> tall;
+    } else if (!index -> stale) {
+        // 16-bit writes only report their first address
+        for (unsigned int offset = 0; offset <= 1; ++offset) {
+            const unsigned int a = address + offset;
+            if (a >= OAM_START && a <= OAM_END && (a - OAM_START) % OAM_ENTRY_SIZE == 0) {
+                const size_t nb = (size_t) (a - OAM_START) / OAM_ENTRY_SIZE;
+                const data_t y = peek(bus, (addr_t) a);
+                if (y != index -> y[nb]) {
+                    mark_lines(index, nb, index -> y[nb], 0);
+                    mark_lines(index, nb, y, 1);
+                    index -> y[nb] = y;
+                }
+            }
+        }
+    }
+
+    return ERR_NONE;
+}
+
+// ======================================================================
+int sprite_index_get_line(sprite_index_t* index, const bus_t bus, size_t ly,
+                          data_t sprites[SPRITE_INDEX_MAX_PER_LINE], size_t* nb_sprites)
+{
+    M_REQUIRE_NON_NULL(index);
+    M_REQUIRE_NON_NULL(bus);
+    M_REQUIRE_NON_NULL(sprites);
+    M_REQUIRE_NON_NULL(nb_sprites);
+    M_REQUIRE(ly < LCD_HEIGHT, ERR_BAD_PARAMETER, "line %zu out of screen", ly);
+
+    if (index -> stale) {
+        M_REQUIRE_NO_ERR(sprite_index_rebuild(index, bus));
+    }
+
+    size_t count = 0;
+    for (uint64_t mask = index -> lines[ly]; mask != 0 && count < SPRITE_INDEX_MAX_PER_LINE;
+         mask &= mask - 1) {
+        sprites[count++] = (data_t) __builtin_ctzll(mask);
+    }
+    *nb_sprites = count;
+
+    return ERR_NONE;
+}
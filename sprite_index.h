@@ -0,0 +1,97 @@
+#pragma once
+
+/**
+ * @file sprite_index.h
+ * @brief Line to sprite index, maintained incrementally from OAM writes
+ *
+ * For every screen line, a 40-bit mask tells which OAM entries overlap
+ * the line. The mask of a sprite is moved when its OAM y coordinate is
+ * written, and every mask is rebuilt when the object size changes or
+ * after an OAM DMA, so that a line query never scans the whole OAM.
+ *
+ * The Game Boy keeps the index up to date from its bus listener, and the
+ * LCD controller queries it for the sprites of each line it draws.
+ *
+ * @date 2020
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "bus.h"
+#include "bit.h"
+#include "lcdc.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define OAM_START           0xFE00
+#define OAM_NB_SPRITES      40
+#define OAM_ENTRY_SIZE      4
+#define OAM_Y_OFFSET        16
+#define OAM_X_OFFSET        8
+
+// Maximum number of sprites selected for a single line
+#define SPRITE_INDEX_MAX_PER_LINE 10
+
+/**
+ * @brief Sprite index type
+ */
+typedef struct {
+    uint64_t lines[LCD_HEIGHT];  // bit i set if OAM entry i overlaps the line
+    data_t y[OAM_NB_SPRITES];    // OAM y coordinate each mask was built from
+    bit_t tall;                  // 8x16 objects
+    bit_t stale;                 // OAM rewritten by DMA, rebuild on next query
+} sprite_index_t;
+
+
+/**
+ * @brief Initiates a sprite index from the current OAM and LCDC contents
+ *
+ * @param index sprite index to initiate
+ * @param bus bus OAM and LCD registers are plugged onto
+ * @return error code
+ */
+int sprite_index_init(sprite_index_t* index, const bus_t bus);
+
+
+/**
+ * @brief Rebuilds the whole index from OAM and LCDC
+ *
+ * @param index sprite index
+ * @param bus bus OAM and LCD registers are plugged onto
+ * @return error code
+ */
+int sprite_index_rebuild(sprite_index_t* index, const bus_t bus);
+
+
+/**
+ * @brief Sprite index bus listening handler: updates the sprite whose
+ *        OAM entry was written, or schedules a rebuild on DMA and object
+ *        size changes
+ *
+ * @param index sprite index
+ * @param bus bus OAM and LCD registers are plugged onto
+ * @param address trigger address
+ * @return error code
+ */
+int sprite_index_bus_listener(sprite_index_t* index, const bus_t bus, addr_t address);
+
+
+/**
+ * @brief Gets the sprites selected for a line, in OAM (priority) order
+ *
+ * @param index sprite index
+ * @param bus bus OAM and LCD registers are plugged onto
+ * @param ly line number (0 to LCD_HEIGHT - 1)
+ * @param sprites where to write the selected OAM entry numbers
+ * @param nb_sprites where to write the number of selected sprites
+ * @return error code
+ */
+int sprite_index_get_line(sprite_index_t* index, const bus_t bus, size_t ly,
+                          data_t sprites[SPRITE_INDEX_MAX_PER_LINE], size_t* nb_sprites);
+
+#ifdef __cplusplus
+}
+#endif
@@ -7,6 +7,8 @@
  */
 
 #include "gameboy.h"
+#include "frame_dump.h"
+#include "movie.h"
 #include "util.h"  // for zero_init_var()
 #include "error.h"
 
@@ -22,9 +24,13 @@ static void error(const char* pgm, const char* msg)
 {
     fputs("ERROR: ", stderr);
     if (msg != NULL) fputs(msg, stderr);
-    fprintf(stderr, "\nusage:    %s input_file [iterations]\n", pgm);
+    fprintf(stderr, "\nusage:    %s [-f] [-m movie_file] input_file [iterations [frames_file]]\n", pgm);
     fprintf(stderr, "examples: %s rom.gb 1000\n", pgm);
     fprintf(stderr, "          %s game.gb\n", pgm);
+    fprintf(stderr, "          %s game.gb 1000000 frames.y4m   (or .ppm, .png)\n", pgm);
+    fprintf(stderr, "          %s -m run.gbm game.gb           (replays the whole movie)\n", pgm);
+    fprintf(stderr, "          %s -m run.gbm game.gb 2500000000 (seeks in the movie)\n", pgm);
+    fprintf(stderr, "          %s -f game.gb 1000000           (skips the boot ROM)\n", pgm);
 }
 
 // ======================================================================
@@ -83,11 +89,63 @@ int cpu_dump_to_file(const char* filename, cpu_t* cpu)
     return ERR_NONE;
 }
 
+// ======================================================================
+/**
+ * @brief runs until the given cycle, replaying the input of the movie if any
+ */
+static int run_until(gameboy_t* gb, movie_t* movie, uint64_t cycle)
+{
+    return movie != NULL ? movie_run_until(movie, gb, cycle) : gameboy_run_until(gb, cycle);
+}
+
+// ======================================================================
+/**
+ * @brief runs until the given cycle, capturing every completed frame
+ */
+static int run_and_capture(gameboy_t* gb, movie_t* movie, uint64_t cycle, const char* filename)
+{
+    frame_dump_t dump;
+    M_REQUIRE_NO_ERR(frame_dump_open(&dump, filename, frame_dump_format_from_name(filename),
+                                     FRAME_DUMP_DEFAULT_RING_SIZE));
+
+    int err = ERR_NONE;
+    while (err == ERR_NONE && gb->cycles < cycle) {
+        const uint64_t frame_end = (gb->cycles / FRAME_TOTAL_CYCLES + 1) * FRAME_TOTAL_CYCLES;
+        const int complete = frame_end <= cycle;
+        err = run_until(gb, movie, complete ? frame_end : cycle);
+        if (err == ERR_NONE && complete) {
+            err = frame_dump_push_image(&dump, &(gb->screen.display));
+        }
+    }
+
+    const int dump_err = frame_dump_close(&dump);
+    fprintf(stderr, "frames: %" PRIu64 " written, %" PRIu64 " dropped\n",
+            (uint64_t) dump.written, dump.dropped);
+    return err != ERR_NONE ? err : dump_err;
+}
+
 // ======================================================================
 int main(int argc, char* argv[])
 {
+    const char* const pgm = argv[0];
+    const char* movie_name = NULL;
+    boot_mode_t boot = BOOT_WITH_ROM;
+    for (int done = 0; !done && argc > 1; ) {
+        if (strcmp(argv[1], "-f") == 0) {
+            boot = BOOT_FAST;
+            --argc;
+            ++argv;
+        } else if (argc > 2 && strcmp(argv[1], "-m") == 0) {
+            movie_name = argv[2];
+            argc -= 2;
+            argv += 2;
+        } else {
+            done = 1;
+        }
+    }
+
     if (argc < 2) {
-        error(argv[0], "please provide input_file");
+        error(pgm, "please provide input_file");
         return 1;
     }
 
@@ -95,18 +153,51 @@ int main(int argc, char* argv[])
 
     gameboy_t gb;
     zero_init_var(gb);
-    int err = gameboy_create(&gb, filename);
+    int err = gameboy_create_with_boot(&gb, filename, boot);
     if (err != ERR_NONE) {
         gameboy_free(&gb);
         return err;
     }
 
+#ifdef BLARGG
+    // test ROMs report their results through the serial port
+    gameboy_set_serial(&gb, stdout);
+#endif
+
+    movie_t movie;
+    zero_init_var(movie);
+    if (movie_name != NULL) {
+        err = movie_replay_open(&movie, movie_name, &gb);
+        if (err != ERR_NONE) {
+            gameboy_free(&gb);
+            return err;
+        }
+    }
+    movie_t* const replay = movie_name != NULL ? &movie : NULL;
+
     uint64_t cycle = 1;
     if (argc > 2) {
         cycle = (uint64_t) atoll(argv[2]);
     }
 
-    err = gameboy_run_until(&gb, cycle);
+    if (argc > 3) {
+        err = run_and_capture(&gb, replay, cycle, argv[3]);
+    } else {
+        // only CPU and memory are dumped: no need to draw any frame
+        gameboy_set_render_policy(&gb, RENDER_NEVER, 0);
+        if (replay != NULL && argc == 2) {
+            err = movie_run_to_end(replay, &gb);
+        } else if (replay != NULL) {
+            // from the keyframe before the cycle, if the movie has any
+            err = movie_seek(replay, &gb, cycle);
+        } else {
+            err = run_until(&gb, replay, cycle);
+        }
+    }
+    if (replay != NULL) {
+        fprintf(stderr, "movie: %" PRIu64 " key changes replayed\n", replay -> events);
+        movie_close(replay, NULL);
+    }
     if (err == ERR_NONE) {
         cpu_dump_to_file("dump_cpu.txt", &(gb.cpu));
         mem_dump_to_file("dump_mem.bin", gb.components);
@@ -0,0 +1,46 @@
+#pragma once
+
+/**
+ * @file tests-snapshot.h
+ * @brief Gameboy snapshots for tests: what a run must reproduce
+ *
+ * @date 2020
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#include "gameboy.h"
+
+/**
+ * @brief Whole bus content, CPU registers and frame on display
+ */
+typedef struct {
+    uint16_t AF, BC, DE, HL, PC, SP;
+    uint8_t IME, IE, IF, HALT;
+    uint64_t cycles;
+    data_t memory[BUS_SIZE];
+    uint32_t display[LCD_HEIGHT][BIT_VECTOR_CHUNKS(LCD_WIDTH)][2];
+} snapshot_t;
+
+// ======================================================================
+static inline void take_snapshot(snapshot_t* s, const gameboy_t* gb)
+{
+    memset(s, 0, sizeof(*s));
+    s -> AF = gb -> cpu.AF; s -> BC = gb -> cpu.BC;
+    s -> DE = gb -> cpu.DE; s -> HL = gb -> cpu.HL;
+    s -> PC = gb -> cpu.PC; s -> SP = gb -> cpu.SP;
+    s -> IME = gb -> cpu.IME; s -> IE = gb -> cpu.IE;
+    s -> IF = gb -> cpu.IF; s -> HALT = gb -> cpu.HALT;
+    s -> cycles = gb -> cycles;
+    for (size_t addr = 0; addr < BUS_SIZE; ++addr) {
+        if (gb -> bus[addr] != NULL) s -> memory[addr] = *(gb -> bus[addr]);
+    }
+    if (gb -> screen.display.content == NULL) return;
+    for (size_t y = 0; y < LCD_HEIGHT; ++y) {
+        for (size_t w = 0; w < BIT_VECTOR_CHUNKS(LCD_WIDTH); ++w) {
+            s -> display[y][w][0] = gb -> screen.display.content[y].msb -> content[w];
+            s -> display[y][w][1] = gb -> screen.display.content[y].lsb -> content[w];
+        }
+    }
+}
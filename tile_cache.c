@@ -0,0 +1,141 @@
+/**
+ * @file tile_cache.c
+ * @brief Cache of predecoded 2bpp tiles for the Game Boy LCD controller
+ *
+ * @date 2020
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#include "tile_cache.h"
+#include "error.h"
+
+#define TILE_DATA_END (TILE_SRC_ADDR_LOW + TILE_CACHE_NB_TILES * TILE_SIZE)
+
+#define is_dirty(cache, i) (((cache) -> dirty[(i) / 32] >> ((i) % 32)) & 1)
+
+// ======================================================================
+/**
+ * @brief Decodes the 16 bytes of a tile, as is and horizontally flipped
+ *
+ * @param cache tile cache
+ * @param index tile index
+ */
+static void tile_cache_decode(tile_cache_t* cache, size_t index)
+{
+    const data_t* src = cache -> vram -> mem -> memory + index * TILE_SIZE;
+
+    for (size_t y = 0; y < TILE_PIXELS; ++y) {
+        const data_t lsb = src[2 * y];
+        const data_t msb = src[2 * y + 1];
+        for (size_t x = 0; x < TILE_PIXELS; ++x) {
+            // leftmost pixel is bit 7
+            const int bit = MSB_INDEX_8 - (int) x;
+            const uint8_t color = (uint8_t) ((((msb >> bit) & 1) << 1) | ((lsb >> bit) & 1));
+            cache -> tiles[index][y][x] = color;
+            cache -> flipped[index][y][TILE_PIXELS - 1 - x] = color;
+        }
+    }
+
+    cache -> dirty[index / 32] &= ~(UINT32_C(1) << (index % 32));
+}
+
+// ======================================================================
+int tile_cache_init(tile_cache_t* cache, const component_t* vram)
+{
+    M_REQUIRE_NON_NULL(cache);
+    M_REQUIRE_NON_NULL(vram);
+    M_REQUIRE_NON_NULL(vram -> mem);
+    M_REQUIRE_NON_NULL(vram -> mem -> memory);
+    M_REQUIRE(vram -> mem -> size >= TILE_CACHE_NB_TILES * TILE_SIZE, ERR_BAD_PARAMETER,
+              "video RAM too small (%zu bytes)", vram -> mem -> size);
+
+    cache -> vram = vram;
+    tile_cache_invalidate_all(cache);
+
+    return ERR_NONE;
+}
+
+// ======================================================================
+void tile_cache_invalidate_all(tile_cache_t* cache)
+{
+    if (cache != NULL) {
+        memset(cache -> dirty, 0xFF, sizeof(cache -> dirty));
+    }
+}
+
+// ======================================================================
+int tile_cache_bus_listener(tile_cache_t* cache, addr_t addr)
+{
+    M_REQUIRE_NON_NULL(cache);
+
+    // 16-bit writes only report their first address: also cover addr + 1
+    for (uint32_t a = addr; a <= (uint32_t) addr + 1; ++a) {
+        if (a >= TILE_SRC_ADDR_LOW && a < TILE_DATA_END) {
+            const size_t index = (a - TILE_SRC_ADDR_LOW) / TILE_SIZE;
+            cache -> dirty[index / 32] |= UINT32_C(1) << (index % 32);
+        }
+    }
+
+    return ERR_NONE;
+}
+
+// ======================================================================
+size_t tile_cache_index(data_t tile_nb, bit_t tile_source)
+{
+    if (tile_source) {
+        return tile_nb;
+    }
+    // signed addressing: tile 0 is at 0x9000, tiles 128-255 at 0x8800
+    return (size_t) ((TILE_SRC_ADDR_HIGH - TILE_SRC_ADDR_LOW) / TILE_SIZE) + (tile_nb ^ 0x80);
+}
+
+// ======================================================================
+const tile_pixels_t* tile_cache_get(tile_cache_t* cache, size_t index, bit_t flip_x)
+{
+    if (cache == NULL || cache -> vram == NULL || index >= TILE_CACHE_NB_TILES) {
+        return NULL;
+    }
+
+    if (is_dirty(cache, index)) {
+        tile_cache_decode(cache, index);
+    }
+
+    return (const tile_pixels_t*) (flip_x ? &cache -> flipped[index] : &cache -> tiles[index]);
+}
+
+// ======================================================================
+const uint8_t* tile_cache_get_row(tile_cache_t* cache, size_t index, size_t row,
+                                  bit_t flip_x, bit_t flip_y)
+{
+    if (row >= TILE_PIXELS) {
+        return NULL;
+    }
+
+    const tile_pixels_t* tile = tile_cache_get(cache, index, flip_x);
+    if (tile == NULL) {
+        return NULL;
+    }
+
+    return (*tile)[flip_y ? TILE_PIXELS - 1 - row : row];
+}
+
+// ======================================================================
+int tile_cache_map_row(tile_cache_t* cache, const data_t* map_row, size_t nb_tiles,
+                       bit_t tile_source, size_t row, uint8_t* output)
+{
+    M_REQUIRE_NON_NULL(cache);
+    M_REQUIRE_NON_NULL(map_row);
+    M_REQUIRE_NON_NULL(output);
+    M_REQUIRE(row < TILE_PIXELS, ERR_BAD_PARAMETER, "Invalid row (%zu >= %d)", row, TILE_PIXELS);
+
+    for (size_t i = 0; i < nb_tiles; ++i) {
+        const uint8_t* pixels = tile_cache_get_row(cache, tile_cache_index(map_row[i], tile_source),
+                                                   row, 0, 0);
+        M_REQUIRE_NON_NULL(pixels);
+        memcpy(output + i * TILE_PIXELS, pixels, TILE_PIXELS);
+    }
+
+    return ERR_NONE;
+}
@@ -0,0 +1,130 @@
+#pragma once
+
+/**
+ * @file tile_cache.h
+ * @brief Cache of predecoded 2bpp tiles for the Game Boy LCD controller
+ *
+ * @date 2020
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "memory.h"
+#include "component.h"
+#include "bit.h"
+#include "lcdc.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Number of tiles held in the tile data area (0x8000 - 0x97FF)
+#define TILE_CACHE_NB_TILES 384
+
+// Width and height of a tile, in pixels
+#define TILE_PIXELS 8
+
+#define TILE_CACHE_DIRTY_WORDS (TILE_CACHE_NB_TILES / 32)
+
+/**
+ * @brief A decoded tile: one color index (0 to 3) per pixel, row-major
+ */
+typedef uint8_t tile_pixels_t[TILE_PIXELS][TILE_PIXELS];
+
+/**
+ * @brief Tile cache type.
+ *        Holds every tile of the tile data area, both as is and
+ *        horizontally flipped, together with one dirty bit per tile.
+ */
+typedef struct {
+    const component_t* vram;
+    uint32_t dirty[TILE_CACHE_DIRTY_WORDS];
+    tile_pixels_t tiles[TILE_CACHE_NB_TILES];
+    tile_pixels_t flipped[TILE_CACHE_NB_TILES];
+} tile_cache_t;
+
+
+/**
+ * @brief Initiates a tile cache on top of the video RAM component
+ *        (every tile starts dirty)
+ *
+ * @param cache tile cache to initiate
+ * @param vram video RAM component (mapped from TILE_SRC_ADDR_LOW)
+ * @return error code
+ */
+int tile_cache_init(tile_cache_t* cache, const component_t* vram);
+
+
+/**
+ * @brief Marks every tile as dirty
+ *
+ * @param cache tile cache
+ */
+void tile_cache_invalidate_all(tile_cache_t* cache);
+
+
+/**
+ * @brief Tile cache bus listening handler: marks the tile containing
+ *        the written address (if any) as dirty
+ *
+ * @param cache tile cache
+ * @param addr trigger address
+ * @return error code
+ */
+int tile_cache_bus_listener(tile_cache_t* cache, addr_t addr);
+
+
+/**
+ * @brief Converts a tile number read from a tile map into a cache index
+ *
+ * @param tile_nb tile number
+ * @param tile_source value of the LCDC_REG_TILE_SOURCE_MASK bit of LCDC
+ * @return tile index in the cache (between 0 and TILE_CACHE_NB_TILES - 1)
+ */
+size_t tile_cache_index(data_t tile_nb, bit_t tile_source);
+
+
+/**
+ * @brief Gets a decoded tile, decoding it first if it is dirty
+ *
+ * @param cache tile cache
+ * @param index tile index (see tile_cache_index())
+ * @param flip_x whether the tile is wanted horizontally flipped
+ * @return pointer to the decoded tile, NULL on bad parameters
+ */
+const tile_pixels_t* tile_cache_get(tile_cache_t* cache, size_t index, bit_t flip_x);
+
+
+/**
+ * @brief Gets one decoded row of a tile
+ *
+ * @param cache tile cache
+ * @param index tile index (see tile_cache_index())
+ * @param row row index inside the tile (0 to 7)
+ * @param flip_x whether the row is wanted horizontally flipped
+ * @param flip_y whether the tile is vertically flipped
+ * @return pointer to the TILE_PIXELS color indices of the row, NULL on bad parameters
+ */
+const uint8_t* tile_cache_get_row(tile_cache_t* cache, size_t index, size_t row,
+                                  bit_t flip_x, bit_t flip_y);
+
+
+/**
+ * @brief Expands one pixel line of a row of tile numbers (typically a
+ *        TILE_LINE_SIZE tile map row) into color indices
+ *
+ * @param cache tile cache
+ * @param map_row tile numbers, as read from a tile map
+ * @param nb_tiles number of tiles in map_row
+ * @param tile_source value of the LCDC_REG_TILE_SOURCE_MASK bit of LCDC
+ * @param row row index inside the tiles (0 to 7)
+ * @param output buffer of at least nb_tiles * TILE_PIXELS color indices
+ * @return error code
+ */
+int tile_cache_map_row(tile_cache_t* cache, const data_t* map_row, size_t nb_tiles,
+                       bit_t tile_source, size_t row, uint8_t* output);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,368 @@
+/**
+ * @file tile_decode.c
+ * @brief Decoding of 2bpp tile rows into image lines, with vectorised kernels
+ *
+ * The kernels turn the (lsb, msb) byte pairs of a strip of tile rows into
+ * one palette-mapped byte per tile and per plane, pixel k of the tile being
+ * bit k (the image_line_t bit order). A final pass assembles these bytes
+ * into image line words, applying the scroll with byte-granular funnel shifts.
+ *
+ * @date 2020
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include <stdatomic.h>
+
+#include "tile_decode.h"
+#include "tile_cache.h" // TILE_PIXELS
+#include "lcdc.h"
+#include "error.h"
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define TILE_DECODE_X86 1
+#include <immintrin.h>
+#endif
+
+// extra strip bytes, replicated from the start, so that any 32-bit window can be read linearly
+#define STRIP_PADDING 8
+
+// ======================================================================
+/**
+ * @brief bit-reversed bytes: leftmost pixel (bit 7) becomes bit 0
+ */
+#define R2(n) n, n + 2 * 64, n + 1 * 64, n + 3 * 64
+#define R4(n) R2(n), R2(n + 2 * 16), R2(n + 1 * 16), R2(n + 3 * 16)
+#define R6(n) R4(n), R4(n + 2 * 4 ), R4(n + 1 * 4 ), R4(n + 3 * 4 )
+static const uint8_t reversed[256] = { R6(0), R6(2), R6(1), R6(3) };
+#undef R6
+#undef R4
+#undef R2
+
+/**
+ * @brief maps one color plane through a palette, given the all-ones or
+ *        all-zeros masks T0..T3 of the palette bits for that plane.
+ *        Works on any integer or GCC vector type.
+ */
+#define PALETTE_PLANE(l, m, T0, T1, T2, T3) \
+    (((((T3) & (l)) | ((T2) & ~(l))) & (m)) | ((((T1) & (l)) | ((T0) & ~(l))) & ~(m)))
+
+/**
+ * @brief palette bit masks, one byte per color and per plane
+ */
+typedef struct {
+    uint8_t lsb[PALETTE_COLOR_COUNT];
+    uint8_t msb[PALETTE_COLOR_COUNT];
+} palette_masks_t;
+
+typedef void (*kernel_fn)(const data_t* rows, size_t nb_tiles, bit_t flip_x,
+                          const palette_masks_t* pal, uint8_t* lsb, uint8_t* msb, uint8_t* opacity);
+
+// ======================================================================
+static void palette_masks(palette_t palette, palette_masks_t* pal)
+{
+    for (int c = 0; c < PALETTE_COLOR_COUNT; ++c) {
+        pal -> lsb[c] = ((palette >> (2 * c))     & 1) ? 0xFF : 0x00;
+        pal -> msb[c] = ((palette >> (2 * c + 1)) & 1) ? 0xFF : 0x00;
+    }
+}
+
+// ======================================================================
+static void decode_scalar_range(const data_t* rows, size_t from, size_t to, bit_t flip_x,
+                                const palette_masks_t* pal, uint8_t* lsb, uint8_t* msb, uint8_t* opacity)
+{
+    const uint8_t* const L = pal -> lsb;
+    const uint8_t* const M = pal -> msb;
+
+    for (size_t i = from; i < to; ++i) {
+        uint8_t l = rows[2 * i];
+        uint8_t m = rows[2 * i + 1];
+        if (!flip_x) {
+            l = reversed[l];
+            m = reversed[m];
+        }
+        lsb[i]     = (uint8_t) PALETTE_PLANE(l, m, L[0], L[1], L[2], L[3]);
+        msb[i]     = (uint8_t) PALETTE_PLANE(l, m, M[0], M[1], M[2], M[3]);
+        opacity[i] = (uint8_t) (l | m);
+    }
+}
+
+// ----------------------------------------------------------------------
+static void decode_scalar(const data_t* rows, size_t nb_tiles, bit_t flip_x,
+                          const palette_masks_t* pal, uint8_t* lsb, uint8_t* msb, uint8_t* opacity)
+{
+    decode_scalar_range(rows, 0, nb_tiles, flip_x, pal, lsb, msb, opacity);
+}
+
+#ifdef TILE_DECODE_X86
+// ======================================================================
+#define BYTES_TO_WORD(b) ((uint32_t) (b) * UINT32_C(0x01010101))
+
+__attribute__((target("bmi2")))
+static void decode_bmi2(const data_t* rows, size_t nb_tiles, bit_t flip_x,
+                        const palette_masks_t* pal, uint8_t* lsb, uint8_t* msb, uint8_t* opacity)
+{
+    uint32_t L[PALETTE_COLOR_COUNT], M[PALETTE_COLOR_COUNT];
+    for (int c = 0; c < PALETTE_COLOR_COUNT; ++c) {
+        L[c] = BYTES_TO_WORD(pal -> lsb[c]);
+        M[c] = BYTES_TO_WORD(pal -> msb[c]);
+    }
+
+    size_t i = 0;
+    for (; i + 4 <= nb_tiles; i += 4) {
+        uint64_t pairs;
+        memcpy(&pairs, rows + 2 * i, sizeof(pairs));
+        uint32_t l = (uint32_t) _pext_u64(pairs, UINT64_C(0x00FF00FF00FF00FF));
+        uint32_t m = (uint32_t) _pext_u64(pairs, UINT64_C(0xFF00FF00FF00FF00));
+        if (!flip_x) {
+#define REVERSE_BYTES_BITS(x) \
+            x = ((x >> 1) & UINT32_C(0x55555555)) | ((x & UINT32_C(0x55555555)) << 1); \
+            x = ((x >> 2) & UINT32_C(0x33333333)) | ((x & UINT32_C(0x33333333)) << 2); \
+            x = ((x >> 4) & UINT32_C(0x0F0F0F0F)) | ((x & UINT32_C(0x0F0F0F0F)) << 4)
+            REVERSE_BYTES_BITS(l);
+            REVERSE_BYTES_BITS(m);
+#undef REVERSE_BYTES_BITS
+        }
+        const uint32_t out_l = PALETTE_PLANE(l, m, L[0], L[1], L[2], L[3]);
+        const uint32_t out_m = PALETTE_PLANE(l, m, M[0], M[1], M[2], M[3]);
+        const uint32_t out_o = l | m;
+        memcpy(lsb + i, &out_l, sizeof(out_l));
+        memcpy(msb + i, &out_m, sizeof(out_m));
+        memcpy(opacity + i, &out_o, sizeof(out_o));
+    }
+
+    decode_scalar_range(rows, i, nb_tiles, flip_x, pal, lsb, msb, opacity);
+}
+
+// ======================================================================
+__attribute__((target("sse2")))
+static void decode_sse2(const data_t* rows, size_t nb_tiles, bit_t flip_x,
+                        const palette_masks_t* pal, uint8_t* lsb, uint8_t* msb, uint8_t* opacity)
+{
+    __m128i L[PALETTE_COLOR_COUNT], M[PALETTE_COLOR_COUNT];
+    for (int c = 0; c < PALETTE_COLOR_COUNT; ++c) {
+        L[c] = _mm_set1_epi8((char) pal -> lsb[c]);
+        M[c] = _mm_set1_epi8((char) pal -> msb[c]);
+    }
+    const __m128i low_bytes = _mm_set1_epi16(0x00FF);
+    const __m128i m55 = _mm_set1_epi8(0x55);
+    const __m128i m33 = _mm_set1_epi8(0x33);
+    const __m128i m0F = _mm_set1_epi8(0x0F);
+
+    size_t i = 0;
+    for (; i + 16 <= nb_tiles; i += 16) {
+        const __m128i v0 = _mm_loadu_si128((const __m128i*) (rows + 2 * i));
+        const __m128i v1 = _mm_loadu_si128((const __m128i*) (rows + 2 * i + 16));
+        __m128i l = _mm_packus_epi16(_mm_and_si128(v0, low_bytes), _mm_and_si128(v1, low_bytes));
+        __m128i m = _mm_packus_epi16(_mm_srli_epi16(v0, 8), _mm_srli_epi16(v1, 8));
+        if (!flip_x) {
+#define REVERSE_BYTES_BITS(x) \
+            x = _mm_or_si128(_mm_and_si128(_mm_srli_epi16(x, 1), m55), _mm_slli_epi16(_mm_and_si128(x, m55), 1)); \
+            x = _mm_or_si128(_mm_and_si128(_mm_srli_epi16(x, 2), m33), _mm_slli_epi16(_mm_and_si128(x, m33), 2)); \
+            x = _mm_or_si128(_mm_and_si128(_mm_srli_epi16(x, 4), m0F), _mm_slli_epi16(_mm_and_si128(x, m0F), 4))
+            REVERSE_BYTES_BITS(l);
+            REVERSE_BYTES_BITS(m);
+#undef REVERSE_BYTES_BITS
+        }
+        _mm_storeu_si128((__m128i*) (lsb + i), PALETTE_PLANE(l, m, L[0], L[1], L[2], L[3]));
+        _mm_storeu_si128((__m128i*) (msb + i), PALETTE_PLANE(l, m, M[0], M[1], M[2], M[3]));
+        _mm_storeu_si128((__m128i*) (opacity + i), _mm_or_si128(l, m));
+    }
+
+    decode_scalar_range(rows, i, nb_tiles, flip_x, pal, lsb, msb, opacity);
+}
+
+// ======================================================================
+__attribute__((target("avx2")))
+static void decode_avx2(const data_t* rows, size_t nb_tiles, bit_t flip_x,
+                        const palette_masks_t* pal, uint8_t* lsb, uint8_t* msb, uint8_t* opacity)
+{
+    __m256i L[PALETTE_COLOR_COUNT], M[PALETTE_COLOR_COUNT];
+    for (int c = 0; c < PALETTE_COLOR_COUNT; ++c) {
+        L[c] = _mm256_set1_epi8((char) pal -> lsb[c]);
+        M[c] = _mm256_set1_epi8((char) pal -> msb[c]);
+    }
+    const __m256i low_bytes = _mm256_set1_epi16(0x00FF);
+    const __m256i m0F = _mm256_set1_epi8(0x0F);
+    // bit-reversed nibbles, as is (for the high nibble) and shifted up (for the low one)
+    const __m256i rev_hi = _mm256_setr_epi8(
+                               0x0, 0x8, 0x4, 0xC, 0x2, 0xA, 0x6, 0xE, 0x1, 0x9, 0x5, 0xD, 0x3, 0xB, 0x7, 0xF,
+                               0x0, 0x8, 0x4, 0xC, 0x2, 0xA, 0x6, 0xE, 0x1, 0x9, 0x5, 0xD, 0x3, 0xB, 0x7, 0xF);
+    const __m256i rev_lo = _mm256_slli_epi16(rev_hi, 4);
+
+    size_t i = 0;
+    for (; i + 32 <= nb_tiles; i += 32) {
+        const __m256i v0 = _mm256_loadu_si256((const __m256i*) (rows + 2 * i));
+        const __m256i v1 = _mm256_loadu_si256((const __m256i*) (rows + 2 * i + 32));
+        // packus works per 128-bit lane: restore tile order afterwards
+        __m256i l = _mm256_permute4x64_epi64(
+                        _mm256_packus_epi16(_mm256_and_si256(v0, low_bytes), _mm256_and_si256(v1, low_bytes)), 0xD8);
+        __m256i m = _mm256_permute4x64_epi64(
+                        _mm256_packus_epi16(_mm256_srli_epi16(v0, 8), _mm256_srli_epi16(v1, 8)), 0xD8);
+        if (!flip_x) {
+#define REVERSE_BYTES_BITS(x) \
+            x = _mm256_or_si256(_mm256_shuffle_epi8(rev_lo, _mm256_and_si256(x, m0F)), \
+                                _mm256_shuffle_epi8(rev_hi, _mm256_and_si256(_mm256_srli_epi16(x, 4), m0F)))
+            REVERSE_BYTES_BITS(l);
+            REVERSE_BYTES_BITS(m);
+#undef REVERSE_BYTES_BITS
+        }
+        _mm256_storeu_si256((__m256i*) (lsb + i), PALETTE_PLANE(l, m, L[0], L[1], L[2], L[3]));
+        _mm256_storeu_si256((__m256i*) (msb + i), PALETTE_PLANE(l, m, M[0], M[1], M[2], M[3]));
+        _mm256_storeu_si256((__m256i*) (opacity + i), _mm256_or_si256(l, m));
+    }
+
+    decode_sse2(rows + 2 * i, nb_tiles - i, flip_x, pal, lsb + i, msb + i, opacity + i);
+}
+#endif
+
+// ======================================================================
+// shared by all threads: detection only ever replaces TILE_DECODE_AUTO
+static _Atomic(tile_decode_kernel_t) selected = TILE_DECODE_AUTO;
+
+static const kernel_fn kernels[NB_TILE_DECODE_KERNELS] = {
+    [TILE_DECODE_SCALAR] = decode_scalar,
+#ifdef TILE_DECODE_X86
+    [TILE_DECODE_BMI2]   = decode_bmi2,
+    [TILE_DECODE_SSE2]   = decode_sse2,
+    [TILE_DECODE_AVX2]   = decode_avx2,
+#endif
+};
+
+static const char* const kernel_names[NB_TILE_DECODE_KERNELS] = {
+    "auto", "scalar", "bmi2", "sse2", "avx2"
+};
+
+// ----------------------------------------------------------------------
+static int kernel_supported(tile_decode_kernel_t kernel)
+{
+    if (kernel <= TILE_DECODE_AUTO || kernel >= NB_TILE_DECODE_KERNELS || kernels[kernel] == NULL) {
+        return 0;
+    }
+#ifdef TILE_DECODE_X86
+    __builtin_cpu_init();
+    switch (kernel) {
+    case TILE_DECODE_BMI2:
+        return __builtin_cpu_supports("bmi2");
+    case TILE_DECODE_SSE2:
+        return __builtin_cpu_supports("sse2");
+    case TILE_DECODE_AVX2:
+        return __builtin_cpu_supports("avx2");
+    default:
+        return 1;
+    }
+#else
+    return 1;
+#endif
+}
+
+// ----------------------------------------------------------------------
+static tile_decode_kernel_t kernel_in_use(void)
+{
+    tile_decode_kernel_t kernel = atomic_load_explicit(&selected, memory_order_relaxed);
+    if (kernel == TILE_DECODE_AUTO) {
+        // vector kernels first, BMI2 (slow pext on some CPUs) only before the scalar one
+        static const tile_decode_kernel_t by_preference[] = {
+            TILE_DECODE_AVX2, TILE_DECODE_SSE2, TILE_DECODE_BMI2
+        };
+        tile_decode_kernel_t detected = TILE_DECODE_SCALAR;
+        for (size_t i = 0; i < sizeof(by_preference) / sizeof(by_preference[0]); ++i) {
+            if (kernel_supported(by_preference[i])) {
+                detected = by_preference[i];
+                break;
+            }
+        }
+        // on failure, kernel is the one another thread detected or forced meanwhile
+        if (atomic_compare_exchange_strong(&selected, &kernel, detected)) {
+            kernel = detected;
+        }
+    }
+    return kernel;
+}
+
+// ======================================================================
+int tile_decode_select(tile_decode_kernel_t kernel)
+{
+    if (kernel == TILE_DECODE_AUTO) {
+        atomic_store(&selected, TILE_DECODE_AUTO);
+        return ERR_NONE;
+    }
+    M_REQUIRE(kernel_supported(kernel), ERR_BAD_PARAMETER, "kernel %d not supported", kernel);
+    atomic_store(&selected, kernel);
+    return ERR_NONE;
+}
+
+// ======================================================================
+const char* tile_decode_kernel_name(tile_decode_kernel_t kernel)
+{
+    if (kernel == TILE_DECODE_AUTO) {
+        kernel = kernel_in_use();
+    }
+    if (kernel < TILE_DECODE_AUTO || kernel >= NB_TILE_DECODE_KERNELS) {
+        return "unknown";
+    }
+    return kernel_names[kernel];
+}
+
+// ======================================================================
+/**
+ * @brief Reads 32 strip pixels from a (padded) plane, starting at pixel bit
+ */
+static inline uint32_t strip_word(const uint8_t* plane, size_t bit)
+{
+    const uint8_t* p = plane + bit / 8;
+    const uint64_t window = (uint64_t) p[0]         | ((uint64_t) p[1] << 8)  |
+                            ((uint64_t) p[2] << 16) | ((uint64_t) p[3] << 24) |
+                            ((uint64_t) p[4] << 32);
+    return (uint32_t) (window >> (bit % 8));
+}
+
+// ======================================================================
+int tile_decode_line(image_line_t* output, const data_t* rows, size_t nb_tiles,
+                     size_t scroll, palette_t palette, bit_t flip_x)
+{
+    M_REQUIRE_NON_NULL(output);
+    M_REQUIRE_NON_NULL(output -> msb);
+    M_REQUIRE_NON_NULL(output -> lsb);
+    M_REQUIRE_NON_NULL(output -> opacity);
+    M_REQUIRE_NON_NULL(rows);
+    M_REQUIRE(nb_tiles > 0 && nb_tiles <= TILE_LINE_SIZE, ERR_BAD_PARAMETER,
+              "Invalid number of tiles (%zu)", nb_tiles);
+    const size_t size = output -> msb -> size;
+    M_REQUIRE(output -> lsb -> size == size && output -> opacity -> size == size,
+              ERR_BAD_PARAMETER, "Incorrect sizes in image_line (%zu, %zu, %zu)",
+              output -> lsb -> size, size, output -> opacity -> size);
+
+    palette_masks_t pal;
+    palette_masks(palette, &pal);
+
+    uint8_t lsb[TILE_LINE_SIZE + STRIP_PADDING];
+    uint8_t msb[TILE_LINE_SIZE + STRIP_PADDING];
+    uint8_t opacity[TILE_LINE_SIZE + STRIP_PADDING];
+    kernels[kernel_in_use()](rows, nb_tiles, flip_x, &pal, lsb, msb, opacity);
+
+    for (size_t k = 0; k < STRIP_PADDING; ++k) {
+        lsb[nb_tiles + k]     = lsb[k % nb_tiles];
+        msb[nb_tiles + k]     = msb[k % nb_tiles];
+        opacity[nb_tiles + k] = opacity[k % nb_tiles];
+    }
+
+    const size_t strip_bits = nb_tiles * TILE_PIXELS;
+    const size_t nb_words = size / IMAGE_LINE_WORD_BITS + (size % IMAGE_LINE_WORD_BITS ? 1 : 0);
+    size_t bit = scroll % strip_bits;
+    for (size_t j = 0; j < nb_words; ++j) {
+        output -> lsb     -> content[j] = strip_word(lsb, bit);
+        output -> msb     -> content[j] = strip_word(msb, bit);
+        output -> opacity -> content[j] = strip_word(opacity, bit);
+        bit = (bit + IMAGE_LINE_WORD_BITS) % strip_bits;
+    }
+
+    if (size % IMAGE_LINE_WORD_BITS != 0) {
+        const uint32_t mask = (UINT32_C(1) << (size % IMAGE_LINE_WORD_BITS)) - 1;
+        output -> lsb     -> content[nb_words - 1] &= mask;
+        output -> msb     -> content[nb_words - 1] &= mask;
+        output -> opacity -> content[nb_words - 1] &= mask;
+    }
+
+    return ERR_NONE;
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+/**
+ * @file tile_decode.h
+ * @brief Decoding of 2bpp tile rows into image lines, with vectorised kernels
+ *
+ * @date 2020
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "memory.h"
+#include "bit.h"
+#include "image.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Available decoding kernels
+ */
+typedef enum {
+    TILE_DECODE_AUTO,   // best kernel supported by the running CPU
+    TILE_DECODE_SCALAR, // portable fallback
+    TILE_DECODE_BMI2,   // pext based byte deinterleaving
+    TILE_DECODE_SSE2,
+    TILE_DECODE_AVX2,
+    NB_TILE_DECODE_KERNELS
+} tile_decode_kernel_t;
+
+
+/**
+ * @brief Decodes a circular strip of tile rows into an image line.
+ *        Output pixel x is strip pixel (scroll + x) modulo the strip length,
+ *        colors are mapped through palette, and opacity is set where the
+ *        original (unmapped) color is not 0.
+ *
+ * @param output image line to write to (already created, e.g. LCD_WIDTH or 256 pixels)
+ * @param rows tile-row byte pairs as stored in VRAM: for tile i, rows[2*i]
+ *        holds the lsb plane and rows[2*i+1] the msb plane (leftmost pixel is bit 7)
+ * @param nb_tiles number of tiles in the strip (1 to TILE_LINE_SIZE)
+ * @param scroll strip pixel index written at output pixel 0
+ * @param palette palette to apply
+ * @param flip_x whether every tile is horizontally flipped
+ * @return error code
+ */
+int tile_decode_line(image_line_t* output, const data_t* rows, size_t nb_tiles,
+                     size_t scroll, palette_t palette, bit_t flip_x);
+
+
+/**
+ * @brief Forces the kernel used by tile_decode_line()
+ *
+ * @param kernel kernel to use (TILE_DECODE_AUTO restores runtime detection)
+ * @return error code (ERR_BAD_PARAMETER if the CPU does not support it)
+ */
+int tile_decode_select(tile_decode_kernel_t kernel);
+
+
+/**
+ * @brief Gets the name of a kernel
+ *
+ * @param kernel kernel (TILE_DECODE_AUTO for the one currently in use)
+ * @return name of the kernel
+ */
+const char* tile_decode_kernel_name(tile_decode_kernel_t kernel);
+
+#ifdef __cplusplus
+}
+#endif
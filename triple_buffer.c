@@ -0,0 +1,89 @@
+/**
+ * @file triple_buffer.c
+ * @brief Lock-free single-producer/single-consumer triple buffer
+ *
+ * @date 2020
+ */
+
+#include <stdlib.h>
+#include <stdatomic.h>
+
+#include "triple_buffer.h"
+#include "error.h"
+
+#define FRESH_FLAG 4u
+#define INDEX_MASK 3u
+
+// ======================================================================
+int triple_buffer_create(triple_buffer_t* tb, size_t size)
+{
+    M_REQUIRE_NON_NULL(tb);
+    M_REQUIRE(size > 0, ERR_BAD_PARAMETER, "%s", "buffer size cannot be zero");
+
+    for (size_t i = 0; i < 3; ++i) {
+        tb -> buffers[i] = calloc(1, size);
+        if (tb -> buffers[i] == NULL) {
+            for (size_t j = 0; j < i; ++j) {
+                free(tb -> buffers[j]);
+                tb -> buffers[j] = NULL;
+            }
+            return ERR_MEM;
+        }
+    }
+
+    tb -> size = size;
+    tb -> back = 0;
+    atomic_init(&(tb -> middle), 1u);
+    tb -> front = 2;
+
+    return ERR_NONE;
+}
+
+// ======================================================================
+void triple_buffer_free(triple_buffer_t* tb)
+{
+    if (tb != NULL) {
+        for (size_t i = 0; i < 3; ++i) {
+            free(tb -> buffers[i]);
+            tb -> buffers[i] = NULL;
+        }
+        tb -> size = 0;
+    }
+}
+
+// ======================================================================
+void* triple_buffer_back(triple_buffer_t* tb)
+{
+    return tb == NULL ? NULL : tb -> buffers[tb -> back];
+}
+
+// ======================================================================
+void triple_buffer_publish(triple_buffer_t* tb)
+{
+    if (tb != NULL) {
+        // release the written buffer, acquire the one the consumer gave back
+        const unsigned int previous = atomic_exchange_explicit(&(tb -> middle),
+                                      tb -> back | FRESH_FLAG, memory_order_acq_rel);
+        tb -> back = previous & INDEX_MASK;
+    }
+}
+
+// ======================================================================
+bit_t triple_buffer_acquire(triple_buffer_t* tb)
+{
+    if (tb == NULL ||
+        !(atomic_load_explicit(&(tb -> middle), memory_order_relaxed) & FRESH_FLAG)) {
+        return 0;
+    }
+
+    const unsigned int previous = atomic_exchange_explicit(&(tb -> middle), tb -> front,
+                                  memory_order_acq_rel);
+    tb -> front = previous & INDEX_MASK;
+    return 1;
+}
+
+// ======================================================================
+const void* triple_buffer_front(const triple_buffer_t* tb)
+{
+    return tb == NULL ? NULL : tb -> buffers[tb -> front];
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+/**
+ * @file triple_buffer.h
+ * @brief Lock-free single-producer/single-consumer triple buffer
+ *
+ * The producer always owns a back buffer to write the next frame into,
+ * the consumer always owns a front buffer to read from, and the third one
+ * is exchanged atomically between them. Neither side ever waits for the
+ * other: the producer overwrites unread frames and the consumer keeps its
+ * current frame until a newer one is published.
+ *
+ * @date 2020
+ */
+
+#include <stddef.h>
+#include <stdatomic.h>
+
+#include "bit.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Triple buffer type
+ */
+typedef struct {
+    void* buffers[3];
+    size_t size;
+    atomic_uint middle; // index of the exchanged buffer, with a "fresh" flag
+    unsigned int back;  // producer side only
+    unsigned int front; // consumer side only
+} triple_buffer_t;
+
+
+/**
+ * @brief Creates a triple buffer of three zeroed buffers of a given size
+ *
+ * @param tb triple buffer to create
+ * @param size size of each buffer (in bytes)
+ * @return error code
+ */
+int triple_buffer_create(triple_buffer_t* tb, size_t size);
+
+
+/**
+ * @brief Frees a triple buffer
+ *
+ * @param tb triple buffer to free
+ */
+void triple_buffer_free(triple_buffer_t* tb);
+
+
+/**
+ * @brief Gets the buffer the producer writes to (producer thread only)
+ *
+ * @param tb triple buffer
+ * @return back buffer (NULL on bad parameter)
+ */
+void* triple_buffer_back(triple_buffer_t* tb);
+
+
+/**
+ * @brief Publishes the back buffer and takes a new one (producer thread only)
+ *
+ * @param tb triple buffer
+ */
+void triple_buffer_publish(triple_buffer_t* tb);
+
+
+/**
+ * @brief Takes the latest published buffer, if any (consumer thread only)
+ *
+ * @param tb triple buffer
+ * @return 1 if a new buffer was taken, 0 if the front buffer is unchanged
+ */
+bit_t triple_buffer_acquire(triple_buffer_t* tb);
+
+
+/**
+ * @brief Gets the buffer the consumer reads from (consumer thread only)
+ *
+ * @param tb triple buffer
+ * @return front buffer (NULL on bad parameter)
+ */
+const void* triple_buffer_front(const triple_buffer_t* tb);
+
+#ifdef __cplusplus
+}
+#endif
@@ -19,6 +19,7 @@
 #include "tests.h"
 #include "bit_vector.h"
 #include "image.h"
+#include "error.h"
 
 
 #define PV1_SIZE 1
@@ -194,6 +195,54 @@ START_TEST(bit_vector_get_exec)
 END_TEST
 
 
+START_TEST(bit_vector_access_exec)
+{
+// ------------------------------------------------------------
+#ifdef WITH_PRINT
+    printf("=== %s:\n", __func__);
+#endif
+    const size_t size = 100;
+    bit_vector_t* pbv = bit_vector_create(size, 0);
+    ck_assert_ptr_nonnull(pbv);
+    bit_t expected[100] = {0};
+
+    for (int round = 0; round < 2000; ++round) {
+        const size_t i = (size_t) rand() % size;
+        switch (rand() % 3) {
+        case 0:
+            bit_vector_set(pbv, i);
+            expected[i] = 1;
+            break;
+        case 1:
+            bit_vector_clear(pbv, i);
+            expected[i] = 0;
+            break;
+        default:
+            bit_vector_toggle(pbv, i);
+            expected[i] ^= 1;
+            break;
+        }
+
+        const size_t index = (size_t) rand() % size;
+        const size_t width = 1 + (size_t) rand() % (size - index < 32 ? size - index : 32);
+        uint32_t bits = 0;
+        for (size_t k = 0; k < width; ++k) {
+            bits |= (uint32_t) expected[index + k] << k;
+        }
+        ck_assert_uint_eq(bit_vector_get_bits(pbv, index, width), bits);
+        ck_assert_int_eq(bit_vector_test(pbv, index), expected[index]);
+        ck_assert_int_eq(bit_vector_get(pbv, index), expected[index]);
+    }
+    ck_assert_uint_eq(pbv->content[3] >> (size % 32), 0);
+
+    bit_vector_free(&pbv);
+
+#ifdef WITH_PRINT
+    printf("=== END of %s\n", __func__);
+#endif
+}
+END_TEST
+
 START_TEST(bit_vector_not_exec)
 {
 // ------------------------------------------------------------
@@ -606,6 +655,82 @@ START_TEST(bit_vector_extract_wrap_exec)
 END_TEST
 
 
+// ======================================================================
+/**
+ * @brief bit by bit reference of the zero (wrap = 0) and wrap extended extractions
+ */
+static bit_vector_t* extract_reference(const bit_vector_t* pbv, int64_t index, size_t size, bit_t wrap)
+{
+    bit_vector_t* result = bit_vector_create(size, 0);
+    ck_assert_ptr_nonnull(result);
+    const int64_t n = (int64_t) pbv->size;
+    for (size_t i = 0; i < size; ++i) {
+        int64_t src = index + (int64_t) i;
+        if (wrap) {
+            src = ((src % n) + n) % n;
+        }
+        if (src >= 0 && src < n && bit_vector_get(pbv, (size_t) src)) {
+            bit_vector_set(result, i);
+        }
+    }
+    return result;
+}
+
+START_TEST(bit_vector_extract_reference_exec)
+{
+// ------------------------------------------------------------
+#ifdef WITH_PRINT
+    printf("=== %s:\n", __func__);
+#endif
+    // sources not a multiple of 32 bits, windows crossing their tail chunk
+    const size_t sizes[] = { 1, 5, 31, 32, 33, 63, 64, 65, 100, 160, 257 };
+    const size_t widths[] = { 1, 7, 31, 32, 33, 64, 95, 160, 300 };
+    const int64_t indexes[] = { 0, 1, 5, 31, 32, 33, 63, 97, 159, 160, 161, 1000, 100003,
+                                -1, -5, -31, -32, -33, -64, -97, -160, -1000, -100003 };
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); ++s) {
+        bit_vector_t* pbv = bit_vector_create(sizes[s], 0);
+        ck_assert_ptr_nonnull(pbv);
+        for (size_t i = 0; i < sizes[s]; ++i) {
+            if (rand() % 2) {
+                bit_vector_set(pbv, i);
+            }
+        }
+        // the window just before and just after the tail chunk too
+        const int64_t tail = (int64_t) (sizes[s] / IMAGE_LINE_WORD_BITS * IMAGE_LINE_WORD_BITS);
+        for (size_t w = 0; w < sizeof(widths) / sizeof(widths[0]); ++w) {
+            for (size_t k = 0; k < sizeof(indexes) / sizeof(indexes[0]) + 3; ++k) {
+                const size_t nb_indexes = sizeof(indexes) / sizeof(indexes[0]);
+                const int64_t index = k < nb_indexes ? indexes[k]
+                                      : tail - (int64_t) widths[w] / 2 + (int64_t) (k - nb_indexes) - 1;
+                for (bit_t wrap = 0; wrap <= 1; ++wrap) {
+                    bit_vector_t* expected = extract_reference(pbv, index, widths[w], wrap);
+                    bit_vector_t* result = wrap ? bit_vector_extract_wrap_ext(pbv, index, widths[w])
+                                           : bit_vector_extract_zero_ext(pbv, index, widths[w]);
+                    ck_assert_ptr_nonnull(result);
+                    vector_match_vector(result, expected);
+
+                    // into an existing vector, as the image code does
+                    bit_vector_t* dst = bit_vector_create(widths[w], 1);
+                    ck_assert_ptr_nonnull(dst);
+                    ck_assert_ptr_nonnull(wrap ? bit_vector_extract_wrap_ext_to(dst, pbv, index)
+                                          : bit_vector_extract_zero_ext_to(dst, pbv, index));
+                    vector_match_vector(dst, expected);
+
+                    bit_vector_free(&dst);
+                    bit_vector_free(&result);
+                    bit_vector_free(&expected);
+                }
+            }
+        }
+        bit_vector_free(&pbv);
+    }
+
+#ifdef WITH_PRINT
+    printf("=== END of %s\n", __func__);
+#endif
+}
+END_TEST
+
 START_TEST(bit_vector_shift_exec)
 {
 // ------------------------------------------------------------
@@ -747,6 +872,222 @@ START_TEST(bit_vector_join_exec)
 END_TEST
 
 
+START_TEST(bit_vector_to_exec)
+{
+// ------------------------------------------------------------
+#ifdef WITH_PRINT
+    printf("=== %s:\n", __func__);
+#endif
+    bit_vector_t* pbv = bit_vector_create(PV2_SIZE * IMAGE_LINE_WORD_BITS, 0);
+    bit_vector_t* dst = bit_vector_create(PV2_SIZE * IMAGE_LINE_WORD_BITS, 1);
+    bit_vector_t* small = bit_vector_create(IMAGE_LINE_WORD_BITS, 0);
+    ck_assert_ptr_nonnull(pbv);
+    ck_assert_ptr_nonnull(dst);
+    ck_assert_ptr_nonnull(small);
+
+    const uint32_t deadboss = PV1_DEADBOSS_VALUE;
+    const uint32_t deadboss_p5[] = PV1_DEADBOSS_EXT_ZERO_P5_VALUE;
+    const uint32_t deadboss_m10[] = PV1_DEADBOSS_EXT_ZERO_M10_VALUE;
+    const uint32_t wrap_p10[] = PV1_DEADBOSS_EXT_WRAP_P10_VALUE;
+    const uint32_t pv2_0[] = PV2_0_VALUE;
+    fill_vector_with(pbv, deadboss, PV2_SIZE);
+
+    ck_assert_ptr_null(bit_vector_cpy_to(small, pbv));
+    ck_assert_ptr_null(bit_vector_shift_to(small, pbv, 1));
+    ck_assert_ptr_null(bit_vector_join_to(small, pbv, pbv, 1));
+    ck_assert_ptr_null(bit_vector_extract_zero_ext_to(NULL, pbv, 0));
+    ck_assert_ptr_null(bit_vector_extract_wrap_ext_to(dst, NULL, 0));
+    ck_assert_ptr_null(bit_vector_extract_wrap_ext_to(pbv, pbv, 0));
+
+    ck_assert_ptr_eq(bit_vector_extract_zero_ext_to(dst, NULL, 3), dst);
+    vector_match_tab(dst, pv2_0, PV2_SIZE);
+
+    ck_assert_ptr_eq(bit_vector_extract_zero_ext_to(dst, pbv, 5), dst);
+    vector_match_tab(dst, deadboss_p5, PV2_SIZE);
+
+    ck_assert_ptr_eq(bit_vector_extract_wrap_ext_to(small, pbv, 10), small);
+    vector_match_tab(small, wrap_p10, 1);
+
+    // in place: same results as the allocating versions
+    ck_assert_ptr_eq(bit_vector_cpy_to(dst, pbv), dst);
+    ck_assert_ptr_eq(bit_vector_shift_to(dst, dst, 10), dst);
+    vector_match_tab(dst, deadboss_m10, PV2_SIZE);
+
+    ck_assert_ptr_eq(bit_vector_cpy_to(dst, pbv), dst);
+    ck_assert_ptr_eq(bit_vector_shift_to(dst, dst, -5), dst);
+    vector_match_tab(dst, deadboss_p5, PV2_SIZE);
+
+    bit_vector_t* ones = bit_vector_create(PV2_SIZE * IMAGE_LINE_WORD_BITS, 1);
+    ck_assert_ptr_nonnull(ones);
+    for (int64_t shift = 0; shift <= PV2_SIZE * IMAGE_LINE_WORD_BITS; shift += 7) {
+        bit_vector_t* expected = bit_vector_join(pbv, ones, shift);
+        ck_assert_ptr_nonnull(expected);
+        ck_assert_ptr_eq(bit_vector_cpy_to(dst, ones), dst);
+        ck_assert_ptr_eq(bit_vector_join_to(dst, pbv, dst, shift), dst);
+        vector_match_vector(dst, expected);
+        bit_vector_free(&expected);
+    }
+
+    bit_vector_free(&ones);
+    bit_vector_free(&small);
+    bit_vector_free(&dst);
+    bit_vector_free(&pbv);
+#ifdef WITH_PRINT
+    printf("=== END of %s\n", __func__);
+#endif
+}
+END_TEST
+
+
+START_TEST(bit_vector_fixed_exec)
+{
+// ------------------------------------------------------------
+#ifdef WITH_PRINT
+    printf("=== %s:\n", __func__);
+#endif
+    bit_vector_160_t line, other;
+    bit_vector_256_t bg, bg2;
+
+    bit_vector_t* pbv = bit_vector_160_init(&line, 1);
+    ck_assert_ptr_eq(pbv, &line.vector);
+    ck_assert_uint_eq(pbv->size, BIT_VECTOR_160_BITS);
+    vector_match_val(pbv, 0xFFFFFFFF, BIT_VECTOR_CHUNKS(BIT_VECTOR_160_BITS));
+    ck_assert_uint_eq(bit_vector_256_init(&bg, 0)->size, BIT_VECTOR_256_BITS);
+    vector_match_val((&bg.vector), 0, BIT_VECTOR_CHUNKS(BIT_VECTOR_256_BITS));
+
+    const uint32_t deadboss = PV1_DEADBOSS_VALUE;
+    fill_vector_with((&bg.vector), deadboss, BIT_VECTOR_CHUNKS(BIT_VECTOR_256_BITS));
+    bg.fixed.content[3] = 0x12345678;
+    bit_vector_256_init(&bg2, 0);
+    bg2.fixed.content[1] = 0xAAAAAAAA;
+    bg2.fixed.content[7] = 0x5555FFFF;
+
+    // same results as the generic functions, on the bit_vector_t views
+    bit_vector_t* expected = NULL;
+    for (size_t index = 0; index < 2 * BIT_VECTOR_256_BITS; index += 11) {
+        bit_vector_256_extract_160(&line, &bg, index);
+        expected = bit_vector_extract_wrap_ext(&bg.vector, (int64_t) index, BIT_VECTOR_160_BITS);
+        vector_match_vector((&line.vector), expected);
+        bit_vector_free(&expected);
+    }
+
+    for (int64_t shift = -BIT_VECTOR_256_BITS; shift <= BIT_VECTOR_256_BITS; shift += 9) {
+        bit_vector_256_shift(&bg2, &bg, shift);
+        expected = bit_vector_shift(&bg.vector, shift);
+        vector_match_vector((&bg2.vector), expected);
+        bit_vector_free(&expected);
+
+        bit_vector_256_extract_160(&other, &bg, 0);
+        bit_vector_160_shift(&other, &other, shift);
+        bit_vector_256_extract_160(&line, &bg, 0);
+        expected = bit_vector_shift(&line.vector, shift);
+        vector_match_vector((&other.vector), expected);
+        bit_vector_free(&expected);
+    }
+
+    bit_vector_256_extract_160(&line, &bg, 7);
+    bit_vector_256_extract_160(&other, &bg2, 100);
+    expected = bit_vector_cpy(&line.vector);
+    ck_assert_ptr_nonnull(expected);
+    bit_vector_160_and(&line, &other);
+    ck_assert_ptr_nonnull(bit_vector_and(expected, &other.vector));
+    vector_match_vector((&line.vector), expected);
+    bit_vector_160_or(&line, &other);
+    ck_assert_ptr_nonnull(bit_vector_or(expected, &other.vector));
+    vector_match_vector((&line.vector), expected);
+    bit_vector_160_xor(&line, &other);
+    ck_assert_ptr_nonnull(bit_vector_xor(expected, &other.vector));
+    vector_match_vector((&line.vector), expected);
+    bit_vector_160_not(&line);
+    ck_assert_ptr_nonnull(bit_vector_not(expected));
+    vector_match_vector((&line.vector), expected);
+    bit_vector_free(&expected);
+
+    expected = bit_vector_cpy(&bg.vector);
+    ck_assert_ptr_nonnull(expected);
+    bit_vector_256_and(&bg, &bg2);
+    ck_assert_ptr_nonnull(bit_vector_and(expected, &bg2.vector));
+    vector_match_vector((&bg.vector), expected);
+    bit_vector_256_or(&bg, &bg2);
+    ck_assert_ptr_nonnull(bit_vector_or(expected, &bg2.vector));
+    vector_match_vector((&bg.vector), expected);
+    bit_vector_256_xor(&bg, &bg2);
+    ck_assert_ptr_nonnull(bit_vector_xor(expected, &bg2.vector));
+    vector_match_vector((&bg.vector), expected);
+    bit_vector_256_not(&bg);
+    ck_assert_ptr_nonnull(bit_vector_not(expected));
+    vector_match_vector((&bg.vector), expected);
+    bit_vector_free(&expected);
+
+#ifdef WITH_PRINT
+    printf("=== END of %s\n", __func__);
+#endif
+}
+END_TEST
+
+
+START_TEST(bit_vector_backends_exec)
+{
+// ------------------------------------------------------------
+#ifdef WITH_PRINT
+    printf("=== %s:\n", __func__);
+#endif
+    ck_assert_bad_param(bit_vector_select_backend(NB_BIT_VECTOR_BACKENDS));
+    ck_assert_str_eq(bit_vector_backend_name(BIT_VECTOR_BACKEND_SCALAR), "scalar");
+
+    // sizes around the vector widths, with partial last chunks
+    const size_t sizes[] = { 1, 100, 255, 256, 257, 1000, 144 * 160 };
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); ++s) {
+        bit_vector_t* pbv1 = bit_vector_create(sizes[s], 0);
+        bit_vector_t* pbv2 = bit_vector_create(sizes[s], 0);
+        ck_assert_ptr_nonnull(pbv1);
+        ck_assert_ptr_nonnull(pbv2);
+        const size_t nb_chunks = sizes[s] / IMAGE_LINE_WORD_BITS + (sizes[s] % IMAGE_LINE_WORD_BITS ? 1 : 0);
+        for (size_t i = 0; i < nb_chunks; ++i) {
+            pbv1->content[i] = (uint32_t) rand() ^ ((uint32_t) rand() << 16);
+            pbv2->content[i] = (uint32_t) rand() ^ ((uint32_t) rand() << 16);
+        }
+        bit_vector_t* expected[4] = { NULL, NULL, NULL, NULL };
+
+        for (bit_vector_backend_t b = BIT_VECTOR_BACKEND_SCALAR; b < NB_BIT_VECTOR_BACKENDS; ++b) {
+            if (bit_vector_select_backend(b) != ERR_NONE) {
+                continue; // not supported by this CPU
+            }
+            bit_vector_t* results[4] = {
+                bit_vector_and(bit_vector_cpy(pbv1), pbv2),
+                bit_vector_or(bit_vector_cpy(pbv1), pbv2),
+                bit_vector_xor(bit_vector_cpy(pbv1), pbv2),
+                bit_vector_not(bit_vector_cpy(pbv1))
+            };
+            for (size_t op = 0; op < 4; ++op) {
+                ck_assert_ptr_nonnull(results[op]);
+                if (b == BIT_VECTOR_BACKEND_SCALAR) {
+                    expected[op] = results[op];
+                } else {
+                    vector_match_vector(results[op], expected[op]);
+                    bit_vector_free(&results[op]);
+                }
+            }
+        }
+        ck_assert_uint_eq(expected[0]->content[0], pbv1->content[0] & pbv2->content[0]);
+        ck_assert_uint_eq(expected[1]->content[0], pbv1->content[0] | pbv2->content[0]);
+        ck_assert_uint_eq(expected[2]->content[0], pbv1->content[0] ^ pbv2->content[0]);
+
+        for (size_t op = 0; op < 4; ++op) {
+            bit_vector_free(&expected[op]);
+        }
+        bit_vector_free(&pbv1);
+        bit_vector_free(&pbv2);
+    }
+    ck_assert_err_none(bit_vector_select_backend(BIT_VECTOR_BACKEND_AUTO));
+
+#ifdef WITH_PRINT
+    printf("=== END of %s\n", __func__);
+#endif
+}
+END_TEST
+
+
 #define PVV2_VALUE {0x0001FFFF}
 #define PVV3_VALUE {0xFFE0003F,0xFFE0003F}
 
@@ -902,14 +1243,19 @@ Suite* cartridge_test_suite()
     tcase_add_test(tc1, bit_vector_create_exec);
     tcase_add_test(tc1, bit_vector_cpy_exec);
     tcase_add_test(tc1, bit_vector_get_exec);
+    tcase_add_test(tc1, bit_vector_access_exec);
     tcase_add_test(tc1, bit_vector_not_exec);
     tcase_add_test(tc1, bit_vector_and_exec);
     tcase_add_test(tc1, bit_vector_or_exec);
     tcase_add_test(tc1, bit_vector_xor_exec);
     tcase_add_test(tc1, bit_vector_extract_zero_exec);
     tcase_add_test(tc1, bit_vector_extract_wrap_exec);
+    tcase_add_test(tc1, bit_vector_extract_reference_exec);
     tcase_add_test(tc1, bit_vector_shift_exec);
     tcase_add_test(tc1, bit_vector_join_exec);
+    tcase_add_test(tc1, bit_vector_to_exec);
+    tcase_add_test(tc1, bit_vector_fixed_exec);
+    tcase_add_test(tc1, bit_vector_backends_exec);
     tcase_add_test(tc1, bit_vector_various);
     tcase_add_test(tc1, bit_vector_deadboss);
 
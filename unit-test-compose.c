@@ -0,0 +1,206 @@
+/**
+ * @file unit-test-compose.c
+ * @brief Unit test code for the fused line compositing
+ *
+ * @date 2020
+ */
+
+// for thread-safe randomization
+#include <time.h>
+#include <stdlib.h>
+#include <sys/types.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include <check.h>
+#include <inttypes.h>
+
+#include "tests.h"
+#include "compose.h"
+#include "image.h"
+#include "error.h"
+
+#define SCREEN_WIDTH 160
+#define BG_WIDTH     256
+
+static void random_line(image_line_t* line)
+{
+    const size_t size = line->msb->size;
+    for (size_t i = 0; i < (size + IMAGE_LINE_WORD_BITS - 1) / IMAGE_LINE_WORD_BITS; ++i) {
+        uint32_t lsb = (uint32_t) rand() ^ ((uint32_t) rand() << 16);
+        uint32_t msb = (uint32_t) rand() ^ ((uint32_t) rand() << 16);
+        if ((i + 1) * IMAGE_LINE_WORD_BITS > size) {
+            const uint32_t mask = (UINT32_C(1) << (size % IMAGE_LINE_WORD_BITS)) - 1;
+            lsb &= mask;
+            msb &= mask;
+        }
+        image_line_set_word(line, i, msb, lsb);
+    }
+}
+
+static uint8_t raw(const image_line_t* line, size_t x)
+{
+    return (uint8_t) ((bit_vector_get(line->msb, x) << 1) | bit_vector_get(line->lsb, x));
+}
+
+static uint8_t map(palette_t palette, uint8_t color)
+{
+    return (palette >> (2 * color)) & 3;
+}
+
+// per-pixel reference of compose_line()
+static void reference(const compose_line_t* line, int64_t x, uint8_t* color, bit_t* opacity)
+{
+    int covered = 0;
+    uint8_t bg = 0;
+    if (line->window != NULL && x >= line->window_x) {
+        covered = 1;
+        const int64_t from = x - line->window_x;
+        bg = (size_t) from < line->window->msb->size ? raw(line->window, (size_t) from) : 0;
+    } else if (line->background != NULL) {
+        covered = 1;
+        bg = raw(line->background, (line->scroll_x + (size_t) x) % line->background->msb->size);
+    }
+    *color = covered ? map(line->bg_palette, bg) : 0;
+    *opacity = bg != 0;
+
+    for (size_t i = 0; i < line->nb_sprites; ++i) {
+        const compose_sprite_t* s = line->sprites + i;
+        if (x < s->x || x >= s->x + COMPOSE_SPRITE_WIDTH) continue;
+        const int k = (int) (x - s->x);
+        const uint8_t c = (uint8_t) ((((s->msb >> k) & 1) << 1) | ((s->lsb >> k) & 1));
+        if (c == 0) continue;
+        if (!s->behind_bg || bg == 0) {
+            *color = map(s->palette, c);
+            *opacity = 1;
+        }
+        break;
+    }
+}
+
+START_TEST(compose_line_err)
+{
+// ------------------------------------------------------------
+#ifdef WITH_PRINT
+    printf("=== %s:\n", __func__);
+#endif
+    image_line_t output, bg, odd;
+    ck_assert_err_none(image_line_create(&output, SCREEN_WIDTH));
+    ck_assert_err_none(image_line_create(&bg, BG_WIDTH));
+    ck_assert_err_none(image_line_create(&odd, BG_WIDTH - 1));
+
+    compose_line_t line = { .background = &bg };
+    ck_assert_bad_param(compose_line(NULL, &line));
+    ck_assert_bad_param(compose_line(&output, NULL));
+    ck_assert_bad_param(compose_line(&bg, &line));
+
+    line.background = &odd;
+    ck_assert_bad_param(compose_line(&output, &line));
+    line.background = &bg;
+    line.window = &output;
+    ck_assert_bad_param(compose_line(&output, &line));
+    line.window = NULL;
+
+    line.nb_sprites = 1;
+    ck_assert_bad_param(compose_line(&output, &line));
+    compose_sprite_t sprites[COMPOSE_MAX_SPRITES + 1] = {{0}};
+    line.sprites = sprites;
+    line.nb_sprites = COMPOSE_MAX_SPRITES + 1;
+    ck_assert_bad_param(compose_line(&output, &line));
+    line.nb_sprites = COMPOSE_MAX_SPRITES;
+    ck_assert_err_none(compose_line(&output, &line));
+
+    image_line_free(&odd);
+    image_line_free(&bg);
+    image_line_free(&output);
+
+#ifdef WITH_PRINT
+    printf("=== END of %s\n", __func__);
+#endif
+}
+END_TEST
+
+START_TEST(compose_line_exec)
+{
+// ------------------------------------------------------------
+#ifdef WITH_PRINT
+    printf("=== %s:\n", __func__);
+#endif
+    image_line_t output, bg, window, narrow;
+    ck_assert_err_none(image_line_create(&output, SCREEN_WIDTH));
+    ck_assert_err_none(image_line_create(&narrow, SCREEN_WIDTH - 3));
+    ck_assert_err_none(image_line_create(&bg, BG_WIDTH));
+    ck_assert_err_none(image_line_create(&window, BG_WIDTH - 5));
+
+    compose_sprite_t sprites[COMPOSE_MAX_SPRITES];
+    for (int round = 0; round < 500; ++round) {
+        random_line(&bg);
+        random_line(&window);
+
+        for (size_t i = 0; i < COMPOSE_MAX_SPRITES; ++i) {
+            sprites[i].lsb = (uint8_t) rand();
+            sprites[i].msb = (uint8_t) rand();
+            sprites[i].x = rand() % (SCREEN_WIDTH + 16) - 12;
+            sprites[i].palette = (palette_t) rand();
+            sprites[i].behind_bg = rand() & 1;
+        }
+
+        const compose_line_t line = {
+            .background = (round % 5 == 0) ? NULL : &bg,
+            .scroll_x = (size_t) rand() % (2 * BG_WIDTH),
+            .window = (round % 3 == 0) ? NULL : &window,
+            .window_x = rand() % (SCREEN_WIDTH + 16) - 7,
+            .bg_palette = (palette_t) rand(),
+            .sprites = sprites,
+            .nb_sprites = (size_t) rand() % (COMPOSE_MAX_SPRITES + 1)
+        };
+
+        image_line_t* const out = (round % 2 == 0) ? &output : &narrow;
+        ck_assert_err_none(compose_line(out, &line));
+
+        const size_t size = out->msb->size;
+        for (size_t x = 0; x < size; ++x) {
+            uint8_t color = 0;
+            bit_t opacity = 0;
+            reference(&line, (int64_t) x, &color, &opacity);
+            ck_assert_uint_eq(raw(out, x), color);
+            ck_assert_uint_eq(bit_vector_get(out->opacity, x), opacity);
+        }
+        if (size % IMAGE_LINE_WORD_BITS != 0) {
+            const size_t last = size / IMAGE_LINE_WORD_BITS;
+            ck_assert_uint_eq(out->msb->content[last] >> (size % IMAGE_LINE_WORD_BITS), 0);
+            ck_assert_uint_eq(out->lsb->content[last] >> (size % IMAGE_LINE_WORD_BITS), 0);
+            ck_assert_uint_eq(out->opacity->content[last] >> (size % IMAGE_LINE_WORD_BITS), 0);
+        }
+    }
+
+    image_line_free(&window);
+    image_line_free(&bg);
+    image_line_free(&narrow);
+    image_line_free(&output);
+
+#ifdef WITH_PRINT
+    printf("=== END of %s\n", __func__);
+#endif
+}
+END_TEST
+
+Suite* compose_test_suite()
+{
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wsign-conversion"
+#pragma GCC diagnostic ignored "-Wconversion"
+    srand(time(NULL) ^ getpid() ^ pthread_self());
+#pragma GCC diagnostic pop
+
+    Suite* s = suite_create("compose.c Tests");
+
+    Add_Case(s, tc1, "Compose Tests");
+    tcase_add_test(tc1, compose_line_err);
+    tcase_add_test(tc1, compose_line_exec);
+
+    return s;
+}
+
+TEST_SUITE(compose_test_suite)
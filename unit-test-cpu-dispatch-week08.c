@@ -1476,6 +1476,49 @@ START_TEST(test_NOP)
 }
 END_TEST
 
+START_TEST(test_PC_after_ALU_LD)
+{
+    // ------------------------------------------------------------
+#ifdef WITH_PRINT
+    printf("=== %s:\n", __func__);
+#endif
+    INIT_RUN();
+
+    // ALU: PC goes past the opcode and its operands
+    cpu.PC = 0x10;
+    cpu.A = 0x01;
+    ck_assert_int_eq(cpu_write_at_idx(&cpu, 0x11, 0x02), ERR_NONE);
+    {
+        DO_RUN(cpu, OP_ADD_A_N8);
+        ck_assert_int_eq(cpu.A, 0x03);
+        ck_assert_int_eq(cpu.PC, 0x12);
+    }
+    {
+        DO_RUN(cpu, OP_INC_A);
+        ck_assert_int_eq(cpu.A, 0x04);
+        ck_assert_int_eq(cpu.PC, 0x13);
+    }
+
+    // LD: the same
+    cpu.PC = 0x20;
+    ck_assert_int_eq(cpu_write_at_idx(&cpu, 0x21, 0x42), ERR_NONE);
+    {
+        DO_RUN(cpu, OP_LD_B_N8);
+        ck_assert_int_eq(cpu.B, 0x42);
+        ck_assert_int_eq(cpu.PC, 0x22);
+    }
+    {
+        DO_RUN(cpu, OP_LD_A_N16R);
+        ck_assert_int_eq(cpu.PC, 0x25);
+    }
+
+    END_RUN();
+#ifdef WITH_PRINT
+    printf("=== END of %s\n", __func__);
+#endif
+}
+END_TEST
+
 //================================================================
 //                  END END END
 //================================================================
@@ -1554,6 +1597,9 @@ Suite* cpu_test_suite()
     tcase_add_test(tc99, test_STOP); // Doing Nothing
     tcase_add_test(tc99, test_NOP);  // Doing Nothing
 
+    Add_Case(s, tcpc, "Cpu Dispatch PC Tests");
+    tcase_add_test(tcpc, test_PC_after_ALU_LD);
+
     return s;
 }
 TEST_SUITE(cpu_test_suite)
@@ -0,0 +1,232 @@
+/**
+ * @file unit-test-frame-dump.c
+ * @brief Unit test code for the asynchronous frame dump
+ *
+ * @date 2020
+ */
+
+// for thread-safe randomization
+#include <time.h>
+#include <stdlib.h>
+#include <sys/types.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include <check.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "tests.h"
+#include "frame_dump.h"
+#include "image.h"
+#include "error.h"
+
+#define NB_FRAMES 5
+#define PPM_SIZE  (15 + 3 * LCD_WIDTH * LCD_HEIGHT)
+#define Y4M_SIZE  (6 + LCD_WIDTH * LCD_HEIGHT * 3 / 2)
+
+static frame_pixels_t pixels;
+
+static void fill_pixels(void)
+{
+    for (size_t y = 0; y < LCD_HEIGHT; ++y) {
+        for (size_t x = 0; x < LCD_WIDTH; ++x) {
+            pixels[y][x] = (uint8_t) ((x + y) % 4);
+        }
+    }
+}
+
+static size_t read_file(const char* name, uint8_t* buffer, size_t size)
+{
+    FILE* file = fopen(name, "rb");
+    ck_assert_ptr_nonnull(file);
+    const size_t n = fread(buffer, 1, size, file);
+    fclose(file);
+    remove(name);
+    return n;
+}
+
+START_TEST(frame_dump_err)
+{
+// ------------------------------------------------------------
+#ifdef WITH_PRINT
+    printf("=== %s:\n", __func__);
+#endif
+    frame_dump_t dump;
+    image_t image = {0, NULL};
+
+    ck_assert_bad_param(frame_dump_open(NULL, "f.ppm", FRAME_DUMP_PPM, 1));
+    ck_assert_bad_param(frame_dump_open(&dump, NULL, FRAME_DUMP_PPM, 1));
+    ck_assert_bad_param(frame_dump_open(&dump, "f.ppm", NB_FRAME_DUMP_FORMATS, 1));
+    ck_assert_bad_param(frame_dump_open(&dump, "f.ppm", FRAME_DUMP_PPM, 0));
+    ck_assert_int_eq(frame_dump_open(&dump, "/nonexistent/dir/f.ppm", FRAME_DUMP_PPM, 1), ERR_IO);
+
+    ck_assert_err_none(frame_dump_open(&dump, "unit-test-frame-dump.ppm", FRAME_DUMP_PPM, 1));
+    ck_assert_bad_param(frame_dump_push_image(&dump, NULL));
+    ck_assert_bad_param(frame_dump_push_image(&dump, &image));
+    ck_assert_err_none(frame_dump_close(&dump));
+    remove("unit-test-frame-dump.ppm");
+
+    ck_assert_int_eq(frame_dump_format_from_name("a.y4m"), FRAME_DUMP_Y4M);
+    ck_assert_int_eq(frame_dump_format_from_name("a.png"), FRAME_DUMP_PNG);
+    ck_assert_int_eq(frame_dump_format_from_name("a.ppm"), FRAME_DUMP_PPM);
+    ck_assert_int_eq(frame_dump_format_from_name("a"), FRAME_DUMP_PPM);
+
+#ifdef WITH_PRINT
+    printf("=== END of %s\n", __func__);
+#endif
+}
+END_TEST
+
+START_TEST(frame_dump_ppm_exec)
+{
+// ------------------------------------------------------------
+#ifdef WITH_PRINT
+    printf("=== %s:\n", __func__);
+#endif
+    frame_dump_t dump;
+    fill_pixels();
+
+    ck_assert_err_none(frame_dump_open(&dump, "unit-test-frame-dump.ppm", FRAME_DUMP_PPM, NB_FRAMES));
+    for (size_t i = 0; i < NB_FRAMES; ++i) {
+        ck_assert_err_none(frame_dump_push_pixels(&dump, &pixels[0][0]));
+    }
+    ck_assert_err_none(frame_dump_close(&dump));
+    ck_assert_uint_eq(dump.captured, NB_FRAMES);
+    ck_assert_uint_eq(dump.written + dump.dropped, NB_FRAMES);
+
+    uint8_t* buffer = malloc(NB_FRAMES * PPM_SIZE + 1);
+    ck_assert_ptr_nonnull(buffer);
+    ck_assert_uint_eq(read_file("unit-test-frame-dump.ppm", buffer, NB_FRAMES * PPM_SIZE + 1),
+                      dump.written * PPM_SIZE);
+    ck_assert_int_eq(memcmp(buffer, "P6\n160 144\n255\n", 15), 0);
+    ck_assert_int_eq(buffer[15], 255);
+    ck_assert_int_eq(buffer[15 + 3], 170);
+    ck_assert_int_eq(buffer[15 + 3 * (LCD_WIDTH + 2)], 0);
+    free(buffer);
+
+#ifdef WITH_PRINT
+    printf("=== END of %s\n", __func__);
+#endif
+}
+END_TEST
+
+START_TEST(frame_dump_y4m_exec)
+{
+// ------------------------------------------------------------
+#ifdef WITH_PRINT
+    printf("=== %s:\n", __func__);
+#endif
+    frame_dump_t dump;
+    image_t image;
+    ck_assert_err_none(image_create(&image, LCD_WIDTH, LCD_HEIGHT));
+    image_line_t line;
+    ck_assert_err_none(image_line_create(&line, LCD_WIDTH));
+    for (size_t w = 0; w < LCD_WIDTH / IMAGE_LINE_WORD_BITS; ++w) {
+        ck_assert_err_none(image_line_set_word(&line, w, 0xFFFFFFFF, 0)); // color 2
+    }
+    ck_assert_err_none(image_set_line(&image, 3, line));
+    image_line_free(&line);
+
+    ck_assert_err_none(frame_dump_open(&dump, "unit-test-frame-dump.y4m", FRAME_DUMP_Y4M, 2));
+    ck_assert_err_none(frame_dump_push_image(&dump, &image));
+    ck_assert_err_none(frame_dump_close(&dump));
+    image_free(&image);
+    ck_assert_uint_eq(dump.written, 1);
+
+    uint8_t* buffer = malloc(1024 + Y4M_SIZE);
+    ck_assert_ptr_nonnull(buffer);
+    const size_t size = read_file("unit-test-frame-dump.y4m", buffer, 1024 + Y4M_SIZE);
+    const uint8_t* frame = memchr(buffer, '\n', size);
+    ck_assert_ptr_nonnull(frame);
+    ck_assert_int_eq(memcmp(buffer, "YUV4MPEG2 W160 H144 ", 20), 0);
+    ck_assert_uint_eq(size - (size_t) (frame + 1 - buffer), Y4M_SIZE);
+    ck_assert_int_eq(memcmp(frame + 1, "FRAME\n", 6), 0);
+    ck_assert_int_eq(frame[7], 255);
+    ck_assert_int_eq(frame[7 + 3 * LCD_WIDTH + 5], 85);
+    ck_assert_int_eq(frame[7 + LCD_WIDTH * LCD_HEIGHT], 128);
+    free(buffer);
+
+#ifdef WITH_PRINT
+    printf("=== END of %s\n", __func__);
+#endif
+}
+END_TEST
+
+START_TEST(frame_dump_png_exec)
+{
+// ------------------------------------------------------------
+#ifdef WITH_PRINT
+    printf("=== %s:\n", __func__);
+#endif
+    static const uint8_t signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+    frame_dump_t dump;
+    fill_pixels();
+
+    ck_assert_err_none(frame_dump_open(&dump, "unit-test-frame-dump.png", FRAME_DUMP_PNG, 2));
+    ck_assert_err_none(frame_dump_push_pixels(&dump, &pixels[0][0]));
+    ck_assert_err_none(frame_dump_close(&dump));
+    ck_assert_uint_eq(dump.written, 1);
+
+    uint8_t buffer[32 * 1024];
+    const size_t size = read_file("unit-test-frame-dump-000000.png", buffer, sizeof(buffer));
+    ck_assert_uint_gt(size, LCD_WIDTH * LCD_HEIGHT);
+    ck_assert_int_eq(memcmp(buffer, signature, sizeof(signature)), 0);
+    ck_assert_int_eq(memcmp(buffer + 12, "IHDR", 4), 0);
+    ck_assert_int_eq(memcmp(buffer + size - 8, "IEND", 4), 0);
+
+#ifdef WITH_PRINT
+    printf("=== END of %s\n", __func__);
+#endif
+}
+END_TEST
+
+START_TEST(frame_dump_drop_exec)
+{
+// ------------------------------------------------------------
+#ifdef WITH_PRINT
+    printf("=== %s:\n", __func__);
+#endif
+    frame_dump_t dump;
+    fill_pixels();
+
+    // far more frames than the writer can keep up with
+    ck_assert_err_none(frame_dump_open(&dump, "unit-test-frame-dump.ppm", FRAME_DUMP_PPM, 1));
+    for (size_t i = 0; i < 1000; ++i) {
+        ck_assert_err_none(frame_dump_push_pixels(&dump, &pixels[0][0]));
+    }
+    ck_assert_err_none(frame_dump_close(&dump));
+    ck_assert_uint_eq(dump.captured, 1000);
+    ck_assert_uint_gt(dump.dropped, 0);
+    ck_assert_uint_eq(dump.written + dump.dropped, 1000);
+    remove("unit-test-frame-dump.ppm");
+
+#ifdef WITH_PRINT
+    printf("=== END of %s\n", __func__);
+#endif
+}
+END_TEST
+
+Suite* frame_dump_test_suite()
+{
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wsign-conversion"
+#pragma GCC diagnostic ignored "-Wconversion"
+    srand(time(NULL) ^ getpid() ^ pthread_self());
+#pragma GCC diagnostic pop
+
+    Suite* s = suite_create("frame_dump.c Tests");
+
+    Add_Case(s, tc1, "Frame dump Tests");
+    tcase_add_test(tc1, frame_dump_err);
+    tcase_add_test(tc1, frame_dump_ppm_exec);
+    tcase_add_test(tc1, frame_dump_y4m_exec);
+    tcase_add_test(tc1, frame_dump_png_exec);
+    tcase_add_test(tc1, frame_dump_drop_exec);
+
+    return s;
+}
+
+TEST_SUITE(frame_dump_test_suite)
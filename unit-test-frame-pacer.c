@@ -0,0 +1,266 @@
+/**
+ * @file unit-test-frame-pacer.c
+ * @brief Unit test code for the pacing of frames
+ *
+ * @date 2020
+ */
+
+#include <time.h>
+#include <stdlib.h>
+
+#include <check.h>
+#include <inttypes.h>
+#include <string.h>
+
+#include "util.h"
+#include "tests.h"
+#include "frame_pacer.h"
+#include "gameboy.h"
+#include "lcdc.h"
+#include "error.h"
+
+// frames of 2 ms
+#define TEST_FRAME_CYCLES 1
+#define TEST_CYCLES_PER_S 500
+#define TEST_FRAME_NS 2000000ULL
+
+#define NB_FRAMES 50
+#define MAX_CATCH_UP 3
+
+/**
+ * @brief Clock of the tests: time only goes on when slept or told to
+ */
+typedef struct {
+    uint64_t now;
+    uint64_t slept;  // number of sleeps
+    uint64_t until;  // time of the last one
+    int error;       // returned by the sleeps
+} test_clock_t;
+
+static uint64_t test_now(void* clock_data)
+{
+    return ((test_clock_t*) clock_data) -> now;
+}
+
+static int test_sleep_until(void* clock_data, uint64_t until_ns)
+{
+    test_clock_t* const c = clock_data;
+    if (c -> error != ERR_NONE) return c -> error;
+    ck_assert_uint_gt(until_ns, c -> now);
+    ++(c -> slept);
+    c -> until = until_ns;
+    c -> now = until_ns;
+    return ERR_NONE;
+}
+
+#define INIT(frame_cycles, cycles_per_s) \
+    frame_pacer_t pacer; \
+    zero_init_var(pacer); \
+    test_clock_t fake = { .now = 1000000000ULL }; \
+    ck_assert_err_none(frame_pacer_init(&pacer, frame_cycles, cycles_per_s, MAX_CATCH_UP)); \
+    ck_assert_err_none(frame_pacer_set_clock(&pacer, test_now, test_sleep_until, &fake))
+
+START_TEST(frame_pacer_err)
+{
+// ------------------------------------------------------------
+#ifdef WITH_PRINT
+    printf("=== %s:\n", __func__);
+#endif
+    frame_pacer_t pacer;
+    zero_init_var(pacer);
+    ck_assert_bad_param(frame_pacer_init(NULL, 1, 1, 0));
+    ck_assert_bad_param(frame_pacer_init(&pacer, 0, 1, 0));
+    ck_assert_bad_param(frame_pacer_init(&pacer, 1, 0, 0));
+    ck_assert_bad_param(frame_pacer_init(&pacer, 1, (uint64_t) UINT32_MAX + 1, 0));
+    ck_assert_bad_param(frame_pacer_wait(&pacer)); // not initialised
+    ck_assert_bad_param(frame_pacer_wait(NULL));
+    ck_assert_bad_param(frame_pacer_reset(NULL));
+    ck_assert_bad_param(frame_pacer_reset(&pacer)); // not initialised
+    ck_assert_bad_param(frame_pacer_set_speed(&pacer, SPEED_UNTHROTTLED, 0)); // not initialised
+    ck_assert_bad_param(frame_pacer_set_clock(&pacer, NULL, NULL, NULL)); // not initialised
+    ck_assert_int_eq(frame_pacer_present_due(NULL), 0);
+
+    ck_assert_err_none(frame_pacer_init(&pacer, TEST_FRAME_CYCLES, TEST_CYCLES_PER_S, MAX_CATCH_UP));
+    ck_assert_bad_param(frame_pacer_set_clock(NULL, NULL, NULL, NULL));
+    ck_assert_bad_param(frame_pacer_set_speed(NULL, SPEED_REAL_TIME, 1));
+    ck_assert_bad_param(frame_pacer_set_speed(&pacer, NB_SPEED_MODES, 1));
+    ck_assert_bad_param(frame_pacer_set_speed(&pacer, SPEED_MULTIPLIER, 0));
+    ck_assert_bad_param(frame_pacer_set_speed(&pacer, SPEED_MULTIPLIER, FRAME_PACER_MAX_MULTIPLIER + 1));
+    ck_assert_err_none(frame_pacer_set_speed(&pacer, SPEED_UNTHROTTLED, 0)); // multiplier unused
+    ck_assert_err_none(frame_pacer_init(&pacer, TEST_FRAME_CYCLES, UINT32_MAX, MAX_CATCH_UP));
+    ck_assert_bad_param(frame_pacer_set_speed(&pacer, SPEED_MULTIPLIER, 2));
+
+    // the errors of the clock are passed on
+    test_clock_t fake = { .now = 1000, .error = ERR_IO };
+    ck_assert_err_none(frame_pacer_init(&pacer, TEST_FRAME_CYCLES, TEST_CYCLES_PER_S, MAX_CATCH_UP));
+    ck_assert_err_none(frame_pacer_set_clock(&pacer, test_now, test_sleep_until, &fake));
+    ck_assert_int_eq(frame_pacer_wait(&pacer), ERR_IO);
+
+#ifdef WITH_PRINT
+    printf("=== END of %s\n", __func__);
+#endif
+}
+END_TEST
+
+START_TEST(frame_pacer_steady_exec)
+{
+// ------------------------------------------------------------
+#ifdef WITH_PRINT
+    printf("=== %s:\n", __func__);
+#endif
+    INIT(TEST_FRAME_CYCLES, TEST_CYCLES_PER_S);
+    const uint64_t start = fake.now;
+    ck_assert_uint_eq(pacer.origin_ns, start);
+    for (size_t f = 0; f < NB_FRAMES; ++f) {
+        // deadlines are absolute: no drift whatever the time spent between waits
+        fake.now += (f % 3) * TEST_FRAME_NS / 3;
+        ck_assert_err_none(frame_pacer_wait(&pacer));
+        ck_assert_uint_eq(fake.slept, f + 1);
+        ck_assert_uint_eq(fake.until, start + (f + 1) * TEST_FRAME_NS);
+    }
+    ck_assert_uint_eq(pacer.paced, NB_FRAMES);
+    ck_assert_uint_eq(pacer.dropped, 0);
+
+    // gameboy frames, of a fractional number of nanoseconds: no rounding error accumulated
+    ck_assert_err_none(frame_pacer_init(&pacer, FRAME_TOTAL_CYCLES, GB_CYCLES_PER_S, MAX_CATCH_UP));
+    ck_assert_err_none(frame_pacer_set_clock(&pacer, test_now, test_sleep_until, &fake));
+    const uint64_t gb_start = fake.now;
+    for (uint64_t f = 1; f <= 1000; ++f) {
+        ck_assert_err_none(frame_pacer_wait(&pacer));
+        ck_assert_uint_eq(fake.until, gb_start + f * FRAME_TOTAL_CYCLES * 1000000000ULL / GB_CYCLES_PER_S);
+    }
+
+    // the monotonic clock by default, which is never early
+    ck_assert_err_none(frame_pacer_init(&pacer, TEST_FRAME_CYCLES, TEST_CYCLES_PER_S, MAX_CATCH_UP));
+    const uint64_t real_start = pacer.origin_ns;
+    for (size_t f = 0; f < 5; ++f) {
+        ck_assert_err_none(frame_pacer_wait(&pacer));
+    }
+    ck_assert_uint_ge(frame_pacer_now_ns() - real_start, 5 * TEST_FRAME_NS);
+
+#ifdef WITH_PRINT
+    printf("=== END of %s\n", __func__);
+#endif
+}
+END_TEST
+
+START_TEST(frame_pacer_stall_exec)
+{
+// ------------------------------------------------------------
+#ifdef WITH_PRINT
+    printf("=== %s:\n", __func__);
+#endif
+    INIT(TEST_FRAME_CYCLES, TEST_CYCLES_PER_S);
+    const uint64_t start = fake.now;
+    ck_assert_err_none(frame_pacer_wait(&pacer));
+
+    // a stall of 20 frames
+    fake.now += 20 * TEST_FRAME_NS;
+
+    // a few frames at once to catch up...
+    for (size_t f = 0; f < MAX_CATCH_UP; ++f) {
+        ck_assert_err_none(frame_pacer_wait(&pacer));
+    }
+    ck_assert_uint_eq(fake.slept, 1);
+    ck_assert_uint_eq(pacer.late, MAX_CATCH_UP);
+    ck_assert_uint_eq(pacer.dropped, 0);
+
+    // ...then the others are dropped, and pacing goes on from now
+    ck_assert_err_none(frame_pacer_wait(&pacer));
+    ck_assert_uint_eq(fake.slept, 1);
+    ck_assert_uint_eq(pacer.dropped, 21 - (1 + MAX_CATCH_UP + 1));
+    ck_assert_uint_eq(pacer.late, 0);
+    const uint64_t resumed = fake.now;
+    ck_assert_uint_eq(resumed, start + 21 * TEST_FRAME_NS);
+    ck_assert_err_none(frame_pacer_wait(&pacer));
+    ck_assert_uint_eq(fake.until, resumed + TEST_FRAME_NS);
+
+    // no catch-up after a reset
+    fake.now += 20 * TEST_FRAME_NS;
+    ck_assert_err_none(frame_pacer_reset(&pacer));
+    const uint64_t reset = fake.now;
+    ck_assert_err_none(frame_pacer_wait(&pacer));
+    ck_assert_uint_eq(fake.until, reset + TEST_FRAME_NS);
+    ck_assert_uint_eq(pacer.late, 0);
+
+#ifdef WITH_PRINT
+    printf("=== END of %s\n", __func__);
+#endif
+}
+END_TEST
+
+START_TEST(frame_pacer_speed_exec)
+{
+// ------------------------------------------------------------
+#ifdef WITH_PRINT
+    printf("=== %s:\n", __func__);
+#endif
+    INIT(TEST_FRAME_CYCLES, TEST_CYCLES_PER_S);
+
+    // 4 times as many frames per period
+    ck_assert_err_none(frame_pacer_set_speed(&pacer, SPEED_MULTIPLIER, 4));
+    const uint64_t start = fake.now;
+    for (size_t f = 0; f < NB_FRAMES; ++f) {
+        ck_assert_err_none(frame_pacer_wait(&pacer));
+        ck_assert_uint_eq(fake.until, start + (f + 1) * TEST_FRAME_NS / 4);
+    }
+
+    // shown at most once per period
+    ck_assert_int_eq(frame_pacer_present_due(&pacer), 1);
+    ck_assert_int_eq(frame_pacer_present_due(&pacer), 0);
+    fake.now += TEST_FRAME_NS - 1;
+    ck_assert_int_eq(frame_pacer_present_due(&pacer), 0);
+    fake.now += 1;
+    ck_assert_int_eq(frame_pacer_present_due(&pacer), 1);
+
+    // the achieved speed is measured: frames of the measure over its length
+    ck_assert_err_none(frame_pacer_reset(&pacer));
+    const uint64_t readouts = pacer.readouts;
+    uint64_t frames = 0;
+    while (pacer.readouts == readouts) {
+        ck_assert_err_none(frame_pacer_wait(&pacer));
+        ++frames;
+    }
+    ck_assert_uint_eq(frames, FRAME_PACER_READOUT_NS / (TEST_FRAME_NS / 4) + 1);
+    ck_assert_uint_eq(pacer.achieved_cps, frames * TEST_FRAME_CYCLES * 1000000000ULL / FRAME_PACER_READOUT_NS);
+
+    // unthrottled: no wait at all, and never late
+    ck_assert_err_none(frame_pacer_set_speed(&pacer, SPEED_UNTHROTTLED, 0));
+    const uint64_t dropped = pacer.dropped;
+    const uint64_t slept = fake.slept;
+    for (size_t f = 0; f < 100 * NB_FRAMES; ++f) {
+        ck_assert_err_none(frame_pacer_wait(&pacer));
+        fake.now += TEST_FRAME_NS / 1000;
+    }
+    ck_assert_uint_eq(fake.slept, slept);
+    ck_assert_uint_eq(pacer.dropped, dropped);
+
+    // back to real time, from now
+    ck_assert_err_none(frame_pacer_set_speed(&pacer, SPEED_REAL_TIME, 0));
+    ck_assert_int_eq(frame_pacer_present_due(&pacer), 1);
+    ck_assert_int_eq(frame_pacer_present_due(&pacer), 1);
+    const uint64_t slow = fake.now;
+    ck_assert_err_none(frame_pacer_wait(&pacer));
+    ck_assert_uint_eq(fake.until, slow + TEST_FRAME_NS);
+    ck_assert_uint_eq(pacer.late, 0);
+
+#ifdef WITH_PRINT
+    printf("=== END of %s\n", __func__);
+#endif
+}
+END_TEST
+
+Suite* frame_pacer_test_suite()
+{
+    Suite* s = suite_create("frame_pacer.c Tests");
+
+    Add_Case(s, tc1, "Frame Pacer Tests");
+    tcase_add_test(tc1, frame_pacer_err);
+    tcase_add_test(tc1, frame_pacer_steady_exec);
+    tcase_add_test(tc1, frame_pacer_stall_exec);
+    tcase_add_test(tc1, frame_pacer_speed_exec);
+
+    return s;
+}
+
+TEST_SUITE(frame_pacer_test_suite)
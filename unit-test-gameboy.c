@@ -0,0 +1,256 @@
+/**
+ * @file unit-test-gameboy.c
+ * @brief Unit test code for independent gameboys run concurrently
+ *
+ * Meant to also be run built with ThreadSanitizer (make unit-test-gameboy-tsan):
+ * instances must share nothing but read-only data.
+ *
+ * @date 2020
+ */
+
+// for thread-safe randomization
+#include <time.h>
+#include <stdlib.h>
+#include <sys/types.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include <check.h>
+#include <inttypes.h>
+#include <string.h>
+
+#include "tests.h"
+#include "tests-snapshot.h"
+#include "gameboy.h"
+#include "bit_vector.h"
+#include "tile_decode.h"
+#include "error.h"
+
+#define FIBONACCI_ROM "tests/data/fibonacci.gb"
+
+#define NB_THREADS 8
+#define NB_ROUNDS 3          // gameboys created and freed by each thread
+#define RUN_CYCLES 150000
+#define MAX_CHUNK_CYCLES 20000
+#define VECTOR_BITS 4096
+
+typedef struct {
+    unsigned int seed;
+    const snapshot_t* expected;
+    int err;
+    size_t mismatches;
+} worker_t;
+
+// ======================================================================
+/**
+ * @brief runs a fresh gameboy to RUN_CYCLES, in chunks of random length when seed is given
+ */
+static int run_one(snapshot_t* s, unsigned int* seed)
+{
+    gameboy_t* gb = calloc(1, sizeof(gameboy_t));
+    if (gb == NULL) return ERR_MEM;
+    int err = gameboy_create(gb, FIBONACCI_ROM);
+    while (err == ERR_NONE && gb -> cycles < RUN_CYCLES) {
+        uint64_t until = RUN_CYCLES;
+        if (seed != NULL) {
+            const uint64_t chunk = 1 + (uint64_t) rand_r(seed) % MAX_CHUNK_CYCLES;
+            if (gb -> cycles + chunk < until) until = gb -> cycles + chunk;
+        }
+        err = gameboy_run_until(gb, until);
+    }
+    if (err == ERR_NONE) take_snapshot(s, gb);
+    gameboy_free(gb);
+    free(gb);
+    return err;
+}
+
+// ======================================================================
+static void* gameboy_worker(void* arg)
+{
+    worker_t* const w = arg;
+    snapshot_t* const s = malloc(sizeof(snapshot_t));
+    if (s == NULL) {
+        w -> err = ERR_MEM;
+        return NULL;
+    }
+    for (size_t round = 0; w -> err == ERR_NONE && round < NB_ROUNDS; ++round) {
+        w -> err = run_one(s, &(w -> seed));
+        if (w -> err == ERR_NONE && memcmp(s, w -> expected, sizeof(snapshot_t)) != 0) {
+            ++(w -> mismatches);
+        }
+    }
+    free(s);
+    return NULL;
+}
+
+// ======================================================================
+static void* kernels_worker(void* arg)
+{
+    worker_t* const w = arg;
+    bit_vector_t* a = bit_vector_create(VECTOR_BITS, 0);
+    bit_vector_t* b = bit_vector_create(VECTOR_BITS, 0);
+    if (a == NULL || b == NULL) {
+        w -> err = ERR_MEM;
+    }
+    for (size_t round = 0; w -> err == ERR_NONE && round < 100; ++round) {
+        // both lazily detect the backend in use on first call
+        if (strcmp(bit_vector_backend_name(BIT_VECTOR_BACKEND_AUTO), "unknown") == 0 ||
+            strcmp(tile_decode_kernel_name(TILE_DECODE_AUTO), "unknown") == 0) {
+            ++(w -> mismatches);
+        }
+        for (size_t i = 0; i < VECTOR_BITS / 32; ++i) {
+            a -> content[i] = (uint32_t) rand_r(&(w -> seed));
+            b -> content[i] = (uint32_t) rand_r(&(w -> seed));
+        }
+        const uint32_t a0 = a -> content[round % (VECTOR_BITS / 32)];
+        const uint32_t b0 = b -> content[round % (VECTOR_BITS / 32)];
+        bit_vector_xor(bit_vector_or(a, b), b);
+        if (a -> content[round % (VECTOR_BITS / 32)] != (a0 & ~b0)) {
+            ++(w -> mismatches);
+        }
+    }
+    bit_vector_free(&a);
+    bit_vector_free(&b);
+    return NULL;
+}
+
+// ======================================================================
+static void run_workers(void* (*fn)(void*), const snapshot_t* expected)
+{
+    pthread_t threads[NB_THREADS];
+    worker_t workers[NB_THREADS];
+    for (size_t i = 0; i < NB_THREADS; ++i) {
+        workers[i].seed = (unsigned int) rand();
+        workers[i].expected = expected;
+        workers[i].err = ERR_NONE;
+        workers[i].mismatches = 0;
+        ck_assert_int_eq(pthread_create(threads + i, NULL, fn, workers + i), 0);
+    }
+    for (size_t i = 0; i < NB_THREADS; ++i) {
+        ck_assert_int_eq(pthread_join(threads[i], NULL), 0);
+    }
+    for (size_t i = 0; i < NB_THREADS; ++i) {
+        ck_assert_err_none(workers[i].err);
+        ck_assert_uint_eq(workers[i].mismatches, 0);
+    }
+}
+
+START_TEST(gameboy_instances_exec)
+{
+// ------------------------------------------------------------
+#ifdef WITH_PRINT
+    printf("=== %s:\n", __func__);
+#endif
+    static snapshot_t expected;
+    ck_assert_err_none(run_one(&expected, NULL));
+    ck_assert_uint_eq(expected.cycles, RUN_CYCLES);
+
+    run_workers(gameboy_worker, &expected);
+
+#ifdef WITH_PRINT
+    printf("=== END of %s\n", __func__);
+#endif
+}
+END_TEST
+
+START_TEST(shared_kernels_exec)
+{
+// ------------------------------------------------------------
+#ifdef WITH_PRINT
+    printf("=== %s:\n", __func__);
+#endif
+    // every thread races to detect the kernels
+    ck_assert_err_none(bit_vector_select_backend(BIT_VECTOR_BACKEND_AUTO));
+    ck_assert_err_none(tile_decode_select(TILE_DECODE_AUTO));
+
+    run_workers(kernels_worker, NULL);
+
+#ifdef WITH_PRINT
+    printf("=== END of %s\n", __func__);
+#endif
+}
+END_TEST
+
+START_TEST(gameboy_fast_boot_exec)
+{
+// ------------------------------------------------------------
+#ifdef WITH_PRINT
+    printf("=== %s:\n", __func__);
+#endif
+    gameboy_t* gb = calloc(1, sizeof(gameboy_t));
+    ck_assert_ptr_nonnull(gb);
+    ck_assert_bad_param(gameboy_create_with_boot(NULL, FIBONACCI_ROM, BOOT_FAST));
+    ck_assert_bad_param(gameboy_create_with_boot(gb, FIBONACCI_ROM, (boot_mode_t) 2));
+
+    // the boot ROM runs first, over the cartridge
+    ck_assert_err_none(gameboy_create_with_boot(gb, FIBONACCI_ROM, BOOT_WITH_ROM));
+    ck_assert_uint_eq(gb -> boot, 1);
+    ck_assert_ptr_eq(gb -> bus[0x0000], gb -> bootrom.mem -> memory);
+    ck_assert_uint_eq(gb -> cpu.PC, 0x0000);
+    gameboy_free(gb);
+    memset(gb, 0, sizeof(gameboy_t));
+
+    // the state it leaves, at once: DMG registers after boot
+    ck_assert_err_none(gameboy_create_with_boot(gb, FIBONACCI_ROM, BOOT_FAST));
+    ck_assert_uint_eq(gb -> boot, 0);
+    ck_assert_ptr_eq(gb -> bus[0x0000], gb -> cartridge.c.mem -> memory);
+    ck_assert_ptr_eq(gb -> bus[0x0100], gb -> cartridge.c.mem -> memory + 0x0100);
+    ck_assert_uint_eq(gb -> cpu.AF, 0x01B0);
+    ck_assert_uint_eq(gb -> cpu.BC, 0x0013);
+    ck_assert_uint_eq(gb -> cpu.DE, 0x00D8);
+    ck_assert_uint_eq(gb -> cpu.HL, 0x014D);
+    ck_assert_uint_eq(gb -> cpu.SP, 0xFFFE);
+    ck_assert_uint_eq(gb -> cpu.PC, 0x0100);
+    ck_assert_uint_eq(gb -> cpu.IME, 0);
+    ck_assert_uint_eq(gb -> cpu.IF, 0xE1);
+    ck_assert_uint_eq(gb -> cpu.IE, 0x00);
+    ck_assert_uint_eq(*(gb -> bus[REG_P1]), 0xCF);
+    ck_assert_uint_eq(*(gb -> bus[REG_DIV]), 0xAB);
+    ck_assert_uint_eq(gb -> timer.counter, 0xABCC);
+    ck_assert_uint_eq(*(gb -> bus[REG_TAC]), 0xF8);
+    ck_assert_uint_eq(*(gb -> bus[REG_LCDC]), 0x91);
+    ck_assert_uint_eq(*(gb -> bus[REG_STAT]), 0x85);
+    ck_assert_uint_eq(*(gb -> bus[REG_BGP]), 0xFC);
+    ck_assert_uint_eq(*(gb -> bus[REG_OBP0]), 0xFF);
+    ck_assert_uint_eq(*(gb -> bus[REG_OBP1]), 0xFF);
+    ck_assert_uint_eq(*(gb -> bus[0xFF26]), 0xF1);
+    ck_assert_uint_eq(*(gb -> bus[REG_BOOT_ROM_DISABLE]), 0xFF);
+    ck_assert_uint_eq(gb -> cycles, 1);
+
+    // the cartridge runs from its entry point, which jumps to 0x0000 in this ROM
+    ck_assert_err_none(gameboy_run_until(gb, 100));
+    ck_assert_uint_lt(gb -> cpu.PC, 0x0100);
+    ck_assert_uint_eq(gb -> boot, 0);
+
+    gameboy_free(gb);
+    free(gb);
+
+#ifdef WITH_PRINT
+    printf("=== END of %s\n", __func__);
+#endif
+}
+END_TEST
+
+Suite* gameboy_test_suite()
+{
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wsign-conversion"
+#pragma GCC diagnostic ignored "-Wconversion"
+    srand(time(NULL) ^ getpid() ^ pthread_self());
+#pragma GCC diagnostic pop
+
+    Suite* s = suite_create("gameboy.c Tests");
+
+    Add_Case(s, tc1, "Concurrent Instances Tests");
+    tcase_set_timeout(tc1, 60);
+    tcase_add_test(tc1, gameboy_instances_exec);
+    tcase_add_test(tc1, shared_kernels_exec);
+
+    Add_Case(s, tc2, "Boot Tests");
+    tcase_add_test(tc2, gameboy_fast_boot_exec);
+
+    return s;
+}
+
+TEST_SUITE(gameboy_test_suite)
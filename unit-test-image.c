@@ -0,0 +1,285 @@
+/**
+ * @file unit-test-image.c
+ * @brief Unit test code for image lines and their allocation-free API
+ *
+ * @date 2020
+ */
+
+// for thread-safe randomization
+#include <time.h>
+#include <stdlib.h>
+#include <sys/types.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include <check.h>
+#include <inttypes.h>
+
+#include "tests.h"
+#include "image.h"
+#include "error.h"
+
+#define LINE_SIZE 80 // not a multiple of IMAGE_LINE_WORD_BITS
+#define LINE_WORDS 3
+
+#define line_match_line(l1, l2) \
+    do { \
+        ck_assert_uint_eq((l1).msb->size, (l2).msb->size); \
+        for (size_t i_ = 0; i_ < LINE_WORDS; ++i_) { \
+            ck_assert_uint_eq((l1).msb->content[i_], (l2).msb->content[i_]); \
+            ck_assert_uint_eq((l1).lsb->content[i_], (l2).lsb->content[i_]); \
+            ck_assert_uint_eq((l1).opacity->content[i_], (l2).opacity->content[i_]); \
+        } \
+    } while(0)
+
+static void random_line(image_line_t* line)
+{
+    for (size_t i = 0; i < LINE_WORDS; ++i) {
+        image_line_set_word(line, i, (uint32_t) rand() ^ ((uint32_t) rand() << 16),
+                            (uint32_t) rand() ^ ((uint32_t) rand() << 16));
+    }
+    // unused bits of the last word stay 0
+    const uint32_t mask = (UINT32_C(1) << (LINE_SIZE % IMAGE_LINE_WORD_BITS)) - 1;
+    line->msb->content[LINE_WORDS - 1] &= mask;
+    line->lsb->content[LINE_WORDS - 1] &= mask;
+    line->opacity->content[LINE_WORDS - 1] &= mask;
+}
+
+START_TEST(image_scratch_exec)
+{
+// ------------------------------------------------------------
+#ifdef WITH_PRINT
+    printf("=== %s:\n", __func__);
+#endif
+    image_scratch_t scratch;
+    image_line_t line;
+
+    ck_assert_bad_param(image_scratch_create(NULL, LINE_SIZE));
+    ck_assert_bad_param(image_scratch_create(&scratch, 0));
+    ck_assert_bad_param(image_scratch_take(NULL, &line, 1));
+
+    ck_assert_err_none(image_scratch_create(&scratch, LINE_SIZE));
+    ck_assert_bad_param(image_scratch_take(&scratch, NULL, 1));
+    ck_assert_bad_param(image_scratch_take(&scratch, &line, 0));
+    ck_assert_bad_param(image_scratch_take(&scratch, &line, LINE_SIZE + 1));
+
+    image_line_t taken[IMAGE_SCRATCH_LINES];
+    for (size_t i = 0; i < IMAGE_SCRATCH_LINES; ++i) {
+        ck_assert_err_none(image_scratch_take(&scratch, taken + i, LINE_SIZE - i));
+        ck_assert_uint_eq(taken[i].msb->size, LINE_SIZE - i);
+        ck_assert_uint_eq(taken[i].opacity->size, LINE_SIZE - i);
+        for (size_t j = 0; j < i; ++j) {
+            ck_assert_ptr_ne(taken[i].msb, taken[j].msb);
+        }
+    }
+    ck_assert_int_eq(image_scratch_take(&scratch, &line, 1), ERR_MEM);
+
+    image_scratch_release(&scratch);
+    ck_assert_err_none(image_scratch_take(&scratch, &line, LINE_SIZE));
+    ck_assert_ptr_eq(line.msb, taken[0].msb);
+
+    image_scratch_free(&scratch);
+    image_scratch_free(NULL);
+
+#ifdef WITH_PRINT
+    printf("=== END of %s\n", __func__);
+#endif
+}
+END_TEST
+
+static uint8_t pixel(image_line_t line, int64_t x)
+{
+    return (uint8_t) ((bit_vector_get(line.msb, (size_t) x) << 1) | bit_vector_get(line.lsb, (size_t) x));
+}
+
+static bit_t opaque(image_line_t line, int64_t x)
+{
+    return bit_vector_get(line.opacity, (size_t) x);
+}
+
+START_TEST(image_line_to_exec)
+{
+// ------------------------------------------------------------
+#ifdef WITH_PRINT
+    printf("=== %s:\n", __func__);
+#endif
+    image_line_t below, above, expected;
+    ck_assert_err_none(image_line_create(&below, LINE_SIZE));
+    ck_assert_err_none(image_line_create(&above, LINE_SIZE));
+
+    image_scratch_t scratch;
+    ck_assert_err_none(image_scratch_create(&scratch, 2 * LINE_SIZE));
+    image_line_t out;
+    ck_assert_err_none(image_scratch_take(&scratch, &out, LINE_SIZE));
+
+    for (int round = 0; round < 50; ++round) {
+        random_line(&below);
+        random_line(&above);
+
+        for (int64_t shift = -LINE_SIZE; shift <= LINE_SIZE; shift += 13) {
+            ck_assert_err_none(image_line_shift_to(&out, below, shift));
+            for (int64_t x = 0; x < LINE_SIZE; ++x) {
+                const int64_t from = x - shift;
+                const bit_t inside = from >= 0 && from < LINE_SIZE;
+                ck_assert_uint_eq(pixel(out, x), inside ? pixel(below, from) : 0);
+                ck_assert_uint_eq(opaque(out, x), inside ? opaque(below, from) : 0);
+            }
+
+            ck_assert_err_none(image_line_extract_wrap_ext_to(&out, above, shift));
+            for (int64_t x = 0; x < LINE_SIZE; ++x) {
+                const int64_t from = ((x + shift) % LINE_SIZE + LINE_SIZE) % LINE_SIZE;
+                ck_assert_uint_eq(pixel(out, x), pixel(above, from));
+            }
+        }
+
+        const palette_t palette = (palette_t) rand();
+        ck_assert_err_none(image_line_map_colors_to(&out, above, palette));
+        for (int64_t x = 0; x < LINE_SIZE; ++x) {
+            ck_assert_uint_eq(pixel(out, x), (palette >> (2 * pixel(above, x))) & 3);
+            ck_assert_uint_eq(opaque(out, x), opaque(above, x));
+        }
+
+        ck_assert_err_none(image_line_below_to(&out, below, above));
+        for (int64_t x = 0; x < LINE_SIZE; ++x) {
+            ck_assert_uint_eq(pixel(out, x), opaque(above, x) ? pixel(above, x) : pixel(below, x));
+            ck_assert_uint_eq(opaque(out, x), opaque(above, x) | opaque(below, x));
+        }
+
+        const int64_t start = rand() % LINE_SIZE;
+        ck_assert_err_none(image_line_join_to(&out, below, above, start));
+        for (int64_t x = 0; x < LINE_SIZE; ++x) {
+            ck_assert_uint_eq(pixel(out, x), x < start ? pixel(below, x) : pixel(above, x));
+        }
+
+        // the allocating versions give the same lines, also in place
+        ck_assert_err_none(image_line_below(&expected, below, above));
+        ck_assert_err_none(image_line_below_to(&below, below, above));
+        line_match_line(below, expected);
+        image_line_free(&expected);
+
+        ck_assert_err_none(image_line_map_colors(&expected, below, palette));
+        ck_assert_err_none(image_line_map_colors_to(&below, below, palette));
+        line_match_line(below, expected);
+        image_line_free(&expected);
+
+        ck_assert_err_none(image_line_shift(&expected, below, start));
+        ck_assert_err_none(image_line_shift_to(&below, below, start));
+        line_match_line(below, expected);
+        image_line_free(&expected);
+    }
+
+    ck_assert_bad_param(image_line_extract_wrap_ext_to(&below, below, 1));
+    ck_assert_bad_param(image_line_below_with_opacity_to(&out, below, above, NULL));
+
+    image_scratch_free(&scratch);
+    image_line_free(&above);
+    image_line_free(&below);
+
+#ifdef WITH_PRINT
+    printf("=== END of %s\n", __func__);
+#endif
+}
+END_TEST
+
+START_TEST(image_storage_exec)
+{
+// ------------------------------------------------------------
+#ifdef WITH_PRINT
+    printf("=== %s:\n", __func__);
+#endif
+    image_t image, copy, other;
+    uint64_t hash = 0, copy_hash = 0;
+
+    ck_assert_bad_param(image_create(&image, 0, 1));
+    ck_assert_bad_param(image_create(&image, 1, 0));
+    ck_assert_bad_param(image_create(&image, 1, SIZE_MAX / 4));
+
+    ck_assert_err_none(image_create(&image, LINE_SIZE, 10));
+    ck_assert_err_none(image_create(&copy, LINE_SIZE, 10));
+    ck_assert_err_none(image_create(&other, LINE_SIZE, 11));
+
+    // a single slab: lines at a fixed stride after the line array
+    const uintptr_t first = (uintptr_t) image.content[0].msb;
+    const uintptr_t stride = (uintptr_t) image.content[0].lsb - first;
+    ck_assert_uint_eq((uintptr_t) image.content % 64, 0);
+    ck_assert_uint_gt(first, (uintptr_t) (image.content + image.height));
+    for (size_t y = 0; y < image.height; ++y) {
+        ck_assert_uint_eq((uintptr_t) image.content[y].msb,     first + (3 * y)     * stride);
+        ck_assert_uint_eq((uintptr_t) image.content[y].lsb,     first + (3 * y + 1) * stride);
+        ck_assert_uint_eq((uintptr_t) image.content[y].opacity, first + (3 * y + 2) * stride);
+        ck_assert_uint_eq(image.content[y].opacity->size, LINE_SIZE);
+        ck_assert_uint_eq(image.content[y].msb->content[LINE_WORDS - 1], 0);
+    }
+
+    image_line_t line;
+    ck_assert_err_none(image_line_create(&line, LINE_SIZE));
+    random_line(&line);
+    ck_assert_err_none(image_set_line(&image, 4, line));
+
+    ck_assert_err_none(image_hash(&hash, &image));
+    ck_assert_err_none(image_hash(&copy_hash, &copy));
+    ck_assert_uint_ne(hash, copy_hash);
+
+    ck_assert_bad_param(image_copy(&other, &image));
+    ck_assert_err_none(image_copy(&copy, &image));
+    ck_assert_err_none(image_hash(&copy_hash, &copy));
+    ck_assert_uint_eq(hash, copy_hash);
+    line_match_line(copy.content[4], line);
+
+    // ownership of the vectors goes to the image
+    image_line_t owned;
+    ck_assert_err_none(image_line_create(&owned, LINE_SIZE));
+    random_line(&owned);
+    ck_assert_err_none(image_set_line(&copy, 7, owned));
+    ck_assert_err_none(image_own_line_content(&image, 7, owned));
+    ck_assert_ptr_eq(image.content[7].msb, (bit_vector_t*) (first + 21 * stride));
+    line_match_line(image.content[7], copy.content[7]);
+
+    // whole image palette mapping, for every palette
+    for (unsigned map = 0; map <= UINT8_MAX; ++map) {
+        ck_assert_err_none(image_copy(&copy, &image));
+        ck_assert_err_none(image_map_colors(&copy, (palette_t) map));
+        for (size_t y = 0; y < image.height; ++y) {
+            for (int64_t x = 0; x < LINE_SIZE; ++x) {
+                ck_assert_uint_eq(pixel(copy.content[y], x), (map >> (2 * pixel(image.content[y], x))) & 3);
+                ck_assert_uint_eq(opaque(copy.content[y], x), opaque(image.content[y], x));
+            }
+            ck_assert_uint_eq(copy.content[y].lsb->content[LINE_WORDS - 1] >> (LINE_SIZE % 32), 0);
+            ck_assert_uint_eq(copy.content[y].msb->content[LINE_WORDS - 1] >> (LINE_SIZE % 32), 0);
+        }
+    }
+    ck_assert_bad_param(image_map_colors(NULL, 0));
+
+    image_line_free(&line);
+    image_free(&other);
+    image_free(&copy);
+    image_free(&image);
+    ck_assert_ptr_null(image.content);
+    ck_assert_uint_eq(image.height, 0);
+
+#ifdef WITH_PRINT
+    printf("=== END of %s\n", __func__);
+#endif
+}
+END_TEST
+
+Suite* image_test_suite()
+{
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wsign-conversion"
+#pragma GCC diagnostic ignored "-Wconversion"
+    srand(time(NULL) ^ getpid() ^ pthread_self());
+#pragma GCC diagnostic pop
+
+    Suite* s = suite_create("image.c Tests");
+
+    Add_Case(s, tc1, "Image Tests");
+    tcase_add_test(tc1, image_scratch_exec);
+    tcase_add_test(tc1, image_line_to_exec);
+    tcase_add_test(tc1, image_storage_exec);
+
+    return s;
+}
+
+TEST_SUITE(image_test_suite)
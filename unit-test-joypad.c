@@ -0,0 +1,138 @@
+/**
+ * @file unit-test-joypad.c
+ * @brief Unit test code for the joypad
+ *
+ * @date 2020
+ */
+
+// for thread-safe randomization
+#include <time.h>
+#include <stdlib.h>
+#include <sys/types.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include <check.h>
+#include <inttypes.h>
+
+#include "util.h"
+#include "tests.h"
+#include "joypad.h"
+#include "cpu.h"
+#include "bus.h"
+#include "error.h"
+
+#define INIT \
+    joypad_t pad; \
+    cpu_t cpu; \
+    bus_t bus; \
+    data_t p1 = 0; \
+    zero_init_var(pad); \
+    zero_init_var(cpu); \
+    zero_init_var(bus); \
+    bus[REG_P1] = &p1; \
+    cpu.bus = &bus
+
+// CPU write to P1, then notification of the joypad
+#define write_p1(value) \
+    do { \
+        p1 = (value); \
+        ck_assert_err_none(joypad_bus_listener(&pad, REG_P1)); \
+    } while(0)
+
+#define JOYPAD_IF (1 << JOYPAD)
+
+START_TEST(joypad_err)
+{
+// ------------------------------------------------------------
+#ifdef WITH_PRINT
+    printf("=== %s:\n", __func__);
+#endif
+    INIT;
+    ck_assert_bad_param(joypad_init_and_plug(NULL, &cpu));
+    ck_assert_bad_param(joypad_init_and_plug(&pad, NULL));
+    bus[REG_P1] = NULL;
+    ck_assert_bad_param(joypad_init_and_plug(&pad, &cpu));
+    bus[REG_P1] = &p1;
+
+    ck_assert_err_none(joypad_init_and_plug(&pad, &cpu));
+    ck_assert_bad_param(joypad_bus_listener(NULL, REG_P1));
+    ck_assert_bad_param(joypad_key_pressed(NULL, A_KEY));
+    ck_assert_bad_param(joypad_key_pressed(&pad, NB_GB_KEYS));
+    ck_assert_bad_param(joypad_key_released(&pad, NB_GB_KEYS));
+
+#ifdef WITH_PRINT
+    printf("=== END of %s\n", __func__);
+#endif
+}
+END_TEST
+
+START_TEST(joypad_exec)
+{
+// ------------------------------------------------------------
+#ifdef WITH_PRINT
+    printf("=== %s:\n", __func__);
+#endif
+    INIT;
+    ck_assert_err_none(joypad_init_and_plug(&pad, &cpu));
+    ck_assert_int_eq(p1, 0xFF); // no row selected, no key pressed
+
+    // not selected: no visible change, no interrupt
+    ck_assert_err_none(joypad_key_pressed(&pad, START_KEY));
+    ck_assert_int_eq(p1, 0xFF);
+    ck_assert_int_eq(cpu.IF & JOYPAD_IF, 0);
+
+    // buttons row selected: START line goes low, with an interrupt
+    write_p1(0x10);
+    ck_assert_int_eq(p1, 0xD7);
+    ck_assert_int_eq(cpu.IF & JOYPAD_IF, JOYPAD_IF);
+    cpu.IF = 0;
+
+    // key lines are read-only
+    write_p1(0x10 | 0x0F);
+    ck_assert_int_eq(p1, 0xD7);
+    ck_assert_int_eq(cpu.IF & JOYPAD_IF, 0);
+
+    // directions row selected
+    ck_assert_err_none(joypad_key_pressed(&pad, LEFT_KEY));
+    write_p1(0x20);
+    ck_assert_int_eq(p1, 0xED);
+    ck_assert_int_eq(cpu.IF & JOYPAD_IF, JOYPAD_IF);
+    cpu.IF = 0;
+
+    // both rows selected: lines are or-ed, START line goes low again
+    write_p1(0x00);
+    ck_assert_int_eq(p1, 0xC5);
+    ck_assert_int_eq(cpu.IF & JOYPAD_IF, JOYPAD_IF);
+    cpu.IF = 0;
+
+    ck_assert_err_none(joypad_key_released(&pad, START_KEY));
+    ck_assert_err_none(joypad_key_released(&pad, LEFT_KEY));
+    ck_assert_int_eq(p1, 0xCF);
+    ck_assert_int_eq(cpu.IF & JOYPAD_IF, 0);
+
+#ifdef WITH_PRINT
+    printf("=== END of %s\n", __func__);
+#endif
+}
+END_TEST
+
+Suite* joypad_test_suite()
+{
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wsign-conversion"
+#pragma GCC diagnostic ignored "-Wconversion"
+    srand(time(NULL) ^ getpid() ^ pthread_self());
+#pragma GCC diagnostic pop
+
+    Suite* s = suite_create("joypad.c Tests");
+
+    Add_Case(s, tc1, "Joypad Tests");
+    tcase_add_test(tc1, joypad_err);
+    tcase_add_test(tc1, joypad_exec);
+
+    return s;
+}
+
+TEST_SUITE(joypad_test_suite)
@@ -0,0 +1,496 @@
+/**
+ * @file unit-test-lcdc.c
+ * @brief Unit test code for the LCD controller
+ *
+ * @date 2020
+ */
+
+// for thread-safe randomization
+#include <time.h>
+#include <stdlib.h>
+#include <sys/types.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include <check.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "util.h"
+#include "tests.h"
+#include "gameboy.h"
+#include "lcdc.h"
+#include "scanline.h"
+#include "frame_dump.h"
+#include "error.h"
+
+#define FIBONACCI_ROM "tests/data/fibonacci.gb"
+
+// the fast boot leaves the LCD on (LCDC = 0x91), which starts at cycle 1
+#define LINE_START(ly) (1 + (uint64_t) (ly) * LINE_TOTAL_CYCLES)
+#define FRAME_START(n) (1 + (uint64_t) (n) * FRAME_TOTAL_CYCLES)
+
+// frames dumped, and size of one of them in each format
+#define NB_CAPTURED     3
+#define PPM_HEADER_SIZE 15
+#define PPM_SIZE        (PPM_HEADER_SIZE + 3 * LCD_WIDTH * LCD_HEIGHT)
+#define Y4M_SIZE        (6 + LCD_WIDTH * LCD_HEIGHT * 3 / 2)
+
+// the CPU sleeps (no interrupt enabled): only the LCD controller runs
+#define INIT \
+    gameboy_t gb; \
+    zero_init_var(gb); \
+    ck_assert_err_none(gameboy_create_with_boot(&gb, FIBONACCI_ROM, BOOT_FAST)); \
+    gb.cpu.IE = 0; \
+    gb.cpu.IF = 0; \
+    gb.cpu.HALT = 1
+
+#define END \
+    gameboy_free(&gb)
+
+#define reg(addr) (*(gb.bus[addr]))
+
+// ======================================================================
+/**
+ * @brief fills a tile with a single color
+ */
+static void fill_tile(gameboy_t* gb, size_t tile_nb, uint8_t color)
+{
+    for (size_t row = 0; row < TILE_PIXELS; ++row) {
+        const addr_t addr = (addr_t) (TILE_SRC_ADDR_LOW + tile_nb * TILE_SIZE + 2 * row);
+        ck_assert_err_none(bus_write(gb -> bus, addr, (color & 1) ? 0xFF : 0x00));
+        ck_assert_err_none(bus_write(gb -> bus, (addr_t) (addr + 1), (color & 2) ? 0xFF : 0x00));
+    }
+    tile_cache_invalidate_all(&(gb -> tiles));
+}
+
+// ======================================================================
+/**
+ * @brief writes a byte as the CPU would, with the listeners of the sprite index
+ */
+static void cpu_write(gameboy_t* gb, addr_t addr, data_t data)
+{
+    ck_assert_err_none(bus_write(gb -> bus, addr, data));
+    ck_assert_err_none(sprite_index_bus_listener(&(gb -> sprites), gb -> bus, addr));
+}
+
+static uint8_t pixel(gameboy_t* gb, size_t x, size_t y)
+{
+    uint8_t color = 0xFF;
+    ck_assert_err_none(image_get_pixel(&color, &(gb -> screen.display), x, y));
+    return color;
+}
+
+START_TEST(lcdc_err)
+{
+// ------------------------------------------------------------
+#ifdef WITH_PRINT
+    printf("=== %s:\n", __func__);
+#endif
+    INIT;
+    ck_assert_bad_param(lcdc_init(NULL));
+    ck_assert_bad_param(lcdc_plug(NULL, gb.bus));
+    ck_assert_bad_param(lcdc_plug(&(gb.screen), NULL));
+    ck_assert_bad_param(lcdc_cycle(NULL, 1));
+    ck_assert_bad_param(lcdc_bus_listener(NULL, REG_STAT));
+    lcdc_free(NULL);
+    END;
+
+#ifdef WITH_PRINT
+    printf("=== END of %s\n", __func__);
+#endif
+}
+END_TEST
+
+START_TEST(lcdc_timing_exec)
+{
+// ------------------------------------------------------------
+#ifdef WITH_PRINT
+    printf("=== %s:\n", __func__);
+#endif
+    INIT;
+    ck_assert_int_eq(reg(REG_LCDC), 0x91);
+
+    // modes of line 0
+    ck_assert_err_none(gameboy_run_until(&gb, LINE_START(0) + 1));
+    ck_assert_int_eq(gb.screen.on, 1);
+    ck_assert_int_eq(reg(REG_LY), 0);
+    ck_assert_int_eq(reg(REG_STAT) & STAT_REG_MODE_MASK, 2);
+    ck_assert_err_none(gameboy_run_until(&gb, LINE_START(0) + LINE_MODE_3_START_CYCLE + 1));
+    ck_assert_int_eq(reg(REG_STAT) & STAT_REG_MODE_MASK, 3);
+    ck_assert_err_none(gameboy_run_until(&gb, LINE_START(0) + LINE_MODE_0_START_CYCLE + 1));
+    ck_assert_int_eq(reg(REG_STAT) & STAT_REG_MODE_MASK, 0);
+
+    // LY = LYC
+    reg(REG_LYC) = 5;
+    ck_assert_err_none(gameboy_run_until(&gb, LINE_START(5)));
+    ck_assert_int_eq(reg(REG_LY), 4);
+    ck_assert_int_eq(bit_get(reg(REG_STAT), STAT_REG_LYC_EQ_LY_BIT), 0);
+    ck_assert_err_none(gameboy_run_until(&gb, LINE_START(5) + 1));
+    ck_assert_int_eq(reg(REG_LY), 5);
+    ck_assert_int_eq(bit_get(reg(REG_STAT), STAT_REG_LYC_EQ_LY_BIT), 1);
+
+    // VBLANK
+    ck_assert_err_none(gameboy_run_until(&gb, LINE_START(LCD_HEIGHT)));
+    ck_assert_int_eq(gb.cpu.IF & (1 << VBLANK), 0);
+    ck_assert_err_none(gameboy_run_until(&gb, LINE_START(LCD_HEIGHT) + 1));
+    ck_assert_int_eq(reg(REG_LY), LCD_HEIGHT);
+    ck_assert_int_eq(reg(REG_STAT) & STAT_REG_MODE_MASK, 1);
+    ck_assert_int_ne(gb.cpu.IF & (1 << VBLANK), 0);
+    ck_assert_err_none(gameboy_run_until(&gb, LINE_START(LCD_HEIGHT + VBLANK_LINES - 1) + 1));
+    ck_assert_int_eq(reg(REG_LY), LCD_HEIGHT + VBLANK_LINES - 1);
+
+    // next frame
+    ck_assert_err_none(gameboy_run_until(&gb, FRAME_START(1) + 1));
+    ck_assert_int_eq(reg(REG_LY), 0);
+    ck_assert_int_eq(reg(REG_STAT) & STAT_REG_MODE_MASK, 2);
+
+    // read-only bits of STAT and LY are kept
+    ck_assert_err_none(bus_write(gb.bus, REG_STAT, 0x40));
+    ck_assert_err_none(lcdc_bus_listener(&(gb.screen), REG_STAT));
+    ck_assert_int_eq(reg(REG_STAT), 0x42);
+    ck_assert_err_none(bus_write(gb.bus, REG_LY, 0x33));
+    ck_assert_err_none(lcdc_bus_listener(&(gb.screen), REG_LY));
+    ck_assert_int_eq(reg(REG_LY), 0);
+
+    // switched off: LY is 0 and nothing happens any more
+    reg(REG_LCDC) = 0x11;
+    ck_assert_err_none(gameboy_run_until(&gb, FRAME_START(1) + 2 * LINE_TOTAL_CYCLES));
+    ck_assert_int_eq(gb.screen.on, 0);
+    ck_assert_int_eq(reg(REG_LY), 0);
+    ck_assert_int_eq(reg(REG_STAT) & STAT_REG_MODE_MASK, 0);
+    END;
+
+#ifdef WITH_PRINT
+    printf("=== END of %s\n", __func__);
+#endif
+}
+END_TEST
+
+START_TEST(lcdc_draw_exec)
+{
+// ------------------------------------------------------------
+#ifdef WITH_PRINT
+    printf("=== %s:\n", __func__);
+#endif
+    INIT;
+    // background of tile 0, in color 1
+    fill_tile(&gb, 0, 1);
+    fill_tile(&gb, 1, 3);
+    fill_tile(&gb, 2, 2);
+    reg(REG_BGP) = DEFAULT_PALETTE;
+    ck_assert_err_none(gameboy_run_until(&gb, FRAME_START(1)));
+    for (size_t y = 0; y < LCD_HEIGHT; y += 13) {
+        for (size_t x = 0; x < LCD_WIDTH; x += 7) {
+            ck_assert_int_eq(pixel(&gb, x, y), 1);
+        }
+    }
+
+    // a sprite of tile 1 at (16, 8)
+    reg(OAM_START) = OAM_Y_OFFSET + 8;
+    reg(OAM_START + 1) = OAM_X_OFFSET + 16;
+    reg(OAM_START + 2) = 1;
+    reg(OAM_START + 3) = 0;
+    reg(REG_OBP0) = DEFAULT_PALETTE;
+    reg(REG_LCDC) |= LCDC_REG_OBJ_MASK;
+    ck_assert_err_none(sprite_index_rebuild(&(gb.sprites), gb.bus));
+    ck_assert_err_none(gameboy_run_until(&gb, FRAME_START(2)));
+    ck_assert_int_eq(pixel(&gb, 16, 8), 3);
+    ck_assert_int_eq(pixel(&gb, 23, 15), 3);
+    ck_assert_int_eq(pixel(&gb, 15, 8), 1);
+    ck_assert_int_eq(pixel(&gb, 24, 8), 1);
+    ck_assert_int_eq(pixel(&gb, 16, 16), 1);
+
+    // window of tile 2 from (80, 72), over the background
+    for (addr_t addr = TILE_ADDR_BASE_HIGH; addr < TILE_ADDR_BASE_HIGH + 0x400; ++addr) {
+        reg(addr) = 2;
+    }
+    reg(REG_WY) = 72;
+    reg(REG_WX) = WINDOW_OFFSET_X + 80;
+    reg(REG_LCDC) |= LCDC_REG_WIN_MASK | LCDC_REG_WIN_AREA_MASK;
+    ck_assert_err_none(gameboy_run_until(&gb, FRAME_START(3)));
+    ck_assert_int_eq(pixel(&gb, 80, 72), 2);
+    ck_assert_int_eq(pixel(&gb, LCD_WIDTH - 1, LCD_HEIGHT - 1), 2);
+    ck_assert_int_eq(pixel(&gb, 79, 72), 1);
+    ck_assert_int_eq(pixel(&gb, 80, 71), 1);
+    ck_assert_int_eq(pixel(&gb, 16, 8), 3);
+
+    // switched off: blank
+    reg(REG_LCDC) = 0;
+    ck_assert_err_none(gameboy_run_until(&gb, FRAME_START(3) + 2));
+    ck_assert_int_eq(pixel(&gb, 16, 8), 0);
+    ck_assert_int_eq(pixel(&gb, 80, 72), 0);
+    END;
+
+#ifdef WITH_PRINT
+    printf("=== END of %s\n", __func__);
+#endif
+}
+END_TEST
+
+START_TEST(lcdc_sprites_exec)
+{
+// ------------------------------------------------------------
+#ifdef WITH_PRINT
+    printf("=== %s:\n", __func__);
+#endif
+    INIT;
+    fill_tile(&gb, 0, 1);
+    fill_tile(&gb, 1, 3);
+    reg(REG_BGP) = DEFAULT_PALETTE;
+    reg(REG_OBP0) = DEFAULT_PALETTE;
+    reg(REG_LCDC) |= LCDC_REG_OBJ_MASK;
+
+    // 12 sprites on lines 40 to 47: only the first 10 of the OAM are drawn
+    for (size_t i = 0; i < 12; ++i) {
+        const addr_t entry = (addr_t) (OAM_START + i * OAM_ENTRY_SIZE);
+        cpu_write(&gb, entry, OAM_Y_OFFSET + 40);
+        cpu_write(&gb, (addr_t) (entry + 1), (data_t) (OAM_X_OFFSET + 8 * i));
+        cpu_write(&gb, (addr_t) (entry + 2), 1);
+        cpu_write(&gb, (addr_t) (entry + 3), 0);
+    }
+    ck_assert_err_none(gameboy_run_until(&gb, FRAME_START(1)));
+    ck_assert_int_eq(pixel(&gb, 0, 40), 3);
+    ck_assert_int_eq(pixel(&gb, 79, 47), 3);
+    ck_assert_int_eq(pixel(&gb, 80, 40), 1);
+    ck_assert_int_eq(pixel(&gb, 0, 39), 1);
+    ck_assert_int_eq(pixel(&gb, 0, 48), 1);
+
+    // the first one moved out of the screen: the eleventh one shows
+    cpu_write(&gb, OAM_START, 0);
+    ck_assert_err_none(gameboy_run_until(&gb, FRAME_START(2)));
+    ck_assert_int_eq(pixel(&gb, 0, 40), 1);
+    ck_assert_int_eq(pixel(&gb, 80, 40), 3);
+    ck_assert_int_eq(pixel(&gb, 88, 40), 1);
+
+    // 8x16 objects: the sprites cover 16 lines
+    cpu_write(&gb, REG_LCDC, reg(REG_LCDC) | LCDC_REG_OBJ_SIZE_MASK);
+    ck_assert_err_none(gameboy_run_until(&gb, FRAME_START(3)));
+    ck_assert_int_eq(pixel(&gb, 8, 40), 1);
+    ck_assert_int_eq(pixel(&gb, 8, 48), 3);
+    ck_assert_int_eq(pixel(&gb, 8, 56), 1);
+    END;
+
+#ifdef WITH_PRINT
+    printf("=== END of %s\n", __func__);
+#endif
+}
+END_TEST
+
+START_TEST(lcdc_render_policy_exec)
+{
+// ------------------------------------------------------------
+#ifdef WITH_PRINT
+    printf("=== %s:\n", __func__);
+#endif
+    INIT;
+    fill_tile(&gb, 0, 1);
+    reg(REG_BGP) = DEFAULT_PALETTE;
+
+    // never rendered: blank display, but the same timing
+    ck_assert_err_none(gameboy_set_render_policy(&gb, RENDER_NEVER, 0));
+    ck_assert_err_none(gameboy_run_until(&gb, LINE_START(LCD_HEIGHT) + 1));
+    ck_assert_int_eq(reg(REG_LY), LCD_HEIGHT);
+    ck_assert_int_ne(gb.cpu.IF & (1 << VBLANK), 0);
+    ck_assert_int_eq(pixel(&gb, 0, 0), 0);
+    ck_assert_int_eq(pixel(&gb, LCD_WIDTH - 1, LCD_HEIGHT - 1), 0);
+    ck_assert_err_none(gameboy_run_until(&gb, FRAME_START(2)));
+    ck_assert_int_eq(gb.render.rendered, 0);
+    ck_assert_int_eq(pixel(&gb, 80, 72), 0);
+
+    // on request: the next whole frame is drawn
+    ck_assert_err_none(gameboy_set_render_policy(&gb, RENDER_ON_REQUEST, 0));
+    ck_assert_err_none(gameboy_request_frame(&gb));
+    ck_assert_err_none(gameboy_run_until(&gb, FRAME_START(4)));
+    ck_assert_int_eq(gb.render.rendered, 1);
+    for (size_t y = 0; y < LCD_HEIGHT; y += 13) {
+        for (size_t x = 0; x < LCD_WIDTH; x += 7) {
+            ck_assert_int_eq(pixel(&gb, x, y), 1);
+        }
+    }
+    END;
+
+    // the window line counter, LY, STAT and interrupts do not depend on the policy
+    gameboy_t drawn;
+    zero_init_var(drawn);
+    gameboy_t skipped;
+    zero_init_var(skipped);
+    gameboy_t* const gbs[] = { &drawn, &skipped };
+    for (size_t i = 0; i < 2; ++i) {
+        ck_assert_err_none(gameboy_create_with_boot(gbs[i], FIBONACCI_ROM, BOOT_FAST));
+        gbs[i] -> cpu.IE = 0;
+        gbs[i] -> cpu.IF = 0;
+        gbs[i] -> cpu.HALT = 1;
+        *(gbs[i] -> bus[REG_WY]) = 40;
+        *(gbs[i] -> bus[REG_WX]) = WINDOW_OFFSET_X;
+        *(gbs[i] -> bus[REG_LCDC]) |= LCDC_REG_WIN_MASK;
+    }
+    ck_assert_err_none(gameboy_set_render_policy(&skipped, RENDER_NEVER, 0));
+    const uint64_t stops[] = { LINE_START(100) + 70, FRAME_START(1) + 3, FRAME_START(2) - 1 };
+    for (size_t i = 0; i < sizeof(stops) / sizeof(stops[0]); ++i) {
+        ck_assert_err_none(gameboy_run_until(&drawn, stops[i]));
+        ck_assert_err_none(gameboy_run_until(&skipped, stops[i]));
+        ck_assert_int_eq(drawn.screen.window_y, skipped.screen.window_y);
+        ck_assert_int_eq(*(drawn.bus[REG_LY]), *(skipped.bus[REG_LY]));
+        ck_assert_int_eq(*(drawn.bus[REG_STAT]), *(skipped.bus[REG_STAT]));
+        ck_assert_int_eq(drawn.cpu.IF, skipped.cpu.IF);
+    }
+    ck_assert_int_gt(drawn.screen.window_y, 0);
+    gameboy_free(&drawn);
+    gameboy_free(&skipped);
+
+#ifdef WITH_PRINT
+    printf("=== END of %s\n", __func__);
+#endif
+}
+END_TEST
+
+START_TEST(lcdc_dirty_lines_exec)
+{
+// ------------------------------------------------------------
+#ifdef WITH_PRINT
+    printf("=== %s:\n", __func__);
+#endif
+    INIT;
+    fill_tile(&gb, 0, 1);
+    fill_tile(&gb, 1, 3);
+    reg(REG_BGP) = DEFAULT_PALETTE;
+    scanline_mask_t dirty;
+    ck_assert_err_none(gameboy_run_until(&gb, FRAME_START(1)));
+    ck_assert_err_none(scanline_tracker_take_dirty(&(gb.lines), dirty));
+    for (size_t y = 0; y < LCD_HEIGHT; ++y) {
+        ck_assert_int_eq(scanline_mask_get(dirty, y), 1);
+    }
+
+    // nothing changed: no line is drawn again, the pixels are kept
+    ck_assert_err_none(gameboy_run_until(&gb, FRAME_START(2)));
+    ck_assert_err_none(scanline_tracker_take_dirty(&(gb.lines), dirty));
+    for (size_t y = 0; y < LCD_HEIGHT; ++y) {
+        ck_assert_int_eq(scanline_mask_get(dirty, y), 0);
+    }
+    ck_assert_int_eq(pixel(&gb, 40, 20), 1);
+
+    // the third row of tiles: only its lines are drawn again
+    reg(TILE_ADDR_BASE_LOW + 2 * TILE_LINE_SIZE + 5) = 1;
+    ck_assert_err_none(gameboy_run_until(&gb, FRAME_START(3)));
+    ck_assert_err_none(scanline_tracker_take_dirty(&(gb.lines), dirty));
+    for (size_t y = 0; y < LCD_HEIGHT; ++y) {
+        ck_assert_int_eq(scanline_mask_get(dirty, y), y >= 16 && y < 24);
+    }
+    ck_assert_int_eq(pixel(&gb, 40, 16), 3);
+    ck_assert_int_eq(pixel(&gb, 47, 23), 3);
+    ck_assert_int_eq(pixel(&gb, 40, 24), 1);
+    ck_assert_int_eq(pixel(&gb, 48, 20), 1);
+    END;
+
+#ifdef WITH_PRINT
+    printf("=== END of %s\n", __func__);
+#endif
+}
+END_TEST
+
+START_TEST(lcdc_capture_exec)
+{
+// ------------------------------------------------------------
+#ifdef WITH_PRINT
+    printf("=== %s:\n", __func__);
+#endif
+    INIT;
+    fill_tile(&gb, 0, 1);
+    fill_tile(&gb, 1, 3);
+    reg(REG_BGP) = DEFAULT_PALETTE;
+    reg(TILE_ADDR_BASE_LOW) = 1;
+
+    // frames dumped as the test program does: one per completed frame
+    const frame_dump_format_t formats[] = { FRAME_DUMP_PPM, FRAME_DUMP_Y4M };
+    const char* const names[] = { "unit-test-lcdc.ppm", "unit-test-lcdc.y4m" };
+    for (size_t f = 0; f < 2; ++f) {
+        frame_dump_t dump;
+        ck_assert_err_none(frame_dump_open(&dump, names[f], formats[f], NB_CAPTURED));
+        for (size_t i = 1; i <= NB_CAPTURED; ++i) {
+            ck_assert_err_none(gameboy_run_until(&gb, (gb.cycles / FRAME_TOTAL_CYCLES + 1) * FRAME_TOTAL_CYCLES));
+            ck_assert_err_none(frame_dump_push_image(&dump, &(gb.screen.display)));
+        }
+        ck_assert_err_none(frame_dump_close(&dump));
+        ck_assert_uint_eq(dump.written, NB_CAPTURED);
+
+        FILE* file = fopen(names[f], "rb");
+        ck_assert_ptr_nonnull(file);
+        uint8_t* buffer = malloc(NB_CAPTURED * PPM_SIZE + 1);
+        ck_assert_ptr_nonnull(buffer);
+        const size_t size = fread(buffer, 1, NB_CAPTURED * PPM_SIZE + 1, file);
+        fclose(file);
+        remove(names[f]);
+
+        if (formats[f] == FRAME_DUMP_PPM) {
+            ck_assert_uint_eq(size, NB_CAPTURED * PPM_SIZE);
+            // tile 1 at the top left corner, tile 0 anywhere else
+            const uint8_t* const last = buffer + (NB_CAPTURED - 1) * PPM_SIZE + PPM_HEADER_SIZE;
+            ck_assert_int_eq(last[0], 0);
+            ck_assert_int_eq(last[3 * 7], 0);
+            ck_assert_int_eq(last[3 * 8], 170);
+            ck_assert_int_eq(last[3 * (8 * LCD_WIDTH)], 170);
+        } else {
+            const uint8_t* const frames = memchr(buffer, '\n', size);
+            ck_assert_ptr_nonnull(frames);
+            ck_assert_uint_eq(size - (size_t) (frames + 1 - buffer), NB_CAPTURED * Y4M_SIZE);
+        }
+        free(buffer);
+    }
+    END;
+
+#ifdef WITH_PRINT
+    printf("=== END of %s\n", __func__);
+#endif
+}
+END_TEST
+
+START_TEST(lcdc_dma_exec)
+{
+// ------------------------------------------------------------
+#ifdef WITH_PRINT
+    printf("=== %s:\n", __func__);
+#endif
+    INIT;
+    for (addr_t i = 0; i < MEM_SIZE(GRAPH_RAM); ++i) {
+        ck_assert_err_none(bus_write(gb.bus, (addr_t) (WORK_RAM_START + 0x100 + i), (data_t) (i ^ 0x5A)));
+    }
+    ck_assert_err_none(bus_write(gb.bus, REG_DMA, (WORK_RAM_START + 0x100) >> 8));
+    ck_assert_err_none(lcdc_bus_listener(&(gb.screen), REG_DMA));
+    for (addr_t i = 0; i < MEM_SIZE(GRAPH_RAM); ++i) {
+        ck_assert_int_eq(reg(GRAPH_RAM_START + i), (data_t) (i ^ 0x5A));
+    }
+    END;
+
+#ifdef WITH_PRINT
+    printf("=== END of %s\n", __func__);
+#endif
+}
+END_TEST
+
+Suite* lcdc_test_suite()
+{
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wsign-conversion"
+#pragma GCC diagnostic ignored "-Wconversion"
+    srand(time(NULL) ^ getpid() ^ pthread_self());
+#pragma GCC diagnostic pop
+
+    Suite* s = suite_create("lcdc.c Tests");
+
+    Add_Case(s, tc1, "LCD controller Tests");
+    tcase_add_test(tc1, lcdc_err);
+    tcase_add_test(tc1, lcdc_timing_exec);
+    tcase_add_test(tc1, lcdc_draw_exec);
+    tcase_add_test(tc1, lcdc_sprites_exec);
+    tcase_add_test(tc1, lcdc_render_policy_exec);
+    tcase_add_test(tc1, lcdc_dirty_lines_exec);
+    tcase_add_test(tc1, lcdc_capture_exec);
+    tcase_add_test(tc1, lcdc_dma_exec);
+
+    return s;
+}
+
+TEST_SUITE(lcdc_test_suite)
@@ -0,0 +1,312 @@
+/**
+ * @file unit-test-movie.c
+ * @brief Unit test code for movie recording and replay
+ *
+ * @date 2020
+ */
+
+// for thread-safe randomization
+#include <time.h>
+#include <stdlib.h>
+#include <sys/types.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include <check.h>
+#include <inttypes.h>
+#include <string.h>
+
+#include "util.h"
+#include "tests.h"
+#include "movie.h"
+#include "savestate.h"
+#include "gameboy.h"
+#include "error.h"
+
+#define FIBONACCI_ROM "tests/data/fibonacci.gb"
+
+#define NB_CHUNKS 200
+#define MAX_CHUNK_CYCLES 3000
+#define KEYFRAME_CYCLES 20000
+#define NB_TARGETS 12
+
+#define INIT \
+    gameboy_t gb; \
+    zero_init_var(gb); \
+    ck_assert_err_none(gameboy_create(&gb, FIBONACCI_ROM)); \
+    movie_t movie; \
+    zero_init_var(movie); \
+    char filename[] = "/tmp/unit-test-movie-XXXXXX"; \
+    const int fd = mkstemp(filename); \
+    ck_assert_int_ge(fd, 0); \
+    close(fd)
+
+#define END \
+    remove(filename); \
+    gameboy_free(&gb)
+
+/**
+ * @brief records a run of random key changes at random cycles; returns its end state
+ */
+static uint8_t* record(gameboy_t* gb, movie_t* movie, const char* filename, uint64_t keyframe_every,
+                       size_t* changes)
+{
+    ck_assert_err_none(movie_record_open(movie, filename, gb, keyframe_every));
+    *changes = 0;
+    for (size_t i = 0; i < NB_CHUNKS; ++i) {
+        ck_assert_err_none(movie_record_run_until(movie, gb, gb -> cycles + 1 + (uint64_t) rand() % MAX_CHUNK_CYCLES));
+        // sometimes several changes at the same cycle
+        for (int n = rand() % 3; n > 0; --n, ++(*changes)) {
+            ck_assert_err_none(movie_record_key(movie, gb, (gb_key_t) (rand() % NB_GB_KEYS), rand() & 1));
+        }
+    }
+    ck_assert_err_none(movie_record_run_until(movie, gb, gb -> cycles + 100));
+    ck_assert_err_none(movie_close(movie, gb));
+    ck_assert_uint_eq(movie -> events, *changes);
+
+    const size_t size = gameboy_state_size(gb);
+    uint8_t* const state = malloc(size);
+    ck_assert_ptr_nonnull(state);
+    ck_assert_err_none(gameboy_save_state(gb, state, size, NULL));
+    return state;
+}
+
+START_TEST(movie_err)
+{
+// ------------------------------------------------------------
+#ifdef WITH_PRINT
+    printf("=== %s:\n", __func__);
+#endif
+    INIT;
+    ck_assert_bad_param(movie_record_open(NULL, filename, &gb, 0));
+    ck_assert_bad_param(movie_record_open(&movie, NULL, &gb, 0));
+    ck_assert_bad_param(movie_record_open(&movie, filename, NULL, 0));
+    ck_assert_bad_param(movie_replay_open(NULL, filename, &gb));
+    ck_assert_bad_param(movie_replay_open(&movie, NULL, &gb));
+    ck_assert_bad_param(movie_replay_open(&movie, filename, NULL));
+    ck_assert_int_eq(movie_replay_open(&movie, "./file_that_doesnt_exist", &gb), ERR_IO);
+    ck_assert_bad_param(movie_run_until(NULL, &gb, 10));
+    ck_assert_bad_param(movie_run_to_end(NULL, &gb));
+    ck_assert_bad_param(movie_seek(NULL, &gb, 10));
+    ck_assert_bad_param(movie_record_run_until(NULL, &gb, 10));
+    ck_assert_bad_param(movie_close(NULL, &gb));
+
+    // empty file
+    ck_assert_bad_param(movie_replay_open(&movie, filename, &gb));
+
+    ck_assert_err_none(movie_record_open(&movie, filename, &gb, 0));
+    ck_assert_bad_param(movie_record_key(&movie, &gb, NB_GB_KEYS, 1));
+    ck_assert_bad_param(movie_run_until(&movie, &gb, gb.cycles + 10));
+    ck_assert_err_none(movie_record_key(&movie, &gb, A_KEY, 1));
+    ck_assert_err_none(gameboy_run_until(&gb, gb.cycles + 1000));
+    ck_assert_err_none(movie_close(&movie, &gb));
+
+    // not at the start cycle
+    ck_assert_bad_param(movie_replay_open(&movie, filename, &gb));
+
+    // truncated: the end event is lost
+    FILE* file = fopen(filename, "rb");
+    ck_assert_ptr_nonnull(file);
+    uint8_t bytes[64];
+    const size_t length = fread(bytes, 1, sizeof(bytes), file);
+    fclose(file);
+    file = fopen(filename, "wb");
+    ck_assert_ptr_nonnull(file);
+    ck_assert_uint_eq(fwrite(bytes, 1, length - 2, file), length - 2);
+    fclose(file);
+
+    gameboy_free(&gb);
+    ck_assert_err_none(gameboy_create(&gb, FIBONACCI_ROM));
+    ck_assert_err_none(movie_replay_open(&movie, filename, &gb));
+    ck_assert_bad_param(movie_record_key(&movie, &gb, A_KEY, 1));
+    ck_assert_bad_param(movie_record_run_until(&movie, &gb, gb.cycles + 10));
+    ck_assert_bad_param(movie_run_to_end(&movie, &gb));
+    ck_assert_err_none(movie_close(&movie, &gb));
+
+    // not a movie
+    bytes[0] ^= 0xFF;
+    file = fopen(filename, "wb");
+    ck_assert_ptr_nonnull(file);
+    ck_assert_uint_eq(fwrite(bytes, 1, length, file), length);
+    fclose(file);
+    ck_assert_bad_param(movie_replay_open(&movie, filename, &gb));
+
+    END;
+
+#ifdef WITH_PRINT
+    printf("=== END of %s\n", __func__);
+#endif
+}
+END_TEST
+
+START_TEST(movie_replay_exec)
+{
+// ------------------------------------------------------------
+#ifdef WITH_PRINT
+    printf("=== %s:\n", __func__);
+#endif
+    INIT;
+    const uint64_t start_cycle = gb.cycles;
+    size_t changes = 0;
+    uint8_t* const recorded = record(&gb, &movie, filename, 0, &changes);
+    const uint64_t end_cycle = gb.cycles;
+    const size_t size = gameboy_state_size(&gb);
+    uint8_t* const replayed = malloc(size);
+    ck_assert_ptr_nonnull(replayed);
+
+    // compact: 20 bytes of header, at most 3 bytes per change of the run
+    FILE* const file = fopen(filename, "rb");
+    ck_assert_ptr_nonnull(file);
+    fseek(file, 0, SEEK_END);
+    ck_assert_int_le(ftell(file), (long) (20 + 3 * (changes + 1)));
+    fclose(file);
+
+    // the same run, at once
+    gameboy_free(&gb);
+    ck_assert_err_none(gameboy_create(&gb, FIBONACCI_ROM));
+    ck_assert_err_none(movie_replay_open(&movie, filename, &gb));
+    ck_assert_err_none(movie_run_to_end(&movie, &gb));
+    ck_assert_uint_eq(movie.events, changes);
+    ck_assert_uint_eq(gb.cycles, end_cycle);
+    ck_assert_err_none(gameboy_save_state(&gb, replayed, size, NULL));
+    ck_assert_int_eq(memcmp(recorded, replayed, size), 0);
+    // no keyframe to go back to
+    ck_assert_bad_param(movie_seek(&movie, &gb, start_cycle));
+    ck_assert_err_none(movie_close(&movie, NULL));
+
+    // the same run, in other steps
+    gameboy_free(&gb);
+    ck_assert_err_none(gameboy_create(&gb, FIBONACCI_ROM));
+    ck_assert_err_none(movie_replay_open(&movie, filename, &gb));
+    while (gb.cycles < end_cycle) {
+        const uint64_t step = 1 + (uint64_t) rand() % (2 * MAX_CHUNK_CYCLES);
+        ck_assert_err_none(movie_run_until(&movie, &gb, gb.cycles + step < end_cycle ? gb.cycles + step : end_cycle));
+    }
+    ck_assert_err_none(gameboy_save_state(&gb, replayed, size, NULL));
+    ck_assert_int_eq(memcmp(recorded, replayed, size), 0);
+    ck_assert_err_none(movie_close(&movie, NULL));
+
+    // without the input, the run differs
+    gameboy_free(&gb);
+    ck_assert_err_none(gameboy_create(&gb, FIBONACCI_ROM));
+    ck_assert_err_none(gameboy_run_until(&gb, end_cycle));
+    ck_assert_err_none(gameboy_save_state(&gb, replayed, size, NULL));
+    ck_assert_int_ne(memcmp(recorded, replayed, size), 0);
+
+    free(recorded);
+    free(replayed);
+    END;
+
+#ifdef WITH_PRINT
+    printf("=== END of %s\n", __func__);
+#endif
+}
+END_TEST
+
+START_TEST(movie_seek_exec)
+{
+// ------------------------------------------------------------
+#ifdef WITH_PRINT
+    printf("=== %s:\n", __func__);
+#endif
+    INIT;
+    const uint64_t start_cycle = gb.cycles;
+    size_t changes = 0;
+    uint8_t* const recorded = record(&gb, &movie, filename, KEYFRAME_CYCLES, &changes);
+    const uint64_t end_cycle = gb.cycles;
+    const size_t size = gameboy_state_size(&gb);
+    uint8_t* const states = malloc(NB_TARGETS * size);
+    uint8_t* const replayed = malloc(size);
+    ck_assert_ptr_nonnull(states);
+    ck_assert_ptr_nonnull(replayed);
+
+    // states of the run at some cycles, replayed from the start
+    uint64_t targets[NB_TARGETS];
+    for (size_t i = 0; i < NB_TARGETS; ++i) {
+        targets[i] = start_cycle + 1 + (uint64_t) rand() % (end_cycle - start_cycle);
+        for (size_t j = i; j > 0 && targets[j - 1] > targets[j]; --j) {
+            const uint64_t t = targets[j];
+            targets[j] = targets[j - 1];
+            targets[j - 1] = t;
+        }
+    }
+    gameboy_free(&gb);
+    ck_assert_err_none(gameboy_create(&gb, FIBONACCI_ROM));
+    ck_assert_err_none(movie_replay_open(&movie, filename, &gb));
+    for (size_t i = 0; i < NB_TARGETS; ++i) {
+        if (targets[i] > gb.cycles) {
+            ck_assert_err_none(movie_run_until(&movie, &gb, targets[i]));
+        }
+        ck_assert_err_none(gameboy_save_state(&gb, states + i * size, size, NULL));
+    }
+    ck_assert_err_none(movie_close(&movie, NULL));
+
+    // same states, seeking back and forth
+    gameboy_free(&gb);
+    ck_assert_err_none(gameboy_create(&gb, FIBONACCI_ROM));
+    ck_assert_err_none(movie_replay_open(&movie, filename, &gb));
+    ck_assert_uint_eq(movie.nb_keyframes, 1 + (end_cycle - start_cycle) / KEYFRAME_CYCLES);
+    for (size_t k = 1; k < movie.nb_keyframes; ++k) {
+        ck_assert_uint_eq(movie.keyframes[k].cycle - movie.keyframes[k - 1].cycle, KEYFRAME_CYCLES);
+    }
+    for (size_t n = 0; n < 3 * NB_TARGETS; ++n) {
+        const size_t i = (size_t) rand() % NB_TARGETS;
+        ck_assert_err_none(movie_seek(&movie, &gb, targets[i]));
+        ck_assert_uint_eq(gb.cycles, targets[i]);
+        ck_assert_err_none(gameboy_save_state(&gb, replayed, size, NULL));
+        ck_assert_int_eq(memcmp(states + i * size, replayed, size), 0);
+    }
+    ck_assert_err_none(movie_seek(&movie, &gb, end_cycle));
+    ck_assert_err_none(gameboy_save_state(&gb, replayed, size, NULL));
+    ck_assert_int_eq(memcmp(recorded, replayed, size), 0);
+    ck_assert_err_none(movie_seek(&movie, &gb, start_cycle));
+    ck_assert_uint_eq(gb.cycles, start_cycle);
+    ck_assert_err_none(movie_close(&movie, NULL));
+
+    // without its index, a movie still replays
+    FILE* const file = fopen(filename, "rb");
+    ck_assert_ptr_nonnull(file);
+    fseek(file, 0, SEEK_END);
+    const long length = ftell(file);
+    fclose(file);
+    ck_assert_int_eq(truncate(filename, length - 4), 0);
+    gameboy_free(&gb);
+    ck_assert_err_none(gameboy_create(&gb, FIBONACCI_ROM));
+    ck_assert_err_none(movie_replay_open(&movie, filename, &gb));
+    ck_assert_uint_eq(movie.nb_keyframes, 0);
+    ck_assert_err_none(movie_run_to_end(&movie, &gb));
+    ck_assert_err_none(gameboy_save_state(&gb, replayed, size, NULL));
+    ck_assert_int_eq(memcmp(recorded, replayed, size), 0);
+    ck_assert_err_none(movie_close(&movie, NULL));
+
+    free(recorded);
+    free(states);
+    free(replayed);
+    END;
+
+#ifdef WITH_PRINT
+    printf("=== END of %s\n", __func__);
+#endif
+}
+END_TEST
+
+Suite* movie_test_suite()
+{
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wsign-conversion"
+#pragma GCC diagnostic ignored "-Wconversion"
+    srand(time(NULL) ^ getpid() ^ pthread_self());
+#pragma GCC diagnostic pop
+
+    Suite* s = suite_create("movie.c Tests");
+
+    Add_Case(s, tc1, "Movie Tests");
+    tcase_add_test(tc1, movie_err);
+    tcase_add_test(tc1, movie_replay_exec);
+    tcase_add_test(tc1, movie_seek_exec);
+
+    return s;
+}
+
+TEST_SUITE(movie_test_suite)
@@ -0,0 +1,145 @@
+/**
+ * @file unit-test-render-policy.c
+ * @brief Unit test code for the frame rendering policy
+ *
+ * @date 2020
+ */
+
+// for thread-safe randomization
+#include <time.h>
+#include <stdlib.h>
+#include <sys/types.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include <check.h>
+#include <inttypes.h>
+
+#include "tests.h"
+#include "render_policy.h"
+#include "error.h"
+
+#define NB_FRAMES 12
+
+START_TEST(render_policy_init_err)
+{
+// ------------------------------------------------------------
+#ifdef WITH_PRINT
+    printf("=== %s:\n", __func__);
+#endif
+    render_policy_t policy;
+
+    ck_assert_bad_param(render_policy_init(NULL, RENDER_ALWAYS, 1));
+    ck_assert_bad_param(render_policy_init(&policy, NB_RENDER_MODES, 1));
+    ck_assert_bad_param(render_policy_init(&policy, RENDER_EVERY_NTH, 0));
+    ck_assert_bad_param(render_policy_request(NULL));
+    ck_assert_err_none(render_policy_init(&policy, RENDER_NEVER, 0));
+    ck_assert_int_eq(render_policy_is_rendering(NULL), 1);
+
+#ifdef WITH_PRINT
+    printf("=== END of %s\n", __func__);
+#endif
+}
+END_TEST
+
+START_TEST(render_policy_always_never_exec)
+{
+// ------------------------------------------------------------
+#ifdef WITH_PRINT
+    printf("=== %s:\n", __func__);
+#endif
+    render_policy_t policy;
+
+    ck_assert_err_none(render_policy_init(&policy, RENDER_ALWAYS, 0));
+    ck_assert_int_eq(render_policy_is_rendering(&policy), 1);
+    for (int i = 0; i < NB_FRAMES; ++i) {
+        ck_assert_int_eq(render_policy_frame_start(&policy), 1);
+    }
+    ck_assert_int_eq(policy.rendered, NB_FRAMES);
+
+    ck_assert_err_none(render_policy_init(&policy, RENDER_NEVER, 0));
+    ck_assert_int_eq(render_policy_is_rendering(&policy), 0);
+    ck_assert_err_none(render_policy_request(&policy));
+    for (int i = 0; i < NB_FRAMES; ++i) {
+        ck_assert_int_eq(render_policy_frame_start(&policy), 0);
+        ck_assert_int_eq(render_policy_is_rendering(&policy), 0);
+    }
+    ck_assert_int_eq(policy.frames, NB_FRAMES);
+    ck_assert_int_eq(policy.rendered, 0);
+
+#ifdef WITH_PRINT
+    printf("=== END of %s\n", __func__);
+#endif
+}
+END_TEST
+
+START_TEST(render_policy_every_nth_exec)
+{
+// ------------------------------------------------------------
+#ifdef WITH_PRINT
+    printf("=== %s:\n", __func__);
+#endif
+    render_policy_t policy;
+
+    ck_assert_err_none(render_policy_init(&policy, RENDER_EVERY_NTH, 3));
+    for (int i = 0; i < NB_FRAMES; ++i) {
+        ck_assert_int_eq(render_policy_frame_start(&policy), i % 3 == 0);
+    }
+    ck_assert_int_eq(policy.rendered, NB_FRAMES / 3);
+
+    // a request forces the next frame only
+    ck_assert_err_none(render_policy_request(&policy));
+    ck_assert_int_eq(render_policy_frame_start(&policy), 1);
+    ck_assert_int_eq(render_policy_frame_start(&policy), 0);
+
+#ifdef WITH_PRINT
+    printf("=== END of %s\n", __func__);
+#endif
+}
+END_TEST
+
+START_TEST(render_policy_on_request_exec)
+{
+// ------------------------------------------------------------
+#ifdef WITH_PRINT
+    printf("=== %s:\n", __func__);
+#endif
+    render_policy_t policy;
+
+    ck_assert_err_none(render_policy_init(&policy, RENDER_ON_REQUEST, 0));
+    ck_assert_int_eq(render_policy_frame_start(&policy), 0);
+    ck_assert_err_none(render_policy_request(&policy));
+    ck_assert_int_eq(render_policy_is_rendering(&policy), 0);
+    ck_assert_int_eq(render_policy_frame_start(&policy), 1);
+    ck_assert_int_eq(render_policy_is_rendering(&policy), 1);
+    ck_assert_int_eq(render_policy_frame_start(&policy), 0);
+    ck_assert_int_eq(policy.frames, 3);
+    ck_assert_int_eq(policy.rendered, 1);
+
+#ifdef WITH_PRINT
+    printf("=== END of %s\n", __func__);
+#endif
+}
+END_TEST
+
+Suite* render_policy_test_suite()
+{
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wsign-conversion"
+#pragma GCC diagnostic ignored "-Wconversion"
+    srand(time(NULL) ^ getpid() ^ pthread_self());
+#pragma GCC diagnostic pop
+
+    Suite* s = suite_create("render_policy.c Tests");
+
+    Add_Case(s, tc1, "Render policy Tests");
+    tcase_add_test(tc1, render_policy_init_err);
+    tcase_add_test(tc1, render_policy_always_never_exec);
+    tcase_add_test(tc1, render_policy_every_nth_exec);
+    tcase_add_test(tc1, render_policy_on_request_exec);
+
+    return s;
+}
+
+TEST_SUITE(render_policy_test_suite)
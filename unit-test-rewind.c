@@ -0,0 +1,245 @@
+/**
+ * @file unit-test-rewind.c
+ * @brief Unit test code for the rewind history
+ *
+ * @date 2020
+ */
+
+// for thread-safe randomization
+#include <time.h>
+#include <stdlib.h>
+#include <sys/types.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include <check.h>
+#include <inttypes.h>
+#include <string.h>
+
+#include "util.h"
+#include "tests.h"
+#include "tests-snapshot.h"
+#include "rewind.h"
+#include "savestate.h"
+#include "gameboy.h"
+#include "error.h"
+
+#define FIBONACCI_ROM "tests/data/fibonacci.gb"
+
+#define FRAME_CYCLES 1000
+#define NB_FRAMES 150
+#define KEYFRAME_EVERY 16
+
+#define INIT \
+    gameboy_t gb; \
+    zero_init_var(gb); \
+    ck_assert_err_none(gameboy_create(&gb, FIBONACCI_ROM)); \
+    rewind_t rw; \
+    zero_init_var(rw)
+
+#define END \
+    rewind_free(&rw); \
+    gameboy_free(&gb)
+
+/**
+ * @brief runs a frame, with some work RAM and video RAM activity of a game
+ */
+static void run_frame(gameboy_t* gb)
+{
+    for (int i = 0; i < 24; ++i) {
+        const addr_t addr = (addr_t) ((rand() & 1 ? WORK_RAM_START : VIDEO_RAM_START) + rand() % 0x2000);
+        ck_assert_err_none(bus_write(gb -> bus, addr, (data_t) rand()));
+    }
+    ck_assert_err_none(gameboy_run_until(gb, gb -> cycles + FRAME_CYCLES));
+}
+
+START_TEST(rewind_err)
+{
+// ------------------------------------------------------------
+#ifdef WITH_PRINT
+    printf("=== %s:\n", __func__);
+#endif
+    INIT;
+    ck_assert_bad_param(rewind_init(NULL, &gb, 1024, 8, 4));
+    ck_assert_bad_param(rewind_init(&rw, NULL, 1024, 8, 4));
+    ck_assert_bad_param(rewind_init(&rw, &gb, 0, 8, 4));
+    ck_assert_bad_param(rewind_init(&rw, &gb, 1024, 0, 4));
+    ck_assert_bad_param(rewind_init(&rw, &gb, 1024, 8, 0));
+
+    ck_assert_err_none(rewind_init(&rw, &gb, 16, 8, 4));
+    ck_assert_bad_param(rewind_push(&rw, NULL));
+    ck_assert_bad_param(rewind_push(NULL, &gb));
+    ck_assert_bad_param(rewind_step_back(&rw, &gb)); // empty
+    // a keyframe cannot fit in 16 bytes
+    ck_assert_int_eq(rewind_push(&rw, &gb), ERR_MEM);
+    ck_assert_uint_eq(rewind_count(&rw), 0);
+    ck_assert_uint_eq(rewind_count(NULL), 0);
+
+    END;
+
+#ifdef WITH_PRINT
+    printf("=== END of %s\n", __func__);
+#endif
+}
+END_TEST
+
+START_TEST(rewind_exec)
+{
+// ------------------------------------------------------------
+#ifdef WITH_PRINT
+    printf("=== %s:\n", __func__);
+#endif
+    INIT;
+    const size_t size = gameboy_state_size(&gb);
+    uint8_t* const states = malloc(NB_FRAMES * size);
+    uint8_t* const restored = malloc(size);
+    ck_assert_ptr_nonnull(states);
+    ck_assert_ptr_nonnull(restored);
+
+    // room for everything
+    ck_assert_err_none(rewind_init(&rw, &gb, 16 * size, NB_FRAMES, KEYFRAME_EVERY));
+    for (size_t f = 0; f < NB_FRAMES; ++f) {
+        run_frame(&gb);
+        ck_assert_err_none(gameboy_save_state(&gb, states + f * size, size, NULL));
+        ck_assert_err_none(rewind_push(&rw, &gb));
+    }
+    ck_assert_uint_eq(rewind_count(&rw), NB_FRAMES);
+    // deltas are much smaller than the states
+    ck_assert_uint_lt(rw.used, NB_FRAMES * size / 8);
+
+    // back to the first frame, one frame at a time, across keyframes
+    for (size_t f = NB_FRAMES; f-- > 0; ) {
+        ck_assert_err_none(rewind_step_back(&rw, &gb));
+        ck_assert_err_none(gameboy_save_state(&gb, restored, size, NULL));
+        ck_assert_int_eq(memcmp(restored, states + f * size, size), 0);
+    }
+    ck_assert_uint_eq(rewind_count(&rw), 0);
+    ck_assert_uint_eq(rw.used, 0);
+
+    // going on after a partial rewind
+    for (size_t f = 0; f < 40; ++f) {
+        run_frame(&gb);
+        ck_assert_err_none(rewind_push(&rw, &gb));
+    }
+    for (size_t f = 0; f < 20; ++f) {
+        ck_assert_err_none(rewind_step_back(&rw, &gb));
+    }
+    ck_assert_err_none(gameboy_save_state(&gb, states, size, NULL));
+    ck_assert_err_none(rewind_push(&rw, &gb));
+    run_frame(&gb);
+    ck_assert_err_none(rewind_push(&rw, &gb));
+    ck_assert_err_none(rewind_step_back(&rw, &gb));
+    ck_assert_err_none(rewind_step_back(&rw, &gb));
+    ck_assert_err_none(gameboy_save_state(&gb, restored, size, NULL));
+    ck_assert_int_eq(memcmp(restored, states, size), 0);
+
+    free(states);
+    free(restored);
+    END;
+
+#ifdef WITH_PRINT
+    printf("=== END of %s\n", __func__);
+#endif
+}
+END_TEST
+
+START_TEST(rewind_bounded_exec)
+{
+// ------------------------------------------------------------
+#ifdef WITH_PRINT
+    printf("=== %s:\n", __func__);
+#endif
+    INIT;
+    const size_t size = gameboy_state_size(&gb);
+    const size_t capacity = 3 * size;
+    uint8_t* const states = malloc(NB_FRAMES * size);
+    uint8_t* const restored = malloc(size);
+    ck_assert_ptr_nonnull(states);
+    ck_assert_ptr_nonnull(restored);
+
+    // older snapshots are dropped by whole keyframe groups
+    ck_assert_err_none(rewind_init(&rw, &gb, capacity, NB_FRAMES / 2, KEYFRAME_EVERY));
+    for (size_t f = 0; f < NB_FRAMES; ++f) {
+        run_frame(&gb);
+        ck_assert_err_none(gameboy_save_state(&gb, states + f * size, size, NULL));
+        ck_assert_err_none(rewind_push(&rw, &gb));
+        ck_assert_uint_le(rw.used, capacity);
+        ck_assert_uint_le(rewind_count(&rw), NB_FRAMES / 2);
+        ck_assert_int_eq(rw.entries[rw.first].keyframe, 1);
+    }
+
+    // every snapshot kept is restored exactly
+    const size_t kept = rewind_count(&rw);
+    ck_assert_uint_gt(kept, KEYFRAME_EVERY);
+    for (size_t f = NB_FRAMES; f-- > NB_FRAMES - kept; ) {
+        ck_assert_err_none(rewind_step_back(&rw, &gb));
+        ck_assert_err_none(gameboy_save_state(&gb, restored, size, NULL));
+        ck_assert_int_eq(memcmp(restored, states + f * size, size), 0);
+    }
+    ck_assert_bad_param(rewind_step_back(&rw, &gb));
+
+    free(states);
+    free(restored);
+    END;
+
+#ifdef WITH_PRINT
+    printf("=== END of %s\n", __func__);
+#endif
+}
+END_TEST
+
+START_TEST(rewind_display_exec)
+{
+// ------------------------------------------------------------
+#ifdef WITH_PRINT
+    printf("=== %s:\n", __func__);
+#endif
+    INIT;
+    static snapshot_t pushed[4], restored;
+    const size_t size = gameboy_state_size(&gb);
+
+    // whole LCD frames, so that each one is drawn
+    ck_assert_err_none(rewind_init(&rw, &gb, 8 * size, 4, 2));
+    for (size_t f = 0; f < 4; ++f) {
+        for (size_t i = 0; i < FRAME_TOTAL_CYCLES / FRAME_CYCLES; ++i) run_frame(&gb);
+        take_snapshot(pushed + f, &gb);
+        ck_assert_err_none(rewind_push(&rw, &gb));
+    }
+    ck_assert_int_ne(memcmp(pushed[2].display, pushed[3].display, sizeof(pushed[3].display)), 0);
+
+    // the frame on display goes back with the state
+    for (size_t f = 4; f-- > 0; ) {
+        ck_assert_err_none(rewind_step_back(&rw, &gb));
+        take_snapshot(&restored, &gb);
+        ck_assert_int_eq(memcmp(pushed + f, &restored, sizeof(restored)), 0);
+    }
+
+    END;
+
+#ifdef WITH_PRINT
+    printf("=== END of %s\n", __func__);
+#endif
+}
+END_TEST
+
+Suite* rewind_test_suite()
+{
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wsign-conversion"
+#pragma GCC diagnostic ignored "-Wconversion"
+    srand(time(NULL) ^ getpid() ^ pthread_self());
+#pragma GCC diagnostic pop
+
+    Suite* s = suite_create("rewind.c Tests");
+
+    Add_Case(s, tc1, "Rewind Tests");
+    tcase_add_test(tc1, rewind_err);
+    tcase_add_test(tc1, rewind_exec);
+    tcase_add_test(tc1, rewind_bounded_exec);
+    tcase_add_test(tc1, rewind_display_exec);
+
+    return s;
+}
+
+TEST_SUITE(rewind_test_suite)
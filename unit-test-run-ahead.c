@@ -0,0 +1,216 @@
+/**
+ * @file unit-test-run-ahead.c
+ * @brief Unit test code for the run-ahead of a gameboy
+ *
+ * @date 2020
+ */
+
+// for thread-safe randomization
+#include <time.h>
+#include <stdlib.h>
+#include <sys/types.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include <check.h>
+#include <inttypes.h>
+#include <string.h>
+
+#include "util.h"
+#include "tests.h"
+#include "tests-snapshot.h"
+#include "run_ahead.h"
+#include "savestate.h"
+#include "gameboy.h"
+#include "lcdc.h"
+#include "error.h"
+
+#define FIBONACCI_ROM "tests/data/fibonacci.gb"
+
+#define AHEAD_FRAMES 3
+#define NB_FRAMES 40
+
+#define INIT \
+    gameboy_t gb; \
+    zero_init_var(gb); \
+    ck_assert_err_none(gameboy_create(&gb, FIBONACCI_ROM)); \
+    run_ahead_t ra; \
+    zero_init_var(ra)
+
+#define END \
+    run_ahead_free(&ra); \
+    gameboy_free(&gb)
+
+START_TEST(run_ahead_err)
+{
+// ------------------------------------------------------------
+#ifdef WITH_PRINT
+    printf("=== %s:\n", __func__);
+#endif
+    INIT;
+    ck_assert_bad_param(run_ahead_init(NULL, &gb, 1));
+    ck_assert_bad_param(run_ahead_init(&ra, NULL, 1));
+    ck_assert_bad_param(run_ahead_init(&ra, &gb, 0));
+    ck_assert_bad_param(run_ahead_init(&ra, &gb, RUN_AHEAD_MAX_FRAMES + 1));
+    ck_assert_bad_param(run_ahead_begin(&ra, &gb)); // not initialised
+
+    ck_assert_err_none(run_ahead_init(&ra, &gb, 1));
+    ck_assert_bad_param(run_ahead_begin(NULL, &gb));
+    ck_assert_bad_param(run_ahead_begin(&ra, NULL));
+    ck_assert_bad_param(run_ahead_end(&ra, &gb)); // not ahead
+    ck_assert_err_none(run_ahead_begin(&ra, &gb));
+    ck_assert_bad_param(run_ahead_begin(&ra, &gb)); // already ahead
+    ck_assert_bad_param(run_ahead_end(NULL, &gb));
+    ck_assert_err_none(run_ahead_end(&ra, &gb));
+    ck_assert_uint_eq(gb.cycles, 1);
+
+    END;
+    run_ahead_free(NULL);
+
+#ifdef WITH_PRINT
+    printf("=== END of %s\n", __func__);
+#endif
+}
+END_TEST
+
+START_TEST(run_ahead_exec)
+{
+// ------------------------------------------------------------
+#ifdef WITH_PRINT
+    printf("=== %s:\n", __func__);
+#endif
+    INIT;
+    // same run, without running ahead
+    gameboy_t ref;
+    zero_init_var(ref);
+    ck_assert_err_none(gameboy_create(&ref, FIBONACCI_ROM));
+    gameboy_t check;
+    zero_init_var(check);
+    ck_assert_err_none(gameboy_create(&check, FIBONACCI_ROM));
+
+    // the render policy is part of the state
+    ck_assert_err_none(gameboy_set_render_policy(&gb, RENDER_ON_REQUEST, 0));
+    ck_assert_err_none(gameboy_set_render_policy(&ref, RENDER_ON_REQUEST, 0));
+    ck_assert_err_none(run_ahead_init(&ra, &gb, AHEAD_FRAMES));
+    const size_t size = gameboy_state_size(&gb);
+    uint8_t* const before = malloc(size);
+    uint8_t* const state = malloc(size);
+    uint8_t* const expected = malloc(size);
+    ck_assert_ptr_nonnull(before);
+    ck_assert_ptr_nonnull(state);
+    ck_assert_ptr_nonnull(expected);
+
+    for (size_t f = 0; f < NB_FRAMES; ++f) {
+        const gb_key_t key = (gb_key_t) (rand() % NB_GB_KEYS);
+        if (rand() & 1) {
+            ck_assert_err_none(joypad_key_pressed(&(gb.pad), key));
+            ck_assert_err_none(joypad_key_pressed(&(ref.pad), key));
+        } else {
+            ck_assert_err_none(joypad_key_released(&(gb.pad), key));
+            ck_assert_err_none(joypad_key_released(&(ref.pad), key));
+        }
+        const uint64_t frame_end = (gb.cycles / FRAME_TOTAL_CYCLES + 1) * FRAME_TOTAL_CYCLES;
+        ck_assert_err_none(gameboy_run_until(&gb, frame_end));
+        ck_assert_err_none(gameboy_run_until(&ref, frame_end));
+        ck_assert_err_none(gameboy_save_state(&gb, before, size, NULL));
+
+        // ahead: as if emulated on with the same input
+        ck_assert_err_none(run_ahead_begin(&ra, &gb));
+        ck_assert_uint_eq(gb.cycles, frame_end + AHEAD_FRAMES * FRAME_TOTAL_CYCLES);
+        // only the frame shown was rendered
+        ck_assert_uint_eq(gb.render.rendered, 1);
+        ck_assert_err_none(gameboy_load_state(&check, before, size));
+        ck_assert_err_none(gameboy_run_until(&check, gb.cycles - FRAME_TOTAL_CYCLES));
+        ck_assert_err_none(gameboy_request_frame(&check));
+        ck_assert_err_none(gameboy_run_until(&check, gb.cycles));
+        ck_assert_err_none(gameboy_save_state(&gb, state, size, NULL));
+        ck_assert_err_none(gameboy_save_state(&check, expected, size, NULL));
+        ck_assert_int_eq(memcmp(state, expected, size), 0);
+
+        // back: the real run goes on unchanged
+        ck_assert_err_none(run_ahead_end(&ra, &gb));
+        ck_assert_err_none(gameboy_save_state(&gb, state, size, NULL));
+        ck_assert_int_eq(memcmp(state, before, size), 0);
+        ck_assert_err_none(gameboy_save_state(&ref, expected, size, NULL));
+        ck_assert_int_eq(memcmp(state, expected, size), 0);
+    }
+    // the frames run ahead are forgotten with the rest
+    ck_assert_uint_eq(gb.render.rendered, 0);
+
+    free(before);
+    free(state);
+    free(expected);
+    gameboy_free(&check);
+    gameboy_free(&ref);
+    END;
+
+#ifdef WITH_PRINT
+    printf("=== END of %s\n", __func__);
+#endif
+}
+END_TEST
+
+START_TEST(run_ahead_frame_exec)
+{
+// ------------------------------------------------------------
+#ifdef WITH_PRINT
+    printf("=== %s:\n", __func__);
+#endif
+    INIT;
+    // frames of the same run, rendering every frame without running ahead
+    gameboy_t ref;
+    zero_init_var(ref);
+    ck_assert_err_none(gameboy_create(&ref, FIBONACCI_ROM));
+    static snapshot_t frames[NB_FRAMES + AHEAD_FRAMES], shown, frame;
+    for (size_t f = 0; f < NB_FRAMES + AHEAD_FRAMES; ++f) {
+        ck_assert_err_none(gameboy_run_until(&ref, (ref.cycles / FRAME_TOTAL_CYCLES + 1) * FRAME_TOTAL_CYCLES));
+        take_snapshot(frames + f, &ref);
+    }
+    // the game draws as it goes
+    ck_assert_int_ne(memcmp(frames[0].display, frames[NB_FRAMES - 1].display, sizeof(frames[0].display)), 0);
+
+    ck_assert_err_none(gameboy_set_render_policy(&gb, RENDER_ON_REQUEST, 0));
+    ck_assert_err_none(run_ahead_init(&ra, &gb, AHEAD_FRAMES));
+    for (size_t f = 0; f < NB_FRAMES; ++f) {
+        // shown ahead: the frame the plain run draws at the end of the run-ahead
+        ck_assert_err_none(run_ahead_begin(&ra, &gb));
+        take_snapshot(&shown, &gb);
+        ck_assert_int_eq(memcmp(shown.display, frames[f + AHEAD_FRAMES - 1].display, sizeof(shown.display)), 0);
+
+        // back, the LCD included: the real frame is the one of the plain run
+        ck_assert_err_none(run_ahead_end(&ra, &gb));
+        ck_assert_err_none(gameboy_request_frame(&gb));
+        ck_assert_err_none(gameboy_run_until(&gb, (gb.cycles / FRAME_TOTAL_CYCLES + 1) * FRAME_TOTAL_CYCLES));
+        take_snapshot(&frame, &gb);
+        ck_assert_int_eq(memcmp(&frame, frames + f, sizeof(frame)), 0);
+    }
+
+    gameboy_free(&ref);
+    END;
+
+#ifdef WITH_PRINT
+    printf("=== END of %s\n", __func__);
+#endif
+}
+END_TEST
+
+Suite* run_ahead_test_suite()
+{
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wsign-conversion"
+#pragma GCC diagnostic ignored "-Wconversion"
+    srand(time(NULL) ^ getpid() ^ pthread_self());
+#pragma GCC diagnostic pop
+
+    Suite* s = suite_create("run_ahead.c Tests");
+
+    Add_Case(s, tc1, "Run-Ahead Tests");
+    tcase_add_test(tc1, run_ahead_err);
+    tcase_add_test(tc1, run_ahead_exec);
+    tcase_add_test(tc1, run_ahead_frame_exec);
+
+    return s;
+}
+
+TEST_SUITE(run_ahead_test_suite)
@@ -0,0 +1,268 @@
+/**
+ * @file unit-test-savestate.c
+ * @brief Unit test code for save states
+ *
+ * @date 2020
+ */
+
+// for thread-safe randomization
+#include <time.h>
+#include <stdlib.h>
+#include <sys/types.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include <check.h>
+#include <inttypes.h>
+#include <string.h>
+
+#include "util.h"
+#include "tests.h"
+#include "tests-snapshot.h"
+#include "savestate.h"
+#include "gameboy.h"
+#include "bootrom.h"
+#include "error.h"
+
+#define FIBONACCI_ROM "tests/data/fibonacci.gb"
+
+#define SAVE_CYCLE 40000
+#define END_CYCLE 90000
+
+#define INIT \
+    gameboy_t gb; \
+    zero_init_var(gb); \
+    ck_assert_err_none(gameboy_create(&gb, FIBONACCI_ROM)); \
+    const size_t size = gameboy_state_size(&gb); \
+    ck_assert_uint_gt(size, 0); \
+    uint8_t* const state = malloc(size + 64); \
+    ck_assert_ptr_nonnull(state)
+
+#define END \
+    free(state); \
+    gameboy_free(&gb)
+
+static void put16(uint8_t* p, uint16_t v)
+{
+    p[0] = (uint8_t) v;
+    p[1] = (uint8_t) (v >> 8);
+}
+
+static void put32(uint8_t* p, uint32_t v)
+{
+    put16(p, (uint16_t) v);
+    put16(p + 2, (uint16_t) (v >> 16));
+}
+
+START_TEST(savestate_err)
+{
+// ------------------------------------------------------------
+#ifdef WITH_PRINT
+    printf("=== %s:\n", __func__);
+#endif
+    INIT;
+    size_t written = 0;
+    ck_assert_uint_eq(gameboy_state_size(NULL), 0);
+    ck_assert_bad_param(gameboy_save_state(NULL, state, size, &written));
+    ck_assert_bad_param(gameboy_save_state(&gb, NULL, size, &written));
+    ck_assert_bad_param(gameboy_save_state(&gb, state, size - 1, &written));
+    ck_assert_bad_param(gameboy_load_state(NULL, state, size));
+    ck_assert_bad_param(gameboy_load_state(&gb, NULL, size));
+    ck_assert_bad_param(gameboy_save_state_file(&gb, NULL));
+    ck_assert_bad_param(gameboy_load_state_file(&gb, NULL));
+    ck_assert_int_eq(gameboy_load_state_file(&gb, "./file_that_doesnt_exist"), ERR_IO);
+
+    ck_assert_err_none(gameboy_save_state(&gb, state, size, &written));
+    ck_assert_uint_le(written, size);
+
+    // truncated
+    ck_assert_bad_param(gameboy_load_state(&gb, state, 3));
+    ck_assert_bad_param(gameboy_load_state(&gb, state, written - 1));
+    // not a state
+    state[0] ^= 0xFF;
+    ck_assert_bad_param(gameboy_load_state(&gb, state, size));
+    state[0] ^= 0xFF;
+    // future version
+    put16(state + 4, GB_STATE_VERSION + 1);
+    ck_assert_bad_param(gameboy_load_state(&gb, state, size));
+    put16(state + 4, GB_STATE_VERSION);
+    // missing section
+    put16(state + 6, 6);
+    ck_assert_bad_param(gameboy_load_state(&gb, state, size));
+    put16(state + 6, 7);
+    // another cartridge
+    uint8_t* mem = state;
+    while (memcmp(mem, "MEM ", 4) != 0) ++mem;
+    mem[8] ^= 0x01;
+    ck_assert_bad_param(gameboy_load_state(&gb, state, size));
+    mem[8] ^= 0x01;
+
+    // an invalid state leaves the gameboy as is
+    ck_assert_err_none(gameboy_run_until(&gb, SAVE_CYCLE));
+    static snapshot_t before, after;
+    take_snapshot(&before, &gb);
+    // cartridge plugged over more than its size: found out after all the other checks
+    uint8_t* bus = state;
+    while (memcmp(bus, "BUS ", 4) != 0) ++bus;
+    put16(bus + 8 + 1 + 2, 0xFFFF);
+    ck_assert_bad_param(gameboy_load_state(&gb, state, size));
+    take_snapshot(&after, &gb);
+    ck_assert_int_eq(memcmp(&before, &after, sizeof(before)), 0);
+
+    END;
+
+#ifdef WITH_PRINT
+    printf("=== END of %s\n", __func__);
+#endif
+}
+END_TEST
+
+START_TEST(savestate_roundtrip_exec)
+{
+// ------------------------------------------------------------
+#ifdef WITH_PRINT
+    printf("=== %s:\n", __func__);
+#endif
+    INIT;
+    static snapshot_t saved, expected, replayed;
+    uint8_t* const again = malloc(size);
+    ck_assert_ptr_nonnull(again);
+
+    ck_assert_err_none(gameboy_run_until(&gb, SAVE_CYCLE));
+    ck_assert_err_none(joypad_key_pressed(&(gb.pad), A_KEY));
+    ck_assert_err_none(gameboy_set_render_policy(&gb, RENDER_EVERY_NTH, 3));
+    take_snapshot(&saved, &gb);
+    const render_policy_t render = gb.render;
+    size_t written = 0;
+    ck_assert_err_none(gameboy_save_state(&gb, state, size, &written));
+    // the cartridge is not stored, as long as it is not written to
+    ck_assert_uint_lt(written + BANK_ROM_SIZE, size);
+
+    ck_assert_err_none(joypad_key_released(&(gb.pad), A_KEY));
+    ck_assert_err_none(gameboy_run_until(&gb, END_CYCLE));
+    take_snapshot(&expected, &gb);
+    ck_assert_err_none(gameboy_set_render_policy(&gb, RENDER_NEVER, 0));
+
+    // back in time, the render policy included
+    ck_assert_err_none(gameboy_load_state(&gb, state, written));
+    take_snapshot(&replayed, &gb);
+    ck_assert_int_eq(memcmp(&saved, &replayed, sizeof(saved)), 0);
+    ck_assert_int_eq(gb.render.mode, RENDER_EVERY_NTH);
+    ck_assert_uint_eq(gb.render.every, render.every);
+    ck_assert_uint_eq(gb.render.frames, render.frames);
+    ck_assert_uint_eq(gb.render.rendered, render.rendered);
+    ck_assert_int_eq(gb.pad.keys_state[1] != 0, 1);
+    ck_assert_err_none(gameboy_save_state(&gb, again, size, NULL));
+    ck_assert_int_eq(memcmp(state, again, size), 0);
+
+    // same future
+    ck_assert_err_none(joypad_key_released(&(gb.pad), A_KEY));
+    ck_assert_err_none(gameboy_run_until(&gb, END_CYCLE));
+    take_snapshot(&replayed, &gb);
+    ck_assert_int_eq(memcmp(&expected, &replayed, sizeof(expected)), 0);
+
+    // unknown sections are skipped
+    memcpy(state + written, "XTRA", 4);
+    put32(state + written + 4, 0);
+    put16(state + 6, 8);
+    put32(state + 8, (uint32_t) written + 8);
+    ck_assert_err_none(gameboy_load_state(&gb, state, written + 8));
+    ck_assert_uint_eq(gb.cycles, SAVE_CYCLE);
+
+    // the display is the last section, which version 3 states lack: blank
+    uint8_t* const scrn = state + written - (8 + LCD_HEIGHT * BIT_VECTOR_CHUNKS(LCD_WIDTH) * 2 * 4);
+    ck_assert_int_eq(memcmp(scrn, "SCRN", 4), 0);
+    put16(state + 4, 3);
+    put16(state + 6, 6);
+    put32(state + 8, (uint32_t) (scrn - state));
+    gb.screen.display.content[0].msb -> content[0] = 0x12345678;
+    ck_assert_err_none(gameboy_load_state(&gb, state, (size_t) (scrn - state)));
+    ck_assert_uint_eq(gb.cycles, SAVE_CYCLE);
+    ck_assert_uint_eq(gb.screen.display.content[0].msb -> content[0], 0);
+
+    // written to, the cartridge is stored page by page
+    gb.cartridge.c.mem -> memory[0x2000] ^= 0xFF;
+    ck_assert_err_none(gameboy_save_state(&gb, state, size, &written));
+    gb.cartridge.c.mem -> memory[0x2000] ^= 0xFF;
+    ck_assert_err_none(gameboy_load_state(&gb, state, written));
+    ck_assert_int_eq(gb.cartridge.c.mem -> memory[0x2000], gb.rom[0x2000] ^ 0xFF);
+    ck_assert_int_eq(gb.cartridge.c.mem -> memory[0x2100], gb.rom[0x2100]);
+
+    free(again);
+    END;
+
+#ifdef WITH_PRINT
+    printf("=== END of %s\n", __func__);
+#endif
+}
+END_TEST
+
+START_TEST(savestate_bus_exec)
+{
+// ------------------------------------------------------------
+#ifdef WITH_PRINT
+    printf("=== %s:\n", __func__);
+#endif
+    INIT;
+    ck_assert_err_none(gameboy_save_state(&gb, state, size, NULL));
+    ck_assert_ptr_eq(gb.bus[0x0000], gb.bootrom.mem -> memory);
+
+    // end of boot: the cartridge is seen from 0
+    ck_assert_err_none(bus_write(gb.bus, REG_BOOT_ROM_DISABLE, 1));
+    ck_assert_err_none(bootrom_bus_listener(&gb, REG_BOOT_ROM_DISABLE));
+    ck_assert_int_eq(gb.boot, 0);
+    ck_assert_ptr_eq(gb.bus[0x0000], gb.cartridge.c.mem -> memory);
+    ck_assert_ptr_eq(gb.bus[0x0100], gb.cartridge.c.mem -> memory + 0x100);
+
+    // back to boot
+    ck_assert_err_none(gameboy_load_state(&gb, state, size));
+    ck_assert_int_eq(gb.boot, 1);
+    ck_assert_ptr_eq(gb.bus[0x0000], gb.bootrom.mem -> memory);
+    ck_assert_ptr_eq(gb.bus[0x00FF], gb.bootrom.mem -> memory + 0xFF);
+    ck_assert_ptr_eq(gb.bus[0x0100], gb.cartridge.c.mem -> memory + 0x100);
+    ck_assert_ptr_eq(gb.bus[REG_IF], &(gb.cpu.IF));
+    ck_assert_ptr_eq(gb.bus[REG_IE], &(gb.cpu.IE));
+    ck_assert_ptr_eq(gb.bus[ECHO_RAM_START], gb.components[0].mem -> memory);
+
+    // through a file
+    char filename[] = "/tmp/unit-test-savestate-XXXXXX";
+    const int fd = mkstemp(filename);
+    ck_assert_int_ge(fd, 0);
+    close(fd);
+    ck_assert_err_none(gameboy_run_until(&gb, SAVE_CYCLE));
+    const uint16_t pc = gb.cpu.PC;
+    ck_assert_err_none(gameboy_save_state_file(&gb, filename));
+    ck_assert_err_none(gameboy_run_until(&gb, END_CYCLE));
+    ck_assert_err_none(gameboy_load_state_file(&gb, filename));
+    ck_assert_uint_eq(gb.cycles, SAVE_CYCLE);
+    ck_assert_uint_eq(gb.cpu.PC, pc);
+    remove(filename);
+
+    END;
+
+#ifdef WITH_PRINT
+    printf("=== END of %s\n", __func__);
+#endif
+}
+END_TEST
+
+Suite* savestate_test_suite()
+{
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wsign-conversion"
+#pragma GCC diagnostic ignored "-Wconversion"
+    srand(time(NULL) ^ getpid() ^ pthread_self());
+#pragma GCC diagnostic pop
+
+    Suite* s = suite_create("savestate.c Tests");
+
+    Add_Case(s, tc1, "Save State Tests");
+    tcase_add_test(tc1, savestate_err);
+    tcase_add_test(tc1, savestate_roundtrip_exec);
+    tcase_add_test(tc1, savestate_bus_exec);
+
+    return s;
+}
+
+TEST_SUITE(savestate_test_suite)
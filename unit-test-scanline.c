@@ -0,0 +1,186 @@
+/**
+ * @file unit-test-scanline.c
+ * @brief Unit test code for scanline fingerprints and dirty-line tracking
+ *
+ * @date 2020
+ */
+
+// for thread-safe randomization
+#include <time.h>
+#include <stdlib.h>
+#include <sys/types.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include <check.h>
+#include <inttypes.h>
+
+#include "tests.h"
+#include "scanline.h"
+#include "component.h"
+#include "bus.h"
+#include "error.h"
+
+#define INIT_BUS \
+    bus_t bus = {0}; \
+    component_t vram, oam, regs; \
+    ck_assert_err_none(component_create(&vram, 0x2000)); \
+    ck_assert_err_none(component_create(&oam, 0xA0)); \
+    ck_assert_err_none(component_create(&regs, 0x80)); \
+    ck_assert_err_none(bus_plug(bus, &vram, 0x8000, 0x9FFF)); \
+    ck_assert_err_none(bus_plug(bus, &oam, 0xFE00, 0xFE9F)); \
+    ck_assert_err_none(bus_plug(bus, &regs, 0xFF00, 0xFF7F)); \
+    ck_assert_err_none(bus_write(bus, REG_LCDC, 0x91))
+
+#define FREE_BUS \
+    component_free(&vram); \
+    component_free(&oam); \
+    component_free(&regs)
+
+#define fingerprint_of(ly) fingerprint_line(bus, ly)
+
+static uint64_t fingerprint_line(const bus_t bus, size_t ly)
+{
+    uint64_t fingerprint = 0;
+    ck_assert_err_none(scanline_fingerprint(bus, ly, 0, &fingerprint));
+    return fingerprint;
+}
+
+START_TEST(scanline_err)
+{
+// ------------------------------------------------------------
+#ifdef WITH_PRINT
+    printf("=== %s:\n", __func__);
+#endif
+    bus_t bus = {0};
+    uint64_t fingerprint = 0;
+    scanline_mask_t mask;
+
+    ck_assert_bad_param(scanline_tracker_init(NULL));
+    ck_assert_bad_param(scanline_fingerprint(bus, 0, 0, NULL));
+    ck_assert_bad_param(scanline_fingerprint(bus, LCD_HEIGHT, 0, &fingerprint));
+    ck_assert_bad_param(scanline_tracker_take_dirty(NULL, mask));
+    ck_assert_int_eq(scanline_tracker_update(NULL, 0, 0), 1);
+    ck_assert_int_eq(scanline_tracker_is_dirty(NULL, 0), 1);
+
+#ifdef WITH_PRINT
+    printf("=== END of %s\n", __func__);
+#endif
+}
+END_TEST
+
+START_TEST(scanline_fingerprint_exec)
+{
+// ------------------------------------------------------------
+#ifdef WITH_PRINT
+    printf("=== %s:\n", __func__);
+#endif
+    INIT_BUS;
+
+    // lines 0 and 8 use different map rows, which both point to tile 0
+    const uint64_t line0 = fingerprint_of(0);
+    const uint64_t line8 = fingerprint_of(8);
+
+    // row 3 of tile 1 is not referenced
+    ck_assert_err_none(bus_write(bus, 0x8000 + TILE_SIZE + 6, 0x55));
+    ck_assert_int_eq(fingerprint_of(0), line0);
+
+    // row 0 of tile 0 is referenced by line 0 and line 8
+    ck_assert_err_none(bus_write(bus, 0x8000, 0x55));
+    ck_assert_int_ne(fingerprint_of(0), line0);
+    ck_assert_int_ne(fingerprint_of(8), line8);
+    ck_assert_int_eq(fingerprint_of(1), fingerprint_of(9));
+
+    // map entry of line 8 only
+    const uint64_t line0_bis = fingerprint_of(0);
+    ck_assert_err_none(bus_write(bus, 0x9800 + TILE_LINE_SIZE, 1));
+    ck_assert_int_eq(fingerprint_of(0), line0_bis);
+    ck_assert_int_ne(fingerprint_of(8), fingerprint_of(0));
+
+    // palettes affect every line
+    ck_assert_err_none(bus_write(bus, REG_BGP, 0xE4));
+    ck_assert_int_ne(fingerprint_of(0), line0_bis);
+
+    // a sprite covering lines 4 to 11 (OAM y = 20)
+    const uint64_t line3 = fingerprint_of(3), line4 = fingerprint_of(4), line12 = fingerprint_of(12);
+    ck_assert_err_none(bus_write(bus, 0xFE00, 20));
+    ck_assert_err_none(bus_write(bus, 0xFE01, 40));
+    ck_assert_err_none(bus_write(bus, REG_LCDC, 0x93));
+    ck_assert_int_ne(fingerprint_of(4), line4);
+    const uint64_t line3_obj = fingerprint_of(3), line12_obj = fingerprint_of(12);
+    ck_assert_int_ne(line3_obj, line3); // LCDC changed
+    const uint64_t line4_obj = fingerprint_of(4);
+    ck_assert_err_none(bus_write(bus, 0xFE01, 41));
+    ck_assert_int_ne(fingerprint_of(4), line4_obj);
+    ck_assert_int_eq(fingerprint_of(3), line3_obj);
+    ck_assert_int_eq(fingerprint_of(12), line12_obj);
+    ck_assert_int_ne(line12_obj, line12);
+
+    FREE_BUS;
+#ifdef WITH_PRINT
+    printf("=== END of %s\n", __func__);
+#endif
+}
+END_TEST
+
+START_TEST(scanline_tracker_exec)
+{
+// ------------------------------------------------------------
+#ifdef WITH_PRINT
+    printf("=== %s:\n", __func__);
+#endif
+    scanline_tracker_t tracker;
+    scanline_mask_t mask;
+
+    ck_assert_err_none(scanline_tracker_init(&tracker));
+    for (size_t y = 0; y < LCD_HEIGHT; ++y) {
+        ck_assert_int_eq(scanline_tracker_is_dirty(&tracker, y), 1);
+        ck_assert_int_eq(scanline_tracker_update(&tracker, y, y), 1);
+    }
+    ck_assert_err_none(scanline_tracker_take_dirty(&tracker, mask));
+    for (size_t y = 0; y < LCD_HEIGHT; ++y) {
+        ck_assert_int_eq(scanline_mask_get(mask, y), 1);
+        ck_assert_int_eq(scanline_tracker_is_dirty(&tracker, y), 0);
+    }
+
+    // same fingerprints: nothing to compose
+    for (size_t y = 0; y < LCD_HEIGHT; ++y) {
+        ck_assert_int_eq(scanline_tracker_update(&tracker, y, y), 0);
+    }
+    ck_assert_int_eq(scanline_tracker_update(&tracker, 100, 1), 1);
+    ck_assert_int_eq(scanline_tracker_update(&tracker, 100, 1), 0);
+    ck_assert_err_none(scanline_tracker_take_dirty(&tracker, mask));
+    for (size_t y = 0; y < LCD_HEIGHT; ++y) {
+        ck_assert_int_eq(scanline_mask_get(mask, y), y == 100);
+    }
+
+    scanline_tracker_invalidate_all(&tracker);
+    ck_assert_int_eq(scanline_tracker_is_dirty(&tracker, 5), 1);
+    ck_assert_int_eq(scanline_tracker_update(&tracker, 5, 5), 1);
+
+#ifdef WITH_PRINT
+    printf("=== END of %s\n", __func__);
+#endif
+}
+END_TEST
+
+Suite* scanline_test_suite()
+{
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wsign-conversion"
+#pragma GCC diagnostic ignored "-Wconversion"
+    srand(time(NULL) ^ getpid() ^ pthread_self());
+#pragma GCC diagnostic pop
+
+    Suite* s = suite_create("scanline.c Tests");
+
+    Add_Case(s, tc1, "Scanline Tests");
+    tcase_add_test(tc1, scanline_err);
+    tcase_add_test(tc1, scanline_fingerprint_exec);
+    tcase_add_test(tc1, scanline_tracker_exec);
+
+    return s;
+}
+
+TEST_SUITE(scanline_test_suite)
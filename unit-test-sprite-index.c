@@ -0,0 +1,181 @@
+/**
+ * @file unit-test-sprite-index.c
+ * @brief Unit test code for the line to sprite index
+ *
+ * @date 2020
+ */
+
+// for thread-safe randomization
+#include <time.h>
+#include <stdlib.h>
+#include <sys/types.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include <check.h>
+#include <inttypes.h>
+
+#include "tests.h"
+#include "sprite_index.h"
+#include "component.h"
+#include "bus.h"
+#include "error.h"
+
+#define INIT_BUS \
+    bus_t bus = {0}; \
+    component_t oam, regs; \
+    ck_assert_err_none(component_create(&oam, 0xA0)); \
+    ck_assert_err_none(component_create(&regs, 0x80)); \
+    ck_assert_err_none(bus_plug(bus, &oam, 0xFE00, 0xFE9F)); \
+    ck_assert_err_none(bus_plug(bus, &regs, 0xFF00, 0xFF7F)); \
+    sprite_index_t index; \
+    ck_assert_err_none(sprite_index_init(&index, bus))
+
+#define FREE_BUS \
+    component_free(&oam); \
+    component_free(&regs)
+
+// writes the y coordinate of a sprite and notifies the index
+#define set_y(nb, y) \
+    do { \
+        ck_assert_err_none(bus_write(bus, (addr_t) (OAM_START + (nb) * OAM_ENTRY_SIZE), y)); \
+        ck_assert_err_none(sprite_index_bus_listener(&index, bus, (addr_t) (OAM_START + (nb) * OAM_ENTRY_SIZE))); \
+    } while(0)
+
+// expected sprites follow a leading placeholder 0, so that the list is never empty
+#define assert_line(ly, ...) \
+    do { \
+        const data_t expected_[] = { __VA_ARGS__ }; \
+        data_t got_[SPRITE_INDEX_MAX_PER_LINE]; \
+        size_t nb_ = 0; \
+        ck_assert_err_none(sprite_index_get_line(&index, bus, ly, got_, &nb_)); \
+        ck_assert_int_eq(nb_, sizeof(expected_) - 1); \
+        for (size_t i_ = 0; i_ < nb_; ++i_) ck_assert_int_eq(got_[i_], expected_[i_ + 1]); \
+    } while(0)
+
+START_TEST(sprite_index_err)
+{
+// ------------------------------------------------------------
+#ifdef WITH_PRINT
+    printf("=== %s:\n", __func__);
+#endif
+    INIT_BUS;
+    data_t sprites[SPRITE_INDEX_MAX_PER_LINE];
+    size_t nb = 0;
+
+    ck_assert_bad_param(sprite_index_init(NULL, bus));
+    ck_assert_bad_param(sprite_index_bus_listener(NULL, bus, OAM_START));
+    ck_assert_bad_param(sprite_index_get_line(&index, bus, 0, NULL, &nb));
+    ck_assert_bad_param(sprite_index_get_line(&index, bus, 0, sprites, NULL));
+    ck_assert_bad_param(sprite_index_get_line(&index, bus, LCD_HEIGHT, sprites, &nb));
+
+    FREE_BUS;
+#ifdef WITH_PRINT
+    printf("=== END of %s\n", __func__);
+#endif
+}
+END_TEST
+
+START_TEST(sprite_index_write_exec)
+{
+// ------------------------------------------------------------
+#ifdef WITH_PRINT
+    printf("=== %s:\n", __func__);
+#endif
+    INIT_BUS;
+
+    // OAM is all 0: every sprite is hidden above the screen
+    assert_line(0, 0);
+
+    set_y(3, OAM_Y_OFFSET);     // lines 0 to 7
+    set_y(1, OAM_Y_OFFSET + 4); // lines 4 to 11
+    assert_line(0, 0, 3);
+    assert_line(4, 0, 1, 3);
+    assert_line(8, 0, 1);
+    assert_line(12, 0);
+
+    // moving a sprite clears its former lines
+    set_y(3, OAM_Y_OFFSET + 100);
+    assert_line(0, 0);
+    assert_line(4, 0, 1);
+    assert_line(107, 0, 3);
+
+    // partially visible at the top and at the bottom
+    set_y(5, 10);
+    set_y(6, LCD_HEIGHT + 12);
+    assert_line(1, 0, 5);
+    assert_line(2, 0);
+    assert_line(LCD_HEIGHT - 4, 0, 6);
+
+    // 16-bit write reporting the previous address only
+    ck_assert_err_none(bus_write(bus, (addr_t) (OAM_START + 2 * OAM_ENTRY_SIZE), OAM_Y_OFFSET + 50));
+    ck_assert_err_none(sprite_index_bus_listener(&index, bus, (addr_t) (OAM_START + 2 * OAM_ENTRY_SIZE - 1)));
+    assert_line(50, 0, 2);
+
+    // no more than SPRITE_INDEX_MAX_PER_LINE, in OAM order
+    for (size_t i = 39; i >= 20; --i) {
+        set_y(i, OAM_Y_OFFSET + 60);
+    }
+    assert_line(60, 0, 20, 21, 22, 23, 24, 25, 26, 27, 28, 29);
+
+    FREE_BUS;
+#ifdef WITH_PRINT
+    printf("=== END of %s\n", __func__);
+#endif
+}
+END_TEST
+
+START_TEST(sprite_index_rebuild_exec)
+{
+// ------------------------------------------------------------
+#ifdef WITH_PRINT
+    printf("=== %s:\n", __func__);
+#endif
+    INIT_BUS;
+
+    set_y(0, OAM_Y_OFFSET);
+    assert_line(8, 0);
+
+    // object size change
+    ck_assert_err_none(bus_write(bus, REG_LCDC, LCDC_REG_OBJ_SIZE_MASK));
+    ck_assert_err_none(sprite_index_bus_listener(&index, bus, REG_LCDC));
+    assert_line(8, 0, 0);
+    assert_line(15, 0, 0);
+    assert_line(16, 0);
+
+    // DMA: OAM rewritten without any listened write
+    for (size_t i = 0; i < OAM_NB_SPRITES; ++i) {
+        ck_assert_err_none(bus_write(bus, (addr_t) (OAM_START + i * OAM_ENTRY_SIZE), OAM_Y_OFFSET + 30));
+    }
+    assert_line(30, 0);
+    ck_assert_err_none(sprite_index_bus_listener(&index, bus, REG_DMA));
+    assert_line(30, 0, 0, 1, 2, 3, 4, 5, 6, 7, 8, 9);
+    assert_line(0, 0);
+
+    FREE_BUS;
+#ifdef WITH_PRINT
+    printf("=== END of %s\n", __func__);
+#endif
+}
+END_TEST
+
+Suite* sprite_index_test_suite()
+{
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wsign-conversion"
+#pragma GCC diagnostic ignored "-Wconversion"
+    srand(time(NULL) ^ getpid() ^ pthread_self());
+#pragma GCC diagnostic pop
+
+    Suite* s = suite_create("sprite_index.c Tests");
+
+    Add_Case(s, tc1, "Sprite index Tests");
+    tcase_add_test(tc1, sprite_index_err);
+    tcase_add_test(tc1, sprite_index_write_exec);
+    tcase_add_test(tc1, sprite_index_rebuild_exec);
+
+    return s;
+}
+
+TEST_SUITE(sprite_index_test_suite)
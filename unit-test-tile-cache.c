@@ -0,0 +1,219 @@
+/**
+ * @file unit-test-tile-cache.c
+ * @brief Unit test code for the tile cache
+ *
+ * @date 2020
+ */
+
+// for thread-safe randomization
+#include <time.h>
+#include <stdlib.h>
+#include <sys/types.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include <check.h>
+#include <inttypes.h>
+
+#include "tests.h"
+#include "tile_cache.h"
+#include "component.h"
+#include "error.h"
+
+#define VRAM_SIZE 0x2000
+
+#define INIT_VRAM \
+    component_t vram; \
+    ck_assert_err_none(component_create(&vram, VRAM_SIZE)); \
+    tile_cache_t* cache = malloc(sizeof(tile_cache_t)); \
+    ck_assert_ptr_nonnull(cache); \
+    ck_assert_err_none(tile_cache_init(cache, &vram))
+
+#define FREE_VRAM \
+    free(cache); \
+    component_free(&vram)
+
+// tile row 0: lsb = 0x3C, msb = 0x7E  =>  0 2 3 3 3 3 2 0
+#define ROW0_LSB 0x3C
+#define ROW0_MSB 0x7E
+static const uint8_t row0[TILE_PIXELS]         = {0, 2, 3, 3, 3, 3, 2, 0};
+// tile row 1: lsb = 0x81, msb = 0x01  =>  1 0 0 0 0 0 0 3
+#define ROW1_LSB 0x81
+#define ROW1_MSB 0x01
+static const uint8_t row1[TILE_PIXELS]         = {1, 0, 0, 0, 0, 0, 0, 3};
+static const uint8_t row1_flipped[TILE_PIXELS] = {3, 0, 0, 0, 0, 0, 0, 1};
+
+#define row_match(row, expected) \
+    do { \
+        ck_assert_ptr_nonnull(row); \
+        for (size_t i = 0; i < TILE_PIXELS; ++i) { ck_assert_int_eq((row)[i], (expected)[i]); } \
+    } while(0)
+
+START_TEST(tile_cache_init_err)
+{
+// ------------------------------------------------------------
+#ifdef WITH_PRINT
+    printf("=== %s:\n", __func__);
+#endif
+    tile_cache_t cache;
+    component_t small;
+    ck_assert_err_none(component_create(&small, 16));
+
+    ck_assert_bad_param(tile_cache_init(NULL, &small));
+    ck_assert_bad_param(tile_cache_init(&cache, NULL));
+    ck_assert_bad_param(tile_cache_init(&cache, &small));
+    ck_assert_bad_param(tile_cache_bus_listener(NULL, TILE_SRC_ADDR_LOW));
+    ck_assert_ptr_null(tile_cache_get(NULL, 0, 0));
+
+    component_free(&small);
+#ifdef WITH_PRINT
+    printf("=== END of %s\n", __func__);
+#endif
+}
+END_TEST
+
+START_TEST(tile_cache_index_exec)
+{
+// ------------------------------------------------------------
+#ifdef WITH_PRINT
+    printf("=== %s:\n", __func__);
+#endif
+    ck_assert_uint_eq(tile_cache_index(0x00, 1), 0);
+    ck_assert_uint_eq(tile_cache_index(0x80, 1), 128);
+    ck_assert_uint_eq(tile_cache_index(0xFF, 1), 255);
+    ck_assert_uint_eq(tile_cache_index(0x00, 0), 256);
+    ck_assert_uint_eq(tile_cache_index(0x7F, 0), 383);
+    ck_assert_uint_eq(tile_cache_index(0x80, 0), 128);
+    ck_assert_uint_eq(tile_cache_index(0xFF, 0), 255);
+#ifdef WITH_PRINT
+    printf("=== END of %s\n", __func__);
+#endif
+}
+END_TEST
+
+START_TEST(tile_cache_decode_exec)
+{
+// ------------------------------------------------------------
+#ifdef WITH_PRINT
+    printf("=== %s:\n", __func__);
+#endif
+    INIT_VRAM;
+    const size_t tile = 300;
+    data_t* mem = vram.mem->memory + tile * TILE_SIZE;
+    mem[0] = ROW0_LSB;
+    mem[1] = ROW0_MSB;
+    mem[2] = ROW1_LSB;
+    mem[3] = ROW1_MSB;
+
+    row_match(tile_cache_get_row(cache, tile, 0, 0, 0), row0);
+    row_match(tile_cache_get_row(cache, tile, 1, 0, 0), row1);
+    row_match(tile_cache_get_row(cache, tile, 1, 1, 0), row1_flipped);
+    row_match(tile_cache_get_row(cache, tile, 6, 0, 1), row1);
+    row_match(tile_cache_get_row(cache, tile, 7, 1, 1), row0);
+    ck_assert_ptr_null(tile_cache_get_row(cache, tile, TILE_PIXELS, 0, 0));
+    ck_assert_ptr_null(tile_cache_get_row(cache, TILE_CACHE_NB_TILES, 0, 0, 0));
+
+    FREE_VRAM;
+#ifdef WITH_PRINT
+    printf("=== END of %s\n", __func__);
+#endif
+}
+END_TEST
+
+START_TEST(tile_cache_invalidate_exec)
+{
+// ------------------------------------------------------------
+#ifdef WITH_PRINT
+    printf("=== %s:\n", __func__);
+#endif
+    INIT_VRAM;
+    const size_t tile = 5;
+    data_t* mem = vram.mem->memory + tile * TILE_SIZE;
+    mem[2] = ROW1_LSB;
+    mem[3] = ROW1_MSB;
+    row_match(tile_cache_get_row(cache, tile, 1, 0, 0), row1);
+
+    // not seen until the write is reported
+    mem[2] = ROW0_LSB;
+    mem[3] = ROW0_MSB;
+    row_match(tile_cache_get_row(cache, tile, 1, 0, 0), row1);
+
+    // writes outside of the tile do not invalidate it
+    ck_assert_err_none(tile_cache_bus_listener(cache, (addr_t)(TILE_SRC_ADDR_LOW + (tile + 1) * TILE_SIZE)));
+    ck_assert_err_none(tile_cache_bus_listener(cache, 0xC000));
+    row_match(tile_cache_get_row(cache, tile, 1, 0, 0), row1);
+
+    ck_assert_err_none(tile_cache_bus_listener(cache, (addr_t)(TILE_SRC_ADDR_LOW + tile * TILE_SIZE + 3)));
+    row_match(tile_cache_get_row(cache, tile, 1, 0, 0), row0);
+
+    // second byte of a 16-bit write
+    mem[0] = ROW1_LSB;
+    mem[1] = ROW1_MSB;
+    ck_assert_err_none(tile_cache_bus_listener(cache, (addr_t)(TILE_SRC_ADDR_LOW + tile * TILE_SIZE - 1)));
+    row_match(tile_cache_get_row(cache, tile, 0, 0, 0), row1);
+
+    FREE_VRAM;
+#ifdef WITH_PRINT
+    printf("=== END of %s\n", __func__);
+#endif
+}
+END_TEST
+
+START_TEST(tile_cache_map_row_exec)
+{
+// ------------------------------------------------------------
+#ifdef WITH_PRINT
+    printf("=== %s:\n", __func__);
+#endif
+    INIT_VRAM;
+    // tile 256 (number 0 in signed addressing) and tile 1
+    vram.mem->memory[256 * TILE_SIZE + 2 * 3]     = ROW1_LSB;
+    vram.mem->memory[256 * TILE_SIZE + 2 * 3 + 1] = ROW1_MSB;
+    vram.mem->memory[1 * TILE_SIZE + 2 * 3]       = ROW0_LSB;
+    vram.mem->memory[1 * TILE_SIZE + 2 * 3 + 1]   = ROW0_MSB;
+
+    const data_t map[2] = {0x00, 0x01};
+    uint8_t out[2 * TILE_PIXELS];
+
+    ck_assert_bad_param(tile_cache_map_row(cache, map, 2, 0, TILE_PIXELS, out));
+    ck_assert_err_none(tile_cache_map_row(cache, map, 2, 0, 3, out));
+    row_match(out, row1);
+    for (size_t i = TILE_PIXELS; i < 2 * TILE_PIXELS; ++i) {
+        ck_assert_int_eq(out[i], 0);
+    }
+
+    ck_assert_err_none(tile_cache_map_row(cache, map, 2, 1, 3, out));
+    for (size_t i = 0; i < TILE_PIXELS; ++i) {
+        ck_assert_int_eq(out[i], 0);
+    }
+    row_match(out + TILE_PIXELS, row0);
+
+    FREE_VRAM;
+#ifdef WITH_PRINT
+    printf("=== END of %s\n", __func__);
+#endif
+}
+END_TEST
+
+Suite* tile_cache_test_suite()
+{
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wsign-conversion"
+#pragma GCC diagnostic ignored "-Wconversion"
+    srand(time(NULL) ^ getpid() ^ pthread_self());
+#pragma GCC diagnostic pop
+
+    Suite* s = suite_create("tile_cache.c Tests");
+
+    Add_Case(s, tc1, "Tile cache Tests");
+    tcase_add_test(tc1, tile_cache_init_err);
+    tcase_add_test(tc1, tile_cache_index_exec);
+    tcase_add_test(tc1, tile_cache_decode_exec);
+    tcase_add_test(tc1, tile_cache_invalidate_exec);
+    tcase_add_test(tc1, tile_cache_map_row_exec);
+
+    return s;
+}
+
+TEST_SUITE(tile_cache_test_suite)
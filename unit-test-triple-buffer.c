@@ -0,0 +1,160 @@
+/**
+ * @file unit-test-triple-buffer.c
+ * @brief Unit test code for the lock-free triple buffer
+ *
+ * @date 2020
+ */
+
+// for thread-safe randomization
+#include <time.h>
+#include <stdlib.h>
+#include <sys/types.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include <check.h>
+#include <inttypes.h>
+#include <stdatomic.h>
+
+#include "tests.h"
+#include "triple_buffer.h"
+#include "error.h"
+
+#define FRAME_WORDS 4096
+#define NB_FRAMES   20000
+
+START_TEST(triple_buffer_err)
+{
+// ------------------------------------------------------------
+#ifdef WITH_PRINT
+    printf("=== %s:\n", __func__);
+#endif
+    triple_buffer_t tb;
+
+    ck_assert_bad_param(triple_buffer_create(NULL, 1));
+    ck_assert_bad_param(triple_buffer_create(&tb, 0));
+    ck_assert_ptr_null(triple_buffer_back(NULL));
+    ck_assert_ptr_null(triple_buffer_front(NULL));
+    ck_assert_int_eq(triple_buffer_acquire(NULL), 0);
+    triple_buffer_publish(NULL);
+    triple_buffer_free(NULL);
+
+#ifdef WITH_PRINT
+    printf("=== END of %s\n", __func__);
+#endif
+}
+END_TEST
+
+START_TEST(triple_buffer_exec)
+{
+// ------------------------------------------------------------
+#ifdef WITH_PRINT
+    printf("=== %s:\n", __func__);
+#endif
+    triple_buffer_t tb;
+    ck_assert_err_none(triple_buffer_create(&tb, sizeof(int)));
+
+    // nothing published yet
+    ck_assert_int_eq(triple_buffer_acquire(&tb), 0);
+    ck_assert_int_eq(*(const int*) triple_buffer_front(&tb), 0);
+
+    *(int*) triple_buffer_back(&tb) = 1;
+    triple_buffer_publish(&tb);
+    ck_assert_ptr_ne(triple_buffer_back(&tb), triple_buffer_front(&tb));
+    ck_assert_int_eq(triple_buffer_acquire(&tb), 1);
+    ck_assert_int_eq(*(const int*) triple_buffer_front(&tb), 1);
+    ck_assert_int_eq(triple_buffer_acquire(&tb), 0);
+    ck_assert_int_eq(*(const int*) triple_buffer_front(&tb), 1);
+
+    // unread frames are overwritten by newer ones
+    *(int*) triple_buffer_back(&tb) = 2;
+    triple_buffer_publish(&tb);
+    *(int*) triple_buffer_back(&tb) = 3;
+    triple_buffer_publish(&tb);
+    ck_assert_int_eq(triple_buffer_acquire(&tb), 1);
+    ck_assert_int_eq(*(const int*) triple_buffer_front(&tb), 3);
+    ck_assert_ptr_ne(triple_buffer_back(&tb), triple_buffer_front(&tb));
+
+    triple_buffer_free(&tb);
+
+#ifdef WITH_PRINT
+    printf("=== END of %s\n", __func__);
+#endif
+}
+END_TEST
+
+static triple_buffer_t shared;
+static atomic_bool producer_done;
+
+static void* producer(void* arg)
+{
+    (void) arg;
+    for (uint32_t frame = 1; frame <= NB_FRAMES; ++frame) {
+        uint32_t* const words = triple_buffer_back(&shared);
+        for (size_t i = 0; i < FRAME_WORDS; ++i) {
+            words[i] = frame;
+        }
+        triple_buffer_publish(&shared);
+    }
+    atomic_store(&producer_done, 1);
+    return NULL;
+}
+
+START_TEST(triple_buffer_threads_exec)
+{
+// ------------------------------------------------------------
+#ifdef WITH_PRINT
+    printf("=== %s:\n", __func__);
+#endif
+    ck_assert_err_none(triple_buffer_create(&shared, FRAME_WORDS * sizeof(uint32_t)));
+    atomic_store(&producer_done, 0);
+
+    pthread_t thread;
+    ck_assert_int_eq(pthread_create(&thread, NULL, producer, NULL), 0);
+
+    uint32_t last = 0;
+    size_t torn = 0;
+    bit_t done = 0;
+    while (!done) {
+        done = atomic_load(&producer_done);
+        if (triple_buffer_acquire(&shared)) {
+            const uint32_t* const words = triple_buffer_front(&shared);
+            ck_assert_uint_gt(words[0], last);
+            for (size_t i = 1; i < FRAME_WORDS; ++i) {
+                torn += words[i] != words[0];
+            }
+            last = words[0];
+        }
+    }
+    pthread_join(thread, NULL);
+
+    ck_assert_uint_eq(torn, 0);
+    ck_assert_uint_eq(last, NB_FRAMES);
+    triple_buffer_free(&shared);
+
+#ifdef WITH_PRINT
+    printf("=== END of %s\n", __func__);
+#endif
+}
+END_TEST
+
+Suite* triple_buffer_test_suite()
+{
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wsign-conversion"
+#pragma GCC diagnostic ignored "-Wconversion"
+    srand(time(NULL) ^ getpid() ^ pthread_self());
+#pragma GCC diagnostic pop
+
+    Suite* s = suite_create("triple_buffer.c Tests");
+
+    Add_Case(s, tc1, "Triple buffer Tests");
+    tcase_add_test(tc1, triple_buffer_err);
+    tcase_add_test(tc1, triple_buffer_exec);
+    tcase_add_test(tc1, triple_buffer_threads_exec);
+
+    return s;
+}
+
+TEST_SUITE(triple_buffer_test_suite)
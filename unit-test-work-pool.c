@@ -0,0 +1,121 @@
+/**
+ * @file unit-test-work-pool.c
+ * @brief Unit test code for the work-stealing thread pool
+ *
+ * @date 2020
+ */
+
+// for thread-safe randomization
+#include <time.h>
+#include <stdlib.h>
+#include <sys/types.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include <check.h>
+#include <inttypes.h>
+#include <stdatomic.h>
+
+#include "tests.h"
+#include "work_pool.h"
+#include "error.h"
+
+#define NB_TASKS 200
+
+typedef struct {
+    unsigned int slices;  // slices left
+    unsigned int runs;    // slices run
+    atomic_int running;   // detects a task run by two workers at once
+    atomic_int overlaps;
+} task_t;
+
+static atomic_uint total_runs;
+
+static work_status_t slice(void* arg)
+{
+    task_t* const task = arg;
+    if (atomic_fetch_add(&(task->running), 1) != 0) {
+        atomic_fetch_add(&(task->overlaps), 1);
+    }
+    ++(task->runs);
+    atomic_fetch_add(&total_runs, 1);
+    const work_status_t status = --(task->slices) == 0 ? WORK_DONE : WORK_AGAIN;
+    atomic_fetch_sub(&(task->running), 1);
+    return status;
+}
+
+START_TEST(work_pool_err)
+{
+// ------------------------------------------------------------
+#ifdef WITH_PRINT
+    printf("=== %s:\n", __func__);
+#endif
+    void* tasks[1] = { NULL };
+    ck_assert_bad_param(work_pool_run(1, tasks, 1, NULL));
+    ck_assert_bad_param(work_pool_run(1, NULL, 1, slice));
+    ck_assert_err_none(work_pool_run(1, NULL, 0, slice));
+    ck_assert_uint_ge(work_pool_default_workers(), 1);
+
+#ifdef WITH_PRINT
+    printf("=== END of %s\n", __func__);
+#endif
+}
+END_TEST
+
+START_TEST(work_pool_run_exec)
+{
+// ------------------------------------------------------------
+#ifdef WITH_PRINT
+    printf("=== %s:\n", __func__);
+#endif
+    static task_t tasks[NB_TASKS];
+    void* pointers[NB_TASKS];
+
+    const size_t workers[] = { 1, 3, 0, NB_TASKS * 2 };
+    for (size_t w = 0; w < sizeof(workers) / sizeof(workers[0]); ++w) {
+        unsigned int expected = 0;
+        atomic_init(&total_runs, 0);
+        for (size_t i = 0; i < NB_TASKS; ++i) {
+            // a few long tasks among many short ones
+            tasks[i].slices = (i % 17 == 0) ? 500 : 1 + (unsigned int) rand() % 5;
+            tasks[i].runs = 0;
+            atomic_init(&(tasks[i].running), 0);
+            atomic_init(&(tasks[i].overlaps), 0);
+            expected += tasks[i].slices;
+            pointers[i] = tasks + i;
+        }
+
+        ck_assert_err_none(work_pool_run(workers[w], pointers, NB_TASKS, slice));
+
+        ck_assert_uint_eq(atomic_load(&total_runs), expected);
+        for (size_t i = 0; i < NB_TASKS; ++i) {
+            ck_assert_uint_eq(tasks[i].slices, 0);
+            ck_assert_int_eq(atomic_load(&(tasks[i].overlaps)), 0);
+        }
+    }
+
+#ifdef WITH_PRINT
+    printf("=== END of %s\n", __func__);
+#endif
+}
+END_TEST
+
+Suite* work_pool_test_suite()
+{
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wsign-conversion"
+#pragma GCC diagnostic ignored "-Wconversion"
+    srand(time(NULL) ^ getpid() ^ pthread_self());
+#pragma GCC diagnostic pop
+
+    Suite* s = suite_create("work_pool.c Tests");
+
+    Add_Case(s, tc1, "Work Pool Tests");
+    tcase_add_test(tc1, work_pool_err);
+    tcase_add_test(tc1, work_pool_run_exec);
+
+    return s;
+}
+
+TEST_SUITE(work_pool_test_suite)
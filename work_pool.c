@@ -0,0 +1,230 @@
+/**
+ * @file work_pool.c
+ * @brief Work-stealing thread pool running time-sliced tasks to completion
+ *
+ * @date 2020
+ */
+
+#include <stdlib.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include "work_pool.h"
+#include "error.h"
+
+/**
+ * @brief Deque of task indexes, as a ring. Its capacity is the number of
+ *        tasks, since a task is in at most one deque at a time.
+ */
+typedef struct {
+    pthread_mutex_t lock;
+    size_t* slots;
+    size_t head;
+    size_t count;
+} deque_t;
+
+typedef struct pool_ pool_t;
+
+typedef struct {
+    pool_t* pool;
+    size_t id;
+} worker_t;
+
+struct pool_ {
+    void* const* tasks;
+    size_t capacity; // number of tasks
+    work_fn fn;
+    deque_t* deques;
+    worker_t* workers;
+    size_t nb_workers;
+    atomic_size_t remaining; // tasks not done yet
+    atomic_size_t queued;    // tasks waiting in a deque
+    pthread_mutex_t idle_lock;
+    pthread_cond_t wakeup;   // a task was queued, or the last one is done
+};
+
+// ======================================================================
+static int deque_pop_head(deque_t* d, size_t capacity, size_t* task)
+{
+    pthread_mutex_lock(&(d -> lock));
+    const int found = d -> count > 0;
+    if (found) {
+        *task = d -> slots[d -> head];
+        d -> head = (d -> head + 1) % capacity;
+        --(d -> count);
+    }
+    pthread_mutex_unlock(&(d -> lock));
+    return found;
+}
+
+// ======================================================================
+static int deque_steal_tail(deque_t* d, size_t capacity, size_t* task)
+{
+    pthread_mutex_lock(&(d -> lock));
+    const int found = d -> count > 0;
+    if (found) {
+        --(d -> count);
+        *task = d -> slots[(d -> head + d -> count) % capacity];
+    }
+    pthread_mutex_unlock(&(d -> lock));
+    return found;
+}
+
+// ======================================================================
+static void deque_push_tail(deque_t* d, size_t capacity, size_t task)
+{
+    pthread_mutex_lock(&(d -> lock));
+    d -> slots[(d -> head + d -> count) % capacity] = task;
+    ++(d -> count);
+    pthread_mutex_unlock(&(d -> lock));
+}
+
+// ======================================================================
+/**
+ * @brief wakes up idle workers; the lock makes sure none of them is between
+ *        its check and its wait
+ */
+static void pool_wake(pool_t* pool, int all)
+{
+    pthread_mutex_lock(&(pool -> idle_lock));
+    if (all) {
+        pthread_cond_broadcast(&(pool -> wakeup));
+    } else {
+        pthread_cond_signal(&(pool -> wakeup));
+    }
+    pthread_mutex_unlock(&(pool -> idle_lock));
+}
+
+// ======================================================================
+static void* worker_main(void* arg)
+{
+    const worker_t* const self = arg;
+    pool_t* const pool = self -> pool;
+    deque_t* const own = pool -> deques + self -> id;
+
+    while (atomic_load(&(pool -> remaining)) > 0) {
+        size_t task = 0;
+        int found = deque_pop_head(own, pool -> capacity, &task);
+        for (size_t i = 1; !found && i < pool -> nb_workers; ++i) {
+            found = deque_steal_tail(pool -> deques + (self -> id + i) % pool -> nb_workers,
+                                     pool -> capacity, &task);
+        }
+        if (!found) {
+            // the remaining tasks are running on other workers: sleep until
+            // one of them is queued again or the last one is done
+            pthread_mutex_lock(&(pool -> idle_lock));
+            while (atomic_load(&(pool -> queued)) == 0 && atomic_load(&(pool -> remaining)) > 0) {
+                pthread_cond_wait(&(pool -> wakeup), &(pool -> idle_lock));
+            }
+            pthread_mutex_unlock(&(pool -> idle_lock));
+            continue;
+        }
+        atomic_fetch_sub(&(pool -> queued), 1);
+
+        if (pool -> fn(pool -> tasks[task]) == WORK_AGAIN) {
+            deque_push_tail(own, pool -> capacity, task);
+            atomic_fetch_add(&(pool -> queued), 1);
+            pool_wake(pool, 0);
+        } else if (atomic_fetch_sub(&(pool -> remaining), 1) == 1) {
+            pool_wake(pool, 1);
+        }
+    }
+    return NULL;
+}
+
+// ======================================================================
+size_t work_pool_default_workers(void)
+{
+    const long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    return cores > 0 ? (size_t) cores : 1;
+}
+
+// ======================================================================
+static void pool_free(pool_t* pool, size_t nb_deques)
+{
+    pthread_mutex_destroy(&(pool -> idle_lock));
+    pthread_cond_destroy(&(pool -> wakeup));
+    for (size_t i = 0; i < nb_deques; ++i) {
+        pthread_mutex_destroy(&(pool -> deques[i].lock));
+        free(pool -> deques[i].slots);
+    }
+    free(pool -> deques);
+    free(pool -> workers);
+}
+
+// ======================================================================
+int work_pool_run(size_t nb_workers, void* const tasks[], size_t nb_tasks, work_fn fn)
+{
+    M_REQUIRE_NON_NULL(fn);
+    if (nb_tasks == 0) return ERR_NONE;
+    M_REQUIRE_NON_NULL(tasks);
+
+    if (nb_workers == 0) nb_workers = work_pool_default_workers();
+    if (nb_workers > nb_tasks) nb_workers = nb_tasks;
+
+    pool_t pool = {
+        .tasks = tasks,
+        .capacity = nb_tasks,
+        .fn = fn,
+        .deques = calloc(nb_workers, sizeof(deque_t)),
+        .workers = calloc(nb_workers, sizeof(worker_t)),
+        .nb_workers = nb_workers
+    };
+    atomic_init(&(pool.remaining), nb_tasks);
+    atomic_init(&(pool.queued), nb_tasks);
+
+    pthread_mutex_init(&(pool.idle_lock), NULL);
+    pthread_cond_init(&(pool.wakeup), NULL);
+
+    size_t nb_deques = 0;
+    int err = (pool.deques == NULL || pool.workers == NULL) ? ERR_MEM : ERR_NONE;
+    for (; err == ERR_NONE && nb_deques < nb_workers; ++nb_deques) {
+        pool.deques[nb_deques].slots = calloc(nb_tasks, sizeof(size_t));
+        if (pool.deques[nb_deques].slots == NULL) {
+            err = ERR_MEM;
+            break;
+        }
+        pthread_mutex_init(&(pool.deques[nb_deques].lock), NULL);
+    }
+    if (err != ERR_NONE) {
+        if (pool.deques != NULL) {
+            pool_free(&pool, nb_deques);
+        } else {
+            free(pool.workers);
+            pthread_mutex_destroy(&(pool.idle_lock));
+            pthread_cond_destroy(&(pool.wakeup));
+        }
+        return err;
+    }
+
+    // round-robin dealing: every worker starts with its share
+    for (size_t t = 0; t < nb_tasks; ++t) {
+        deque_push_tail(pool.deques + t % nb_workers, nb_tasks, t);
+    }
+
+    // the calling thread is worker 0
+    pthread_t* threads = calloc(nb_workers, sizeof(pthread_t));
+    if (threads == NULL) {
+        pool_free(&pool, nb_deques);
+        return ERR_MEM;
+    }
+    size_t started = 1;
+    for (size_t i = 0; i < nb_workers; ++i) {
+        pool.workers[i].pool = &pool;
+        pool.workers[i].id = i;
+    }
+    for (; started < nb_workers; ++started) {
+        if (pthread_create(threads + started, NULL, worker_main, pool.workers + started) != 0) {
+            break; // fewer workers: the ones started steal the others' tasks
+        }
+    }
+    worker_main(pool.workers);
+    for (size_t i = 1; i < started; ++i) {
+        pthread_join(threads[i], NULL);
+    }
+
+    free(threads);
+    pool_free(&pool, nb_deques);
+    return ERR_NONE;
+}
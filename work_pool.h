@@ -0,0 +1,55 @@
+#pragma once
+
+/**
+ * @file work_pool.h
+ * @brief Work-stealing thread pool running time-sliced tasks to completion
+ *
+ * Tasks are dealt round-robin to one deque per worker. A worker runs one
+ * slice of the task at the head of its own deque; a task which is not done
+ * goes back to the tail, so that long tasks do not starve short ones. A
+ * worker whose deque is empty steals the task at the tail of another one.
+ *
+ * @date 2020
+ */
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief What a task slice tells the pool
+ */
+typedef enum {
+    WORK_DONE,  // task finished, never run again
+    WORK_AGAIN  // task to be run again later (next slice)
+} work_status_t;
+
+/**
+ * @brief Runs one slice of a task
+ */
+typedef work_status_t (*work_fn)(void* task);
+
+
+/**
+ * @brief Number of workers used when none is given (online cores, at least 1)
+ */
+size_t work_pool_default_workers(void);
+
+
+/**
+ * @brief Runs every task until it is done, then returns
+ *
+ * @param nb_workers number of worker threads (0 for work_pool_default_workers())
+ * @param tasks tasks, each given as is to fn
+ * @param nb_tasks number of tasks
+ * @param fn function running one slice of a task; a given task is never
+ *        run by two workers at the same time
+ * @return error code
+ */
+int work_pool_run(size_t nb_workers, void* const tasks[], size_t nb_tasks, work_fn fn);
+
+#ifdef __cplusplus
+}
+#endif